@@ -27,6 +27,7 @@ set(__INCLUDED_GR_BOOST_CMAKE TRUE)
 ########################################################################
 
 set(BOOST_REQUIRED_COMPONENTS
+    atomic
     date_time
     program_options
     filesystem
@@ -52,7 +53,7 @@ if(MSVC)
     endif(BOOST_ALL_DYN_LINK)
 endif(MSVC)
 
-find_package(Boost "1.35" COMPONENTS ${BOOST_REQUIRED_COMPONENTS})
+find_package(Boost "1.53" COMPONENTS ${BOOST_REQUIRED_COMPONENTS})
 
 # This does not allow us to disable specific versions. It is used
 # internally by cmake to know the formation newer versions. As newer
@@ -39,6 +39,7 @@ GR_CHECK_HDR_N_DEF(netinet/in.h HAVE_NETINET_IN_H)
 GR_CHECK_HDR_N_DEF(arpa/inet.h HAVE_ARPA_INET_H)
 GR_CHECK_HDR_N_DEF(byteswap.h HAVE_BYTESWAP_H)
 GR_CHECK_HDR_N_DEF(linux/ppdev.h HAVE_LINUX_PPDEV_H)
+GR_CHECK_HDR_N_DEF(linux/futex.h HAVE_LINUX_FUTEX_H)
 GR_CHECK_HDR_N_DEF(dev/ppbus/ppi.h HAVE_DEV_PPBUS_PPI_H)
 GR_CHECK_HDR_N_DEF(unistd.h HAVE_UNISTD_H)
 GR_CHECK_HDR_N_DEF(malloc.h HAVE_MALLOC_H)
@@ -169,6 +170,23 @@ CHECK_CXX_SOURCE_COMPILES("
 GR_ADD_COND_DEF(HAVE_SHM_OPEN)
 SET(CMAKE_REQUIRED_LIBRARIES)
 
+########################################################################
+CHECK_CXX_SOURCE_COMPILES("
+    #include <unistd.h>
+    #include <sys/syscall.h>
+    int main(){syscall(SYS_memfd_create, \"\", 0); return 0;}
+    " HAVE_MEMFD_CREATE
+)
+GR_ADD_COND_DEF(HAVE_MEMFD_CREATE)
+
+CHECK_CXX_SOURCE_COMPILES("
+    #include <unistd.h>
+    #include <sys/syscall.h>
+    int main(){syscall(SYS_mbind, 0, 0, 0, 0, 0, 0); return 0;}
+    " HAVE_MBIND
+)
+GR_ADD_COND_DEF(HAVE_MBIND)
+
 ########################################################################
 CHECK_CXX_SOURCE_COMPILES("
     #define _GNU_SOURCE
@@ -24,11 +24,14 @@
 #define INCLUDED_GR_BASIC_BLOCK_H
 
 #include <gnuradio/api.h>
+#include <gnuradio/attributes.h>
 #include <gnuradio/sptr_magic.h>
 #include <gnuradio/msg_accepter.h>
 #include <gnuradio/runtime_types.h>
 #include <gnuradio/io_signature.h>
+#include <gnuradio/msg_port_queue.h>
 #include <gnuradio/thread/thread.h>
+#include <boost/atomic.hpp>
 #include <boost/enable_shared_from_this.hpp>
 #include <boost/function.hpp>
 #include <boost/foreach.hpp>
@@ -64,17 +67,31 @@ namespace gr {
     typedef std::map<pmt::pmt_t , msg_handler_t, pmt::comparator> d_msg_handlers_t;
     d_msg_handlers_t d_msg_handlers;
 
-    typedef std::deque<pmt::pmt_t> msg_queue_t;
+    typedef boost::shared_ptr<msg_port_queue> msg_queue_t;
     typedef std::map<pmt::pmt_t, msg_queue_t, pmt::comparator> msg_queue_map_t;
     typedef std::map<pmt::pmt_t, msg_queue_t, pmt::comparator>::iterator msg_queue_map_itr;
     std::map<pmt::pmt_t, boost::shared_ptr<boost::condition_variable>, pmt::comparator> msg_queue_ready;
 
     gr::thread::mutex mutex;          //< protects all vars
 
+    // The queues themselves are lock-free; the mutex and condition
+    // variables are only used by threads that have to sleep on them.
+    gr::thread::condition_variable d_msg_space;	// a full queue drained
+    boost::atomic<int> d_msg_nreaders;	// threads in delete_head_blocking
+    boost::atomic<int> d_msg_nwriters;	// threads waiting for room
+    bool d_msg_backpressure;		// wait rather than drop when full
+
+    // Messages handed out by the deprecated get_iterator().
+    std::map<pmt::pmt_t, std::deque<pmt::pmt_t>, pmt::comparator> d_compat_msgs;
+
+    void msg_queue_popped();
+
   protected:
     friend class flowgraph;
     friend class flat_flowgraph; // TODO: will be redundant
     friend class tpb_thread_body;
+    friend class tpb_fused_thread_body;
+    friend class scheduler_pool;
 
     enum vcolor { WHITE, GREY, BLACK };
 
@@ -91,7 +108,9 @@ namespace gr {
     msg_queue_map_t msg_queue;
     std::vector<boost::any> d_rpc_vars; // container for all RPC variables
 
-    basic_block(void) {} // allows pure virtual interface sub-classes
+    // allows pure virtual interface sub-classes
+    basic_block(void)
+      : d_msg_nreaders(0), d_msg_nwriters(0), d_msg_backpressure(false) {}
 
     //! Protected constructor prevents instantiation by non-derived classes
     basic_block(const std::string &name,
@@ -135,6 +154,18 @@ namespace gr {
       }
     }
 
+    /*!
+     * Called after a message is queued; blocks override this to wake
+     * up the thread that runs them.
+     */
+    virtual void notify_msg_queued() {}
+
+    /*!
+     * Whether the thread that drains the message queues has finished,
+     * so that insert_tail stops waiting for room.
+     */
+    virtual bool msg_queues_finished() { return false; }
+
     // Message passing interface
     pmt::pmt_t d_message_subscribers;
 
@@ -214,14 +245,15 @@ namespace gr {
 
     //! is the queue empty?
     bool empty_p(pmt::pmt_t which_port) {
-      if(msg_queue.find(which_port) == msg_queue.end())
+      msg_queue_map_itr q = msg_queue.find(which_port);
+      if(q == msg_queue.end())
         throw std::runtime_error("port does not exist!");
-      return msg_queue[which_port].empty();
+      return q->second->empty();
     }
     bool empty_p() {
       bool rv = true;
       BOOST_FOREACH(msg_queue_map_t::value_type &i, msg_queue) {
-        rv &= msg_queue[i.first].empty();
+        rv &= i.second->empty();
       }
       return rv;
     }
@@ -240,12 +272,33 @@ namespace gr {
 
     //! How many messages in the queue?
     size_t nmsgs(pmt::pmt_t which_port) {
-      if(msg_queue.find(which_port) == msg_queue.end())
+      msg_queue_map_itr q = msg_queue.find(which_port);
+      if(q == msg_queue.end())
+        throw std::runtime_error("port does not exist!");
+      return q->second->size();
+    }
+
+    //! How many messages were dropped because the queue was full?
+    uint64_t nmsgs_dropped(pmt::pmt_t which_port) {
+      msg_queue_map_itr q = msg_queue.find(which_port);
+      if(q == msg_queue.end())
         throw std::runtime_error("port does not exist!");
-      return msg_queue[which_port].size();
+      return q->second->ndropped();
+    }
+    uint64_t nmsgs_dropped() {
+      uint64_t n = 0;
+      BOOST_FOREACH(msg_queue_map_t::value_type &i, msg_queue) {
+        n += i.second->ndropped();
+      }
+      return n;
     }
 
-    //| Acquires and release the mutex
+    /*!
+     * Append \p msg to the queue of \p which_port and wake up the
+     * thread running the block. When the queue is full, either the
+     * oldest message is dropped (and counted) or, if the [DEFAULT]
+     * msg_backpressure pref is set, the caller waits for room.
+     */
     void insert_tail( pmt::pmt_t which_port, pmt::pmt_t msg);
     /*!
      * \returns returns pmt at head of queue or pmt::pmt_t() if empty.
@@ -259,13 +312,15 @@ namespace gr {
      */
     pmt::pmt_t delete_head_blocking(pmt::pmt_t which_port, unsigned int millisec = 0);
 
-    msg_queue_t::iterator get_iterator(pmt::pmt_t which_port) {
-      return msg_queue[which_port].begin();
-    }
-
-    void erase_msg(pmt::pmt_t which_port, msg_queue_t::iterator it) {
-      msg_queue[which_port].erase(it);
-    }
+    /*!
+     * \brief Remove up to \p max messages from the head of the queue.
+     * \param[in] which_port The message port from which to get the messages.
+     * \param[out] msgs Replaced by the messages, oldest first.
+     * \param[in] max Maximum number of messages to remove.
+     * \returns the number of messages removed.
+     */
+    size_t delete_head_batch(pmt::pmt_t which_port, std::vector<pmt::pmt_t> &msgs,
+                             size_t max = 64);
 
     virtual bool has_msg_port(pmt::pmt_t which_port) {
       if(msg_queue.find(which_port) != msg_queue.end()) {
@@ -277,6 +332,32 @@ namespace gr {
       return false;
     }
 
+    /*!
+     * \brief DEPRECATED. Will be removed in 3.8.
+     *
+     * The queues are lock-free rings now, so this returns an
+     * iterator into a copy of the messages queued on \p which_port,
+     * oldest first. The copy is valid until the next call.
+     *
+     * To make the copy it empties the queue and pushes the messages
+     * back. Only call it from the block's own thread: a message
+     * posted meanwhile can end up ahead of the ones taken out, or be
+     * dropped if the queue fills up.
+     */
+    std::deque<pmt::pmt_t>::iterator get_iterator(pmt::pmt_t which_port)
+      __GR_ATTR_DEPRECATED;
+
+    /*!
+     * \brief DEPRECATED. Will be removed in 3.8.
+     *
+     * Removes the message \p it refers to, from an earlier
+     * get_iterator(), from the queue of \p which_port. Like
+     * get_iterator(), it empties the queue and pushes back the rest,
+     * so it can reorder or drop messages posted meanwhile.
+     */
+    void erase_msg(pmt::pmt_t which_port, std::deque<pmt::pmt_t>::iterator it)
+      __GR_ATTR_DEPRECATED;
+
     const msg_queue_map_t& get_msg_map(void) const {
       return msg_queue;
     }
@@ -257,6 +257,24 @@ namespace gr {
      */
     double relative_rate() const { return d_relative_rate; }
 
+    /*!
+     * \brief Declare that work() still gives the right answer when
+     * its output buffer is its input buffer.
+     *
+     * That holds when output item i only depends on input item i,
+     * as in a 1:1 sync_block with one input, one output of the same
+     * item size and no history. If such a block is the only reader of
+     * its upstream buffer, the flowgraph lets it write its output
+     * over its input rather than into a buffer of its own. The
+     * default is false.
+     */
+    void set_in_place(bool in_place) { d_in_place = in_place; }
+
+    /*!
+     * \brief True if the block declared it can work in place.
+     */
+    bool in_place() const { return d_in_place; }
+
     /*
      * The following two methods provide special case info to the
      * scheduler in the event that a block has a fixed input to output
@@ -563,6 +581,49 @@ namespace gr {
      */
     float pc_throughput_avg();
 
+    /*!
+     * \brief Gets the number of messages dropped because one of
+     * the block's message queues was full.
+     */
+    float pc_msgs_dropped();
+
+    /*!
+     * \brief Gets the number of calls to work. This and the
+     * counters below are kept unless [PerfCounters] stats is off,
+     * whether or not the library was built with performance counters.
+     */
+    float pc_work_calls();
+
+    /*!
+     * \brief Gets the histogram of time spent in each call to work:
+     * element i counts the calls that took 2^i to 2^(i+1) ticks.
+     */
+    std::vector<float> pc_work_time_hist();
+
+    /*!
+     * \brief Gets the total clock ticks spent blocked waiting for
+     * input.
+     */
+    float pc_input_blocked_time();
+
+    /*!
+     * \brief Gets the total clock ticks spent blocked waiting for
+     * output buffer space.
+     */
+    float pc_output_blocked_time();
+
+    /*!
+     * \brief Gets the number of times the block was woken up after
+     * being blocked.
+     */
+    float pc_wakeups();
+
+    /*!
+     * \brief Gets the total clock ticks spent waiting for buffer
+     * locks.
+     */
+    float pc_lock_wait_time();
+
     /*!
      * \brief Resets the performance counters
      */
@@ -637,6 +698,12 @@ namespace gr {
     bool finished();
 
   private:
+    //! Wakes up the thread running us when a message is queued.
+    void notify_msg_queued();
+
+    //! Whether the thread running us is done.
+    bool msg_queues_finished();
+
     int                   d_output_multiple;
     bool                  d_output_multiple_set;
     int                   d_unaligned;
@@ -646,6 +713,7 @@ namespace gr {
     unsigned              d_history;
     unsigned              d_attr_delay;         // the block's sample delay
     bool                  d_fixed_rate;
+    bool                  d_in_place;	// work() may have output == input
     bool                  d_max_noutput_items_set;     // if d_max_noutput_items is valid
     int                   d_max_noutput_items;         // value of max_noutput_items for this block
     int                   d_min_noutput_items;
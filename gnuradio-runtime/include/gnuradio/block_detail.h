@@ -28,6 +28,8 @@
 #include <gnuradio/tpb_detail.h>
 #include <gnuradio/tags.h>
 #include <gnuradio/high_res_timer.h>
+#include <boost/atomic.hpp>
+#include <stdint.h>
 #include <stdexcept>
 
 namespace gr {
@@ -123,6 +125,18 @@ namespace gr {
      */
     void remove_item_tag(unsigned int which_input, const tag_t &tag, long id);
 
+    /*!
+     * \brief  Removes several tags from the given input stream.
+     *
+     * Calls gr::buffer::remove_item_tags(), which takes the buffer's
+     * lock once for all of them.
+     *
+     * \param which_input  an integer of which input stream to remove the tags from
+     * \param tags the tag objects to remove
+     * \param id The unique block ID (use gr::block::unique_id())
+     */
+    void remove_item_tags(unsigned int which_input, const std::vector<tag_t> &tags, long id);
+
     /*!
      * \brief Given a [start,end), returns a vector of all tags in the range.
      *
@@ -231,6 +245,46 @@ namespace gr {
 
     float pc_work_time_total();
 
+    // Counters kept by the block's executor unless [PerfCounters]
+    // stats is off and trace isn't on. Times are high_res_timer ticks. Only
+    // the block's thread adds to them, so they're relaxed atomics
+    // that anyone may read.
+    static const int PC_WORK_HIST_SIZE = 32;
+
+    void add_work_time(high_res_timer_type ticks);
+    void add_blocked_time(bool input, high_res_timer_type ticks);
+    void add_lock_wait_time(high_res_timer_type ticks) { add(d_pc_lock_wait_time, ticks); }
+
+    //! Number of calls to work().
+    uint64_t pc_work_calls() const { return d_pc_work_calls.load(boost::memory_order_relaxed); }
+
+    //! Calls to work() by how long they took: element i counts the
+    //! calls that took [2^i, 2^(i+1)) ticks.
+    std::vector<uint64_t> pc_work_time_hist() const;
+
+    //! Time spent blocked waiting for input or for output space.
+    uint64_t pc_input_blocked_time() const
+    { return d_pc_input_blocked_time.load(boost::memory_order_relaxed); }
+    uint64_t pc_output_blocked_time() const
+    { return d_pc_output_blocked_time.load(boost::memory_order_relaxed); }
+
+    //! Number of times the block was run again after being blocked.
+    uint64_t pc_wakeups() const { return d_pc_wakeups.load(boost::memory_order_relaxed); }
+
+    //! Time spent waiting for buffer locks.
+    uint64_t pc_lock_wait_time() const
+    { return d_pc_lock_wait_time.load(boost::memory_order_relaxed); }
+
+    /*!
+     * \brief Number of blocks on the longest stream path through
+     * this block, from a source to a sink.
+     *
+     * Set by the flowgraph when a latency target is configured; the
+     * executor divides the target between the blocks on the path.
+     */
+    int path_depth() const { return d_path_depth; }
+    void set_path_depth(int depth) { d_path_depth = depth; }
+
     tpb_detail d_tpb;	// used by thread-per-block scheduler
     int d_produce_or;
 
@@ -242,6 +296,7 @@ namespace gr {
     std::vector<buffer_reader_sptr> d_input;
     std::vector<buffer_sptr>        d_output;
     bool                            d_done;
+    int                             d_path_depth;
 
     // Performance counters
     float d_ins_noutput_items;
@@ -267,8 +322,24 @@ namespace gr {
     float d_avg_throughput;
     float d_pc_counter;
 
+    boost::atomic<uint64_t> d_pc_work_calls;
+    boost::atomic<uint64_t> d_pc_work_time_hist[PC_WORK_HIST_SIZE];
+    boost::atomic<uint64_t> d_pc_input_blocked_time;
+    boost::atomic<uint64_t> d_pc_output_blocked_time;
+    boost::atomic<uint64_t> d_pc_wakeups;
+    boost::atomic<uint64_t> d_pc_lock_wait_time;
+
+    // A single writer doesn't need a locked add.
+    static void add(boost::atomic<uint64_t> &counter, uint64_t n)
+    {
+      counter.store(counter.load(boost::memory_order_relaxed) + n,
+                    boost::memory_order_relaxed);
+    }
+
     block_detail(unsigned int ninputs, unsigned int noutputs);
 
+    void reset_stats();
+
     friend struct tpb_detail;
 
     friend GR_RUNTIME_API block_detail_sptr
@@ -24,12 +24,18 @@
 #define INCLUDED_GR_RUNTIME_BUFFER_H
 
 #include <gnuradio/api.h>
+#include <gnuradio/attributes.h>
 #include <gnuradio/runtime_types.h>
 #include <gnuradio/tags.h>
+#include <gnuradio/tag_store.h>
 #include <boost/weak_ptr.hpp>
+#include <boost/atomic.hpp>
 #include <gnuradio/thread/thread.h>
 #include <map>
 
+//! Padding used to keep the buffer indices on separate cache lines
+#define GR_BUFFER_CACHE_LINE_SIZE 64
+
 namespace gr {
 
   class vmcircbuf;
@@ -44,9 +50,30 @@ namespace gr {
    * \param nitems is the minimum number of items the buffer will hold.
    * \param sizeof_item is the size of an item in bytes.
    * \param link is the block that writes to this buffer.
+   * \param lock_free if true, the read and write indices are published
+   *        through atomics and the scheduler does not take the buffer
+   *        mutex to query or update them (see buffer::lock_free()).
    */
   GR_RUNTIME_API buffer_sptr make_buffer(int nitems, size_t sizeof_item,
-                                         block_sptr link=block_sptr());
+                                         block_sptr link=block_sptr(),
+                                         bool lock_free=false);
+
+  /*!
+   * \brief Make a buffer that shares the memory of \p upstream.
+   *
+   * For a block that works in place (see block::in_place()): the
+   * block reads \p upstream through its only reader and writes its
+   * output over the items it just read. The returned buffer's write
+   * index starts at and keeps pace with that reader's read index, so
+   * the block's output pointer is its input pointer. \p upstream
+   * won't hand out space still holding items the new buffer's
+   * readers haven't consumed.
+   *
+   * \param upstream is the buffer the block reads from.
+   * \param link is the block that writes to the new buffer.
+   */
+  GR_RUNTIME_API buffer_sptr make_in_place_buffer(buffer_sptr upstream,
+                                                  block_sptr link);
 
   /*!
    * \brief Single writer, multiple reader fifo.
@@ -86,19 +113,37 @@ namespace gr {
     void update_write_pointer(int nitems);
 
     void set_done(bool done);
-    bool done() const { return d_done; }
+    bool done() const { return d_done.load(boost::memory_order_acquire); }
+
+    /*!
+     * \brief True if this buffer runs in lock-free index mode.
+     *
+     * In this mode the write index and each reader's read index are
+     * published with release semantics and read with acquire
+     * semantics, so callers don't need to hold mutex() around
+     * space_available(), items_available(), update_write_pointer(),
+     * update_read_pointer() or done(). The mutex still protects the
+     * tags.
+     */
+    bool lock_free() const { return d_lock_free; }
 
     /*!
      * \brief Return the block that writes to this buffer.
      */
     block_sptr link() { return block_sptr(d_link); }
 
+    /*!
+     * \brief The buffer whose memory this one shares, if it was made
+     * by make_in_place_buffer(); null otherwise.
+     */
+    buffer_sptr in_place_of() const { return d_in_place_of; }
+
     size_t nreaders() const { return d_readers.size(); }
     buffer_reader* reader(size_t index) { return d_readers[index]; }
 
     gr::thread::mutex *mutex() { return &d_mutex; }
 
-    uint64_t nitems_written() { return d_abs_write_offset; }
+    uint64_t nitems_written() { return d_abs_write_offset.load(boost::memory_order_acquire); }
 
     size_t get_sizeof_item() { return d_sizeof_item; }
 
@@ -109,20 +154,43 @@ namespace gr {
      */
     void add_item_tag(const tag_t &tag);
 
+    /*!
+     * \brief  Adds several tags to the buffer under one lock.
+     *
+     * \param tags       the new tags
+     */
+    void add_item_tags(const std::vector<tag_t> &tags);
+
+    /*!
+     * \brief One past the largest offset of any tag ever added, or 0
+     * if there never was one.
+     *
+     * Readers use this to skip the tag store without taking the
+     * mutex when they can't have anything in range.
+     */
+    uint64_t tags_end() const { return d_tags_end.load(boost::memory_order_acquire); }
+
     /*!
      * \brief  Removes an existing tag from the buffer.
      *
      * If no such tag is found, does nothing.
      * Note: Doesn't actually physically delete the tag, but
-     * marks it as deleted. For the user, this has the same effect:
-     * Any subsequent calls to get_tags_in_range() will not return
-     * the tag.
+     * marks it as deleted for every reader belonging to block \p id.
+     * For the user, this has the same effect: Any subsequent calls
+     * to get_tags_in_range() from that block will not return the tag.
      *
      * \param tag        the tag that needs to be removed
      * \param id         the unique ID of the block calling this function
      */
     void remove_item_tag(const tag_t &tag, long id);
 
+    /*!
+     * \brief  Removes several tags under one lock.
+     *
+     * Same as calling remove_item_tag() for each of \p tags.
+     */
+    void remove_item_tags(const std::vector<tag_t> &tags, long id);
+
     /*!
      * \brief  Removes all tags before \p max_time from buffer
      *
@@ -130,16 +198,40 @@ namespace gr {
      */
     void prune_tags(uint64_t max_time);
 
-    std::multimap<uint64_t,tag_t>::iterator get_tags_begin() { return d_item_tags.begin(); }
-    std::multimap<uint64_t,tag_t>::iterator get_tags_end() { return d_item_tags.end(); }
-    std::multimap<uint64_t,tag_t>::iterator get_tags_lower_bound(uint64_t x) { return d_item_tags.lower_bound(x); }
-    std::multimap<uint64_t,tag_t>::iterator get_tags_upper_bound(uint64_t x) { return d_item_tags.upper_bound(x); }
+    /*!
+     * \brief DEPRECATED. Will be removed in 3.8; use
+     * buffer_reader::get_tags_in_range() instead.
+     *
+     * The tags no longer live in a multimap. These return iterators
+     * into a copy of them, made again whenever the tags have changed
+     * since the last call; marked_deleted holds the unique IDs of the
+     * blocks that deleted each tag. Call them with mutex() held, and
+     * don't mix iterators from before and after a change.
+     */
+    std::multimap<uint64_t,tag_t>::iterator get_tags_begin() __GR_ATTR_DEPRECATED
+    { return compat_tags().begin(); }
+    std::multimap<uint64_t,tag_t>::iterator get_tags_end() __GR_ATTR_DEPRECATED
+    { return compat_tags().end(); }
+    std::multimap<uint64_t,tag_t>::iterator get_tags_lower_bound(uint64_t x) __GR_ATTR_DEPRECATED
+    { return compat_tags().lower_bound(x); }
+    std::multimap<uint64_t,tag_t>::iterator get_tags_upper_bound(uint64_t x) __GR_ATTR_DEPRECATED
+    { return compat_tags().upper_bound(x); }
+
+    //! Number of tags currently held (for tests and debugging).
+    size_t ntags()
+    {
+      gr::thread::scoped_lock guard(d_mutex);
+      return d_item_tags.size();
+    }
 
     // -------------------------------------------------------------------------
 
   private:
     friend class buffer_reader;
-    friend GR_RUNTIME_API buffer_sptr make_buffer(int nitems, size_t sizeof_item, block_sptr link);
+    friend GR_RUNTIME_API buffer_sptr make_buffer(int nitems, size_t sizeof_item,
+                                                  block_sptr link, bool lock_free);
+    friend GR_RUNTIME_API buffer_sptr make_in_place_buffer(buffer_sptr upstream,
+                                                           block_sptr link);
     friend GR_RUNTIME_API buffer_reader_sptr buffer_add_reader
       (buffer_sptr buf, int nzero_preload, block_sptr link, int delay);
 
@@ -155,18 +247,40 @@ namespace gr {
     size_t	 			d_sizeof_item;	// in bytes
     std::vector<buffer_reader *>	d_readers;
     boost::weak_ptr<block>		d_link;		// block that writes to this buffer
+    bool				d_lock_free;
+    buffer_sptr				d_in_place_of;	// whose memory we share
+    std::vector<buffer *>		d_in_place;	// buffers sharing ours
+    boost::atomic<bool>			d_has_in_place;	// !d_in_place.empty()
+
+    // Only used in the buffer that owns the memory (see
+    // in_place_mutex()). Protects d_in_place and d_readers of every
+    // buffer sharing it, which may change while its writer runs
+    // during an incremental reconfiguration.
+    gr::thread::mutex			d_in_place_mutex;
 
     //
-    // The mutex protects d_write_index, d_abs_write_offset, d_done, d_item_tags
-    // and the d_read_index's and d_abs_read_offset's in the buffer readers.
+    // Unless d_lock_free is set, the mutex protects d_write_index,
+    // d_abs_write_offset, d_done and the d_read_index's and
+    // d_abs_read_offset's in the buffer readers. It always protects
+    // d_item_tags. d_tags_end is only written with it held.
     //
     gr::thread::mutex			d_mutex;
-    unsigned int			d_write_index;	// in items [0,d_bufsize)
-    uint64_t                            d_abs_write_offset; // num items written since the start
-    bool				d_done;
-    std::multimap<uint64_t,tag_t>                   d_item_tags;
+    tag_store				d_item_tags;
+    boost::atomic<uint64_t>		d_tags_end;	// see tags_end()
+
+    // Copy of d_item_tags for the deprecated get_tags_* accessors
+    std::multimap<uint64_t,tag_t>	d_compat_tags;
+    uint64_t				d_compat_version;
     uint64_t                            d_last_min_items_read;
 
+    // The writer's indices live on their own cache line so that
+    // readers polling them don't false-share with the fields above.
+    char				d_pad0[GR_BUFFER_CACHE_LINE_SIZE];
+    boost::atomic<unsigned int>		d_write_index;	// in items [0,d_bufsize)
+    boost::atomic<uint64_t>		d_abs_write_offset; // num items written since the start
+    boost::atomic<bool>			d_done;
+    char				d_pad1[GR_BUFFER_CACHE_LINE_SIZE];
+
     unsigned index_add(unsigned a, unsigned b)
     {
       unsigned s = a + b;
@@ -191,6 +305,18 @@ namespace gr {
 
     virtual bool allocate_buffer(int nitems, size_t sizeof_item);
 
+    //! Most items between \p write_index and any reader of the
+    //! buffers sharing our memory.
+    int in_place_data(unsigned write_index);
+
+    //! d_in_place_mutex of the buffer that owns our memory.
+    gr::thread::mutex &in_place_mutex();
+
+    std::multimap<uint64_t,tag_t> &compat_tags();
+
+    //! remove_item_tag() with the mutex already held.
+    void remove_item_tag_locked(const tag_t &tag, long id);
+
     /*!
      * \brief constructor is private.  Use gr_make_buffer to create instances.
      *
@@ -199,12 +325,16 @@ namespace gr {
      * \param nitems is the minimum number of items the buffer will hold.
      * \param sizeof_item is the size of an item in bytes.
      * \param link is the block that writes to this buffer.
+     * \param lock_free publish the indices through atomics only.
      *
      * The total size of the buffer will be rounded up to a system
      * dependent boundary.  This is typically the system page size, but
      * under MS windows is 64KB.
      */
-    buffer(int nitems, size_t sizeof_item, block_sptr link);
+    buffer(int nitems, size_t sizeof_item, block_sptr link, bool lock_free);
+
+    //! Constructor for make_in_place_buffer().
+    buffer(buffer_sptr upstream, block_sptr link);
 
     /*!
      * \brief disassociate \p reader from this buffer
@@ -283,10 +413,11 @@ namespace gr {
 
     void set_done(bool done) { d_buffer->set_done(done); }
     bool done() const { return d_buffer->done(); }
+    bool lock_free() const { return d_buffer->lock_free(); }
 
     gr::thread::mutex *mutex() { return d_buffer->mutex(); }
 
-    uint64_t nitems_read() { return d_abs_read_offset; }
+    uint64_t nitems_read() { return d_abs_read_offset.load(boost::memory_order_acquire); }
 
     size_t get_sizeof_item() { return d_buffer->get_sizeof_item(); }
 
@@ -308,6 +439,9 @@ namespace gr {
      * \param abs_start    a uint64 count of the start of the range of interest
      * \param abs_end      a uint64 count of the end of the range of interest
      * \param id           the unique ID of the block to make sure already deleted tags are not returned
+     *
+     * Deletions are tracked per reader, so \p id is expected to be
+     * the unique ID of the block that owns this reader.
      */
     void get_tags_in_range(std::vector<tag_t> &v,
                            uint64_t abs_start,
@@ -322,14 +456,21 @@ namespace gr {
       buffer_add_reader(buffer_sptr buf, int nzero_preload, block_sptr link, int delay);
 
     buffer_sptr  d_buffer;
-    unsigned int d_read_index;       // in items [0,d->buffer.d_bufsize)
-    uint64_t     d_abs_read_offset;  // num items seen since the start
     boost::weak_ptr<block> d_link;   // block that reads via this buffer reader
+    long         d_link_id;          // unique_id() of d_link, or -1
+    unsigned int d_tag_slot;         // our bit in the tag store's deletion bitmaps
     unsigned d_attr_delay;           // sample delay attribute for tag propagation
 
+    // Polled by the writer in space_available(); keep it off the
+    // cache line of the read-mostly fields above.
+    char                         d_pad0[GR_BUFFER_CACHE_LINE_SIZE];
+    boost::atomic<unsigned int>  d_read_index;       // in items [0,d->buffer.d_bufsize)
+    boost::atomic<uint64_t>      d_abs_read_offset;  // num items seen since the start
+    char                         d_pad1[GR_BUFFER_CACHE_LINE_SIZE];
+
     //! constructor is private.  Use gr::buffer::add_reader to create instances
     buffer_reader(buffer_sptr buffer, unsigned int read_index,
-                  block_sptr link);
+                  block_sptr link, unsigned int tag_slot);
   };
 
   //! returns # of buffer_readers currently allocated
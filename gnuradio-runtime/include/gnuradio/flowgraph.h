@@ -27,6 +27,7 @@
 #include <gnuradio/basic_block.h>
 #include <gnuradio/io_signature.h>
 #include <iostream>
+#include <map>
 
 namespace gr {
 
@@ -258,12 +259,23 @@ namespace gr {
     void check_contiguity(basic_block_sptr block, const std::vector<int> &used_ports, bool check_inputs);
 
     basic_block_vector_t calc_downstream_blocks(basic_block_sptr block);
-    basic_block_vector_t calc_reachable_blocks(basic_block_sptr block, basic_block_vector_t &blocks);
     void reachable_dfs_visit(basic_block_sptr block, basic_block_vector_t &blocks);
     basic_block_vector_t calc_adjacent_blocks(basic_block_sptr block, basic_block_vector_t &blocks);
     basic_block_vector_t sort_sources_first(basic_block_vector_t &blocks);
     bool source_p(basic_block_sptr block);
     void topological_dfs_visit(basic_block_sptr block, basic_block_vector_t &output);
+
+    // Each block's stream edges, in d_edges order, kept in step with
+    // d_edges so looking up a block's neighbors doesn't mean
+    // scanning every edge in the graph.
+    struct block_edges {
+      edge_vector_t inputs;
+      edge_vector_t outputs;
+    };
+    typedef std::map<basic_block_sptr, block_edges> edge_index_t;
+    edge_index_t d_edge_index;
+
+    const block_edges &indexed_edges(basic_block_sptr block) const;
   };
 
   // Convenience functions
@@ -0,0 +1,110 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2016 Free Software Foundation, Inc.
+ *
+ * This file is part of GNU Radio
+ *
+ * GNU Radio is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * GNU Radio is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GNU Radio; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef INCLUDED_GR_RUNTIME_MSG_PORT_QUEUE_H
+#define INCLUDED_GR_RUNTIME_MSG_PORT_QUEUE_H
+
+#include <gnuradio/api.h>
+#include <pmt/pmt.h>
+#include <boost/atomic.hpp>
+#include <boost/noncopyable.hpp>
+#include <vector>
+
+namespace gr {
+
+  /*!
+   * \brief Bounded lock-free queue of messages for one input message
+   * port of a block.
+   * \ingroup internal
+   *
+   * A fixed ring of cells, each with a sequence number that tells
+   * producers and consumers whose turn it is to use it (D. Vyukov's
+   * bounded MPMC queue). Any number of threads may push; the block's
+   * thread pops, but so may a producer making room by discarding the
+   * oldest message, so popping is safe from any thread as well.
+   *
+   * The capacity is the requested limit rounded up to a power of
+   * two. The ring is only allocated when the first message is
+   * pushed, since most ports never see one. The queue only counts
+   * drops; whether to drop or wait when
+   * it's full is up to the caller (see basic_block::insert_tail).
+   */
+  class GR_RUNTIME_API msg_port_queue : boost::noncopyable
+  {
+  public:
+    explicit msg_port_queue(size_t limit);
+    ~msg_port_queue();
+
+    /*!
+     * \brief Append \p msg.
+     * \returns false if the queue is full.
+     */
+    bool push(const pmt::pmt_t &msg);
+
+    /*!
+     * \brief Remove the oldest message and store it in \p msg.
+     * \returns false if the queue is empty.
+     */
+    bool pop(pmt::pmt_t &msg);
+
+    /*!
+     * \brief Replace the contents of \p msgs with up to \p max of
+     * the oldest messages.
+     * \returns the number of messages removed.
+     */
+    size_t pop_batch(std::vector<pmt::pmt_t> &msgs, size_t max);
+
+    //! Number of messages queued (a snapshot when others are active).
+    size_t size() const;
+    bool empty() const { return size() == 0; }
+
+    //! Maximum number of messages held.
+    size_t capacity() const { return d_mask + 1; }
+
+    //! Count a message that was dropped instead of queued.
+    void add_dropped() { d_ndropped.fetch_add(1, boost::memory_order_relaxed); }
+
+    //! Number of messages dropped so far.
+    uint64_t ndropped() const { return d_ndropped.load(boost::memory_order_relaxed); }
+
+  private:
+    struct cell {
+      boost::atomic<size_t> seq;
+      pmt::pmt_t            msg;
+    };
+
+    // Keep the producer and consumer positions on their own cache lines.
+    boost::atomic<cell*>    d_cells;	// null until the first push
+    size_t                  d_mask;
+    char                    d_pad0[64];
+    boost::atomic<size_t>   d_tail;	// next position to push
+    char                    d_pad1[64];
+    boost::atomic<size_t>   d_head;	// next position to pop
+    char                    d_pad2[64];
+    boost::atomic<uint64_t> d_ndropped;
+
+    cell *cells();
+  };
+
+} /* namespace gr */
+
+#endif /* INCLUDED_GR_RUNTIME_MSG_PORT_QUEUE_H */
@@ -0,0 +1,131 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2016 Free Software Foundation, Inc.
+ *
+ * This file is part of GNU Radio
+ *
+ * GNU Radio is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * GNU Radio is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GNU Radio; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef INCLUDED_GR_RUNTIME_PERF_TRACE_H
+#define INCLUDED_GR_RUNTIME_PERF_TRACE_H
+
+#include <gnuradio/api.h>
+#include <gnuradio/high_res_timer.h>
+#include <gnuradio/thread/thread.h>
+#include <boost/atomic.hpp>
+#include <stdint.h>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace gr {
+
+  /*!
+   * \brief A fixed-size ring of scheduler events (calls to work(),
+   * time spent blocked) for finding the bottleneck in a running
+   * flowgraph.
+   * \ingroup internal
+   *
+   * Enabled by [PerfCounters] trace; [PerfCounters] trace_size sets
+   * the number of events kept (rounded up to a power of two), after
+   * which the oldest are overwritten. Adding an event is one atomic
+   * increment and a 24-byte store, so it can be left on.
+   *
+   * If [PerfCounters] trace_file is set, the trace is written there
+   * when a top_block's wait() returns (not when lock() and unlock()
+   * restart it): as Chrome trace event
+   * JSON (chrome://tracing, Perfetto) if the name ends in ".json",
+   * otherwise in the binary format written by write_binary().
+   */
+  class GR_RUNTIME_API perf_trace
+  {
+  public:
+    enum event_type {
+      WORK = 0,			// a call to general_work()
+      BLOCKED_INPUT = 1,	// waiting for input
+      BLOCKED_OUTPUT = 2	// waiting for output space
+    };
+
+    struct record {
+      uint64_t start;		// high_res_timer ticks
+      uint32_t duration;	// ticks, saturated
+      uint32_t block;		// basic_block::unique_id()
+      uint32_t nitems;		// items produced (WORK)
+      uint32_t type;		// event_type
+    };
+
+    static perf_trace *singleton();
+
+    perf_trace(size_t capacity);
+
+    bool enabled() const { return d_enabled; }
+    void set_enabled(bool enabled) { d_enabled = enabled; }
+
+    //! Remember a block's name for the exported trace.
+    void register_block(uint32_t id, const std::string &name);
+
+    void add(event_type type, uint32_t block,
+             high_res_timer_type start, high_res_timer_type duration,
+             uint32_t nitems=0)
+    {
+      uint64_t i = d_next.fetch_add(1, boost::memory_order_relaxed);
+      record &r = d_ring[i & d_mask];
+      r.start = start;
+      r.duration = duration > 0xffffffffLL ? 0xffffffffU : (uint32_t)duration;
+      r.block = block;
+      r.nitems = nitems;
+      r.type = type;
+    }
+
+    size_t capacity() const { return d_ring.size(); }
+
+    //! Number of events held, at most capacity().
+    size_t size() const;
+
+    //! The events held, oldest first. Events added while this runs
+    //! may come out torn, so call it once the flowgraph stops.
+    std::vector<record> records() const;
+
+    void clear();
+
+    /*!
+     * Write the trace in a compact binary form, in host byte order:
+     * the 8 bytes "GRTRACE1", the ticks per second (uint64), the
+     * number of blocks (uint32) followed by each block's id (uint32),
+     * name length (uint32) and name, then the number of events
+     * (uint64) followed by the records.
+     */
+    bool write_binary(const std::string &filename) const;
+
+    //! Write the trace as Chrome trace event JSON, one row per block.
+    bool write_chrome(const std::string &filename) const;
+
+    //! Write to filename in the format its extension picks.
+    bool write(const std::string &filename) const;
+
+  private:
+    bool                          d_enabled;
+    std::vector<record>           d_ring;
+    uint64_t                      d_mask;
+    boost::atomic<uint64_t>       d_next;
+    mutable gr::thread::mutex     d_names_mutex;
+    std::map<uint32_t, std::string> d_names;
+  };
+
+} /* namespace gr */
+
+#endif /* INCLUDED_GR_RUNTIME_PERF_TRACE_H */
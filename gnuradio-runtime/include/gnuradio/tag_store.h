@@ -0,0 +1,115 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2016 Free Software Foundation, Inc.
+ *
+ * This file is part of GNU Radio
+ *
+ * GNU Radio is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * GNU Radio is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GNU Radio; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef INCLUDED_GR_RUNTIME_TAG_STORE_H
+#define INCLUDED_GR_RUNTIME_TAG_STORE_H
+
+#include <gnuradio/api.h>
+#include <gnuradio/tags.h>
+#include <vector>
+
+namespace gr {
+
+  /*!
+   * \brief Offset-sorted store of the tags held by a gr::buffer.
+   * \ingroup internal
+   *
+   * Tags live in a growable ring (power-of-two capacity) kept in
+   * ascending offset order, so that range lookups are a binary
+   * search, appending a tag at or after the newest offset is O(1)
+   * and pruning old tags just advances the head of the ring.
+   *
+   * Each buffer reader owns a slot; a per-tag bitmap records which
+   * slots have deleted the tag. The bitmaps are stored in a flat
+   * array parallel to the ring, one or more 64-bit words per tag.
+   *
+   * Not thread safe; the owning buffer serializes access.
+   */
+  class GR_RUNTIME_API tag_store
+  {
+  public:
+    tag_store();
+
+    //! Number of tags held.
+    size_t size() const { return d_size; }
+    bool empty() const { return d_size == 0; }
+
+    //! Changes whenever a tag is added, deleted or pruned.
+    uint64_t version() const { return d_version; }
+
+    //! Offset of the oldest tag; only valid if !empty().
+    uint64_t front_offset() const { return d_tags[d_head].offset; }
+
+    /*!
+     * \brief Insert \p tag, after any tags with the same offset.
+     *
+     * Tags arriving in offset order are appended in constant time.
+     * The tag's marked_deleted vector is not stored.
+     */
+    void add(const tag_t &tag);
+
+    //! Index of the first tag with offset >= \p offset.
+    size_t lower_bound(uint64_t offset) const;
+
+    //! Index of the first tag with offset > \p offset.
+    size_t upper_bound(uint64_t offset) const;
+
+    //! The \p i th tag in offset order.
+    const tag_t &at(size_t i) const { return d_tags[slot(i)]; }
+
+    //! Mark the \p i th tag deleted for reader \p reader_slot.
+    void mark_deleted(size_t i, unsigned int reader_slot);
+
+    //! True if reader \p reader_slot deleted the \p i th tag.
+    bool is_deleted(size_t i, unsigned int reader_slot) const
+    {
+      if(reader_slot >= d_nwords * 64)
+        return false;
+      return (d_deleted[slot(i) * d_nwords + reader_slot / 64]
+              >> (reader_slot % 64)) & 1;
+    }
+
+    //! Forget all deletions made by \p reader_slot (e.g. when it's reused).
+    void clear_reader(unsigned int reader_slot);
+
+    /*!
+     * \brief Drop all tags with offset < \p offset.
+     * \returns the number of tags removed.
+     */
+    size_t prune(uint64_t offset);
+
+  private:
+    std::vector<tag_t>    d_tags;     // ring, capacity is a power of 2
+    std::vector<uint64_t> d_deleted;  // d_nwords deletion words per ring entry
+    size_t                d_head;     // ring index of the oldest tag
+    size_t                d_size;
+    unsigned int          d_nwords;
+    uint64_t              d_version;
+
+    size_t slot(size_t i) const { return (d_head + i) & (d_tags.size() - 1); }
+
+    void reserve(size_t ntags, unsigned int nwords);
+  };
+
+} /* namespace gr */
+
+#endif /* INCLUDED_GR_RUNTIME_TAG_STORE_H */
@@ -39,10 +39,19 @@ namespace gr {
   private:
     pmt::pmt_t d_length_tag_key; //!< This is the key for the tag that stores the PDU length
     gr_vector_int d_n_input_items_reqd; //!< How many input items do I need to process the next PDU?
+    bool d_packet_vectors; //!< Hand work_packets() every complete PDU at once?
+    std::vector<std::vector<tag_t> > d_length_tags; //!< Length tags of the PDUs in a call, per input
+    std::vector<gr_vector_int> d_packet_lengths; //!< Items per input of the PDUs in a call
+    gr_vector_int d_packet_noutput_items; //!< Items produced per PDU in a call
+
+    int general_work_packets(int noutput_items,
+                             gr_vector_int &ninput_items,
+                             gr_vector_const_void_star &input_items,
+                             gr_vector_void_star &output_items);
 
   protected:
     std::string d_length_tag_key_str;
-    tagged_stream_block(void) {} // allows pure virtual interface sub-classes
+    tagged_stream_block(void) : d_packet_vectors(false) {} // allows pure virtual interface sub-classes
     tagged_stream_block(const std::string &name,
                         gr::io_signature::sptr input_signature,
                         gr::io_signature::sptr output_signature,
@@ -92,6 +101,35 @@ namespace gr {
      */
     virtual void update_length_tags(int n_produced, int n_ports);
 
+    /*!
+     * \brief Set the new length tags on the output stream for a
+     *        vector of PDUs
+     *
+     * Used instead of update_length_tags() when packet vectors are
+     * enabled. Default behaviour: Set a tag with key \p
+     * length_tag_key and the number of produced items on the first
+     * item of every non-empty PDU on every output port.
+     *
+     * \param packet_noutput_items Length of each new PDU
+     * \param n_ports Number of output ports
+     */
+    virtual void update_packet_length_tags(const gr_vector_int &packet_noutput_items,
+                                           int n_ports);
+
+    /*!
+     * \brief Hand over all complete PDUs at once.
+     *
+     * By default, work() is called once per PDU, so every PDU costs
+     * a trip through the scheduler. With packet vectors enabled,
+     * general_work() reads the length tags of everything on the
+     * inputs in one go and passes as many complete PDUs as fit into
+     * the output buffer to work_packets().
+     *
+     * Only the length tag key is looked at; blocks that override
+     * parse_length_tags() can't use this.
+     */
+    void enable_packet_vectors(bool enable) { d_packet_vectors = enable; }
+
   public:
     /*! \brief Don't override this.
      */
@@ -138,6 +176,34 @@ namespace gr {
                      gr_vector_int &ninput_items,
                      gr_vector_const_void_star &input_items,
                      gr_vector_void_star &output_items) = 0;
+
+    /*!
+     * \brief Process several PDUs in one call.
+     *
+     * Only called if enable_packet_vectors() was set. The PDUs lie
+     * back to back in \p input_items; \p packet_lengths[k][i] is the
+     * number of items of the k-th PDU on input i. The output buffer
+     * has room for calculate_output_stream_length() items of every
+     * one of them.
+     *
+     * All PDUs must be processed: write the number of items produced
+     * for the k-th PDU to \p packet_noutput_items[k] (one entry per
+     * PDU, preset to 0) and put their output back to back as well.
+     * The PDUs are consumed for you, and
+     * update_packet_length_tags() tags the outputs.
+     *
+     * The default implementation calls work() once per PDU with the
+     * pointers moved along. nitems_read() and nitems_written() stay
+     * at the start of the first PDU throughout, so blocks that tag
+     * their output from work() should override this.
+     *
+     * \return the total number of items produced, or WORK_DONE
+     */
+    virtual int work_packets(int noutput_items,
+                             const std::vector<gr_vector_int> &packet_lengths,
+                             gr_vector_int &packet_noutput_items,
+                             gr_vector_const_void_star &input_items,
+                             gr_vector_void_star &output_items);
   };
 
 }  /* namespace gr */
@@ -42,7 +42,7 @@ namespace gr {
     //! the source ID of \p tag (as a PMT)
     pmt::pmt_t srcid;
 
-    //! Used by gr_buffer to mark a tagged as deleted by a specific block. You can usually ignore this.
+    //! No longer used by gr::buffer, which tracks deleted tags per reader. You can usually ignore this.
     std::vector<long> marked_deleted;
 
     /*!
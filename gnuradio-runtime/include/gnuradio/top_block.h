@@ -25,6 +25,8 @@
 
 #include <gnuradio/api.h>
 #include <gnuradio/hier_block2.h>
+#include <utility>
+#include <vector>
 
 namespace gr {
 
@@ -138,6 +140,31 @@ namespace gr {
     //! Set the maximum number of noutput_items in the flowgraph
     void set_max_noutput_items(int nmax);
 
+    /*!
+     * Seconds the last reconfiguration of the running flowgraph
+     * (the unlock() matching the first lock()) took, until every
+     * block was running again; 0 if there hasn't been one. See the
+     * [Scheduler] incremental option.
+     */
+    double reconfigure_time();
+
+    /*!
+     * Seconds each phase of the last start() took, in the order they
+     * ran: "flatten" (the hierarchy into one flat graph), "validate",
+     * "buffers" (block details and output buffers), "readers" (buffer
+     * readers and message subscriptions) and "scheduler" (starting
+     * the blocks and their threads).
+     */
+    std::vector<std::pair<std::string, double> > startup_profile();
+
+    /*!
+     * Returns a string with the CPU each block's thread was bound to
+     * by the running scheduler, one "alias: cpu" line per block, "-"
+     * where it didn't bind one. Empty unless the flowgraph is running
+     * with the TPB scheduler and [Scheduler] placement = topology.
+     */
+    std::string thread_placement();
+
     top_block_sptr to_top_block(); // Needed for Python type coercion
 
     void setup_rpc();
@@ -23,7 +23,10 @@
 #define INCLUDED_GR_TPB_DETAIL_H
 
 #include <gnuradio/api.h>
+#include <gnuradio/attributes.h>
 #include <gnuradio/thread/thread.h>
+#include <boost/atomic.hpp>
+#include <boost/function.hpp>
 #include <deque>
 #include <pmt/pmt.h>
 
@@ -33,17 +36,41 @@ namespace gr {
 
   /*!
    * \brief used by thread-per-block scheduler
+   *
+   * Everything that can wake up a block's thread (new input, more
+   * output space, a message) sets a bit in one event word. The thread
+   * sleeps on that word (a futex where there is one) until a bit it
+   * waits for is set, and only then do notifiers make a system call.
    */
   struct GR_RUNTIME_API tpb_detail {
-    gr::thread::mutex			mutex;			//< protects all vars
-    bool				input_changed;
-    gr::thread::condition_variable	input_cond;
-    bool				output_changed;
-    gr::thread::condition_variable	output_cond;
+    enum {
+      INPUT_CHANGED  = 1 << 0,
+      OUTPUT_CHANGED = 1 << 1,
+      MSG_ARRIVED    = 1 << 2,
+      ALL_EVENTS     = INPUT_CHANGED | OUTPUT_CHANGED | MSG_ARRIVED
+    };
+
+    gr::thread::mutex			mutex;			//< protects notify_hook
+    boost::function<void()>		notify_hook;		//< see set_notify_hook
+
+    /*!
+     * \brief DEPRECATED. Will be removed in 3.8. Use wait().
+     *
+     * Notified, without holding the mutex, whenever our input
+     * changes or a message arrives.
+     */
+    gr::thread::condition_variable	input_cond __GR_ATTR_DEPRECATED;
+
+    /*!
+     * \brief DEPRECATED. Will be removed in 3.8. Use wait().
+     *
+     * Notified, without holding the mutex, whenever our output
+     * changes or a message arrives.
+     */
+    gr::thread::condition_variable	output_cond __GR_ATTR_DEPRECATED;
 
   public:
-    tpb_detail()
-      : input_changed(false), output_changed(false) { }
+    tpb_detail();
 
     //! Called by us to tell all our upstream blocks that their output
     //! may have changed.
@@ -57,35 +84,69 @@ namespace gr {
     void notify_neighbors(block_detail *d);
 
     //! Called by pmt msg posters
-    void notify_msg() {
-      input_cond.notify_one();
-      output_cond.notify_one();
+    void notify_msg() { post(MSG_ARRIVED); }
+
+    //! Called by schedulers that don't park a thread on the event
+    //! word. \p f is called with the mutex held each time the
+    //! block's input or output changes or a message arrives, so it
+    //! must not block. Pass an empty function to remove it.
+    void set_notify_hook(const boost::function<void()> &f)
+    {
+      gr::thread::scoped_lock guard(mutex);
+      notify_hook = f;
+      d_hooked = !f.empty();
     }
 
     //! Called by us
-    void clear_changed()
+    void clear_changed() { clear(ALL_EVENTS); }
+
+    //! Called by us to forget about \p events.
+    void clear(unsigned int events)
     {
-      gr::thread::scoped_lock guard(mutex);
-      input_changed = false;
-      output_changed = false;
+      d_events.fetch_and(~events, boost::memory_order_acq_rel);
     }
 
+    /*!
+     * \brief Called by us to sleep until one of \p events is set.
+     *
+     * Returns the events set at that point; they stay set until
+     * cleared. Also returns, with nothing set, after wake().
+     */
+    unsigned int wait(unsigned int events);
+
+    //! Makes wait() return, e.g., after interrupting the thread.
+    void wake();
+
+    //! Number of times our thread went to sleep and woke up to an
+    //! event it was waiting for. Spurious wakeups and wake() don't
+    //! count.
+    uint64_t nwakeups() const { return d_nwakeups.load(boost::memory_order_relaxed); }
+
+    //! Number of times a notifier had to wake us up.
+    uint64_t nsignals() const { return d_nsignals.load(boost::memory_order_relaxed); }
+
   private:
+    // The events, plus the ones we're sleeping on shifted up by
+    // WAITING_SHIFT. Waited on as a futex, so it must stay 32 bits.
+    static const int WAITING_SHIFT = 4;
+    static const unsigned int WAKE = 1 << 3;
+    boost::atomic<unsigned int>		d_events;
+    boost::atomic<bool>			d_hooked;
+    gr::thread::condition_variable	d_cond;			//< without futexes only
+    boost::atomic<uint64_t>		d_nwakeups;
+    boost::atomic<uint64_t>		d_nsignals;
+
+    //! Sets \p events, waking our thread if it waits for one of them.
+    void post(unsigned int events);
+
+    //! Notifies input_cond and/or output_cond for \p events.
+    void notify_deprecated(unsigned int events);
+
     //! Used by notify_downstream
-    void set_input_changed()
-    {
-      gr::thread::scoped_lock guard(mutex);
-      input_changed = true;
-      input_cond.notify_one();
-    }
+    void set_input_changed() { post(INPUT_CHANGED); }
 
     //! Used by notify_upstream
-    void set_output_changed()
-    {
-      gr::thread::scoped_lock guard(mutex);
-      output_changed = true;
-      output_cond.notify_one();
-    }
+    void set_output_changed() { post(OUTPUT_CHANGED); }
   };
 
 } /* namespace gr */
@@ -572,6 +572,10 @@ PMT_API std::complex<double> *c64vector_writable_elements(pmt_t v, size_t &len);
  * This is a functional data structure that is persistent.  Updating a
  * functional data structure does not destroy the existing version, but
  * rather creates a new version that coexists with the old.
+ *
+ * make_dict() returns a hash array mapped trie, so lookups, additions
+ * and deletions take time logarithmic (base 32) in the number of keys.
+ * The empty list and a-lists are dictionaries too.
  * ------------------------------------------------------------------------
  */
 
@@ -593,7 +597,7 @@ PMT_API bool  dict_has_key(const pmt_t &dict, const pmt_t &key);
 //! If \p key exists in \p dict, return associated value; otherwise return \p not_found.
 PMT_API pmt_t dict_ref(const pmt_t &dict, const pmt_t &key, const pmt_t &not_found);
 
-//! Return list of (key . value) pairs
+//! Return list of (key . value) pairs, most recently added first
 PMT_API pmt_t dict_items(pmt_t dict);
 
 //! Return list of keys
@@ -885,6 +889,40 @@ PMT_API bool serialize(pmt_t obj, std::streambuf &sink);
  */
 PMT_API pmt_t deserialize(std::streambuf &source);
 
+/*!
+ * \brief Number of bytes in the portable byte-serial representation of \p obj
+ */
+PMT_API size_t serialized_size(pmt_t obj);
+
+/*!
+ * \brief Write portable byte-serial representation of \p obj into the
+ * \p len bytes at \p buf.
+ *
+ * Returns the number of bytes written, or 0 if that would be more than
+ * \p len (see serialized_size()).
+ */
+PMT_API size_t serialize(pmt_t obj, void *buf, size_t len);
+
+/*!
+ * \brief Create obj from the portable byte-serial representation in the
+ * \p len bytes at \p buf.
+ *
+ * Sets \p used to the number of bytes it took up. Returns PMT_EOF if
+ * \p len is 0; throws if the representation is cut short.
+ */
+PMT_API pmt_t deserialize(const void *buf, size_t len, size_t &used);
+
+/*!
+ * \brief Create obj from the portable byte-serial representation in
+ * u8vector \p blob, starting \p offset bytes in, and advance \p offset
+ * past it.
+ *
+ * Byte vectors (u8 and s8) in it are not copied but refer to the bytes
+ * of \p blob, which they keep alive; they are copied only if written to.
+ * Don't modify \p blob afterwards. Returns PMT_EOF at the end of \p blob.
+ */
+PMT_API pmt_t deserialize(pmt_t blob, size_t &offset);
+
 
 PMT_API void dump_sizeof();	// debugging
 
@@ -24,15 +24,24 @@
 #include <pmt/api.h>
 #include <cstddef>
 #include <vector>
+#include <boost/atomic.hpp>
 #include <boost/thread.hpp>
+#include <boost/thread/tss.hpp>
 
 namespace pmt {
 
 /*!
- * \brief very simple thread-safe fixed-size allocation pool
+ * \brief thread-safe fixed-size allocation pool with per-thread free lists
  *
- * FIXME may want to go to global allocation with per-thread free list.
- * This would eliminate virtually all lock contention.
+ * Each thread allocates from and frees to its own free list, without
+ * locking. When a thread's list grows past a limit it hands half of
+ * it to a global list, a lock-free stack that other threads take
+ * whole when theirs runs dry (so items freed by a consumer thread
+ * flow back to the producer in batches). Only carving a new chunk
+ * out of the underlying allocator takes a lock.
+ *
+ * A pool must outlive the threads that used it, since they give
+ * back their free lists when they exit.
  */
 class PMT_API pmt_pool {
 
@@ -40,18 +49,36 @@ class PMT_API pmt_pool {
     struct item	*d_next;
   };
 
+  // A thread's free list.
+  struct cache {
+    pmt_pool   *d_pool;
+    item       *d_head;
+    size_t	d_n_items;
+
+    cache(pmt_pool *pool) : d_pool(pool), d_head(0), d_n_items(0) {}
+    ~cache();
+  };
+
   typedef boost::unique_lock<boost::mutex>  scoped_lock;
-  mutable boost::mutex 		d_mutex;
+  mutable boost::mutex 		d_mutex;	// protects d_allocations, d_n_items
   boost::condition_variable	d_cond;
 
   size_t	      d_itemsize;
   size_t	      d_alignment;
   size_t	      d_allocation_size;
   size_t	      d_max_items;
-  size_t	      d_n_items;
-  item	       	     *d_freelist;
+  size_t	      d_n_items;	// only counted with d_max_items
+  size_t	      d_cache_items;	// most items a thread keeps
+  unsigned int	      d_id;		// never reused
   std::vector<char *> d_allocations;
 
+  boost::atomic<item *>		    d_global;	// free items given back by threads
+  boost::thread_specific_ptr<cache> d_cache;	// after d_global: flushes to it
+
+  cache *get_cache();
+  void refill(cache *c);
+  void push_global(item *first, item *last);
+
 public:
   /*!
    * \param itemsize size in bytes of the items to be allocated.
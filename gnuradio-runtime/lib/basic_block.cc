@@ -27,6 +27,7 @@
 #include <gnuradio/basic_block.h>
 #include <gnuradio/block_registry.h>
 #include <gnuradio/logger.h>
+#include <gnuradio/prefs.h>
 #include <stdexcept>
 #include <sstream>
 #include <iostream>
@@ -55,6 +56,9 @@ namespace gr {
       d_rpc_set(false),
       d_message_subscribers(pmt::make_dict())
   {
+    d_msg_nreaders = 0;
+    d_msg_nwriters = 0;
+    d_msg_backpressure = false;
     s_ncurrently_allocated++;
   }
 
@@ -95,7 +99,11 @@ namespace gr {
     if(!pmt::is_symbol(port_id)) {
       throw std::runtime_error("message_port_register_in: bad port id");
     }
-    msg_queue[port_id] = msg_queue_t();
+    prefs *p = prefs::singleton();
+    size_t max_nmsgs = static_cast<size_t>(p->get_long("DEFAULT", "max_messages", 8192));
+    d_msg_backpressure = p->get_bool("DEFAULT", "msg_backpressure", false);
+
+    msg_queue[port_id] = msg_queue_t(new msg_port_queue(max_nmsgs));
     msg_queue_ready[port_id] = boost::shared_ptr<boost::condition_variable>(new boost::condition_variable());
   }
 
@@ -198,55 +206,176 @@ namespace gr {
   void
   basic_block::insert_tail(pmt::pmt_t which_port, pmt::pmt_t msg)
   {
-    gr::thread::scoped_lock guard(mutex);
-
-    if((msg_queue.find(which_port) == msg_queue.end()) || (msg_queue_ready.find(which_port) == msg_queue_ready.end())) {
+    msg_queue_map_itr q = msg_queue.find(which_port);
+    if((q == msg_queue.end()) || (msg_queue_ready.find(which_port) == msg_queue_ready.end())) {
       std::cout << "target port = " << pmt::symbol_to_string(which_port) << std::endl;
       throw std::runtime_error("attempted to insert_tail on invalid queue!");
     }
+    msg_port_queue &queue = *q->second;
+
+    if(!queue.push(msg)) {
+      if(d_msg_backpressure) {
+        // Wait for the block to make room. Don't hold the mutex
+        // while waking it up below: the scheduler takes it (in
+        // msg_queue_popped) with the block's tpb mutex held.
+        // Poll for interruption rather than throw from the wait.
+        boost::this_thread::disable_interruption no_interruption;
+        gr::thread::scoped_lock guard(mutex);
+        d_msg_nwriters++;
+        boost::atomic_thread_fence(boost::memory_order_seq_cst);
+        bool queued;
+        while(!(queued = queue.push(msg))) {
+          // Nobody is going to make room.
+          if(msg_queues_finished() || boost::this_thread::interruption_requested())
+            break;
+          boost::system_time const timeout = boost::get_system_time() + boost::posix_time::milliseconds(100);
+          d_msg_space.timed_wait(guard, timeout);
+        }
+        d_msg_nwriters--;
+        if(!queued) {
+          queue.add_dropped();
+          return;
+        }
+      }
+      else {
+        // Make room by dropping the oldest message.
+        pmt::pmt_t oldest;
+        do {
+          if(queue.pop(oldest))
+            queue.add_dropped();
+        } while(!queue.push(msg));
+      }
+    }
 
-    msg_queue[which_port].push_back(msg);
-    msg_queue_ready[which_port]->notify_one();
+    boost::atomic_thread_fence(boost::memory_order_seq_cst);
+    if(d_msg_nreaders > 0) {
+      gr::thread::scoped_lock guard(mutex);
+      msg_queue_ready[which_port]->notify_all();
+    }
 
     // wake up thread if BLKD_IN or BLKD_OUT
-    global_block_registry.notify_blk(alias());
+    notify_msg_queued();
+  }
+
+  /*
+   * Wake up anybody in insert_tail waiting for room.
+   */
+  void
+  basic_block::msg_queue_popped()
+  {
+    boost::atomic_thread_fence(boost::memory_order_seq_cst);
+    if(d_msg_nwriters > 0) {
+      gr::thread::scoped_lock guard(mutex);
+      d_msg_space.notify_all();
+    }
   }
 
   pmt::pmt_t
   basic_block::delete_head_nowait(pmt::pmt_t which_port)
   {
-    gr::thread::scoped_lock guard(mutex);
+    msg_queue_map_itr q = msg_queue.find(which_port);
+    if(q == msg_queue.end())
+      throw std::runtime_error("port does not exist!");
+
+    pmt::pmt_t m;
+    if(q->second->pop(m))
+      msg_queue_popped();
+    return m;
+  }
 
-    if(empty_p(which_port)) {
-      return pmt::pmt_t();
+  std::deque<pmt::pmt_t>::iterator
+  basic_block::get_iterator(pmt::pmt_t which_port)
+  {
+    msg_queue_map_itr q = msg_queue.find(which_port);
+    if(q == msg_queue.end())
+      throw std::runtime_error("port does not exist!");
+
+    // Copy the messages out and put them back in the same order.
+    std::vector<pmt::pmt_t> msgs;
+    q->second->pop_batch(msgs, q->second->capacity());
+    for(size_t i = 0; i < msgs.size(); i++) {
+      if(!q->second->push(msgs[i]))
+        q->second->add_dropped();
     }
 
-    pmt::pmt_t m(msg_queue[which_port].front());
-    msg_queue[which_port].pop_front();
+    std::deque<pmt::pmt_t> &copy = d_compat_msgs[which_port];
+    copy.assign(msgs.begin(), msgs.end());
+    return copy.begin();
+  }
 
-    return m;
+  void
+  basic_block::erase_msg(pmt::pmt_t which_port, std::deque<pmt::pmt_t>::iterator it)
+  {
+    msg_queue_map_itr q = msg_queue.find(which_port);
+    if(q == msg_queue.end())
+      throw std::runtime_error("port does not exist!");
+
+    pmt::pmt_t victim = *it;
+    d_compat_msgs[which_port].erase(it);
+
+    // Put back everything but victim.
+    std::vector<pmt::pmt_t> msgs;
+    q->second->pop_batch(msgs, q->second->capacity());
+    bool found = false;
+    for(size_t i = 0; i < msgs.size(); i++) {
+      if(!found && msgs[i] == victim) {
+        found = true;
+        continue;
+      }
+      if(!q->second->push(msgs[i]))
+        q->second->add_dropped();
+    }
+    if(found)
+      msg_queue_popped();
+  }
+
+  size_t
+  basic_block::delete_head_batch(pmt::pmt_t which_port,
+                                 std::vector<pmt::pmt_t> &msgs,
+                                 size_t max)
+  {
+    msg_queue_map_itr q = msg_queue.find(which_port);
+    if(q == msg_queue.end())
+      throw std::runtime_error("port does not exist!");
+
+    size_t n = q->second->pop_batch(msgs, max);
+    if(n > 0)
+      msg_queue_popped();
+    return n;
   }
 
   pmt::pmt_t
   basic_block::delete_head_blocking(pmt::pmt_t which_port, unsigned int millisec)
   {
-    gr::thread::scoped_lock guard(mutex);
+    msg_queue_map_itr q = msg_queue.find(which_port);
+    if(q == msg_queue.end())
+      throw std::runtime_error("port does not exist!");
+
+    pmt::pmt_t m;
+    if(q->second->pop(m)) {
+      msg_queue_popped();
+      return m;
+    }
 
-    if (millisec) {
-       boost::system_time const timeout = boost::get_system_time() + boost::posix_time::milliseconds(millisec);
-       while (empty_p(which_port)) {
-         if (!msg_queue_ready[which_port]->timed_wait(guard, timeout)) {
-           return pmt::pmt_t();
-	 }
-       }
-    } else {
-      while(empty_p(which_port)) {
+    gr::thread::scoped_lock guard(mutex);
+    d_msg_nreaders++;
+    boost::atomic_thread_fence(boost::memory_order_seq_cst);
+
+    boost::system_time const timeout = boost::get_system_time() + boost::posix_time::milliseconds(millisec);
+    while(!q->second->pop(m)) {
+      if(millisec) {
+        if(!msg_queue_ready[which_port]->timed_wait(guard, timeout))
+          break;
+      }
+      else {
         msg_queue_ready[which_port]->wait(guard);
       }
     }
+    d_msg_nreaders--;
+    guard.unlock();
 
-    pmt::pmt_t m(msg_queue[which_port].front());
-    msg_queue[which_port].pop_front();
+    if(m)
+      msg_queue_popped();
     return m;
   }
 
@@ -46,6 +46,7 @@ namespace gr {
       d_history(1),
       d_attr_delay(0),
       d_fixed_rate(false),
+      d_in_place(false),
       d_max_noutput_items_set(false),
       d_max_noutput_items(0),
       d_min_noutput_items(0),
@@ -692,6 +693,78 @@ namespace gr {
     }
   }
 
+  float
+  block::pc_msgs_dropped()
+  {
+    return nmsgs_dropped();
+  }
+
+  float
+  block::pc_work_calls()
+  {
+    if(d_detail) {
+      return d_detail->pc_work_calls();
+    }
+    else {
+      return 0;
+    }
+  }
+
+  std::vector<float>
+  block::pc_work_time_hist()
+  {
+    std::vector<float> hist;
+    if(d_detail) {
+      std::vector<uint64_t> h = d_detail->pc_work_time_hist();
+      hist.assign(h.begin(), h.end());
+    }
+    return hist;
+  }
+
+  float
+  block::pc_input_blocked_time()
+  {
+    if(d_detail) {
+      return d_detail->pc_input_blocked_time();
+    }
+    else {
+      return 0;
+    }
+  }
+
+  float
+  block::pc_output_blocked_time()
+  {
+    if(d_detail) {
+      return d_detail->pc_output_blocked_time();
+    }
+    else {
+      return 0;
+    }
+  }
+
+  float
+  block::pc_wakeups()
+  {
+    if(d_detail) {
+      return d_detail->pc_wakeups();
+    }
+    else {
+      return 0;
+    }
+  }
+
+  float
+  block::pc_lock_wait_time()
+  {
+    if(d_detail) {
+      return d_detail->pc_lock_wait_time();
+    }
+    else {
+      return 0;
+    }
+  }
+
   void
   block::reset_perf_counters()
   {
@@ -715,6 +788,21 @@ namespace gr {
     }
   }
 
+  void
+  block::notify_msg_queued()
+  {
+    block_detail_sptr d = d_detail;
+    if(d)
+      d->d_tpb.notify_msg();
+  }
+
+  bool
+  block::msg_queues_finished()
+  {
+    block_detail_sptr d = d_detail;
+    return d && d->done();
+  }
+
   void
   block::notify_msg_neighbors()
   {
@@ -846,6 +934,55 @@ namespace gr {
         "items/s", "Average items throughput in call to work", RPC_PRIVLVL_MIN,
         DISPTIME | DISPOPTSTRIP)));
 
+    d_rpc_vars.push_back(
+      rpcbasic_sptr(new rpcbasic_register_get<block, float>(
+        alias(), "msgs dropped", &block::pc_msgs_dropped,
+        pmt::mp(0), pmt::mp(1e6), pmt::mp(0),
+        "", "Messages dropped from full message queues", RPC_PRIVLVL_MIN,
+        DISPTIME | DISPOPTSTRIP)));
+
+    d_rpc_vars.push_back(
+      rpcbasic_sptr(new rpcbasic_register_get<block, float>(
+        alias(), "work calls", &block::pc_work_calls,
+        pmt::mp(0), pmt::mp(1e9), pmt::mp(0),
+        "", "Number of calls to work", RPC_PRIVLVL_MIN,
+        DISPTIME | DISPOPTSTRIP)));
+
+    d_rpc_vars.push_back(
+      rpcbasic_sptr(new rpcbasic_register_get<block, std::vector<float> >(
+        alias(), "work time histogram", &block::pc_work_time_hist,
+        pmt::make_f32vector(0,0), pmt::make_f32vector(0,1e9), pmt::make_f32vector(0,0),
+        "", "Calls to work by log2 of clock cycles taken", RPC_PRIVLVL_MIN,
+        DISPTIME | DISPOPTSTRIP)));
+
+    d_rpc_vars.push_back(
+      rpcbasic_sptr(new rpcbasic_register_get<block, float>(
+        alias(), "input blocked time", &block::pc_input_blocked_time,
+        pmt::mp(0), pmt::mp(1e9), pmt::mp(0),
+        "", "Total clock cycles blocked on input", RPC_PRIVLVL_MIN,
+        DISPTIME | DISPOPTSTRIP)));
+
+    d_rpc_vars.push_back(
+      rpcbasic_sptr(new rpcbasic_register_get<block, float>(
+        alias(), "output blocked time", &block::pc_output_blocked_time,
+        pmt::mp(0), pmt::mp(1e9), pmt::mp(0),
+        "", "Total clock cycles blocked on output space", RPC_PRIVLVL_MIN,
+        DISPTIME | DISPOPTSTRIP)));
+
+    d_rpc_vars.push_back(
+      rpcbasic_sptr(new rpcbasic_register_get<block, float>(
+        alias(), "wakeups", &block::pc_wakeups,
+        pmt::mp(0), pmt::mp(1e9), pmt::mp(0),
+        "", "Times woken up after being blocked", RPC_PRIVLVL_MIN,
+        DISPTIME | DISPOPTSTRIP)));
+
+    d_rpc_vars.push_back(
+      rpcbasic_sptr(new rpcbasic_register_get<block, float>(
+        alias(), "lock wait time", &block::pc_lock_wait_time,
+        pmt::mp(0), pmt::mp(1e9), pmt::mp(0),
+        "", "Total clock cycles waiting for buffer locks", RPC_PRIVLVL_MIN,
+        DISPTIME | DISPOPTSTRIP)));
+
     d_rpc_vars.push_back(
       rpcbasic_sptr(new rpcbasic_register_get<block, std::vector<float> >(
         alias(), "input \% full", &block::pc_input_buffers_full,
@@ -26,6 +26,7 @@
 
 #include <gnuradio/block_detail.h>
 #include <gnuradio/buffer.h>
+#include <algorithm>
 #include <iostream>
 
 namespace gr {
@@ -43,6 +44,7 @@ namespace gr {
       d_ninputs(ninputs), d_noutputs(noutputs),
       d_input(ninputs), d_output(noutputs),
       d_done(false),
+      d_path_depth(1),
       d_ins_noutput_items(0),
       d_avg_noutput_items(0),
       d_var_noutput_items(0),
@@ -64,6 +66,7 @@ namespace gr {
   {
     s_ncurrently_allocated++;
     d_pc_start_time = gr::high_res_timer_now();
+    reset_stats();
   }
 
   block_detail::~block_detail()
@@ -185,6 +188,13 @@ namespace gr {
     }
   }
 
+  void
+  block_detail::remove_item_tags(unsigned int which_input,
+                                 const std::vector<tag_t> &tags, long id)
+  {
+    d_input[which_input]->buffer()->remove_item_tags(tags, id);
+  }
+
   void
   block_detail::get_tags_in_range(std::vector<tag_t> &v,
                                   unsigned int which_input,
@@ -285,7 +295,9 @@ namespace gr {
       d_total_noutput_items = noutput_items;
       d_pc_start_time = (float)gr::high_res_timer_now();
       for(size_t i=0; i < d_input.size(); i++) {
-	gr::thread::scoped_lock guard(*d_input[i]->mutex());
+	gr::thread::scoped_lock guard(*d_input[i]->mutex(), boost::defer_lock);
+	if(!d_input[i]->lock_free())
+	  guard.lock();
         float pfull = static_cast<float>(d_input[i]->items_available()) /
           static_cast<float>(d_input[i]->max_possible_items_available());
         d_ins_input_buffers_full[i] = pfull;
@@ -293,7 +305,9 @@ namespace gr {
         d_var_input_buffers_full[i] = 0;
       }
       for(size_t i=0; i < d_output.size(); i++) {
-	gr::thread::scoped_lock guard(*d_output[i]->mutex());
+	gr::thread::scoped_lock guard(*d_output[i]->mutex(), boost::defer_lock);
+	if(!d_output[i]->lock_free())
+	  guard.lock();
         float pfull = 1.0f - static_cast<float>(d_output[i]->space_available()) /
           static_cast<float>(d_output[i]->bufsize());
         d_ins_output_buffers_full[i] = pfull;
@@ -323,7 +337,9 @@ namespace gr {
       d_avg_throughput = d_total_noutput_items / monitor_time;
 
       for(size_t i=0; i < d_input.size(); i++) {
-	gr::thread::scoped_lock guard(*d_input[i]->mutex());
+	gr::thread::scoped_lock guard(*d_input[i]->mutex(), boost::defer_lock);
+	if(!d_input[i]->lock_free())
+	  guard.lock();
         float pfull = static_cast<float>(d_input[i]->items_available()) /
           static_cast<float>(d_input[i]->max_possible_items_available());
 
@@ -334,7 +350,9 @@ namespace gr {
       }
 
       for(size_t i=0; i < d_output.size(); i++) {
-	gr::thread::scoped_lock guard(*d_output[i]->mutex());
+	gr::thread::scoped_lock guard(*d_output[i]->mutex(), boost::defer_lock);
+	if(!d_output[i]->lock_free())
+	  guard.lock();
         float pfull = 1.0f - static_cast<float>(d_output[i]->space_available()) /
           static_cast<float>(d_output[i]->bufsize());
 
@@ -352,6 +370,46 @@ namespace gr {
   block_detail::reset_perf_counters()
   {
     d_pc_counter = 0;
+    reset_stats();
+  }
+
+  void
+  block_detail::reset_stats()
+  {
+    d_pc_work_calls.store(0, boost::memory_order_relaxed);
+    for(int i = 0; i < PC_WORK_HIST_SIZE; i++)
+      d_pc_work_time_hist[i].store(0, boost::memory_order_relaxed);
+    d_pc_input_blocked_time.store(0, boost::memory_order_relaxed);
+    d_pc_output_blocked_time.store(0, boost::memory_order_relaxed);
+    d_pc_wakeups.store(0, boost::memory_order_relaxed);
+    d_pc_lock_wait_time.store(0, boost::memory_order_relaxed);
+  }
+
+  void
+  block_detail::add_work_time(high_res_timer_type ticks)
+  {
+    // floor(log2(ticks)), capped to the last bucket
+    int i = 0;
+    for(uint64_t t = ticks; t > 1 && i < PC_WORK_HIST_SIZE - 1; t >>= 1)
+      i++;
+    add(d_pc_work_time_hist[i], 1);
+    add(d_pc_work_calls, 1);
+  }
+
+  void
+  block_detail::add_blocked_time(bool input, high_res_timer_type ticks)
+  {
+    add(input ? d_pc_input_blocked_time : d_pc_output_blocked_time, ticks);
+    add(d_pc_wakeups, 1);
+  }
+
+  std::vector<uint64_t>
+  block_detail::pc_work_time_hist() const
+  {
+    std::vector<uint64_t> hist(PC_WORK_HIST_SIZE);
+    for(int i = 0; i < PC_WORK_HIST_SIZE; i++)
+      hist[i] = d_pc_work_time_hist[i].load(boost::memory_order_relaxed);
+    return hist;
   }
 
   float
@@ -25,9 +25,11 @@
 #endif
 
 #include <block_executor.h>
+#include "cachesize.h"
 #include <gnuradio/block.h>
 #include <gnuradio/block_detail.h>
 #include <gnuradio/buffer.h>
+#include <gnuradio/perf_trace.h>
 #include <gnuradio/prefs.h>
 #include <boost/thread.hpp>
 #include <boost/format.hpp>
@@ -35,6 +37,7 @@
 #include <limits>
 #include <assert.h>
 #include <stdio.h>
+#include <stdlib.h>
 
 namespace gr {
 
@@ -61,6 +64,18 @@ namespace gr {
     return (n / multiple) * multiple;
   }
 
+  // Lock a buffer's mutex, unless the buffer is lock-free, adding any
+  // time spent waiting for it to the block's counters.
+  inline static void
+  lock_buffer(gr::thread::scoped_lock &guard, bool lock_free, block_detail *d)
+  {
+    if(lock_free || guard.try_lock())
+      return;
+    gr::high_res_timer_type start = gr::high_res_timer_now();
+    guard.lock();
+    d->add_lock_wait_time(gr::high_res_timer_now() - start);
+  }
+
   //
   // Return minimum available write space in all our downstream
   // buffers or -1 if we're output blocked and the output we're
@@ -73,7 +88,8 @@ namespace gr {
     if(min_noutput_items == 0)
       min_noutput_items = 1;
     for(int i = 0; i < d->noutputs (); i++) {
-      gr::thread::scoped_lock guard(*d->output(i)->mutex());
+      gr::thread::scoped_lock guard(*d->output(i)->mutex(), boost::defer_lock);
+      lock_buffer(guard, d->output(i)->lock_free(), d);
       int avail_n = round_down(d->output(i)->space_available(), output_multiple);
       int best_n = round_down(d->output(i)->bufsize()/2, output_multiple);
       if(best_n < min_noutput_items)
@@ -90,6 +106,19 @@ namespace gr {
     return min_space;
   }
 
+  /*
+   * Move the offsets of tags read on an input to the matching items
+   * of the outputs.
+   */
+  static void
+  rescale_tags(std::vector<tag_t> &tags, double rrate)
+  {
+    if(rrate == 1.0)
+      return;
+    for(std::vector<tag_t>::iterator t = tags.begin(); t != tags.end(); t++)
+      t->offset = ((double)t->offset * rrate) + 0.5;
+  }
+
   static bool
   propagate_tags(block::tag_propagation_policy_t policy, block_detail *d,
                  const std::vector<uint64_t> &start_nitems_read, double rrate,
@@ -101,6 +130,9 @@ namespace gr {
       return true;
     }
 
+    // get_tags_in_range() returns without locking when the input
+    // never had a tag in range, which is the common case; whatever
+    // it does find goes to each output under one lock.
     switch(policy) {
     case block::TPP_DONT:
       return true;
@@ -110,22 +142,12 @@ namespace gr {
       for(int i = 0; i < d->ninputs(); i++) {
         d->get_tags_in_range(rtags, i, start_nitems_read[i],
                              d->nitems_read(i), block_id);
+        if(rtags.empty())
+          continue;
 
-        std::vector<tag_t>::iterator t;
-        if(rrate == 1.0) {
-          for(t = rtags.begin(); t != rtags.end(); t++) {
-            for(int o = 0; o < d->noutputs(); o++)
-              d->output(o)->add_item_tag(*t);
-          }
-        }
-        else {
-          for(t = rtags.begin(); t != rtags.end(); t++) {
-            tag_t new_tag = *t;
-            new_tag.offset = ((double)new_tag.offset * rrate) + 0.5;
-            for(int o = 0; o < d->noutputs(); o++)
-              d->output(o)->add_item_tag(new_tag);
-          }
-        }
+        rescale_tags(rtags, rrate);
+        for(int o = 0; o < d->noutputs(); o++)
+          d->output(o)->add_item_tags(rtags);
       }
       break;
     case block::TPP_ONE_TO_ONE:
@@ -136,13 +158,11 @@ namespace gr {
         for(int i = 0; i < d->ninputs(); i++) {
           d->get_tags_in_range(rtags, i, start_nitems_read[i],
                                d->nitems_read(i), block_id);
+          if(rtags.empty())
+            continue;
 
-          std::vector<tag_t>::iterator t;
-          for(t = rtags.begin(); t != rtags.end(); t++) {
-            tag_t new_tag = *t;
-            new_tag.offset = ((double)new_tag.offset * rrate) + 0.5;
-            d->output(i)->add_item_tag(new_tag);
-          }
+          rescale_tags(rtags, rrate);
+          d->output(i)->add_item_tags(rtags);
         }
       }
       else  {
@@ -157,8 +177,42 @@ namespace gr {
     return true;
   }
 
+  int
+  block_executor::working_set_noutput_items(block_sptr block, int max_noutput_items)
+  {
+    if(block->is_set_max_noutput_items())
+      max_noutput_items = std::min(max_noutput_items, block->max_noutput_items());
+
+    std::string ws = prefs::singleton()->get_string("Scheduler", "working_set", "0");
+    long working_set;
+    if(ws == "auto")
+      working_set = l2_cache_size() / 2;
+    else
+      working_set = atol(ws.c_str());
+    if(working_set <= 0)
+      return max_noutput_items;
+
+    // Bytes moved per output item: our own outputs, plus the inputs
+    // it takes to make them.
+    block_detail *d = block->detail().get();
+    double rrate = block->relative_rate() > 0 ? block->relative_rate() : 1.0;
+    double nbytes = 0;
+    for(int i = 0; i < d->noutputs(); i++)
+      nbytes += block->output_signature()->sizeof_stream_item(i);
+    for(int i = 0; i < d->ninputs(); i++)
+      nbytes += block->input_signature()->sizeof_stream_item(i) / rrate;
+    if(nbytes <= 0)
+      return max_noutput_items;
+
+    int n = std::max(static_cast<int>(working_set / nbytes), block->output_multiple());
+    return std::min(n, max_noutput_items);
+  }
+
   block_executor::block_executor(block_sptr block, int max_noutput_items)
-    : d_block(block), d_log(0), d_max_noutput_items(max_noutput_items)
+    : d_block(block), d_log(0), d_max_noutput_items(max_noutput_items),
+      d_latency(0), d_latency_noutput_items(max_noutput_items),
+      d_latency_rate(0), d_latency_nitems(0), d_latency_time(0),
+      d_stats(false), d_trace(0), d_blocked(READY), d_blocked_time(0)
   {
     if(ENABLE_LOGGING) {
       std::string name = str(boost::format("sst-%03d.log") % which_scheduler++);
@@ -168,6 +222,19 @@ namespace gr {
              << d_block << std::endl;
     }
 
+    d_max_noutput_items = working_set_noutput_items(block, max_noutput_items);
+    d_latency_noutput_items = d_max_noutput_items;
+
+    // The trace is recorded along with the counters.
+    d_trace = perf_trace::singleton()->enabled() ? perf_trace::singleton() : 0;
+    if(d_trace)
+      d_trace->register_block(block->unique_id(), block->alias());
+    d_stats = d_trace || prefs::singleton()->get_bool("PerfCounters", "stats", true);
+
+    d_latency = prefs::singleton()->get_double("Scheduler", "latency", 0);
+    if(d_latency > 0)
+      d_latency_time = gr::high_res_timer_now();
+
 #ifdef GR_PERFORMANCE_COUNTERS
     prefs *prefs = prefs::singleton();
     d_use_pc = prefs->get_bool("PerfCounters", "on", false);
@@ -184,8 +251,73 @@ namespace gr {
     d_block->stop();			// stop any drivers, etc.
   }
 
+  // How often the latency budget follows the block's rate, in seconds.
+  static const double s_latency_update_period = 0.1;
+  static const double s_latency_rate_decay = 0.99;
+
+  void
+  block_executor::update_latency_budget()
+  {
+    gr::high_res_timer_type now = gr::high_res_timer_now();
+    double dt = (double)(now - d_latency_time) / gr::high_res_timer_tps();
+    if(dt < s_latency_update_period)
+      return;
+
+    block_detail *d = d_block->detail().get();
+    uint64_t nitems = 0;
+    if(d->noutputs() > 0)
+      nitems = d->nitems_written(0);
+    else if(d->ninputs() > 0)
+      nitems = d->nitems_read(0);
+
+    // Follow the peak rate, decaying slowly. Smaller chunks lower
+    // the rate of a flowgraph that isn't rate limited, so tracking
+    // the current rate would shrink the budget without bound.
+    double rate = (nitems - d_latency_nitems) / dt;
+    d_latency_rate = std::max(rate, d_latency_rate * s_latency_rate_decay);
+    d_latency_nitems = nitems;
+    d_latency_time = now;
+
+    // Each block on the longest path through us gets an equal share
+    // of the target; a chunk of n items takes n / rate seconds to
+    // fill at the rate we're actually running at.
+    if(d_latency_rate > 0) {
+      double budget = d_latency * d_latency_rate / d->path_depth();
+      budget = std::max(budget, (double)d_block->output_multiple());
+      budget = std::min(budget, (double)d_max_noutput_items);
+      d_latency_noutput_items = static_cast<int>(budget);
+    }
+  }
+
   block_executor::state
   block_executor::run_one_iteration()
+  {
+    if(!d_stats)
+      return iterate();
+
+    // Count how long we were blocked, if we were, up to now.
+    block_detail *d = d_block->detail().get();
+    if(d_blocked != READY) {
+      gr::high_res_timer_type now = gr::high_res_timer_now();
+      d->add_blocked_time(d_blocked == BLKD_IN, now - d_blocked_time);
+      if(d_trace)
+        d_trace->add(d_blocked == BLKD_IN ? perf_trace::BLOCKED_INPUT : perf_trace::BLOCKED_OUTPUT,
+                     d_block->unique_id(), d_blocked_time, now - d_blocked_time);
+    }
+
+    state s = iterate();
+
+    if(s == BLKD_IN || s == BLKD_OUT) {
+      d_blocked = s;
+      d_blocked_time = gr::high_res_timer_now();
+    }
+    else
+      d_blocked = READY;
+    return s;
+  }
+
+  block_executor::state
+  block_executor::iterate()
   {
     int noutput_items;
     int max_items_avail;
@@ -199,7 +331,12 @@ namespace gr {
 
     LOG(*d_log << std::endl << m);
 
-    max_noutput_items = round_down(d_max_noutput_items, m->output_multiple());
+    if(d_latency > 0) {
+      update_latency_budget();
+      max_noutput_items = round_down(d_latency_noutput_items, m->output_multiple());
+    }
+    else
+      max_noutput_items = round_down(d_max_noutput_items, m->output_multiple());
 
     if(d->done()){
       assert(0);
@@ -242,11 +379,14 @@ namespace gr {
       for(int i = 0; i < d->ninputs (); i++) {
         {
           /*
-           * Acquire the mutex and grab local copies of items_available and done.
+           * Acquire the mutex (unless the buffer is lock-free) and
+           * grab local copies of done and items_available.
            */
-          gr::thread::scoped_lock guard(*d->input(i)->mutex());
-          d_ninput_items[i] = d->input(i)->items_available();
-          d_input_done[i] = d->input(i)->done();
+          gr::thread::scoped_lock guard(*d->input(i)->mutex(), boost::defer_lock);
+          lock_buffer(guard, d->input(i)->lock_free(), d);
+          bool done;
+          d_ninput_items[i] = input_state(*d->input(i), done);
+          d_input_done[i] = done;
         }
 
         LOG(*d_log << "  d_ninput_items[" << i << "] = " << d_ninput_items[i] << std::endl);
@@ -286,11 +426,14 @@ namespace gr {
       for(int i = 0; i < d->ninputs (); i++) {
         {
           /*
-           * Acquire the mutex and grab local copies of items_available and done.
+           * Acquire the mutex (unless the buffer is lock-free) and
+           * grab local copies of done and items_available.
            */
-          gr::thread::scoped_lock guard(*d->input(i)->mutex());
-          d_ninput_items[i] = d->input(i)->items_available ();
-          d_input_done[i] = d->input(i)->done();
+          gr::thread::scoped_lock guard(*d->input(i)->mutex(), boost::defer_lock);
+          lock_buffer(guard, d->input(i)->lock_free(), d);
+          bool done;
+          d_ninput_items[i] = input_state(*d->input(i), done);
+          d_input_done[i] = done;
         }
         max_items_avail = std::max(max_items_avail, d_ninput_items[i]);
       }
@@ -446,10 +589,22 @@ namespace gr {
         d->start_perf_counters();
 #endif /* GR_PERFORMANCE_COUNTERS */
 
+      gr::high_res_timer_type work_start = 0;
+      if(d_stats)
+        work_start = gr::high_res_timer_now();
+
       // Do the actual work of the block
       int n = m->general_work(noutput_items, d_ninput_items,
                               d_input_items, d_output_items);
 
+      if(d_stats) {
+        gr::high_res_timer_type work_time = gr::high_res_timer_now() - work_start;
+        d->add_work_time(work_time);
+        if(d_trace)
+          d_trace->add(perf_trace::WORK, m->unique_id(), work_start, work_time,
+                       n > 0 ? n : 0);
+      }
+
 #ifdef GR_PERFORMANCE_COUNTERS
       if(d_use_pc)
         d->stop_perf_counters(noutput_items, n);
@@ -26,6 +26,8 @@
 #include <gnuradio/api.h>
 #include <gnuradio/runtime_types.h>
 #include <gnuradio/tags.h>
+#include <gnuradio/high_res_timer.h>
+#include <gnuradio/perf_trace.h>
 #include <fstream>
 
 namespace gr {
@@ -51,6 +53,24 @@ namespace gr {
     std::vector<tag_t>          d_returned_tags;
     int                         d_max_noutput_items;
 
+    // Latency-bounded mode ([Scheduler] latency > 0): the block's
+    // share of the latency target, converted to items at its
+    // measured rate, caps noutput_items below d_max_noutput_items.
+    double                      d_latency;
+    int                         d_latency_noutput_items;
+    double                      d_latency_rate;		// items/sec, peak
+    uint64_t                    d_latency_nitems;
+    gr::high_res_timer_type     d_latency_time;
+
+    void update_latency_budget();
+
+    // Counters ([PerfCounters] stats) and trace: what we
+    // were blocked on after the last iteration, and since when.
+    bool                        d_stats;
+    perf_trace                 *d_trace;
+    int                         d_blocked;
+    gr::high_res_timer_type     d_blocked_time;
+
 #ifdef GR_PERFORMANCE_COUNTERS
     bool d_use_pc;
 #endif /* GR_PERFORMANCE_COUNTERS */
@@ -71,6 +91,37 @@ namespace gr {
      * \brief Run one iteration.
      */
     state run_one_iteration();
+
+    /*!
+     * \brief How many items reader \p r has, and in \p done whether
+     * its writer is done.
+     *
+     * done() is loaded first: a writer sets it after publishing its
+     * last items, so once we see it the count we read next includes
+     * them. Read the other way round, the writer could finish in
+     * between and we'd take the old count for the final one.
+     */
+    template<class reader_t>
+    static int input_state(const reader_t &r, bool &done)
+    {
+      done = r.done();
+      return r.items_available();
+    }
+
+    /*!
+     * \brief The most items to ask \p block for in one call.
+     *
+     * \p max_noutput_items, or the block's own max_noutput_items()
+     * if set and smaller, further capped by the [Scheduler]
+     * working_set pref (a size in bytes, "auto" for half the L2
+     * cache, 0 for no cap) to what keeps one call's input and output
+     * within that many bytes, but never below output_multiple().
+     */
+    static int working_set_noutput_items(block_sptr block, int max_noutput_items);
+
+  protected:
+    // run_one_iteration() without the counters
+    state iterate();
   };
 
 } /* namespace gr */
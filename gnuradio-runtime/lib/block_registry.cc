@@ -41,20 +41,16 @@ namespace gr {
   {
     gr::thread::scoped_lock guard(d_mutex);
 
-    if(d_map.find(block->name()) == d_map.end()) {
-      d_map[block->name()] = blocksubmap_t();
-      d_map[block->name()][0] = block;
-      return 0;
+    // Hand out the lowest free id. While none have been freed the
+    // ids in use are 0..size-1, so that's the size.
+    blocksubmap_t &ids = d_map[block->name()];
+    long id = ids.size();
+    if(!ids.empty() && ids.rbegin()->first != id - 1) {
+      for(id = 0; ids.find(id) != ids.end(); id++)
+        ;
     }
-    else {
-      for(size_t i=0; i<=d_map[block->name()].size(); i++){
-        if(d_map[block->name()].find(i) == d_map[block->name()].end()){
-          d_map[block->name()][i] = block;
-          return i;
-        }
-      }
-    }
-    throw std::runtime_error("should not reach this");
+    ids[id] = block;
+    return id;
   }
 
   void
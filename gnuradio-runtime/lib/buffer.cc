@@ -25,7 +25,9 @@
 #endif
 #include <algorithm>
 #include <gnuradio/buffer.h>
+#include <gnuradio/block.h>
 #include <gnuradio/math.h>
+#include <gnuradio/prefs.h>
 #include "vmcircbuf.h"
 #include <stdexcept>
 #include <iostream>
@@ -79,11 +81,12 @@ namespace gr {
   }
 
 
-  buffer::buffer(int nitems, size_t sizeof_item, block_sptr link)
+  buffer::buffer(int nitems, size_t sizeof_item, block_sptr link, bool lock_free)
     : d_base(0), d_bufsize(0), d_max_reader_delay(0), d_vmcircbuf(0),
-      d_sizeof_item(sizeof_item), d_link(link),
-      d_write_index(0), d_abs_write_offset(0), d_done(false),
-      d_last_min_items_read(0)
+      d_sizeof_item(sizeof_item), d_link(link), d_lock_free(lock_free),
+      d_has_in_place(false), d_tags_end(0), d_compat_version(~(uint64_t)0),
+      d_last_min_items_read(0),
+      d_write_index(0), d_abs_write_offset(0), d_done(false)
   {
     if(!allocate_buffer (nitems, sizeof_item))
       throw std::bad_alloc ();
@@ -91,14 +94,42 @@ namespace gr {
     s_buffer_count++;
   }
 
+  buffer::buffer(buffer_sptr upstream, block_sptr link)
+    : d_base(upstream->d_base), d_bufsize(upstream->d_bufsize),
+      d_max_reader_delay(0), d_vmcircbuf(0),
+      d_sizeof_item(upstream->d_sizeof_item), d_link(link),
+      d_lock_free(upstream->d_lock_free), d_in_place_of(upstream),
+      d_has_in_place(false), d_tags_end(0), d_compat_version(~(uint64_t)0),
+      d_last_min_items_read(0),
+      d_write_index(upstream->d_write_index.load()), d_abs_write_offset(0),
+      d_done(false)
+  {
+    gr::thread::scoped_lock guard(in_place_mutex());
+    upstream->d_in_place.push_back(this);
+    upstream->d_has_in_place.store(true, boost::memory_order_release);
+    s_buffer_count++;
+  }
+
+  buffer_sptr
+  make_buffer(int nitems, size_t sizeof_item, block_sptr link, bool lock_free)
+  {
+    return buffer_sptr(new buffer(nitems, sizeof_item, link, lock_free));
+  }
+
   buffer_sptr
-  make_buffer(int nitems, size_t sizeof_item, block_sptr link)
+  make_in_place_buffer(buffer_sptr upstream, block_sptr link)
   {
-    return buffer_sptr(new buffer(nitems, sizeof_item, link));
+    return buffer_sptr(new buffer(upstream, link));
   }
 
   buffer::~buffer()
   {
+    if(d_in_place_of) {
+      gr::thread::scoped_lock guard(in_place_mutex());
+      std::vector<buffer *> &v = d_in_place_of->d_in_place;
+      v.erase(std::find(v.begin(), v.end(), this));
+      d_in_place_of->d_has_in_place.store(!v.empty(), boost::memory_order_release);
+    }
     delete d_vmcircbuf;
     assert(d_readers.size() == 0);
     s_buffer_count--;
@@ -141,6 +172,17 @@ namespace gr {
       return false;
     }
 
+    // Optionally put the pages on the NUMA node the producer is
+    // pinned to, before anybody touches them.
+    block_sptr link = d_link.lock();
+    if(link && !link->processor_affinity().empty()
+       && prefs::singleton()->get_bool("Buffers", "numa_bind", false)) {
+      int node = gr::vmcircbuf_sysconfig::numa_node_of_cpu(link->processor_affinity()[0]);
+      if(node >= 0 && !d_vmcircbuf->bind_to_numa_node(node))
+        std::cerr << "gr::buffer::allocate_buffer: warning: couldn't bind buffer of "
+                  << link->alias() << " to NUMA node " << node << std::endl;
+    }
+
     d_base = (char*)d_vmcircbuf->pointer_to_first_copy();
     return true;
   }
@@ -161,7 +203,20 @@ namespace gr {
         min_items_read = std::min(min_items_read, d_readers[i]->nitems_read());
       }
 
+      // Items written over in place are still ours until the
+      // readers of those buffers are done with them too.
+      if(d_has_in_place.load(boost::memory_order_acquire)) {
+        gr::thread::scoped_lock guard(in_place_mutex());
+        most_data = std::max(most_data,
+                             in_place_data(d_write_index.load(boost::memory_order_relaxed)));
+      }
+
       if(min_items_read != d_last_min_items_read) {
+        // In lock-free mode our caller doesn't hold the mutex, but
+        // the tags still need it.
+        gr::thread::scoped_lock guard(d_mutex, boost::defer_lock);
+        if(d_lock_free)
+          guard.lock();
         prune_tags(d_last_min_items_read);
         d_last_min_items_read = min_items_read;
       }
@@ -172,25 +227,60 @@ namespace gr {
     }
   }
 
+  int
+  buffer::in_place_data(unsigned write_index)
+  {
+    // All these buffers have our size and index space.
+    int most_data = 0;
+    for(size_t i = 0; i < d_in_place.size(); i++) {
+      buffer *b = d_in_place[i];
+      for(size_t j = 0; j < b->d_readers.size(); j++) {
+        unsigned read_index = b->d_readers[j]->d_read_index.load(boost::memory_order_acquire);
+        most_data = std::max(most_data, (int)index_sub(write_index, read_index));
+      }
+      most_data = std::max(most_data, b->in_place_data(write_index));
+    }
+    return most_data;
+  }
+
+  gr::thread::mutex &
+  buffer::in_place_mutex()
+  {
+    buffer *b = this;
+    while(b->d_in_place_of)
+      b = b->d_in_place_of.get();
+    return b->d_in_place_mutex;
+  }
+
   void *
   buffer::write_pointer()
   {
-    return &d_base[d_write_index * d_sizeof_item];
+    return &d_base[d_write_index.load(boost::memory_order_relaxed) * d_sizeof_item];
   }
 
   void
   buffer::update_write_pointer(int nitems)
   {
-    gr::thread::scoped_lock guard(*mutex());
-    d_write_index = index_add(d_write_index, nitems);
-    d_abs_write_offset += nitems;
+    gr::thread::scoped_lock guard(d_mutex, boost::defer_lock);
+    if(!d_lock_free)
+      guard.lock();
+
+    // Only the writer stores these, so relaxed loads are fine. The
+    // release on d_write_index publishes the items we just wrote to
+    // readers that acquire it in items_available().
+    d_abs_write_offset.store(d_abs_write_offset.load(boost::memory_order_relaxed) + nitems,
+                             boost::memory_order_release);
+    d_write_index.store(index_add(d_write_index.load(boost::memory_order_relaxed), nitems),
+                        boost::memory_order_release);
   }
 
   void
   buffer::set_done(bool done)
   {
-    gr::thread::scoped_lock guard(*mutex());
-    d_done = done;
+    gr::thread::scoped_lock guard(d_mutex, boost::defer_lock);
+    if(!d_lock_free)
+      guard.lock();
+    d_done.store(done, boost::memory_order_release);
   }
 
   buffer_reader_sptr
@@ -199,11 +289,21 @@ namespace gr {
     if(nzero_preload < 0)
       throw std::invalid_argument("buffer_add_reader: nzero_preload must be >= 0");
 
+    // Give the reader the lowest tag deletion slot not in use.
+    std::vector<bool> used(buf->d_readers.size() + 1, false);
+    for(size_t i = 0; i < buf->d_readers.size(); i++)
+      if(buf->d_readers[i]->d_tag_slot < used.size())
+        used[buf->d_readers[i]->d_tag_slot] = true;
+    unsigned int tag_slot = 0;
+    while(used[tag_slot])
+      tag_slot++;
+
     buffer_reader_sptr r(new buffer_reader(buf,
-                                           buf->index_sub(buf->d_write_index,
+                                           buf->index_sub(buf->d_write_index.load(),
                                                           nzero_preload),
-                                           link));
+                                           link, tag_slot));
     r->declare_sample_delay(delay);
+    gr::thread::scoped_lock guard(buf->in_place_mutex());
     buf->d_readers.push_back(r.get ());
 
     return r;
@@ -218,6 +318,10 @@ namespace gr {
     if(result == d_readers.end())
       throw std::invalid_argument("buffer::drop_reader");    // we didn't find it...
 
+    // The slot may be handed to a new reader; forget its deletions.
+    gr::thread::scoped_lock guard(*mutex());
+    d_item_tags.clear_reader(reader->d_tag_slot);
+    gr::thread::scoped_lock in_place_guard(in_place_mutex());
     d_readers.erase(result);
   }
 
@@ -225,18 +329,75 @@ namespace gr {
   buffer::add_item_tag(const tag_t &tag)
   {
     gr::thread::scoped_lock guard(*mutex());
-    d_item_tags.insert(std::pair<uint64_t,tag_t>(tag.offset,tag));
+    d_item_tags.add(tag);
+    if(tag.offset >= d_tags_end.load(boost::memory_order_relaxed))
+      d_tags_end.store(tag.offset + 1, boost::memory_order_release);
+  }
+
+  void
+  buffer::add_item_tags(const std::vector<tag_t> &tags)
+  {
+    if(tags.empty())
+      return;
+
+    gr::thread::scoped_lock guard(*mutex());
+    uint64_t end = d_tags_end.load(boost::memory_order_relaxed);
+    for(size_t i = 0; i < tags.size(); i++) {
+      d_item_tags.add(tags[i]);
+      end = std::max(end, tags[i].offset + 1);
+    }
+    d_tags_end.store(end, boost::memory_order_release);
   }
 
   void
   buffer::remove_item_tag(const tag_t &tag, long id)
   {
     gr::thread::scoped_lock guard(*mutex());
-    for(std::multimap<uint64_t,tag_t>::iterator it = d_item_tags.lower_bound(tag.offset); it != d_item_tags.upper_bound(tag.offset); ++it) {
-      if((*it).second == tag) {
-        (*it).second.marked_deleted.push_back(id);
+    remove_item_tag_locked(tag, id);
+  }
+
+  void
+  buffer::remove_item_tags(const std::vector<tag_t> &tags, long id)
+  {
+    if(tags.empty())
+      return;
+
+    gr::thread::scoped_lock guard(*mutex());
+    for(size_t t = 0; t < tags.size(); t++)
+      remove_item_tag_locked(tags[t], id);
+  }
+
+  void
+  buffer::remove_item_tag_locked(const tag_t &tag, long id)
+  {
+    size_t end = d_item_tags.upper_bound(tag.offset);
+    for(size_t i = d_item_tags.lower_bound(tag.offset); i < end; i++) {
+      if(d_item_tags.at(i) == tag) {
+        for(size_t r = 0; r < d_readers.size(); r++) {
+          if(d_readers[r]->d_link_id == id)
+            d_item_tags.mark_deleted(i, d_readers[r]->d_tag_slot);
+        }
+      }
+    }
+  }
+
+  std::multimap<uint64_t,tag_t> &
+  buffer::compat_tags()
+  {
+    if(d_compat_version == d_item_tags.version())
+      return d_compat_tags;
+
+    d_compat_tags.clear();
+    for(size_t i = 0; i < d_item_tags.size(); i++) {
+      tag_t t = d_item_tags.at(i);
+      for(size_t r = 0; r < d_readers.size(); r++) {
+        if(d_item_tags.is_deleted(i, d_readers[r]->d_tag_slot))
+          t.marked_deleted.push_back(d_readers[r]->d_link_id);
       }
+      d_compat_tags.insert(d_compat_tags.end(), std::make_pair(t.offset, t));
     }
+    d_compat_version = d_item_tags.version();
+    return d_compat_tags;
   }
 
   void
@@ -245,40 +406,21 @@ namespace gr {
     /* NOTE: this function _should_ lock the mutex before editing
        d_item_tags. In practice, this function is only called at
        runtime by min_available_space in block_executor.cc, which
-       locks the mutex itself.
+       locks the mutex itself (or by space_available() itself for
+       lock-free buffers).
 
        If this function is used elsewhere, remember to lock the
        buffer's mutex al la the scoped_lock:
            gr::thread::scoped_lock guard(*mutex());
      */
 
-    /*
-      http://www.cplusplus.com/reference/map/multimap/erase/
-      "Iterators, pointers and references referring to elements removed
-      by the function are invalidated. All other iterators, pointers
-      and references keep their validity."
-
-      Store the iterator to be deleted in tmp; increment itr to the
-      next valid iterator, then erase tmp, which now becomes invalid.
-     */
-
-    uint64_t item_time;
-   std::multimap<uint64_t,tag_t>::iterator itr(d_item_tags.begin()), tmp;
-    while(itr != d_item_tags.end()) {
-      item_time = (*itr).second.offset;
-      if(item_time+d_max_reader_delay + bufsize() < max_time) {
-        tmp = itr;
-       itr++;
-        d_item_tags.erase(tmp);
-      }
-      else {
-        // d_item_tags is a map sorted by offset, so when the if
-        // condition above fails, all future tags in the map must also
-        // fail. So just break here.
-        break;
-      }
-    }
-   }
+    // Drop every tag with offset+d_max_reader_delay+bufsize() <
+    // max_time. d_item_tags is sorted by offset, so this just
+    // advances the head of the ring.
+    uint64_t horizon = (uint64_t)d_max_reader_delay + bufsize();
+    if(max_time > horizon)
+      d_item_tags.prune(max_time - horizon);
+  }
 
   long
   buffer_ncurrently_allocated()
@@ -289,9 +431,10 @@ namespace gr {
   // ----------------------------------------------------------------------------
 
   buffer_reader::buffer_reader(buffer_sptr buffer, unsigned int read_index,
-                               block_sptr link)
-    : d_buffer(buffer), d_read_index(read_index), d_abs_read_offset(0), d_link(link),
-      d_attr_delay(0)
+                               block_sptr link, unsigned int tag_slot)
+    : d_buffer(buffer), d_link(link), d_link_id(link ? link->unique_id() : -1),
+      d_tag_slot(tag_slot), d_attr_delay(0),
+      d_read_index(read_index), d_abs_read_offset(0)
   {
     s_buffer_reader_count++;
 
@@ -321,21 +464,31 @@ namespace gr {
   int
   buffer_reader::items_available() const
   {
-    return d_buffer->index_sub(d_buffer->d_write_index, d_read_index);
+    // The acquire pairs with the release in update_write_pointer()
+    // and makes the items up to the write index visible to us.
+    return d_buffer->index_sub(d_buffer->d_write_index.load(boost::memory_order_acquire),
+                               d_read_index.load(boost::memory_order_acquire));
   }
 
   const void *
   buffer_reader::read_pointer()
   {
-    return &d_buffer->d_base[d_read_index * d_buffer->d_sizeof_item];
+    return &d_buffer->d_base[d_read_index.load(boost::memory_order_relaxed) * d_buffer->d_sizeof_item];
   }
 
   void
   buffer_reader::update_read_pointer(int nitems)
   {
-    gr::thread::scoped_lock guard(*mutex());
-    d_read_index = d_buffer->index_add (d_read_index, nitems);
-    d_abs_read_offset += nitems;
+    gr::thread::scoped_lock guard(*mutex(), boost::defer_lock);
+    if(!d_buffer->d_lock_free)
+      guard.lock();
+
+    // The release on d_read_index tells the writer we're done with
+    // the items it may now overwrite.
+    d_abs_read_offset.store(d_abs_read_offset.load(boost::memory_order_relaxed) + nitems,
+                            boost::memory_order_release);
+    d_read_index.store(d_buffer->index_add(d_read_index.load(boost::memory_order_relaxed), nitems),
+                       boost::memory_order_release);
   }
 
   void
@@ -344,27 +497,36 @@ namespace gr {
                                    uint64_t abs_end,
                                    long id)
   {
+    v.resize(0);
+
+    // Every tag we could return has offset + d_attr_delay >=
+    // abs_start, so this needs no lock. That doesn't promise a
+    // reader every tag on the items it can see: tags are usually
+    // added before the items are produced, but a block that calls
+    // produce() from work() publishes its items before the executor
+    // propagates the upstream tags onto them. A reader can miss
+    // those tags on items it has already seen, lock or no lock.
+    if(d_buffer->tags_end() + d_attr_delay <= abs_start)
+      return;
+
     gr::thread::scoped_lock guard(*mutex());
 
-    v.resize(0);
-    std::multimap<uint64_t,tag_t>::iterator itr = d_buffer->get_tags_lower_bound(std::min(abs_start, abs_start - d_attr_delay));
-    std::multimap<uint64_t,tag_t>::iterator itr_end = d_buffer->get_tags_upper_bound(std::min(abs_end, abs_end - d_attr_delay));
+    const tag_store &tags = d_buffer->d_item_tags;
+    if(tags.empty())
+      return;
+
+    size_t i = tags.lower_bound(std::min(abs_start, abs_start - d_attr_delay));
+    size_t end = tags.upper_bound(std::min(abs_end, abs_end - d_attr_delay));
 
     uint64_t item_time;
-    while(itr != itr_end) {
-      item_time = (*itr).second.offset + d_attr_delay;
-      if((item_time >= abs_start) && (item_time < abs_end)) {
-        std::vector<long>::iterator id_itr;
-        id_itr = std::find(itr->second.marked_deleted.begin(), itr->second.marked_deleted.end(), id);
-        // If id is not in the vector of marked blocks
-        if(id_itr == itr->second.marked_deleted.end()) {
-          tag_t t = (*itr).second;
-          t.offset += d_attr_delay;
-          v.push_back(t);
-          v.back().marked_deleted.clear();
-        }
+    for(; i < end; i++) {
+      const tag_t &tag = tags.at(i);
+      item_time = tag.offset + d_attr_delay;
+      if((item_time >= abs_start) && (item_time < abs_end)
+         && !tags.is_deleted(i, d_tag_slot)) {
+        v.push_back(tag);
+        v.back().offset = item_time;
       }
-      itr++;
     }
   }
 
@@ -0,0 +1,96 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2016 Free Software Foundation, Inc.
+ *
+ * This file is part of GNU Radio
+ *
+ * GNU Radio is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * GNU Radio is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GNU Radio; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "cachesize.h"
+#include <unistd.h>
+#include <stdio.h>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+namespace gr {
+
+  static const int s_default_l2_cache_size = 256*1024;
+
+  // Linux describes each cache level of cpu0 under sysfs.
+  static int
+  sysfs_l2_cache_size()
+  {
+    for(int i = 0; i < 8; i++) {
+      std::stringstream dir;
+      dir << "/sys/devices/system/cpu/cpu0/cache/index" << i << "/";
+
+      int level = 0;
+      std::ifstream level_file((dir.str() + "level").c_str());
+      if(!(level_file >> level))
+        break;
+      if(level != 2)
+        continue;
+
+      std::string type;
+      std::ifstream type_file((dir.str() + "type").c_str());
+      if(type_file >> type && type == "Instruction")
+        continue;
+
+      int size = 0;
+      char unit = 0;
+      std::ifstream size_file((dir.str() + "size").c_str());
+      if(!(size_file >> size))
+        break;
+      size_file >> unit;
+      if(unit == 'K')
+        size *= 1024;
+      else if(unit == 'M')
+        size *= 1024*1024;
+      return size;
+    }
+    return 0;
+  }
+
+  int
+  l2_cache_size()
+  {
+    static int s_l2_cache_size = -1;
+
+    if(s_l2_cache_size == -1) {
+      s_l2_cache_size = 0;
+#if defined(HAVE_SYSCONF) && defined(_SC_LEVEL2_CACHE_SIZE)
+      long size = sysconf(_SC_LEVEL2_CACHE_SIZE);
+      if(size > 0)
+        s_l2_cache_size = size;
+#endif
+      if(s_l2_cache_size <= 0)
+        s_l2_cache_size = sysfs_l2_cache_size();
+      if(s_l2_cache_size <= 0) {
+        fprintf(stderr, "gr::l2_cache_size: no info; setting l2_cache_size = %d\n",
+                s_default_l2_cache_size);
+        s_l2_cache_size = s_default_l2_cache_size;
+      }
+    }
+    return s_l2_cache_size;
+  }
+
+} /* namespace gr */
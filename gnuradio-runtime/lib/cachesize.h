@@ -0,0 +1,37 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2016 Free Software Foundation, Inc.
+ *
+ * This file is part of GNU Radio
+ *
+ * GNU Radio is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * GNU Radio is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GNU Radio; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef GR_CACHESIZE_H_
+#define GR_CACHESIZE_H_
+
+#include <gnuradio/api.h>
+
+namespace gr {
+
+  /*!
+   * \brief return the size of the (first CPU's) L2 cache in bytes
+   */
+  GR_RUNTIME_API int l2_cache_size();
+
+} /* namespace gr */
+
+#endif /* GR_CACHESIZE_H_ */
@@ -31,6 +31,7 @@
 #include <volk/volk.h>
 #include <iostream>
 #include <map>
+#include <set>
 #include <boost/format.hpp>
 
 namespace gr {
@@ -42,6 +43,21 @@ namespace gr {
 
   static const unsigned int s_fixed_buffer_size = GR_FIXED_BUFFER_SIZE;
 
+  // Orders edges by their endpoints so they can be kept in a std::set.
+  struct edge_less
+  {
+    bool operator()(const edge &a, const edge &b) const
+    {
+      if(a.src().block() != b.src().block())
+        return a.src().block() < b.src().block();
+      if(a.src().port() != b.src().port())
+        return a.src().port() < b.src().port();
+      if(a.dst().block() != b.dst().block())
+        return a.dst().block() < b.dst().block();
+      return a.dst().port() < b.dst().port();
+    }
+  };
+
   flat_flowgraph_sptr
   make_flat_flowgraph()
   {
@@ -59,12 +75,38 @@ namespace gr {
 
   void
   flat_flowgraph::setup_connections()
+  {
+    setup_buffers();
+    setup_readers();
+  }
+
+  void
+  flat_flowgraph::setup_buffers()
   {
     basic_block_vector_t blocks = calc_used_blocks();
+    d_item_rates.clear();
+
+    // Blocks working in place need their upstream buffer to exist
+    // first.
+    bool in_place = prefs::singleton()->get_bool("Buffers", "in_place", false);
+    if(in_place) {
+      for(basic_block_viter_t p = blocks.begin(); p != blocks.end(); p++) {
+        if(cast_to_block_sptr(*p)->in_place()) {
+          blocks = topological_sort(blocks);
+          break;
+        }
+      }
+    }
 
     // Assign block details to blocks
     for(basic_block_viter_t p = blocks.begin(); p != blocks.end(); p++)
-      cast_to_block_sptr(*p)->set_detail(allocate_block_detail(*p));
+      cast_to_block_sptr(*p)->set_detail(allocate_block_detail(*p, in_place));
+  }
+
+  void
+  flat_flowgraph::setup_readers()
+  {
+    basic_block_vector_t blocks = calc_used_blocks();
 
     // Connect inputs to outputs for each block
     for(basic_block_viter_t p = blocks.begin(); p != blocks.end(); p++) {
@@ -75,6 +117,9 @@ namespace gr {
       block->set_is_unaligned(false);
     }
 
+    if(prefs::singleton()->get_double("Scheduler", "latency", 0) > 0)
+      setup_path_depths(blocks);
+
     // Connect message ports connetions
     for(msg_edge_viter_t i = d_msg_edges.begin(); i != d_msg_edges.end(); i++) {
       if(FLAT_FLOWGRAPH_DEBUG)
@@ -86,7 +131,7 @@ namespace gr {
   }
 
   block_detail_sptr
-  flat_flowgraph::allocate_block_detail(basic_block_sptr block)
+  flat_flowgraph::allocate_block_detail(basic_block_sptr block, bool in_place)
   {
     int ninputs = calc_used_ports(block, true).size();
     int noutputs = calc_used_ports(block, false).size();
@@ -104,7 +149,12 @@ namespace gr {
     for(int i = 0; i < noutputs; i++) {
       grblock->expand_minmax_buffer(i);
 
-      buffer_sptr buffer = allocate_buffer(block, i);
+      buffer_sptr buffer;
+      buffer_sptr upstream;
+      if(in_place && (upstream = in_place_source(grblock)))
+        buffer = make_in_place_buffer(upstream, grblock);
+      else
+        buffer = allocate_buffer(block, i);
       if(FLAT_FLOWGRAPH_DEBUG)
         std::cout << "Allocated buffer for output " << block << ":" << i << std::endl;
       detail->set_output(i, buffer);
@@ -115,6 +165,19 @@ namespace gr {
                                             " instead of requested %3%") \
                     % grblock->alias() % buffer->bufsize() % grblock->max_output_buffer(i));
       grblock->set_max_output_buffer(i, buffer->bufsize());
+
+      if(prefs::singleton()->get_bool("Buffers", "report", false)) {
+        std::string line = (boost::format("buffer %1%:%2%: %3% items x %4% bytes = %5% bytes%6%")
+                            % grblock->alias() % i % buffer->bufsize() % buffer->get_sizeof_item()
+                            % (buffer->bufsize() * buffer->get_sizeof_item())
+                            % (buffer->in_place_of() ? " (in place)" : "")).str();
+#ifdef ENABLE_GR_LOG
+        GR_LOG_INFO(d_logger, line);
+#else
+        // Asked for explicitly, so don't lose it without a logger.
+        std::cout << "INFO: " << line << std::endl;
+#endif
+      }
     }
 
     return detail;
@@ -127,11 +190,36 @@ namespace gr {
     if(!grblock)
       throw std::runtime_error("allocate_buffer found non-gr::block");
     int item_size = block->output_signature()->sizeof_stream_item(port);
-
-    // *2 because we're now only filling them 1/2 way in order to
-    // increase the available parallelism when using the TPB scheduler.
-    // (We're double buffering, where we used to single buffer)
-    int nitems = s_fixed_buffer_size * 2 / item_size;
+    prefs *p = prefs::singleton();
+
+    int nitems;
+    if(p->get_string("Buffers", "policy", "fixed") == "adaptive") {
+      // Size the edge to hold latency_items items at the flowgraph's
+      // source rate, scaled by the rate changes between the sources
+      // and here, within [min_size, max_size] bytes. With no latency
+      // target use the fixed size, but don't let big items (vectors,
+      // FFT frames) starve the edge.
+      long latency_items = p->get_long("Buffers", "latency_items", 0);
+      long min_size = p->get_long("Buffers", "min_size", 4096);
+      long max_size = p->get_long("Buffers", "max_size", 4L*(1L<<20));
+      long min_items = p->get_long("Buffers", "min_items", 16);
+
+      double target;
+      if(latency_items > 0)
+        target = latency_items * item_rate(block);
+      else
+        target = s_fixed_buffer_size * 2.0 / item_size;
+      target = std::min(target, (double)max_size / item_size);
+      target = std::max(target, (double)min_size / item_size);
+      target = std::max(target, (double)min_items);
+      nitems = static_cast<int>(target);
+    }
+    else {
+      // *2 because we're now only filling them 1/2 way in order to
+      // increase the available parallelism when using the TPB scheduler.
+      // (We're double buffering, where we used to single buffer)
+      nitems = s_fixed_buffer_size * 2 / item_size;
+    }
 
     // Make sure there are at least twice the output_multiple no. of items
     if(nitems < 2*grblock->output_multiple())	// Note: this means output_multiple()
@@ -167,19 +255,118 @@ namespace gr {
       nitems = std::max(nitems, static_cast<int>(2*(decimation*multiple+history)));
     }
 
+    // Optionally let the scheduler poll the buffer indices without
+    // taking the buffer's mutex.
+    bool lock_free = p->get_bool("Buffers", "lock_free", false);
+
     //  std::cout << "make_buffer(" << nitems << ", " << item_size << ", " << grblock << "\n";
     // We're going to let this fail once and retry. If that fails,
     // throw and exit.
     buffer_sptr b;
     try {
-      b = make_buffer(nitems, item_size, grblock);
+      b = make_buffer(nitems, item_size, grblock, lock_free);
     }
     catch(std::bad_alloc&) {
-      b = make_buffer(nitems, item_size, grblock);
+      b = make_buffer(nitems, item_size, grblock, lock_free);
     }
     return b;
   }
 
+  buffer_sptr
+  flat_flowgraph::in_place_source(block_sptr block)
+  {
+    // Only a 1:1 block with one input and one output of the same
+    // size, and no history to keep around, can overwrite its input.
+    if(!block->in_place() || !block->fixed_rate() || block->relative_rate() != 1.0
+       || block->history() != 1)
+      return buffer_sptr();
+    if(calc_used_ports(block, true).size() != 1 || calc_used_ports(block, false).size() != 1)
+      return buffer_sptr();
+    if(block->input_signature()->sizeof_stream_item(0) !=
+       block->output_signature()->sizeof_stream_item(0))
+      return buffer_sptr();
+
+    // We must be the upstream buffer's only reader.
+    edge e = calc_upstream_edge(block, 0);
+    block_sptr src = cast_to_block_sptr(e.src().block());
+    if(!src->detail())
+      return buffer_sptr();
+    if(calc_downstream_blocks(src, e.src().port()).size() != 1)
+      return buffer_sptr();
+    buffer_sptr upstream = src->detail()->output(e.src().port());
+
+    // And it must be big enough for our own readers.
+    int nitems = 2*block->output_multiple();
+    basic_block_vector_t blocks = calc_downstream_blocks(block, 0);
+    for(basic_block_viter_t p = blocks.begin(); p != blocks.end(); p++) {
+      block_sptr dgrblock = cast_to_block_sptr(*p);
+      double decimation = (1.0/dgrblock->relative_rate());
+      int multiple      = dgrblock->output_multiple();
+      int history       = dgrblock->history();
+      nitems = std::max(nitems, static_cast<int>(2*(decimation*multiple+history)));
+    }
+    if(upstream->bufsize() < nitems)
+      return buffer_sptr();
+
+    // And within any limits set on our own output buffer.
+    if(block->max_output_buffer(0) > 0 && upstream->bufsize() > block->max_output_buffer(0))
+      return buffer_sptr();
+    if(block->min_output_buffer(0) > 0 && upstream->bufsize() < block->min_output_buffer(0))
+      return buffer_sptr();
+
+    return upstream;
+  }
+
+  double
+  flat_flowgraph::item_rate(basic_block_sptr block)
+  {
+    std::map<basic_block_sptr, double>::iterator i = d_item_rates.find(block);
+    if(i != d_item_rates.end())
+      return i->second;
+
+    // Sources run at rate 1; everyone else at the fastest of their
+    // inputs times their own relative rate.
+    double rate = 1.0;
+    edge_vector_t in_edges = calc_upstream_edges(block);
+    if(!in_edges.empty()) {
+      rate = 0.0;
+      for(edge_viter_t e = in_edges.begin(); e != in_edges.end(); e++)
+        rate = std::max(rate, item_rate(e->src().block()));
+      rate *= cast_to_block_sptr(block)->relative_rate();
+    }
+
+    d_item_rates[block] = rate;
+    return rate;
+  }
+
+  void
+  flat_flowgraph::setup_path_depths(basic_block_vector_t &blocks)
+  {
+    basic_block_vector_t sorted = topological_sort(blocks);
+    std::map<basic_block_sptr, int> from_source, to_sink;
+
+    // Longest path from any source to (and including) each block...
+    for(basic_block_viter_t p = sorted.begin(); p != sorted.end(); p++) {
+      int depth = 0;
+      edge_vector_t in_edges = calc_upstream_edges(*p);
+      for(edge_viter_t e = in_edges.begin(); e != in_edges.end(); e++)
+        depth = std::max(depth, from_source[e->src().block()]);
+      from_source[*p] = depth + 1;
+    }
+
+    // ...and from each block to any sink, pushed back upstream.
+    for(basic_block_vector_t::reverse_iterator p = sorted.rbegin(); p != sorted.rend(); p++) {
+      int depth = std::max(to_sink[*p], 1);
+      to_sink[*p] = depth;
+      edge_vector_t in_edges = calc_upstream_edges(*p);
+      for(edge_viter_t e = in_edges.begin(); e != in_edges.end(); e++)
+        to_sink[e->src().block()] = std::max(to_sink[e->src().block()], depth + 1);
+    }
+
+    for(basic_block_viter_t p = sorted.begin(); p != sorted.end(); p++)
+      cast_to_block_sptr(*p)->detail()->set_path_depth(from_source[*p] + to_sink[*p] - 1);
+  }
+
   void
   flat_flowgraph::connect_block_inputs(basic_block_sptr block)
   {
@@ -214,6 +401,8 @@ namespace gr {
   void
   flat_flowgraph::merge_connections(flat_flowgraph_sptr old_ffg)
   {
+    d_item_rates.clear();
+
     // Allocate block details if needed.  Only new blocks that aren't pruned out
     // by flattening will need one; existing blocks still in the new flowgraph will
     // already have one.
@@ -230,19 +419,25 @@ namespace gr {
           std::cout << "merge: reusing original detail for block " << (*p) << std::endl;
     }
 
+    // A block left writing in place over a buffer it no longer may
+    // (it's fed differently now, or the buffer gained readers) gets
+    // a buffer of its own; its readers are reconnected below.
+    for(basic_block_viter_t p = d_blocks.begin(); p != d_blocks.end(); p++) {
+      block_sptr block = cast_to_block_sptr(*p);
+      block_detail_sptr detail = block->detail();
+      if(detail->noutputs() == 1 && detail->output(0)->in_place_of()
+         && detail->output(0)->in_place_of() != in_place_source(block))
+        detail->set_output(0, allocate_buffer(block, 0));
+    }
+
     // Calculate the old edges that will be going away, and clear the
     // buffer readers on the RHS.
+    std::set<edge, edge_less> new_edges(d_edges.begin(), d_edges.end());
     for(edge_viter_t old_edge = old_ffg->d_edges.begin(); old_edge != old_ffg->d_edges.end(); old_edge++) {
       if(FLAT_FLOWGRAPH_DEBUG)
         std::cout << "merge: testing old edge " << (*old_edge) << "...";
 
-      edge_viter_t new_edge;
-      for(new_edge = d_edges.begin(); new_edge != d_edges.end(); new_edge++)
-        if(new_edge->src() == old_edge->src() &&
-           new_edge->dst() == old_edge->dst())
-          break;
-
-      if(new_edge == d_edges.end()) { // not found in new edge list
+      if(!new_edges.count(*old_edge)) { // not found in new edge list
         if(FLAT_FLOWGRAPH_DEBUG)
           std::cout << "not in new edge list" << std::endl;
         // zero the buffer reader on RHS of old edge
@@ -312,6 +507,71 @@ namespace gr {
       // changed numbers of inputs and outputs vs. in the old
       // flowgraph.
     }
+
+    if(prefs::singleton()->get_double("Scheduler", "latency", 0) > 0)
+      setup_path_depths(d_blocks);
+  }
+
+  basic_block_vector_t
+  flat_flowgraph::calc_changed_blocks(flat_flowgraph_sptr old_ffg)
+  {
+    std::set<basic_block_sptr> changed;
+
+    // Blocks added or removed
+    std::set<basic_block_sptr> old_blocks(old_ffg->d_blocks.begin(), old_ffg->d_blocks.end());
+    std::set<basic_block_sptr> new_blocks(d_blocks.begin(), d_blocks.end());
+    for(basic_block_viter_t p = d_blocks.begin(); p != d_blocks.end(); p++)
+      if(!old_blocks.count(*p))
+        changed.insert(*p);
+    for(basic_block_viter_t p = old_ffg->d_blocks.begin(); p != old_ffg->d_blocks.end(); p++)
+      if(!new_blocks.count(*p))
+        changed.insert(*p);
+
+    // Both ends of every edge added or removed
+    std::set<edge, edge_less> old_edges(old_ffg->d_edges.begin(), old_ffg->d_edges.end());
+    std::set<edge, edge_less> new_edges(d_edges.begin(), d_edges.end());
+    for(edge_viter_t e = d_edges.begin(); e != d_edges.end(); e++) {
+      if(!old_edges.count(*e)) {
+        changed.insert(e->src().block());
+        changed.insert(e->dst().block());
+      }
+    }
+    for(edge_viter_t e = old_ffg->d_edges.begin(); e != old_ffg->d_edges.end(); e++) {
+      if(!new_edges.count(*e)) {
+        changed.insert(e->src().block());
+        changed.insert(e->dst().block());
+      }
+    }
+
+    // merge_connections() gives a block writing in place a buffer of
+    // its own once it may not anymore, and with it new readers. Which
+    // of a run of such blocks that hits can depend on the order they
+    // are merged in, so once the block a run writes over changes, the
+    // whole run and its readers are taken as changed.
+    bool grew = true;
+    while(grew) {
+      grew = false;
+      for(basic_block_viter_t p = d_blocks.begin(); p != d_blocks.end(); p++) {
+        block_sptr block = cast_to_block_sptr(*p);
+        block_detail_sptr detail = block->detail();
+        if(!detail || detail->noutputs() != 1 || !detail->output(0)->in_place_of())
+          continue;
+
+        if(!changed.count(*p)) {
+          buffer_sptr upstream = detail->output(0)->in_place_of();
+          if(upstream == in_place_source(block) && !changed.count(upstream->link()))
+            continue;
+          changed.insert(*p);
+          grew = true;
+        }
+
+        basic_block_vector_t readers = calc_downstream_blocks(*p, 0);
+        for(basic_block_viter_t r = readers.begin(); r != readers.end(); r++)
+          grew |= changed.insert(*r).second;
+      }
+    }
+
+    return basic_block_vector_t(changed.begin(), changed.end());
   }
 
   void
@@ -323,8 +583,12 @@ namespace gr {
       unsigned long int ri = (unsigned long int)r % alignment;
       //std::cerr << "reader: " << r << "  alignment: " << ri << std::endl;
       if(ri != 0) {
+        // Don't skip past the writer: the reader would see a full
+        // buffer of stale items.
         size_t itemsize = block->detail()->input(i)->get_sizeof_item();
-        block->detail()->input(i)->update_read_pointer((alignment-ri)/itemsize);
+        int nskip = (alignment-ri)/itemsize;
+        if(block->detail()->input(i)->items_available() >= nskip)
+          block->detail()->input(i)->update_read_pointer(nskip);
       }
       block->set_unaligned(0);
       block->set_is_unaligned(false);
@@ -397,6 +661,60 @@ namespace gr {
     return result;
   }
 
+  bool
+  flat_flowgraph::fusable(block_sptr block)
+  {
+    // A 1:1 block with one input and one output, no history, and no
+    // message ports besides "system": it only talks to the rest of
+    // the graph through its two buffers.
+    if(!block->fixed_rate() || block->relative_rate() != 1.0 || block->history() != 1)
+      return false;
+    if(calc_used_ports(block, true).size() != 1 || calc_used_ports(block, false).size() != 1)
+      return false;
+    if(pmt::length(block->message_ports_in()) != 1 || pmt::length(block->message_ports_out()) != 0)
+      return false;
+
+    // Anything asking for its own thread keeps it.
+    if(!block->processor_affinity().empty() || block->thread_priority() > 0)
+      return false;
+
+    return true;
+  }
+
+  std::vector<block_vector_t>
+  flat_flowgraph::calc_fusable_chains(block_vector_t &blocks)
+  {
+    std::vector<block_vector_t> chains;
+    std::map<block_sptr, size_t> chain_of;
+
+    // blocks is topologically sorted, so a block's upstream neighbor
+    // has already been placed by the time we get to it.
+    for(block_viter_t p = blocks.begin(); p != blocks.end(); p++) {
+      block_sptr block = *p;
+      if(!fusable(block))
+        continue;
+
+      edge e = calc_upstream_edge(block, 0);
+      block_sptr src = cast_to_block_sptr(e.src().block());
+      std::map<block_sptr, size_t>::iterator c = chain_of.find(src);
+      if(c != chain_of.end() && calc_downstream_blocks(src, e.src().port()).size() == 1) {
+        chains[c->second].push_back(block);
+        chain_of[block] = c->second;
+      }
+      else {
+        chain_of[block] = chains.size();
+        chains.push_back(block_vector_t(1, block));
+      }
+    }
+
+    std::vector<block_vector_t> result;
+    for(size_t i = 0; i < chains.size(); i++) {
+      if(chains[i].size() > 1)
+        result.push_back(chains[i]);
+    }
+    return result;
+  }
+
   void
   flat_flowgraph::clear_endpoint(const msg_endpoint &e, bool is_src)
   {
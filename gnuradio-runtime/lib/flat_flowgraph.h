@@ -27,6 +27,7 @@
 #include <gnuradio/flowgraph.h>
 #include <gnuradio/block.h>
 #include <gnuradio/logger.h>
+#include <map>
 
 namespace gr {
 
@@ -50,9 +51,24 @@ namespace gr {
     // Wire list of gr::block together in new flat_flowgraph
     void setup_connections();
 
+    // The two halves of setup_connections(): give every block its
+    // detail and output buffers, then hook up the buffer readers and
+    // message subscriptions.
+    void setup_buffers();
+    void setup_readers();
+
     // Merge applicable connections from existing flat flowgraph
     void merge_connections(flat_flowgraph_sptr sfg);
 
+    /*!
+     * The blocks merge_connections(\p old_ffg) would rewire, which so
+     * have to be stopped while it runs: blocks added or removed, both
+     * ends of every stream edge added or removed, and blocks whose
+     * buffers move because of writing in place. Must be called
+     * before merge_connections().
+     */
+    basic_block_vector_t calc_changed_blocks(flat_flowgraph_sptr old_ffg);
+
     // Return a string list of edges
     std::string edge_list();
 
@@ -66,6 +82,15 @@ namespace gr {
      */
     static block_vector_t make_block_vector(basic_block_vector_t &blocks);
 
+    /*!
+     * Find the runs of adjacent 1:1 blocks in \p blocks (which must
+     * be topologically sorted) that a scheduler may run as one unit:
+     * each has one input and one output, no history and no message
+     * ports of its own, and is the only reader of the block before
+     * it. Each run has at least two blocks, upstream first.
+     */
+    std::vector<block_vector_t> calc_fusable_chains(block_vector_t &blocks);
+
     /*!
      * replace hierarchical message connections with internal primitive ones
      */
@@ -90,10 +115,26 @@ namespace gr {
   private:
     flat_flowgraph();
 
-    block_detail_sptr allocate_block_detail(basic_block_sptr block);
+    block_detail_sptr allocate_block_detail(basic_block_sptr block,
+                                            bool in_place=false);
     buffer_sptr allocate_buffer(basic_block_sptr block, int port);
+
+    // The buffer block may write its output over in place (see
+    // block::set_in_place()), or null if it can't.
+    buffer_sptr in_place_source(block_sptr block);
+
+    // Whether block may be run as part of a fused chain.
+    bool fusable(block_sptr block);
     void connect_block_inputs(basic_block_sptr block);
 
+    // Items produced per source item at block's outputs; cached in
+    // d_item_rates while buffers are being allocated.
+    double item_rate(basic_block_sptr block);
+    std::map<basic_block_sptr, double> d_item_rates;
+
+    // Set each block's path_depth() for the latency-bounded mode.
+    void setup_path_depths(basic_block_vector_t &blocks);
+
     /* When reusing a flowgraph's blocks, this call makes sure all of
      * the buffer's are aligned at the machine's alignment boundary
      * and tells the blocks that they are aligned.
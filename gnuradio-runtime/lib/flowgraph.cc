@@ -25,6 +25,7 @@
 #endif
 
 #include <gnuradio/flowgraph.h>
+#include <algorithm>
 #include <stdexcept>
 #include <sstream>
 #include <iterator>
@@ -72,7 +73,21 @@ namespace gr {
     check_type_match(src, dst);
 
     // Alles klar, Herr Kommissar
-    d_edges.push_back(edge(src,dst));
+    edge e(src, dst);
+    d_edges.push_back(e);
+    d_edge_index[src.block()].outputs.push_back(e);
+    d_edge_index[dst.block()].inputs.push_back(e);
+  }
+
+  static void
+  erase_edge(edge_vector_t &edges, const endpoint &src, const endpoint &dst)
+  {
+    for(edge_vector_t::iterator p = edges.begin(); p != edges.end(); p++) {
+      if(src == p->src() && dst == p->dst()) {
+        edges.erase(p);
+        return;
+      }
+    }
   }
 
   void
@@ -81,6 +96,13 @@ namespace gr {
     for(edge_viter_t p = d_edges.begin(); p != d_edges.end(); p++) {
       if(src == p->src() && dst == p->dst()) {
         d_edges.erase(p);
+
+        erase_edge(d_edge_index[src.block()].outputs, src, dst);
+        erase_edge(d_edge_index[dst.block()].inputs, src, dst);
+        if(d_edge_index[src.block()].inputs.empty() && d_edge_index[src.block()].outputs.empty())
+          d_edge_index.erase(src.block());
+        if(d_edge_index[dst.block()].inputs.empty() && d_edge_index[dst.block()].outputs.empty())
+          d_edge_index.erase(dst.block());
         return;
       }
     }
@@ -126,6 +148,15 @@ namespace gr {
     // Boost shared pointers will deallocate as needed
     d_blocks.clear();
     d_edges.clear();
+    d_edge_index.clear();
+  }
+
+  const flowgraph::block_edges &
+  flowgraph::indexed_edges(basic_block_sptr block) const
+  {
+    static const block_edges none;
+    edge_index_t::const_iterator i = d_edge_index.find(block);
+    return i == d_edge_index.end() ? none : i->second;
   }
 
   void
@@ -169,7 +200,8 @@ namespace gr {
   flowgraph::check_dst_not_used(const endpoint &dst)
   {
     // A destination is in use if it is already on the edge list
-    for(edge_viter_t p = d_edges.begin(); p != d_edges.end(); p++)
+    const edge_vector_t &inputs = indexed_edges(dst.block()).inputs;
+    for(edge_vector_t::const_iterator p = inputs.begin(); p != inputs.end(); p++)
       if(p->dst() == dst) {
         std::stringstream msg;
         msg << "destination already in use by edge " << (*p);
@@ -233,20 +265,8 @@ namespace gr {
   edge_vector_t
   flowgraph::calc_connections(basic_block_sptr block, bool check_inputs)
   {
-    edge_vector_t result;
-
-    for(edge_viter_t p = d_edges.begin(); p != d_edges.end(); p++) {
-      if(check_inputs) {
-        if(p->dst().block() == block)
-          result.push_back(*p);
-      }
-      else {
-        if(p->src().block() == block)
-          result.push_back(*p);
-      }
-    }
-
-    return result; // assumes no duplicates
+    const block_edges &edges = indexed_edges(block);
+    return check_inputs ? edges.inputs : edges.outputs; // assumes no duplicates
   }
 
   void
@@ -297,8 +317,9 @@ namespace gr {
   {
     basic_block_vector_t tmp;
 
-    for(edge_viter_t p = d_edges.begin(); p != d_edges.end(); p++)
-      if(p->src() == endpoint(block, port))
+    const edge_vector_t &outputs = indexed_edges(block).outputs;
+    for(edge_vector_t::const_iterator p = outputs.begin(); p != outputs.end(); p++)
+      if(p->src().port() == port)
         tmp.push_back(p->dst().block());
 
     return unique_vector<basic_block_sptr>(tmp);
@@ -309,9 +330,9 @@ namespace gr {
   {
     basic_block_vector_t tmp;
 
-    for(edge_viter_t p = d_edges.begin(); p != d_edges.end(); p++)
-      if(p->src().block() == block)
-        tmp.push_back(p->dst().block());
+    const edge_vector_t &outputs = indexed_edges(block).outputs;
+    for(edge_vector_t::const_iterator p = outputs.begin(); p != outputs.end(); p++)
+      tmp.push_back(p->dst().block());
 
     return unique_vector<basic_block_sptr>(tmp);
   }
@@ -319,21 +340,14 @@ namespace gr {
   edge_vector_t
   flowgraph::calc_upstream_edges(basic_block_sptr block)
   {
-    edge_vector_t result;
-
-    for(edge_viter_t p = d_edges.begin(); p != d_edges.end(); p++)
-      if(p->dst().block() == block)
-        result.push_back(*p);
-
-    return result; // Assume no duplicates
+    return indexed_edges(block).inputs; // Assume no duplicates
   }
 
   bool
   flowgraph::has_block_p(basic_block_sptr block)
   {
-    basic_block_viter_t result;
-    result = std::find(d_blocks.begin(), d_blocks.end(), block);
-    return (result != d_blocks.end());
+    // d_blocks is sorted; see validate()
+    return std::binary_search(d_blocks.begin(), d_blocks.end(), block);
   }
 
   edge
@@ -341,8 +355,9 @@ namespace gr {
   {
     edge result;
 
-    for(edge_viter_t p = d_edges.begin(); p != d_edges.end(); p++) {
-      if(p->dst() == endpoint(block, port)) {
+    const edge_vector_t &inputs = indexed_edges(block).inputs;
+    for(edge_vector_t::const_iterator p = inputs.begin(); p != inputs.end(); p++) {
+      if(p->dst().port() == port) {
         result = (*p);
         break;
       }
@@ -356,46 +371,34 @@ namespace gr {
   {
     std::vector<basic_block_vector_t> result;
     basic_block_vector_t blocks = calc_used_blocks();
-    basic_block_vector_t graph;
-
-    while(blocks.size() > 0) {
-      graph = calc_reachable_blocks(blocks[0], blocks);
-      assert(graph.size());
-      result.push_back(topological_sort(graph));
-
-      for(basic_block_viter_t p = graph.begin(); p != graph.end(); p++)
-        blocks.erase(find(blocks.begin(), blocks.end(), *p));
-    }
-
-    return result;
-  }
-
-  basic_block_vector_t
-  flowgraph::calc_reachable_blocks(basic_block_sptr block, basic_block_vector_t &blocks)
-  {
-    basic_block_vector_t result;
 
     // Mark all blocks as unvisited
     for(basic_block_viter_t p = blocks.begin(); p != blocks.end(); p++)
       (*p)->set_color(basic_block::WHITE);
 
-    // Recursively mark all reachable blocks
-    reachable_dfs_visit(block, blocks);
+    // Every block not reached from an earlier one starts another
+    // graph. topological_sort() leaves the blocks it sorts black.
+    for(basic_block_viter_t p = blocks.begin(); p != blocks.end(); p++) {
+      if((*p)->color() != basic_block::WHITE)
+        continue;
 
-    // Collect all the blocks that have been visited
-    for(basic_block_viter_t p = blocks.begin(); p != blocks.end(); p++)
-      if((*p)->color() == basic_block::BLACK)
-        result.push_back(*p);
+      basic_block_vector_t graph;
+      reachable_dfs_visit(*p, graph);
+      sort(graph.begin(), graph.end());
+      result.push_back(topological_sort(graph));
+    }
 
     return result;
   }
 
-  // Recursively mark all reachable blocks from given block and block list
+  // Recursively mark all blocks reachable from the given block,
+  // adding them to blocks
   void
   flowgraph::reachable_dfs_visit(basic_block_sptr block, basic_block_vector_t &blocks)
   {
     // Mark the current one as visited
     block->set_color(basic_block::BLACK);
+    blocks.push_back(block);
 
     // Recurse into adjacent vertices
     basic_block_vector_t adjacent = calc_adjacent_blocks(block, blocks);
@@ -412,12 +415,11 @@ namespace gr {
     basic_block_vector_t tmp;
 
     // Find any blocks that are inputs or outputs
-    for(edge_viter_t p = d_edges.begin(); p != d_edges.end(); p++) {
-      if(p->src().block() == block)
-        tmp.push_back(p->dst().block());
-      if(p->dst().block() == block)
-        tmp.push_back(p->src().block());
-    }
+    const block_edges &edges = indexed_edges(block);
+    for(edge_vector_t::const_iterator p = edges.outputs.begin(); p != edges.outputs.end(); p++)
+      tmp.push_back(p->dst().block());
+    for(edge_vector_t::const_iterator p = edges.inputs.begin(); p != edges.inputs.end(); p++)
+      tmp.push_back(p->src().block());
 
     return unique_vector<basic_block_sptr>(tmp);
   }
@@ -0,0 +1,146 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2016 Free Software Foundation, Inc.
+ *
+ * This file is part of GNU Radio
+ *
+ * GNU Radio is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * GNU Radio is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GNU Radio; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <gnuradio/msg_port_queue.h>
+
+namespace gr {
+
+  msg_port_queue::msg_port_queue(size_t limit)
+    : d_cells(0), d_tail(0), d_head(0), d_ndropped(0)
+  {
+    size_t capacity = 2;
+    while(capacity < limit)
+      capacity *= 2;
+    d_mask = capacity - 1;
+  }
+
+  msg_port_queue::~msg_port_queue()
+  {
+    delete [] d_cells.load();
+  }
+
+  /*
+   * The ring, allocated by whoever pushes first. If two producers
+   * race, the loser frees its copy and uses the winner's.
+   */
+  msg_port_queue::cell *
+  msg_port_queue::cells()
+  {
+    cell *cells = d_cells.load(boost::memory_order_acquire);
+    if(cells)
+      return cells;
+
+    cells = new cell[d_mask + 1];
+    for(size_t i = 0; i <= d_mask; i++)
+      cells[i].seq.store(i, boost::memory_order_relaxed);
+
+    cell *expected = 0;
+    if(!d_cells.compare_exchange_strong(expected, cells, boost::memory_order_acq_rel)) {
+      delete [] cells;
+      cells = expected;
+    }
+    return cells;
+  }
+
+  /*
+   * A cell at position pos is free for the producer when its
+   * sequence number is pos, and holds a message for the consumer
+   * when it is pos + 1. Popping sets it to pos + capacity, making it
+   * free for the producer one lap later.
+   */
+  bool
+  msg_port_queue::push(const pmt::pmt_t &msg)
+  {
+    cell *ring = cells();
+    cell *c;
+    size_t pos = d_tail.load(boost::memory_order_relaxed);
+    for(;;) {
+      c = &ring[pos & d_mask];
+      size_t seq = c->seq.load(boost::memory_order_acquire);
+      intptr_t dif = (intptr_t)seq - (intptr_t)pos;
+      if(dif == 0) {
+        if(d_tail.compare_exchange_weak(pos, pos + 1, boost::memory_order_relaxed))
+          break;
+      }
+      else if(dif < 0)
+        return false;	// full
+      else
+        pos = d_tail.load(boost::memory_order_relaxed);
+    }
+
+    c->msg = msg;
+    c->seq.store(pos + 1, boost::memory_order_release);
+    return true;
+  }
+
+  bool
+  msg_port_queue::pop(pmt::pmt_t &msg)
+  {
+    cell *ring = d_cells.load(boost::memory_order_acquire);
+    if(!ring)
+      return false;	// nothing pushed yet
+
+    cell *c;
+    size_t pos = d_head.load(boost::memory_order_relaxed);
+    for(;;) {
+      c = &ring[pos & d_mask];
+      size_t seq = c->seq.load(boost::memory_order_acquire);
+      intptr_t dif = (intptr_t)seq - (intptr_t)(pos + 1);
+      if(dif == 0) {
+        if(d_head.compare_exchange_weak(pos, pos + 1, boost::memory_order_relaxed))
+          break;
+      }
+      else if(dif < 0)
+        return false;	// empty
+      else
+        pos = d_head.load(boost::memory_order_relaxed);
+    }
+
+    msg.swap(c->msg);
+    c->msg.reset();
+    c->seq.store(pos + d_mask + 1, boost::memory_order_release);
+    return true;
+  }
+
+  size_t
+  msg_port_queue::pop_batch(std::vector<pmt::pmt_t> &msgs, size_t max)
+  {
+    msgs.resize(0);
+    pmt::pmt_t msg;
+    while(msgs.size() < max && pop(msg))
+      msgs.push_back(msg);
+    return msgs.size();
+  }
+
+  size_t
+  msg_port_queue::size() const
+  {
+    size_t head = d_head.load(boost::memory_order_relaxed);
+    size_t tail = d_tail.load(boost::memory_order_relaxed);
+    return tail > head ? tail - head : 0;
+  }
+
+} /* namespace gr */
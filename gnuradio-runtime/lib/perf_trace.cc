@@ -0,0 +1,192 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2016 Free Software Foundation, Inc.
+ *
+ * This file is part of GNU Radio
+ *
+ * GNU Radio is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * GNU Radio is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GNU Radio; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <gnuradio/perf_trace.h>
+#include <gnuradio/prefs.h>
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+
+namespace gr {
+
+  perf_trace *
+  perf_trace::singleton()
+  {
+    static perf_trace *s_trace = 0;
+    static gr::thread::mutex s_mutex;
+
+    gr::thread::scoped_lock guard(s_mutex);
+    if(!s_trace) {
+      prefs *p = prefs::singleton();
+      bool enabled = p->get_bool("PerfCounters", "trace", false);
+      s_trace = new perf_trace(enabled ? p->get_long("PerfCounters", "trace_size", 65536) : 1);
+      s_trace->set_enabled(enabled);
+    }
+    return s_trace;
+  }
+
+  perf_trace::perf_trace(size_t capacity)
+    : d_enabled(true), d_next(0)
+  {
+    size_t n = 1;
+    while(n < capacity)
+      n *= 2;
+    d_ring.resize(n);
+    d_mask = n - 1;
+  }
+
+  void
+  perf_trace::register_block(uint32_t id, const std::string &name)
+  {
+    gr::thread::scoped_lock guard(d_names_mutex);
+    d_names[id] = name;
+  }
+
+  size_t
+  perf_trace::size() const
+  {
+    return std::min((uint64_t)d_ring.size(), d_next.load());
+  }
+
+  std::vector<perf_trace::record>
+  perf_trace::records() const
+  {
+    uint64_t next = d_next.load();
+    uint64_t n = std::min((uint64_t)d_ring.size(), next);
+
+    std::vector<record> result;
+    result.reserve(n);
+    for(uint64_t i = next - n; i < next; i++)
+      result.push_back(d_ring[i & d_mask]);
+    return result;
+  }
+
+  void
+  perf_trace::clear()
+  {
+    d_next = 0;
+  }
+
+  bool
+  perf_trace::write_binary(const std::string &filename) const
+  {
+    std::ofstream out(filename.c_str(), std::ios::binary);
+    if(!out)
+      return false;
+
+    out.write("GRTRACE1", 8);
+    uint64_t tps = gr::high_res_timer_tps();
+    out.write((const char *)&tps, sizeof(tps));
+
+    {
+      gr::thread::scoped_lock guard(d_names_mutex);
+      uint32_t nblocks = d_names.size();
+      out.write((const char *)&nblocks, sizeof(nblocks));
+      for(std::map<uint32_t, std::string>::const_iterator i = d_names.begin();
+          i != d_names.end(); i++) {
+        uint32_t len = i->second.size();
+        out.write((const char *)&i->first, sizeof(i->first));
+        out.write((const char *)&len, sizeof(len));
+        out.write(i->second.data(), len);
+      }
+    }
+
+    std::vector<record> r = records();
+    uint64_t nrecords = r.size();
+    out.write((const char *)&nrecords, sizeof(nrecords));
+    if(nrecords > 0)
+      out.write((const char *)&r[0], nrecords * sizeof(record));
+
+    return out.good();
+  }
+
+  // Block names are ours to choose, but may still have anything in
+  // them; keep them from breaking the JSON.
+  static std::string
+  json_escape(const std::string &s)
+  {
+    std::string r;
+    for(size_t i = 0; i < s.size(); i++) {
+      if(s[i] == '"' || s[i] == '\\')
+        r += '\\';
+      if((unsigned char)s[i] >= 0x20)
+        r += s[i];
+    }
+    return r;
+  }
+
+  bool
+  perf_trace::write_chrome(const std::string &filename) const
+  {
+    FILE *fp = fopen(filename.c_str(), "w");
+    if(!fp)
+      return false;
+
+    static const char *names[] = { "work", "blocked input", "blocked output" };
+    double us_per_tick = 1e6 / gr::high_res_timer_tps();
+
+    fprintf(fp, "{\"traceEvents\":[\n");
+    bool first = true;
+
+    {
+      gr::thread::scoped_lock guard(d_names_mutex);
+      for(std::map<uint32_t, std::string>::const_iterator i = d_names.begin();
+          i != d_names.end(); i++) {
+        fprintf(fp, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":%u,"
+                "\"args\":{\"name\":\"%s\"}}",
+                first ? "" : ",\n", i->first, json_escape(i->second).c_str());
+        first = false;
+      }
+    }
+
+    std::vector<record> r = records();
+    uint64_t t0 = r.empty() ? 0 : r[0].start;
+    for(size_t i = 0; i < r.size(); i++) {
+      if(r[i].type > BLOCKED_OUTPUT)
+        continue;
+      fprintf(fp, "%s{\"name\":\"%s\",\"cat\":\"gr\",\"ph\":\"X\",\"pid\":0,\"tid\":%u,"
+              "\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"nitems\":%u}}",
+              first ? "" : ",\n", names[r[i].type], r[i].block,
+              (double)(int64_t)(r[i].start - t0) * us_per_tick,
+              r[i].duration * us_per_tick, r[i].nitems);
+      first = false;
+    }
+
+    fprintf(fp, "\n]}\n");
+    bool ok = !ferror(fp);
+    fclose(fp);
+    return ok;
+  }
+
+  bool
+  perf_trace::write(const std::string &filename) const
+  {
+    if(filename.size() >= 5 && filename.compare(filename.size() - 5, 5, ".json") == 0)
+      return write_chrome(filename);
+    return write_binary(filename);
+  }
+
+} /* namespace gr */
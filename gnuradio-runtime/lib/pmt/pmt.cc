@@ -25,6 +25,8 @@
 #endif
 
 #include <vector>
+#include <algorithm>
+#include <new>
 #include <pmt/pmt.h>
 #include "pmt_int.h"
 #include <gnuradio/messages/msg_accepter.h>
@@ -43,12 +45,40 @@ get_cache_line_size()
   return CACHE_LINE_SIZE;
 }
 
-static pmt_pool global_pmt_pool(sizeof(pmt_pair), get_cache_line_size());
+// One pool per size of PMT object, in steps of a cache line so no
+// two objects share one; the few bigger than s_max_pooled_size come
+// from the heap. The pools are never destroyed, as PMTs may still be
+// released during static destruction.
+static const size_t s_max_pooled_size = 256;
+
+static pmt_pool **
+make_pmt_pools()
+{
+  size_t line = get_cache_line_size();
+  size_t npools = s_max_pooled_size / line;
+  pmt_pool **pools = new pmt_pool*[npools];
+  for(size_t i = 0; i < npools; i++)
+    pools[i] = new pmt_pool((i + 1) * line, line);
+  return pools;
+}
+
+static pmt_pool *
+pmt_pool_for(size_t size)
+{
+  static pmt_pool **s_pools = make_pmt_pools();
+  if(size > s_max_pooled_size)
+    return 0;
+  return s_pools[(size - 1) / get_cache_line_size()];
+}
 
 void *
 pmt_base::operator new(size_t size)
 {
-  void *p = global_pmt_pool.malloc();
+  pmt_pool *pool = pmt_pool_for(size);
+  if(!pool)
+    return ::operator new(size);
+
+  void *p = pool->malloc();
 
   // fprintf(stderr, "pmt_base::new p = %p\n", p);
   assert((reinterpret_cast<intptr_t>(p) & (get_cache_line_size() - 1)) == 0);
@@ -58,7 +88,11 @@ pmt_base::operator new(size_t size)
 void
 pmt_base::operator delete(void *p, size_t size)
 {
-  global_pmt_pool.free(p);
+  pmt_pool *pool = pmt_pool_for(size);
+  if(!pool)
+    ::operator delete(p);
+  else
+    pool->free(p);
 }
 
 #endif
@@ -838,45 +872,434 @@ uniform_vector_writable_elements(pmt_t vector, size_t &len)
 ////////////////////////////////////////////////////////////////////////////
 
 /*
- * This is an a-list implementation.
+ * make_dict() returns a pmt_dict: a persistent hash array mapped trie
+ * (Bagwell, "Ideal Hash Trees", 2001), 32 ways per level on a 32-bit
+ * hash of the key. Symbols, being interned, hash by address. Keys
+ * whose hashes are all the same end up together in a collision node.
  *
- * When we need better performance for large dictionaries, consider implementing
- * persistent Red-Black trees as described in "Purely Functional Data Structures",
- * Chris Okasaki, 1998, section 3.3.
+ * The empty list and a-lists, which is what dictionaries used to be,
+ * are still dictionaries: they are read as they are and turned into a
+ * pmt_dict by the first dict_add or dict_delete. Each key carries the
+ * sequence number of the dict_add that put it there, so dict_items,
+ * dict_keys and dict_values still list the most recent first, and a
+ * pmt_dict prints and serializes as exactly the a-list it replaces.
+ */
+
+struct pmt_dict::item {
+  boost::detail::atomic_count	d_count;
+  bool				d_leaf;
+
+  item(bool leaf) : d_count(1), d_leaf(leaf) {}
+};
+
+namespace {
+
+  struct dict_leaf : pmt_dict::item {
+    uint32_t	d_hash;
+    uint64_t	d_seq;
+    pmt_t	d_key;
+    pmt_t	d_value;
+
+    dict_leaf(uint32_t hash, uint64_t seq, const pmt_t &key, const pmt_t &value)
+      : item(true), d_hash(hash), d_seq(seq), d_key(key), d_value(value) {}
+  };
+
+  // d_bitmap says which of the 32 slots are used; d_child holds the
+  // used ones in slot order. A collision node has d_bitmap == 0 and
+  // only leaves, all with the same hash.
+  struct dict_node : pmt_dict::item {
+    uint32_t		d_bitmap;
+    uint32_t		d_n;
+    pmt_dict::item     *d_child[1];	// really d_n
+
+    dict_node(uint32_t bitmap, uint32_t n) : item(false), d_bitmap(bitmap), d_n(n) {}
+  };
+
+} // anonymous namespace
+
+typedef pmt_dict::item dict_item;
+
+static const unsigned int DICT_BITS = 5;
+static const unsigned int DICT_HASH_BITS = 32;
+
+static inline unsigned int
+popcount32(uint32_t x)
+{
+  x = x - ((x >> 1) & 0x55555555);
+  x = (x & 0x33333333) + ((x >> 2) & 0x33333333);
+  return (((x + (x >> 4)) & 0x0f0f0f0f) * 0x01010101) >> 24;
+}
+
+static inline dict_item *
+dict_ref_item(dict_item *it)
+{
+  if (it)
+    ++it->d_count;
+  return it;
+}
+
+static void
+dict_unref_item(dict_item *it)
+{
+  if (!it || --it->d_count != 0)
+    return;
+
+  if (it->d_leaf){
+    delete static_cast<dict_leaf *>(it);
+    return;
+  }
+
+  dict_node *n = static_cast<dict_node *>(it);
+  for (uint32_t i = 0; i < n->d_n; i++)
+    dict_unref_item(n->d_child[i]);
+  n->~dict_node();
+  ::operator delete(n);
+}
+
+// A node with room for n children, which the caller fills in.
+static dict_node *
+dict_alloc_node(uint32_t bitmap, uint32_t n)
+{
+  void *p = ::operator new(sizeof(dict_node) + (n - 1) * sizeof(dict_item *));
+  return new (p) dict_node(bitmap, n);
+}
+
+/*
+ * Consistent with eqv: numbers hash by value (with 0.0 == -0.0),
+ * everything else by address.
+ */
+static uint32_t
+dict_hash(const pmt_t &key)
+{
+  pmt_base *p = key.get();
+  uint64_t h;
+
+  if (p->is_integer())
+    h = (uint64_t) static_cast<pmt_integer *>(p)->value();
+  else if (p->is_uint64())
+    h = static_cast<pmt_uint64 *>(p)->value();
+  else if (p->is_real()){
+    double d = static_cast<pmt_real *>(p)->value();
+    if (d == 0)
+      d = 0;
+    memcpy(&h, &d, sizeof(h));
+  }
+  else if (p->is_complex()){
+    std::complex<double> z = static_cast<pmt_complex *>(p)->value();
+    double re = z.real() == 0 ? 0 : z.real();
+    double im = z.imag() == 0 ? 0 : z.imag();
+    uint64_t hi;
+    memcpy(&h, &re, sizeof(h));
+    memcpy(&hi, &im, sizeof(hi));
+    h ^= hi * 0x9e3779b97f4a7c15ULL;
+  }
+  else
+    h = (uint64_t)(uintptr_t) p;
+
+  // finalizer from MurmurHash3
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdULL;
+  h ^= h >> 33;
+  h *= 0xc4ceb9fe1a85ec53ULL;
+  h ^= h >> 33;
+  return (uint32_t) h;
+}
+
+static inline unsigned int
+dict_slot(uint32_t hash, unsigned int shift)
+{
+  return (hash >> shift) & ((1 << DICT_BITS) - 1);
+}
+
+static const dict_leaf *
+dict_find(const dict_item *it, const pmt_t &key, uint32_t hash)
+{
+  for (unsigned int shift = 0; it; shift += DICT_BITS){
+    if (it->d_leaf){
+      const dict_leaf *l = static_cast<const dict_leaf *>(it);
+      return (l->d_hash == hash && eqv(l->d_key, key)) ? l : 0;
+    }
+
+    const dict_node *n = static_cast<const dict_node *>(it);
+    if (shift >= DICT_HASH_BITS){	// collision node
+      for (uint32_t i = 0; i < n->d_n; i++){
+	const dict_leaf *l = static_cast<const dict_leaf *>(n->d_child[i]);
+	if (eqv(l->d_key, key))
+	  return l;
+      }
+      return 0;
+    }
+
+    uint32_t bit = 1u << dict_slot(hash, shift);
+    if (!(n->d_bitmap & bit))
+      return 0;
+    it = n->d_child[popcount32(n->d_bitmap & (bit - 1))];
+  }
+  return 0;
+}
+
+// A copy of n (taking new references to its children) with child pos
+// replaced by c, which the copy takes over.
+static dict_node *
+dict_copy_node(const dict_node *n, uint32_t pos, dict_item *c)
+{
+  dict_node *m = dict_alloc_node(n->d_bitmap, n->d_n);
+  for (uint32_t i = 0; i < n->d_n; i++)
+    m->d_child[i] = (i == pos) ? c : dict_ref_item(n->d_child[i]);
+  return m;
+}
+
+// A copy of n with c inserted before pos.
+static dict_node *
+dict_copy_node_insert(const dict_node *n, uint32_t bitmap, uint32_t pos, dict_item *c)
+{
+  dict_node *m = dict_alloc_node(bitmap, n->d_n + 1);
+  for (uint32_t i = 0; i < pos; i++)
+    m->d_child[i] = dict_ref_item(n->d_child[i]);
+  m->d_child[pos] = c;
+  for (uint32_t i = pos; i < n->d_n; i++)
+    m->d_child[i + 1] = dict_ref_item(n->d_child[i]);
+  return m;
+}
+
+// A copy of n without child pos.
+static dict_node *
+dict_copy_node_erase(const dict_node *n, uint32_t bitmap, uint32_t pos)
+{
+  dict_node *m = dict_alloc_node(bitmap, n->d_n - 1);
+  for (uint32_t i = 0, j = 0; i < n->d_n; i++)
+    if (i != pos)
+      m->d_child[j++] = dict_ref_item(n->d_child[i]);
+  return m;
+}
+
+// The subtrie at shift holding the two leaves a and b.
+static dict_item *
+dict_merge(dict_leaf *a, dict_leaf *b, unsigned int shift)
+{
+  if (shift >= DICT_HASH_BITS){
+    dict_node *n = dict_alloc_node(0, 2);
+    n->d_child[0] = dict_ref_item(a);
+    n->d_child[1] = dict_ref_item(b);
+    return n;
+  }
+
+  unsigned int sa = dict_slot(a->d_hash, shift);
+  unsigned int sb = dict_slot(b->d_hash, shift);
+  if (sa == sb){
+    dict_node *n = dict_alloc_node(1u << sa, 1);
+    n->d_child[0] = dict_merge(a, b, shift + DICT_BITS);
+    return n;
+  }
+
+  dict_node *n = dict_alloc_node((1u << sa) | (1u << sb), 2);
+  n->d_child[sa < sb ? 0 : 1] = dict_ref_item(a);
+  n->d_child[sa < sb ? 1 : 0] = dict_ref_item(b);
+  return n;
+}
+
+/*
+ * The subtrie it (at shift) with leaf added, replacing any leaf with
+ * the same key. Returns a new reference; it itself is unchanged.
  */
+static dict_item *
+dict_insert(dict_item *it, unsigned int shift, dict_leaf *leaf, bool &replaced)
+{
+  if (!it)
+    return dict_ref_item(leaf);
+
+  if (it->d_leaf){
+    dict_leaf *l = static_cast<dict_leaf *>(it);
+    if (l->d_hash == leaf->d_hash && eqv(l->d_key, leaf->d_key)){
+      replaced = true;
+      return dict_ref_item(leaf);
+    }
+    return dict_merge(l, leaf, shift);
+  }
+
+  dict_node *n = static_cast<dict_node *>(it);
+  if (shift >= DICT_HASH_BITS){
+    for (uint32_t i = 0; i < n->d_n; i++){
+      if (eqv(static_cast<dict_leaf *>(n->d_child[i])->d_key, leaf->d_key)){
+	replaced = true;
+	return dict_copy_node(n, i, dict_ref_item(leaf));
+      }
+    }
+    return dict_copy_node_insert(n, 0, n->d_n, dict_ref_item(leaf));
+  }
+
+  uint32_t bit = 1u << dict_slot(leaf->d_hash, shift);
+  uint32_t pos = popcount32(n->d_bitmap & (bit - 1));
+  if (!(n->d_bitmap & bit))
+    return dict_copy_node_insert(n, n->d_bitmap | bit, pos, dict_ref_item(leaf));
+
+  dict_item *c = dict_insert(n->d_child[pos], shift + DICT_BITS, leaf, replaced);
+  return dict_copy_node(n, pos, c);
+}
+
+/*
+ * The subtrie it (at shift) without key. Returns a new reference,
+ * possibly to it itself if key isn't there. A node left with a single
+ * leaf is replaced by the leaf.
+ */
+static dict_item *
+dict_remove(dict_item *it, unsigned int shift, const pmt_t &key, uint32_t hash,
+	    bool &found)
+{
+  if (!it)
+    return 0;
+
+  if (it->d_leaf){
+    dict_leaf *l = static_cast<dict_leaf *>(it);
+    if (l->d_hash == hash && eqv(l->d_key, key)){
+      found = true;
+      return 0;
+    }
+    return dict_ref_item(it);
+  }
+
+  dict_node *n = static_cast<dict_node *>(it);
+  uint32_t bitmap, pos;
+  dict_item *c;
+
+  if (shift >= DICT_HASH_BITS){
+    for (pos = 0; pos < n->d_n; pos++)
+      if (eqv(static_cast<dict_leaf *>(n->d_child[pos])->d_key, key))
+	break;
+    if (pos == n->d_n)
+      return dict_ref_item(it);
+    found = true;
+    bitmap = 0;
+    c = 0;
+  }
+  else {
+    uint32_t bit = 1u << dict_slot(hash, shift);
+    if (!(n->d_bitmap & bit))
+      return dict_ref_item(it);
+    pos = popcount32(n->d_bitmap & (bit - 1));
+    c = dict_remove(n->d_child[pos], shift + DICT_BITS, key, hash, found);
+    if (!found){
+      dict_unref_item(c);
+      return dict_ref_item(it);
+    }
+    bitmap = c ? n->d_bitmap : n->d_bitmap & ~bit;
+  }
+
+  if (c){
+    if (n->d_n == 1 && c->d_leaf)
+      return c;
+    return dict_copy_node(n, pos, c);
+  }
+
+  if (n->d_n == 1)
+    return 0;
+  if (n->d_n == 2 && n->d_child[1 - pos]->d_leaf)
+    return dict_ref_item(n->d_child[1 - pos]);
+  return dict_copy_node_erase(n, bitmap, pos);
+}
+
+static void
+dict_collect(const dict_item *it, std::vector<const dict_leaf *> &leaves)
+{
+  if (!it)
+    return;
+  if (it->d_leaf){
+    leaves.push_back(static_cast<const dict_leaf *>(it));
+    return;
+  }
+  const dict_node *n = static_cast<const dict_node *>(it);
+  for (uint32_t i = 0; i < n->d_n; i++)
+    dict_collect(n->d_child[i], leaves);
+}
+
+static bool
+dict_newer(const dict_leaf *a, const dict_leaf *b)
+{
+  return a->d_seq > b->d_seq;
+}
+
+// The leaves of d, most recently added first.
+static void
+dict_leaves(const pmt_dict *d, std::vector<const dict_leaf *> &leaves)
+{
+  leaves.reserve(d->d_size);
+  dict_collect(d->d_root, leaves);
+  std::sort(leaves.begin(), leaves.end(), dict_newer);
+}
+
+pmt_dict::pmt_dict(item *root, size_t size, uint64_t seq)
+  : d_root(root), d_size(size), d_seq(seq) {}
+
+pmt_dict::~pmt_dict()
+{
+  dict_unref_item(d_root);
+}
+
+static pmt_dict *
+_dict(pmt_t x)
+{
+  return static_cast<pmt_dict*>(x.get());
+}
+
+static pmt_t
+dict_add_leaf(pmt_dict *d, const pmt_t &key, const pmt_t &value)
+{
+  dict_leaf *leaf = new dict_leaf(dict_hash(key), d->d_seq, key, value);
+  bool replaced = false;
+  dict_item *root = dict_insert(d->d_root, 0, leaf, replaced);
+  dict_unref_item(leaf);
+  return pmt_t(new pmt_dict(root, d->d_size + (replaced ? 0 : 1), d->d_seq + 1));
+}
+
+/*
+ * dict as a pmt_dict. An a-list is added oldest first, so a key that
+ * appears twice keeps the value assv would have found.
+ */
+static pmt_t
+dict_as_hamt(const pmt_t &dict, const char *caller)
+{
+  if (dict->is_dict())
+    return dict;
+  if (!is_dict(dict))
+    throw wrong_type(caller, dict);
+
+  std::vector<pmt_t> pairs;
+  for (pmt_t p = dict; is_pair(p) && is_pair(car(p)); p = cdr(p))
+    pairs.push_back(car(p));
+
+  pmt_t d = make_dict();
+  for (size_t i = pairs.size(); i-- > 0; )
+    d = dict_add_leaf(_dict(d), car(pairs[i]), cdr(pairs[i]));
+  return d;
+}
 
 bool
 is_dict(const pmt_t &obj)
 {
-  return is_null(obj) || is_pair(obj);
+  return is_null(obj) || is_pair(obj) || obj->is_dict();
 }
 
 pmt_t
 make_dict()
 {
-  return PMT_NIL;
+  return pmt_t(new pmt_dict(0, 0, 0));
 }
 
 pmt_t
 dict_add(const pmt_t &dict, const pmt_t &key, const pmt_t &value)
 {
-  if (is_null(dict))
-    return acons(key, value, PMT_NIL);
-
-  if (dict_has_key(dict, key))
-    return acons(key, value, dict_delete(dict, key));
-
-  return acons(key, value, dict);
+  pmt_t d = dict_as_hamt(dict, "pmt_dict_add");
+  return dict_add_leaf(_dict(d), key, value);
 }
 
 pmt_t
 dict_update(const pmt_t &dict1, const pmt_t &dict2)
 {
   pmt_t d(dict1);
-  pmt_t k(dict_keys(dict2));
-  while(is_pair(k)){
-    d = dict_add(d, car(k), dict_ref(dict2, car(k), PMT_NIL));
-    k = cdr(k);
+  pmt_t items(dict_items(dict2));
+  while(is_pair(items)){
+    d = dict_add(d, caar(items), cdar(items));
+    items = cdr(items);
     }
   return d;
 }
@@ -888,15 +1311,25 @@ dict_delete(const pmt_t &dict, const pmt_t &key)
   if (is_null(dict))
     return dict;
 
-  if (eqv(caar(dict), key))
-    return cdr(dict);
-
-  return cons(car(dict), dict_delete(cdr(dict), key));
+  pmt_t d = dict_as_hamt(dict, "pmt_dict_delete");
+  pmt_dict *pd = _dict(d);
+  bool found = false;
+  dict_item *root = dict_remove(pd->d_root, 0, key, dict_hash(key), found);
+  if (!found){
+    dict_unref_item(root);
+    return d;
+  }
+  return pmt_t(new pmt_dict(root, pd->d_size - 1, pd->d_seq));
 }
 
 pmt_t
 dict_ref(const pmt_t &dict, const pmt_t &key, const pmt_t &not_found)
 {
+  if (dict->is_dict()){
+    const dict_leaf *l = dict_find(_dict(dict)->d_root, key, dict_hash(key));
+    return l ? l->d_value : not_found;
+  }
+
   pmt_t	p = assv(key, dict);	// look for (key . value) pair
   if (is_pair(p))
     return cdr(p);
@@ -907,6 +1340,9 @@ dict_ref(const pmt_t &dict, const pmt_t &key, const pmt_t &not_found)
 bool
 dict_has_key(const pmt_t &dict, const pmt_t &key)
 {
+  if (dict->is_dict())
+    return dict_find(_dict(dict)->d_root, key, dict_hash(key)) != 0;
+
   return is_pair(assv(key, dict));
 }
 
@@ -916,7 +1352,15 @@ dict_items(pmt_t dict)
   if (!is_dict(dict))
     throw wrong_type("pmt_dict_values", dict);
 
-  return dict;		// equivalent to dict in the a-list case
+  if (!dict->is_dict())
+    return dict;		// already an a-list
+
+  std::vector<const dict_leaf *> leaves;
+  dict_leaves(_dict(dict), leaves);
+  pmt_t r = PMT_NIL;
+  for (size_t i = leaves.size(); i-- > 0; )
+    r = cons(cons(leaves[i]->d_key, leaves[i]->d_value), r);
+  return r;
 }
 
 pmt_t
@@ -925,7 +1369,15 @@ dict_keys(pmt_t dict)
   if (!is_dict(dict))
     throw wrong_type("pmt_dict_keys", dict);
 
-  return map(car, dict);
+  if (!dict->is_dict())
+    return map(car, dict);
+
+  std::vector<const dict_leaf *> leaves;
+  dict_leaves(_dict(dict), leaves);
+  pmt_t r = PMT_NIL;
+  for (size_t i = leaves.size(); i-- > 0; )
+    r = cons(leaves[i]->d_key, r);
+  return r;
 }
 
 pmt_t
@@ -934,7 +1386,15 @@ dict_values(pmt_t dict)
   if (!is_dict(dict))
     throw wrong_type("pmt_dict_keys", dict);
 
-  return map(cdr, dict);
+  if (!dict->is_dict())
+    return map(cdr, dict);
+
+  std::vector<const dict_leaf *> leaves;
+  dict_leaves(_dict(dict), leaves);
+  pmt_t r = PMT_NIL;
+  for (size_t i = leaves.size(); i-- > 0; )
+    r = cons(leaves[i]->d_value, r);
+  return r;
 }
 
 ////////////////////////////////////////////////////////////////////////////
@@ -1098,6 +1558,10 @@ equal(const pmt_t& x, const pmt_t& y)
   if (x->is_pair() && y->is_pair())
     return equal(car(x), car(y)) && equal(cdr(x), cdr(y));
 
+  // Compare dictionaries the way they'd compare as a-lists.
+  if ((x->is_dict() || y->is_dict()) && is_dict(x) && is_dict(y))
+    return equal(dict_items(x), dict_items(y));
+
   if (x->is_vector() && y->is_vector()){
     pmt_vector *xv = _vector(x);
     pmt_vector *yv = _vector(y);
@@ -1173,7 +1637,8 @@ length(const pmt_t& x)
     throw wrong_type("pmt_length", x);
   }
 
-  // FIXME dictionary length (number of entries)
+  if (x->is_dict())
+    return _dict(x)->d_size;
 
   throw wrong_type("pmt_length", x);
 }
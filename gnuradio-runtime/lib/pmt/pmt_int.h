@@ -32,7 +32,7 @@
  * See pmt.h for the public interface
  */
 
-#define PMT_LOCAL_ALLOCATOR 0		// define to 0 or 1
+#define PMT_LOCAL_ALLOCATOR 1		// define to 0 or 1
 namespace pmt {
 
 class PMT_API pmt_base : boost::noncopyable {
@@ -217,6 +217,26 @@ public:
   void _set(size_t k, pmt_t v) { d_v[k] = v; }
 };
 
+/*
+ * Persistent hash array mapped trie, keyed by eqv. Adding or deleting
+ * a key copies only the path to it; the rest of the trie is shared
+ * with the dictionary it came from.
+ */
+class pmt_dict : public pmt_base
+{
+public:
+  struct item;			// trie node or (key . value) leaf
+
+  item		*d_root;	// 0 if empty
+  size_t	 d_size;
+  uint64_t	 d_seq;		// stamped on the next key added
+
+  pmt_dict(item *root, size_t size, uint64_t seq);
+  ~pmt_dict();
+
+  bool is_dict() const { return true; }
+};
+
 class pmt_any : public pmt_base
 {
   boost::any	d_any;
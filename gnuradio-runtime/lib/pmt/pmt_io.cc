@@ -105,9 +105,8 @@ write(pmt_t obj, std::ostream &port)
     port << ")";
   }
   else if (is_dict(obj)){
-    // FIXME
-    // port << "#<dict " << obj << ">";
-    port << "#<dict>";
+    // same as the a-list it would once have been
+    write(dict_items(obj), port);
   }
   else if (is_uniform_vector(obj)){
     port << "#[";
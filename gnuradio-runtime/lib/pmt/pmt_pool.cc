@@ -29,68 +29,144 @@
 
 namespace pmt {
 
+#if defined(_MSC_VER)
+#define PMT_TLS __declspec(thread)
+#else
+#define PMT_TLS __thread
+#endif
+
+// boost::thread_specific_ptr owns each thread's caches (and flushes
+// them at thread exit), but looking one up is a map search. The
+// first few pools also keep theirs in a plain thread-local slot.
+static const unsigned int s_max_fast_pools = 16;
+static PMT_TLS void *t_caches[s_max_fast_pools];
+static boost::atomic<unsigned int> s_next_pool_id(0);
+
 static inline size_t
 ROUNDUP(size_t x, size_t stride)
 {
   return ((((x) + (stride) - 1)/(stride)) * (stride));
 }
 
+pmt_pool::cache::~cache()
+{
+  // The thread is going away; give its items to the others.
+  if (d_head){
+    item *last = d_head;
+    while (last->d_next)
+      last = last->d_next;
+    d_pool->push_global(d_head, last);
+  }
+  if (d_pool->d_id < s_max_fast_pools)
+    t_caches[d_pool->d_id] = 0;
+}
+
 pmt_pool::pmt_pool(size_t itemsize, size_t alignment,
 		   size_t allocation_size, size_t max_items)
   : d_itemsize(ROUNDUP(itemsize, alignment)),
     d_alignment(alignment),
     d_allocation_size(std::max(allocation_size, 16 * itemsize)),
     d_max_items(max_items), d_n_items(0),
-    d_freelist(0)
+    d_id(s_next_pool_id++), d_global(0)
 {
+  // Keep a couple of chunks' worth per thread before giving back.
+  d_cache_items = std::max((size_t)64, 2 * d_allocation_size / d_itemsize);
 }
 
 pmt_pool::~pmt_pool()
 {
+  // Flush our own free list while the memory is still there.
+  d_cache.reset();
+
   for (unsigned int i = 0; i < d_allocations.size(); i++){
     delete [] d_allocations[i];
   }
 }
 
-void *
-pmt_pool::malloc()
+pmt_pool::cache *
+pmt_pool::get_cache()
 {
-  scoped_lock guard(d_mutex);
-  item *p;
+  if (d_id < s_max_fast_pools && t_caches[d_id])
+    return (cache *) t_caches[d_id];
 
-  if (d_max_items != 0){
-    while (d_n_items >= d_max_items)
-      d_cond.wait(guard);
+  cache *c = d_cache.get();
+  if (!c){
+    c = new cache(this);
+    d_cache.reset(c);
   }
+  if (d_id < s_max_fast_pools)
+    t_caches[d_id] = c;
+  return c;
+}
 
-  if (d_freelist){	// got something?
-    p = d_freelist;
-    d_freelist = p->d_next;
-    d_n_items++;
-    return p;
+/*
+ * Push the list first..last onto the global stack. Pushing is safe
+ * against ABA; popping only ever takes the whole stack.
+ */
+void
+pmt_pool::push_global(item *first, item *last)
+{
+  item *head = d_global.load(boost::memory_order_relaxed);
+  do {
+    last->d_next = head;
+  } while (!d_global.compare_exchange_weak(head, first,
+                                           boost::memory_order_release,
+                                           boost::memory_order_relaxed));
+}
+
+void
+pmt_pool::refill(cache *c)
+{
+  // Take everything the other threads gave back...
+  item *p = d_global.exchange(0, boost::memory_order_acquire);
+  if (p){
+    size_t n = 0;
+    for (item *q = p; q; q = q->d_next)
+      n++;
+    c->d_head = p;
+    c->d_n_items = n;
+    return;
   }
 
-  // allocate a new chunk
+  // ...or allocate a new chunk
   char *alloc = new char[d_allocation_size + d_alignment - 1];
-  d_allocations.push_back(alloc);
+  {
+    scoped_lock guard(d_mutex);
+    d_allocations.push_back(alloc);
+  }
 
   // get the alignment we require
   char *start = (char *)(((uintptr_t)alloc + d_alignment-1) & -d_alignment);
   char *end = alloc + d_allocation_size + d_alignment - 1;
   size_t n = (end - start) / d_itemsize;
 
-  // link the new items onto the free list.
+  // link the new items onto our free list.
   p = (item *) start;
   for (size_t i = 0; i < n; i++){
-    p->d_next = d_freelist;
-    d_freelist = p;
+    p->d_next = c->d_head;
+    c->d_head = p;
     p = (item *)((char *) p + d_itemsize);
   }
+  c->d_n_items += n;
+}
+
+void *
+pmt_pool::malloc()
+{
+  if (d_max_items != 0){
+    scoped_lock guard(d_mutex);
+    while (d_n_items >= d_max_items)
+      d_cond.wait(guard);
+    d_n_items++;
+  }
+
+  cache *c = get_cache();
+  if (!c->d_head)
+    refill(c);
 
-  // now return the first one
-  p = d_freelist;
-  d_freelist = p->d_next;
-  d_n_items++;
+  item *p = c->d_head;
+  c->d_head = p->d_next;
+  c->d_n_items--;
   return p;
 }
 
@@ -100,14 +176,33 @@ pmt_pool::free(void *foo)
   if (!foo)
     return;
 
-  scoped_lock guard(d_mutex);
-
+  cache *c = get_cache();
   item *p = (item *) foo;
-  p->d_next = d_freelist;
-  d_freelist = p;
-  d_n_items--;
-  if (d_max_items != 0)
+  p->d_next = c->d_head;
+  c->d_head = p;
+  c->d_n_items++;
+
+  // Too many: hand the older half to whoever needs them.
+  if (c->d_n_items > d_cache_items){
+    size_t keep = c->d_n_items / 2;
+    item *last = c->d_head;
+    for (size_t i = 1; i < keep; i++)
+      last = last->d_next;
+    item *first = last->d_next;
+    last->d_next = 0;
+    c->d_n_items = keep;
+
+    last = first;
+    while (last->d_next)
+      last = last->d_next;
+    push_global(first, last);
+  }
+
+  if (d_max_items != 0){
+    scoped_lock guard(d_mutex);
+    d_n_items--;
     d_cond.notify_one();
+  }
 }
 
 } /* namespace pmt */
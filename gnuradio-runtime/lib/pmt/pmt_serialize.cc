@@ -24,6 +24,7 @@
 #endif
 
 #include <vector>
+#include <string.h>
 #include <pmt/pmt.h>
 #include "pmt_int.h"
 #include "pmt/pmt_serial_tags.h"
@@ -33,67 +34,137 @@ namespace pmt {
 static pmt_t parse_pair(std::streambuf &sb);
 
 // ----------------------------------------------------------------
-// output primitives
+// contiguous buffers
 // ----------------------------------------------------------------
 
-static bool
-serialize_untagged_u8(unsigned int i, std::streambuf &sb)
+// always big-endian
+static inline void
+put_be16(uint8_t *p, uint16_t i)
 {
-  return sb.sputc((i >> 0) & 0xff) != std::streambuf::traits_type::eof();
+  p[0] = i >> 8;
+  p[1] = i;
 }
 
-// always writes big-endian
-static bool
-serialize_untagged_u16(unsigned int i, std::streambuf &sb)
+static inline void
+put_be32(uint8_t *p, uint32_t i)
 {
-  sb.sputc((i >> 8) & 0xff);
-  return sb.sputc((i >> 0) & 0xff) != std::streambuf::traits_type::eof();
+  p[0] = i >> 24;
+  p[1] = i >> 16;
+  p[2] = i >> 8;
+  p[3] = i;
 }
 
-// always writes big-endian
-static bool
-serialize_untagged_u32(unsigned int i, std::streambuf &sb)
+static inline void
+put_be64(uint8_t *p, uint64_t i)
 {
-  sb.sputc((i >> 24) & 0xff);
-  sb.sputc((i >> 16) & 0xff);
-  sb.sputc((i >>  8) & 0xff);
-  return sb.sputc((i >> 0) & 0xff) != std::streambuf::traits_type::eof();
+  put_be32(p, i >> 32);
+  put_be32(p + 4, i);
 }
 
-static bool
-serialize_untagged_f64(double i, std::streambuf &sb)
+static inline void
+put_f64(uint8_t *p, double d)
 {
- typedef union {
-	double id;
-	uint64_t ii;
-	} iu_t;
-  iu_t iu;
-  iu.id = i;
-  sb.sputc((iu.ii >> 56) & 0xff);
-  sb.sputc((iu.ii >> 48) & 0xff);
-  sb.sputc((iu.ii >> 40) & 0xff);
-  sb.sputc((iu.ii >> 32) & 0xff);
-  sb.sputc((iu.ii >> 24) & 0xff);
-  sb.sputc((iu.ii >> 16) & 0xff);
-  sb.sputc((iu.ii >>  8) & 0xff);
-  return sb.sputc((iu.ii >>  0) & 0xff) != std::streambuf::traits_type::eof();
+  uint64_t i;
+  memcpy(&i, &d, sizeof(i));
+  put_be64(p, i);
 }
 
+static inline uint16_t
+get_be16(const uint8_t *p)
+{
+  return (p[0] << 8) | p[1];
+}
 
-// always writes big-endian
-static bool
-serialize_untagged_u64(uint64_t i, std::streambuf &sb)
+static inline uint32_t
+get_be32(const uint8_t *p)
+{
+  return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+static inline uint64_t
+get_be64(const uint8_t *p)
 {
-  sb.sputc((i >> 56) & 0xff);
-  sb.sputc((i >> 48) & 0xff);
-  sb.sputc((i >> 40) & 0xff);
-  sb.sputc((i >> 32) & 0xff);
-  sb.sputc((i >> 24) & 0xff);
-  sb.sputc((i >> 16) & 0xff);
-  sb.sputc((i >>  8) & 0xff);
-  return sb.sputc((i >> 0) & 0xff) != std::streambuf::traits_type::eof();
+  return ((uint64_t)get_be32(p) << 32) | get_be32(p + 4);
 }
 
+static inline double
+get_f64(const uint8_t *p)
+{
+  uint64_t i = get_be64(p);
+  double d;
+  memcpy(&d, &i, sizeof(d));
+  return d;
+}
+
+namespace {
+
+  /*
+   * Writes into buf while it fits, but counts everything, so the size
+   * comes out right either way.
+   */
+  class buffer_writer {
+    uint8_t	*d_buf;
+    size_t	 d_len;
+    size_t	 d_n;
+
+  public:
+    buffer_writer(void *buf, size_t len)
+      : d_buf(static_cast<uint8_t *>(buf)), d_len(len), d_n(0) {}
+
+    size_t size() const { return d_n; }
+    bool fits() const { return d_n <= d_len; }
+
+    // where to write the next n bytes, or 0 if they don't fit
+    uint8_t *reserve(size_t n)
+    {
+      uint8_t *p = (d_n + n <= d_len) ? d_buf + d_n : 0;
+      d_n += n;
+      return p;
+    }
+
+    void u8(unsigned int i)  { if (uint8_t *p = reserve(1)) p[0] = i; }
+    void u16(unsigned int i) { if (uint8_t *p = reserve(2)) put_be16(p, i); }
+    void u32(unsigned int i) { if (uint8_t *p = reserve(4)) put_be32(p, i); }
+    void u64(uint64_t i)     { if (uint8_t *p = reserve(8)) put_be64(p, i); }
+    void f64(double d)       { if (uint8_t *p = reserve(8)) put_f64(p, d); }
+  };
+
+  /*
+   * Reads from the bytes [p, end). If there's an owner, byte vectors
+   * are deserialized as views into it rather than copied.
+   */
+  class buffer_reader {
+    const uint8_t	*d_p;
+    const uint8_t	*d_end;
+    pmt_t		 d_owner;
+
+  public:
+    buffer_reader(const void *buf, size_t len, pmt_t owner = pmt_t())
+      : d_p(static_cast<const uint8_t *>(buf)), d_end(d_p + len), d_owner(owner) {}
+
+    size_t left() const { return d_end - d_p; }
+    const uint8_t *pos() const { return d_p; }
+    const pmt_t &owner() const { return d_owner; }
+
+    // the next n items of itemsize bytes
+    const uint8_t *take(size_t n, size_t itemsize = 1)
+    {
+      if (n > left() / itemsize)
+	throw exception("pmt::deserialize: malformed input stream", PMT_F);
+      const uint8_t *p = d_p;
+      d_p += n * itemsize;
+      return p;
+    }
+
+    uint8_t  u8()  { return *take(1); }
+    uint16_t u16() { return get_be16(take(2)); }
+    uint32_t u32() { return get_be32(take(4)); }
+    uint64_t u64() { return get_be64(take(8)); }
+    double   f64() { return get_f64(take(8)); }
+  };
+
+} // anonymous namespace
+
 // ----------------------------------------------------------------
 // input primitives
 // ----------------------------------------------------------------
@@ -234,43 +305,86 @@ deserialize_tuple(pmt_t *tuple, std::streambuf &sb)
 }
 
 
+static void
+uniform_vector_header(buffer_writer &w, int utag, size_t len)
+{
+  w.u8(PST_UNIFORM_VECTOR);
+  w.u8(utag);
+  w.u32(len);
+  w.u8(1);		// npad
+  w.u8(0);
+}
+
 /*
- * Write portable byte-serial representation of \p obj to \p sb
- *
- * N.B., Circular structures cause infinite recursion.
+ * Uniform vectors go over the wire as big-endian integers, and doubles
+ * for all the floating point types. Convert them in one pass over the
+ * elements.
  */
-bool
-serialize(pmt_t obj, std::streambuf &sb)
+template<typename T> static void
+serialize_integers(buffer_writer &w, pmt_t obj, int utag)
+{
+  size_t len;
+  const T *v = static_cast<const T *>(uniform_vector_elements(obj, len));
+  len /= sizeof(T);
+  uniform_vector_header(w, utag, len);
+
+  uint8_t *p = w.reserve(len * sizeof(T));
+  if (!p)
+    return;
+  switch (sizeof(T)){
+  case 1: memcpy(p, v, len); break;
+  case 2: for (size_t i = 0; i < len; i++) put_be16(p + 2*i, v[i]); break;
+  case 4: for (size_t i = 0; i < len; i++) put_be32(p + 4*i, v[i]); break;
+  case 8: for (size_t i = 0; i < len; i++) put_be64(p + 8*i, v[i]); break;
+  }
+}
+
+// T is float or double; ncomp is 2 for complex
+template<typename T> static void
+serialize_reals(buffer_writer &w, pmt_t obj, int utag, size_t ncomp)
 {
-  bool ok = true;
+  size_t len;
+  const T *v = static_cast<const T *>(uniform_vector_elements(obj, len));
+  len /= sizeof(T);
+  uniform_vector_header(w, utag, len / ncomp);
+
+  uint8_t *p = w.reserve(len * 8);
+  if (!p)
+    return;
+  for (size_t i = 0; i < len; i++)
+    put_f64(p + 8*i, v[i]);
+}
 
+/*
+ * N.B., Circular structures cause infinite recursion.
+ */
+static void
+serialize(pmt_t obj, buffer_writer &w)
+{
  tail_recursion:
 
   if(is_bool(obj)) {
-    if(eq(obj, PMT_T))
-      return serialize_untagged_u8(PST_TRUE, sb);
-    else
-      return serialize_untagged_u8(PST_FALSE, sb);
+    w.u8(eq(obj, PMT_T) ? PST_TRUE : PST_FALSE);
+    return;
   }
 
-  if(is_null(obj))
-    return serialize_untagged_u8(PST_NULL, sb);
+  if(is_null(obj)) {
+    w.u8(PST_NULL);
+    return;
+  }
 
   if(is_symbol(obj)) {
     const std::string s = symbol_to_string(obj);
-    size_t len = s.size();
-    ok = serialize_untagged_u8(PST_SYMBOL, sb);
-    ok &= serialize_untagged_u16(len, sb);
-    for(size_t i = 0; i < len; i++)
-      ok &= serialize_untagged_u8(s[i], sb);
-    return ok;
+    w.u8(PST_SYMBOL);
+    w.u16(s.size());
+    if(uint8_t *p = w.reserve(s.size()))
+      memcpy(p, s.data(), s.size());
+    return;
   }
 
   if(is_pair(obj)) {
-    ok = serialize_untagged_u8(PST_PAIR, sb);
-    ok &= serialize(car(obj), sb);
-    if(!ok)
-      return false;
+    w.u8(PST_PAIR);
+    serialize(car(obj), w);
     obj = cdr(obj);
     goto tail_recursion;
   }
@@ -278,244 +392,106 @@ serialize(pmt_t obj, std::streambuf &sb)
   if(is_number(obj)) {
 
     if(is_uint64(obj)) {
-        uint64_t i = to_uint64(obj);
-        ok = serialize_untagged_u8(PST_UINT64, sb);
-        ok &= serialize_untagged_u64(i, sb);
-        return ok;
+      w.u8(PST_UINT64);
+      w.u64(to_uint64(obj));
+      return;
     }
-    else {
-      if(is_integer(obj)) {
-	long i = to_long(obj);
-	if(sizeof(long) > 4) {
-	  if(i < -2147483647 || i > 2147483647)
-	    throw notimplemented("pmt::serialize (64-bit integers)", obj);
-	}
-	ok = serialize_untagged_u8(PST_INT32, sb);
-	ok &= serialize_untagged_u32(i, sb);
-	return ok;
+
+    if(is_integer(obj)) {
+      long i = to_long(obj);
+      if(sizeof(long) > 4) {
+	if(i < -2147483647 || i > 2147483647)
+	  throw notimplemented("pmt::serialize (64-bit integers)", obj);
       }
+      w.u8(PST_INT32);
+      w.u32(i);
+      return;
     }
 
     if(is_real(obj)) {
-      float i = to_double(obj);
-      ok = serialize_untagged_u8(PST_DOUBLE, sb);
-      ok &= serialize_untagged_f64(i, sb);
-      return ok;
+      w.u8(PST_DOUBLE);
+      w.f64(to_double(obj));
+      return;
     }
 
     if(is_complex(obj)) {
       std::complex<double> i = to_complex(obj);
-      ok = serialize_untagged_u8(PST_COMPLEX, sb);
-      ok &= serialize_untagged_f64(i.real(), sb);
-      ok &= serialize_untagged_f64(i.imag(), sb);
-      return ok;
+      w.u8(PST_COMPLEX);
+      w.f64(i.real());
+      w.f64(i.imag());
+      return;
     }
   }
 
   if(is_vector(obj)) {
     size_t vec_len = pmt::length(obj);
-    ok = serialize_untagged_u8(PST_VECTOR, sb);
-    ok &= serialize_untagged_u32(vec_len, sb);
-    for(size_t i=0; i<vec_len; i++) {
-      ok &= serialize(vector_ref(obj, i), sb);
-    }
-    return ok;
+    w.u8(PST_VECTOR);
+    w.u32(vec_len);
+    for(size_t i=0; i<vec_len; i++)
+      serialize(vector_ref(obj, i), w);
+    return;
   }
 
   if(is_uniform_vector(obj)) {
-    size_t npad = 1;
-    size_t vec_len = pmt::length(obj);
-
-    if(is_u8vector(obj)) {
-      ok = serialize_untagged_u8(PST_UNIFORM_VECTOR, sb);
-      ok &= serialize_untagged_u8(UVI_U8, sb);
-      ok &= serialize_untagged_u32(vec_len, sb);
-      ok &= serialize_untagged_u8(npad, sb);
-      for(size_t i=0; i<npad; i++) {
-	ok &= serialize_untagged_u8(0, sb);
-      }
-      for(size_t i=0; i<vec_len; i++) {
-	ok &= serialize_untagged_u8(u8vector_ref(obj, i), sb);
-      }
-      return ok;
-    }
-
-    if(is_s8vector(obj)) {
-      ok = serialize_untagged_u8(PST_UNIFORM_VECTOR, sb);
-      ok &= serialize_untagged_u8(UVI_S8, sb);
-      ok &= serialize_untagged_u32(vec_len, sb);
-      ok &= serialize_untagged_u8(npad, sb);
-      for(size_t i=0; i<npad; i++) {
-	ok &= serialize_untagged_u8(0, sb);
-      }
-      for(size_t i=0; i<vec_len; i++) {
-	ok &= serialize_untagged_u8(s8vector_ref(obj, i), sb);
-      }
-      return ok;
-    }
-
-    if(is_u16vector(obj)) {
-      ok = serialize_untagged_u8(PST_UNIFORM_VECTOR, sb);
-      ok &= serialize_untagged_u8(UVI_U16, sb);
-      ok &= serialize_untagged_u32(vec_len, sb);
-      ok &= serialize_untagged_u8(npad, sb);
-      for(size_t i=0; i<npad; i++) {
-	ok &= serialize_untagged_u8(0, sb);
-      }
-      for(size_t i=0; i<vec_len; i++) {
-	ok &= serialize_untagged_u16(u16vector_ref(obj, i), sb);
-      }
-      return ok;
-    }
-
-    if(is_s16vector(obj)) {
-      ok = serialize_untagged_u8(PST_UNIFORM_VECTOR, sb);
-      ok &= serialize_untagged_u8(UVI_S16, sb);
-      ok &= serialize_untagged_u32(vec_len, sb);
-      ok &= serialize_untagged_u8(npad, sb);
-      for(size_t i=0; i<npad; i++) {
-	ok &= serialize_untagged_u8(0, sb);
-      }
-      for(size_t i=0; i<vec_len; i++) {
-	ok &= serialize_untagged_u16(s16vector_ref(obj, i), sb);
-      }
-      return ok;
-    }
-
-    if(is_u32vector(obj)) {
-      ok = serialize_untagged_u8(PST_UNIFORM_VECTOR, sb);
-      ok &= serialize_untagged_u8(UVI_U32, sb);
-      ok &= serialize_untagged_u32(vec_len, sb);
-      ok &= serialize_untagged_u8(npad, sb);
-      for(size_t i=0; i<npad; i++) {
-	ok &= serialize_untagged_u8(0, sb);
-      }
-      for(size_t i=0; i<vec_len; i++) {
-	ok &= serialize_untagged_u32(u32vector_ref(obj, i), sb);
-      }
-      return ok;
-    }
-
-    if(is_s32vector(obj)) {
-      ok = serialize_untagged_u8(PST_UNIFORM_VECTOR, sb);
-      ok &= serialize_untagged_u8(UVI_S32, sb);
-      ok &= serialize_untagged_u32(vec_len, sb);
-      ok &= serialize_untagged_u8(npad, sb);
-      for(size_t i=0; i<npad; i++) {
-	ok &= serialize_untagged_u8(0, sb);
-      }
-      for(size_t i=0; i<vec_len; i++) {
-	ok &= serialize_untagged_u32(s32vector_ref(obj, i), sb);
-      }
-      return ok;
-    }
-
-    if(is_u64vector(obj)) {
-      ok = serialize_untagged_u8(PST_UNIFORM_VECTOR, sb);
-      ok &= serialize_untagged_u8(UVI_U64, sb);
-      ok &= serialize_untagged_u32(vec_len, sb);
-      ok &= serialize_untagged_u8(npad, sb);
-      for(size_t i=0; i<npad; i++) {
-	ok &= serialize_untagged_u8(0, sb);
-      }
-      for(size_t i=0; i<vec_len; i++) {
-	ok &= serialize_untagged_u64(u64vector_ref(obj, i), sb);
-      }
-      return ok;
-    }
-
-    if(is_s64vector(obj)) {
-      ok = serialize_untagged_u8(PST_UNIFORM_VECTOR, sb);
-      ok &= serialize_untagged_u8(UVI_S64, sb);
-      ok &= serialize_untagged_u32(vec_len, sb);
-      ok &= serialize_untagged_u8(npad, sb);
-      for(size_t i=0; i<npad; i++) {
-	ok &= serialize_untagged_u8(0, sb);
-      }
-      for(size_t i=0; i<vec_len; i++) {
-	ok &= serialize_untagged_u64(s64vector_ref(obj, i), sb);
-      }
-      return ok;
-    }
-
-    if(is_f32vector(obj)) {
-      ok = serialize_untagged_u8(PST_UNIFORM_VECTOR, sb);
-      ok &= serialize_untagged_u8(UVI_F32, sb);
-      ok &= serialize_untagged_u32(vec_len, sb);
-      ok &= serialize_untagged_u8(npad, sb);
-      for(size_t i=0; i<npad; i++) {
-	ok &= serialize_untagged_u8(0, sb);
-      }
-      for(size_t i=0; i<vec_len; i++) {
-	ok &= serialize_untagged_f64(f32vector_ref(obj, i), sb);
-      }
-      return ok;
-    }
-
-    if(is_f64vector(obj)) {
-      ok = serialize_untagged_u8(PST_UNIFORM_VECTOR, sb);
-      ok &= serialize_untagged_u8(UVI_F64, sb);
-      ok &= serialize_untagged_u32(vec_len, sb);
-      ok &= serialize_untagged_u8(npad, sb);
-      for(size_t i=0; i<npad; i++) {
-	ok &= serialize_untagged_u8(0, sb);
-      }
-      for(size_t i=0; i<vec_len; i++) {
-	ok &= serialize_untagged_f64(f64vector_ref(obj, i), sb);
-      }
-      return ok;
-    }
-
-    if(is_c32vector(obj)) {
-      ok = serialize_untagged_u8(PST_UNIFORM_VECTOR, sb);
-      ok &= serialize_untagged_u8(UVI_C32, sb);
-      ok &= serialize_untagged_u32(vec_len, sb);
-      ok &= serialize_untagged_u8(npad, sb);
-      for(size_t i=0; i<npad; i++) {
-	ok &= serialize_untagged_u8(0, sb);
-      }
-      for(size_t i=0; i<vec_len; i++) {
-	std::complex<float> c = c32vector_ref(obj, i);
-	ok &= serialize_untagged_f64(c.real(), sb);
-	ok &= serialize_untagged_f64(c.imag(), sb);
-      }
-      return ok;
-    }
-
-    if(is_c64vector(obj)) {
-      ok = serialize_untagged_u8(PST_UNIFORM_VECTOR, sb);
-      ok &= serialize_untagged_u8(UVI_C64, sb);
-      ok &= serialize_untagged_u32(vec_len, sb);
-      ok &= serialize_untagged_u8(npad, sb);
-      for(size_t i=0; i<npad; i++) {
-	ok &= serialize_untagged_u8(0, sb);
-      }
-      for(size_t i=0; i<vec_len; i++) {
-	std::complex<double> c = c64vector_ref(obj, i);
-	ok &= serialize_untagged_f64(c.real(), sb);
-	ok &= serialize_untagged_f64(c.imag(), sb);
-      }
-      return ok;
-    }
+    if(is_u8vector(obj))  return serialize_integers<uint8_t>(w, obj, UVI_U8);
+    if(is_s8vector(obj))  return serialize_integers<int8_t>(w, obj, UVI_S8);
+    if(is_u16vector(obj)) return serialize_integers<uint16_t>(w, obj, UVI_U16);
+    if(is_s16vector(obj)) return serialize_integers<int16_t>(w, obj, UVI_S16);
+    if(is_u32vector(obj)) return serialize_integers<uint32_t>(w, obj, UVI_U32);
+    if(is_s32vector(obj)) return serialize_integers<int32_t>(w, obj, UVI_S32);
+    if(is_u64vector(obj)) return serialize_integers<uint64_t>(w, obj, UVI_U64);
+    if(is_s64vector(obj)) return serialize_integers<int64_t>(w, obj, UVI_S64);
+    if(is_f32vector(obj)) return serialize_reals<float>(w, obj, UVI_F32, 1);
+    if(is_f64vector(obj)) return serialize_reals<double>(w, obj, UVI_F64, 1);
+    if(is_c32vector(obj)) return serialize_reals<float>(w, obj, UVI_C32, 2);
+    if(is_c64vector(obj)) return serialize_reals<double>(w, obj, UVI_C64, 2);
   }
 
-  if (is_dict(obj))
-    throw notimplemented("pmt::serialize (dict)", obj);
+  // A dictionary goes over the wire as its a-list, as it always has.
+  if (is_dict(obj)) {
+    obj = dict_items(obj);
+    goto tail_recursion;
+  }
 
   if (is_tuple(obj)){
     size_t tuple_len = pmt::length(obj);
-    ok = serialize_untagged_u8(PST_TUPLE, sb);
-    ok &= serialize_untagged_u32(tuple_len, sb);
-    for(size_t i=0; i<tuple_len; i++){
-        ok &= serialize(tuple_ref(obj, i), sb);
-    }
-    return ok;
+    w.u8(PST_TUPLE);
+    w.u32(tuple_len);
+    for(size_t i=0; i<tuple_len; i++)
+      serialize(tuple_ref(obj, i), w);
+    return;
   }
-  //throw pmt_notimplemented("pmt::serialize (tuple)", obj);
 
   throw notimplemented("pmt::serialize (?)", obj);
 }
 
+size_t
+serialized_size(pmt_t obj)
+{
+  buffer_writer w(0, 0);
+  serialize(obj, w);
+  return w.size();
+}
+
+size_t
+serialize(pmt_t obj, void *buf, size_t len)
+{
+  buffer_writer w(buf, len);
+  serialize(obj, w);
+  return w.fits() ? w.size() : 0;
+}
+
+/*
+ * Write portable byte-serial representation of \p obj to \p sb
+ */
+bool
+serialize(pmt_t obj, std::streambuf &sb)
+{
+  std::vector<char> buf(serialized_size(obj));
+  serialize(obj, &buf[0], buf.size());
+  return sb.sputn(&buf[0], buf.size()) == (std::streamsize) buf.size();
+}
+
 /*
  * Create obj from portable byte-serial representation
  *
@@ -764,9 +740,9 @@ deserialize(std::streambuf &sb)
  */
 std::string
 serialize_str(pmt_t obj){
-  std::stringbuf sb;
-  serialize(obj, sb);
-  return sb.str();
+  std::string s(serialized_size(obj), '\0');
+  serialize(obj, &s[0], s.size());
+  return s;
 }
 
 
@@ -775,10 +751,190 @@ serialize_str(pmt_t obj){
  */
 pmt_t
 deserialize_str(std::string s){
-  std::stringbuf sb(s);
-  return deserialize(sb);
+  size_t used;
+  return deserialize(s.data(), s.size(), used);
+}
+
+
+template<typename T> static pmt_t
+deserialize_integers(buffer_reader &r, uint32_t nitems, pmt_t vec)
+{
+  const uint8_t *p = r.take(nitems, sizeof(T));
+  size_t len;
+  T *v = static_cast<T *>(uniform_vector_writable_elements(vec, len));
+  switch (sizeof(T)){
+  case 2: for (size_t i = 0; i < nitems; i++) v[i] = get_be16(p + 2*i); break;
+  case 4: for (size_t i = 0; i < nitems; i++) v[i] = get_be32(p + 4*i); break;
+  case 8: for (size_t i = 0; i < nitems; i++) v[i] = get_be64(p + 8*i); break;
+  }
+  return vec;
 }
 
+template<typename T> static pmt_t
+deserialize_reals(buffer_reader &r, uint32_t nitems, pmt_t vec, size_t ncomp)
+{
+  const uint8_t *p = r.take(nitems, 8 * ncomp);
+  size_t len;
+  T *v = static_cast<T *>(uniform_vector_writable_elements(vec, len));
+  for (size_t i = 0; i < nitems * ncomp; i++)
+    v[i] = static_cast<T>(get_f64(p + 8*i));
+  return vec;
+}
+
+static pmt_t
+deserialize(buffer_reader &r)
+{
+  if (r.left() == 0)
+    return PMT_EOF;
+
+  uint8_t tag = r.u8();
+  switch (tag){
+  case PST_TRUE:
+    return PMT_T;
+
+  case PST_FALSE:
+    return PMT_F;
+
+  case PST_NULL:
+    return PMT_NIL;
+
+  case PST_SYMBOL:
+    {
+      uint16_t len = r.u16();
+      const uint8_t *p = r.take(len);
+      return intern(std::string((const char *) p, len));
+    }
+
+  case PST_INT32:
+    return from_long((int32_t) r.u32());
+
+  case PST_UINT64:
+    return from_uint64(r.u64());
+
+  case PST_PAIR:
+    {
+      // Iterate down the list, so long ones don't use up the stack.
+      pmt_t val, lastnptr;
+      for (;;){
+	pmt_t nptr = cons(deserialize(r), PMT_NIL);
+	if (!lastnptr)
+	  val = nptr;
+	else
+	  set_cdr(lastnptr, nptr);
+	lastnptr = nptr;
+
+	if (r.left() == 0)
+	  throw exception("pmt::deserialize: malformed input stream", PMT_F);
+	if (*r.pos() != PST_PAIR)
+	  break;
+	r.u8();
+      }
+
+      set_cdr(lastnptr, deserialize(r));
+      return val;
+    }
+
+  case PST_DOUBLE:
+    return from_double(r.f64());
+
+  case PST_COMPLEX:
+    {
+      double re = r.f64();
+      return make_rectangular(re, r.f64());
+    }
+
+  case PST_TUPLE:
+    {
+      uint32_t nitems = r.u32();
+      pmt_t vec = make_vector(nitems, PMT_NIL);
+      for (uint32_t i = 0; i < nitems; i++)
+	vector_set(vec, i, deserialize(r));
+      return to_tuple(vec);
+    }
+
+  case PST_VECTOR:
+    {
+      uint32_t nitems = r.u32();
+      pmt_t vec = make_vector(nitems, PMT_NIL);
+      for (uint32_t i = 0; i < nitems; i++)
+	vector_set(vec, i, deserialize(r));
+      return vec;
+    }
+
+  case PST_UNIFORM_VECTOR:
+    {
+      uint8_t utag = r.u8();
+      uint32_t nitems = r.u32();
+      r.take(r.u8());		// padding
+
+      switch(utag) {
+      case UVI_U8:
+	if (r.owner())
+	  return pmt_t(new pmt_u8vector(nitems, r.take(nitems), r.owner()));
+	return init_u8vector(nitems, r.take(nitems));
+      case UVI_S8:
+	if (r.owner())
+	  return pmt_t(new pmt_s8vector(nitems, (const int8_t *) r.take(nitems), r.owner()));
+	return init_s8vector(nitems, (const int8_t *) r.take(nitems));
+      case UVI_U16:
+	return deserialize_integers<uint16_t>(r, nitems, make_u16vector(nitems, 0));
+      case UVI_S16:
+	return deserialize_integers<int16_t>(r, nitems, make_s16vector(nitems, 0));
+      case UVI_U32:
+	return deserialize_integers<uint32_t>(r, nitems, make_u32vector(nitems, 0));
+      case UVI_S32:
+	return deserialize_integers<int32_t>(r, nitems, make_s32vector(nitems, 0));
+      case UVI_U64:
+	return deserialize_integers<uint64_t>(r, nitems, make_u64vector(nitems, 0));
+      case UVI_S64:
+	return deserialize_integers<int64_t>(r, nitems, make_s64vector(nitems, 0));
+      case UVI_F32:
+	return deserialize_reals<float>(r, nitems, make_f32vector(nitems, 0), 1);
+      case UVI_F64:
+	return deserialize_reals<double>(r, nitems, make_f64vector(nitems, 0), 1);
+      case UVI_C32:
+	return deserialize_reals<float>(r, nitems, make_c32vector(nitems, 0), 2);
+      case UVI_C64:
+	return deserialize_reals<double>(r, nitems, make_c64vector(nitems, 0), 2);
+      default:
+	throw exception("pmt::deserialize: malformed input stream, tag value = ",
+			from_long(tag));
+      }
+    }
+
+  case PST_DICT:
+  case PST_COMMENT:
+    throw notimplemented("pmt::deserialize: tag value = ",
+			 from_long(tag));
+
+  default:
+    throw exception("pmt::deserialize: malformed input stream, tag value = ",
+		    from_long(tag));
+  }
+}
+
+pmt_t
+deserialize(const void *buf, size_t len, size_t &used)
+{
+  buffer_reader r(buf, len);
+  pmt_t obj = deserialize(r);
+  used = len - r.left();
+  return obj;
+}
+
+pmt_t
+deserialize(pmt_t blob, size_t &offset)
+{
+  size_t len;
+  const uint8_t *p = u8vector_elements(blob, len);
+  if (offset > len)
+    throw out_of_range("pmt::deserialize", from_uint64(offset));
+
+  buffer_reader r(p + offset, len - offset, blob);
+  pmt_t obj = deserialize(r);
+  offset = len - r.left();
+  return obj;
+}
 
 /*
  * This is a mostly non-recursive implementation that allows us to
@@ -25,6 +25,7 @@
  */
 
 #include <qa_pmt.h>
+#include <qa_pmt_pool.h>
 #include <qa_pmt_prims.h>
 #include <qa_pmt_unv.h>
 
@@ -33,6 +34,7 @@ qa_pmt::suite()
 {
   CppUnit::TestSuite *s = new CppUnit::TestSuite("pmt");
 
+  s->addTest(qa_pmt_pool::suite());
   s->addTest(qa_pmt_prims::suite());
   s->addTest(qa_pmt_unv::suite());
 
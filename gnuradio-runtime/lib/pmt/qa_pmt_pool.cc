@@ -0,0 +1,173 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2016 Free Software Foundation, Inc.
+ *
+ * This file is part of GNU Radio
+ *
+ * GNU Radio is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * GNU Radio is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GNU Radio; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <qa_pmt_pool.h>
+#include <cppunit/TestAssert.h>
+#include <pmt/pmt_pool.h>
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+#include <set>
+#include <stdint.h>
+#include <vector>
+#include <string.h>
+
+#define NTHREADS 8
+#define NITERATIONS 200000
+#define NLIVE 64
+
+/*
+ * Single thread: items are aligned, distinct, and reused once freed.
+ */
+void
+qa_pmt_pool::t1()
+{
+  pmt::pmt_pool pool(40, 64, 4096);
+  std::set<void *> live;
+
+  for(int i = 0; i < 1000; i++) {
+    void *p = pool.malloc();
+    CPPUNIT_ASSERT(p != 0);
+    CPPUNIT_ASSERT_EQUAL((uintptr_t)0, (uintptr_t)p & 63);
+    CPPUNIT_ASSERT(live.insert(p).second);
+    memset(p, 0xa5, 40);
+  }
+
+  void *first = *live.begin();
+  pool.free(first);
+  CPPUNIT_ASSERT_EQUAL(first, pool.malloc());
+
+  for(std::set<void *>::iterator i = live.begin(); i != live.end(); i++)
+    pool.free(*i);
+  pool.free(0);
+}
+
+// Allocate and free in a sliding window, each item stamped with its
+// owner.
+static void
+churn(pmt::pmt_pool *pool, int id, bool *ok)
+{
+  void *live[NLIVE];
+  memset(live, 0, sizeof(live));
+
+  for(int i = 0; i < NITERATIONS; i++) {
+    int n = i % NLIVE;
+    if(live[n]) {
+      if(*(int *)live[n] != id)
+        *ok = false;
+      pool->free(live[n]);
+    }
+    live[n] = pool->malloc();
+    *(int *)live[n] = id;
+  }
+
+  for(int n = 0; n < NLIVE; n++)
+    pool->free(live[n]);
+}
+
+/*
+ * Many threads allocating and freeing at once never get each
+ * other's items. (gr-blocks/tests/benchmark_pmt_pool times this.)
+ */
+void
+qa_pmt_pool::t2()
+{
+  pmt::pmt_pool pool(64, 64, 4096);
+  bool ok[NTHREADS];
+  boost::thread_group threads;
+
+  for(int i = 0; i < NTHREADS; i++) {
+    ok[i] = true;
+    threads.create_thread(boost::bind(churn, &pool, i, &ok[i]));
+  }
+  threads.join_all();
+
+  for(int i = 0; i < NTHREADS; i++)
+    CPPUNIT_ASSERT(ok[i]);
+}
+
+struct handoff {
+  boost::mutex               mutex;
+  boost::condition_variable  cond;
+  std::vector<void *>        items;
+  bool                       done;
+};
+
+static void
+consume(pmt::pmt_pool *pool, handoff *h, size_t *nfreed)
+{
+  std::vector<void *> batch;
+  for(;;) {
+    {
+      boost::unique_lock<boost::mutex> guard(h->mutex);
+      while(h->items.empty() && !h->done)
+        h->cond.wait(guard);
+      if(h->items.empty())
+        return;
+      batch.swap(h->items);
+      h->cond.notify_all();
+    }
+    for(size_t i = 0; i < batch.size(); i++)
+      pool->free(batch[i]);
+    *nfreed += batch.size();
+    batch.clear();
+  }
+}
+
+/*
+ * Everything allocated in one thread is freed in another, the way
+ * PMTs go from a block to its downstream neighbor. The producer
+ * must get the items back rather than growing the pool forever.
+ */
+void
+qa_pmt_pool::t3()
+{
+  pmt::pmt_pool pool(64, 64, 4096);
+  handoff h;
+  h.done = false;
+  size_t nfreed = 0;
+  std::set<void *> seen;
+
+  boost::thread consumer(boost::bind(consume, &pool, &h, &nfreed));
+  for(int i = 0; i < NITERATIONS; i++) {
+    void *p = pool.malloc();
+    seen.insert(p);
+    boost::unique_lock<boost::mutex> guard(h.mutex);
+    while(h.items.size() >= 4 * NLIVE)
+      h.cond.wait(guard);
+    h.items.push_back(p);
+    if(h.items.size() >= NLIVE)
+      h.cond.notify_all();
+  }
+  {
+    boost::unique_lock<boost::mutex> guard(h.mutex);
+    h.done = true;
+    h.cond.notify_all();
+  }
+  consumer.join();
+
+  CPPUNIT_ASSERT_EQUAL((size_t)NITERATIONS, nfreed);
+  CPPUNIT_ASSERT(seen.size() < 10000);
+}
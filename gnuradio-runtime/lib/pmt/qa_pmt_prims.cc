@@ -411,6 +411,72 @@ qa_pmt_prims::test_dict()
   CPPUNIT_ASSERT(pmt::equal(vals, pmt::dict_values(dict)));
 }
 
+void
+qa_pmt_prims::test_big_dict()
+{
+  static const long N = 10000;
+  pmt::pmt_t not_found = pmt::cons(pmt::PMT_NIL, pmt::PMT_NIL);
+  pmt::pmt_t dict = pmt::make_dict();
+  CPPUNIT_ASSERT_EQUAL((size_t)0, pmt::length(dict));
+  CPPUNIT_ASSERT(pmt::equal(dict, pmt::PMT_NIL));
+
+  // integer keys are looked up by value, not by object
+  for (long i = 0; i < N; i++)
+    dict = pmt::dict_add(dict, pmt::from_long(i), pmt::from_long(2*i));
+  CPPUNIT_ASSERT_EQUAL((size_t)N, pmt::length(dict));
+  for (long i = 0; i < N; i++)
+    CPPUNIT_ASSERT_EQUAL(2*i, pmt::to_long(pmt::dict_ref(dict, pmt::from_long(i), not_found)));
+  CPPUNIT_ASSERT(!pmt::dict_has_key(dict, pmt::from_long(N)));
+  CPPUNIT_ASSERT(!pmt::dict_has_key(dict, pmt::from_double(1)));
+  CPPUNIT_ASSERT(!pmt::dict_has_key(dict, pmt::mp("0")));
+
+  // older versions are untouched
+  pmt::pmt_t d2 = pmt::dict_add(dict, pmt::from_long(7), pmt::PMT_T);
+  pmt::pmt_t d3 = dict;
+  for (long i = 0; i < N; i += 2)
+    d3 = pmt::dict_delete(d3, pmt::from_long(i));
+  d3 = pmt::dict_delete(d3, pmt::from_long(N));
+  CPPUNIT_ASSERT_EQUAL((size_t)N, pmt::length(d2));
+  CPPUNIT_ASSERT_EQUAL((size_t)N/2, pmt::length(d3));
+  CPPUNIT_ASSERT(pmt::eqv(pmt::dict_ref(d2, pmt::from_long(7), not_found), pmt::PMT_T));
+  CPPUNIT_ASSERT_EQUAL(14L, pmt::to_long(pmt::dict_ref(dict, pmt::from_long(7), not_found)));
+  for (long i = 0; i < N; i++)
+    CPPUNIT_ASSERT_EQUAL(i % 2 == 1, pmt::dict_has_key(d3, pmt::from_long(i)));
+  for (long i = 1; i < N; i += 2)
+    d3 = pmt::dict_delete(d3, pmt::from_long(i));
+  CPPUNIT_ASSERT_EQUAL((size_t)0, pmt::length(d3));
+  CPPUNIT_ASSERT(pmt::is_null(pmt::dict_items(d3)));
+
+  // dict_update, most recently added first
+  pmt::pmt_t k0 = pmt::mp("k0");
+  pmt::pmt_t k1 = pmt::mp("k1");
+  pmt::pmt_t k2 = pmt::mp("k2");
+  pmt::pmt_t a = pmt::dict_add(pmt::dict_add(pmt::make_dict(), k0, pmt::from_long(0)),
+                               k1, pmt::from_long(1));
+  pmt::pmt_t b = pmt::dict_add(pmt::dict_add(pmt::make_dict(), k1, pmt::from_long(10)),
+                               k2, pmt::from_long(20));
+  pmt::pmt_t u = pmt::dict_update(a, b);
+  CPPUNIT_ASSERT(pmt::equal(pmt::list3(k1, k2, k0), pmt::dict_keys(u)));
+  CPPUNIT_ASSERT_EQUAL(10L, pmt::to_long(pmt::dict_ref(u, k1, not_found)));
+  CPPUNIT_ASSERT_EQUAL(std::string("((k1 . 10) (k2 . 20) (k0 . 0))"), pmt::write_string(u));
+
+  // a-lists are still dictionaries, and turn into the same thing
+  pmt::pmt_t alist = pmt::list2(pmt::cons(k2, pmt::from_long(20)),
+                                pmt::cons(k1, pmt::from_long(10)));
+  CPPUNIT_ASSERT(pmt::equal(alist, b));
+  CPPUNIT_ASSERT(pmt::equal(b, alist));
+  CPPUNIT_ASSERT(pmt::equal(pmt::dict_add(alist, k0, pmt::from_long(0)),
+                            pmt::dict_add(b, k0, pmt::from_long(0))));
+  CPPUNIT_ASSERT(pmt::equal(pmt::dict_delete(alist, k2), pmt::dict_delete(b, k2)));
+
+  // and go over the wire as a-lists
+  std::string s = pmt::serialize_str(u);
+  CPPUNIT_ASSERT_EQUAL(pmt::serialize_str(pmt::dict_items(u)), s);
+  pmt::pmt_t v = pmt::deserialize_str(s);
+  CPPUNIT_ASSERT(pmt::is_dict(v));
+  CPPUNIT_ASSERT(pmt::equal(u, v));
+}
+
 void
 qa_pmt_prims::test_io()
 {
@@ -573,6 +639,63 @@ qa_pmt_prims::test_serialize()
 
 }
 
+void
+qa_pmt_prims::test_serialize_buffer()
+{
+  std::vector<std::complex<float> > cf(3, std::complex<float>(1.5, -2));
+  std::vector<int16_t> s16(5, -300);
+  std::vector<uint64_t> u64(2, 0x0102030405060708ULL);
+  pmt::pmt_t bytes = pmt::make_u8vector(1000, 0xa5);
+  pmt::pmt_t objs = pmt::list5(pmt::cons(pmt::mp("k"), pmt::from_double(0.1)),
+                               pmt::init_c32vector(cf.size(), cf),
+                               pmt::make_tuple(pmt::init_s16vector(s16.size(), s16),
+                                               pmt::init_u64vector(u64.size(), u64)),
+                               pmt::from_complex(1, -1),
+                               bytes);
+  objs = pmt::list_add(objs, pmt::dict_add(pmt::make_dict(), pmt::mp("n"), pmt::from_uint64(7)));
+
+  // same bytes as through a streambuf, and back again
+  size_t n = pmt::serialized_size(objs);
+  std::vector<char> buf(n + 1);
+  CPPUNIT_ASSERT_EQUAL((size_t)0, pmt::serialize(objs, &buf[0], n - 1));
+  CPPUNIT_ASSERT_EQUAL(n, pmt::serialize(objs, &buf[0], n + 1));
+  std::stringbuf sb;
+  pmt::serialize(objs, sb);
+  CPPUNIT_ASSERT(sb.str() == std::string(&buf[0], n));
+  CPPUNIT_ASSERT(pmt::serialize_str(objs) == sb.str());
+
+  size_t used = 0;
+  CPPUNIT_ASSERT(pmt::equal(objs, pmt::deserialize(&buf[0], n, used)));
+  CPPUNIT_ASSERT_EQUAL(n, used);
+  CPPUNIT_ASSERT(pmt::equal(objs, pmt::deserialize(sb)));
+  CPPUNIT_ASSERT(pmt::equal(pmt::PMT_EOF, pmt::deserialize(&buf[0], 0, used)));
+  CPPUNIT_ASSERT_THROW(pmt::deserialize(&buf[0], n - 1, used), pmt::exception);
+
+  // two objects back to back in a u8vector; the bytes are a view
+  std::vector<uint8_t> two(2 * n);
+  pmt::serialize(objs, &two[0], n);
+  pmt::serialize(bytes, &two[n], n);
+  pmt::pmt_t blob = pmt::init_u8vector(n + pmt::serialized_size(bytes), two);
+  size_t offset = 0;
+  CPPUNIT_ASSERT(pmt::equal(objs, pmt::deserialize(blob, offset)));
+  CPPUNIT_ASSERT_EQUAL(n, offset);
+  pmt::pmt_t view = pmt::deserialize(blob, offset);
+  CPPUNIT_ASSERT(pmt::equal(bytes, view));
+  CPPUNIT_ASSERT_EQUAL(pmt::length(blob), offset);
+  CPPUNIT_ASSERT(pmt::equal(pmt::PMT_EOF, pmt::deserialize(blob, offset)));
+
+  size_t blob_len, view_len;
+  const uint8_t *b = pmt::u8vector_elements(blob, blob_len);
+  const uint8_t *v = pmt::u8vector_elements(view, view_len);
+  CPPUNIT_ASSERT(v >= b && v + view_len <= b + blob_len);
+
+  // writing to the view copies it first
+  pmt::u8vector_set(view, 0, 0x5a);
+  CPPUNIT_ASSERT_EQUAL((uint8_t)0x5a, pmt::u8vector_ref(view, 0));
+  CPPUNIT_ASSERT_EQUAL((uint8_t)0xa5, b[blob_len - view_len]);
+  CPPUNIT_ASSERT(pmt::u8vector_elements(view, view_len) != v);
+}
+
 void
 qa_pmt_prims::test_sets()
 {
@@ -42,11 +42,13 @@ class __GR_ATTR_EXPORT qa_pmt_prims : public CppUnit::TestCase
   CPPUNIT_TEST(test_equivalence);
   CPPUNIT_TEST(test_misc);
   CPPUNIT_TEST(test_dict);
+  CPPUNIT_TEST(test_big_dict);
   CPPUNIT_TEST(test_any);
   CPPUNIT_TEST(test_msg_accepter);
   CPPUNIT_TEST(test_io);
   CPPUNIT_TEST(test_lists);
   CPPUNIT_TEST(test_serialize);
+  CPPUNIT_TEST(test_serialize_buffer);
   CPPUNIT_TEST(test_sets);
   CPPUNIT_TEST(test_sugar);
   CPPUNIT_TEST_SUITE_END();
@@ -64,11 +66,13 @@ class __GR_ATTR_EXPORT qa_pmt_prims : public CppUnit::TestCase
   void test_equivalence();
   void test_misc();
   void test_dict();
+  void test_big_dict();
   void test_any();
   void test_msg_accepter();
   void test_io();
   void test_lists();
   void test_serialize();
+  void test_serialize_buffer();
   void test_sets();
   void test_sugar();
 };
@@ -12,24 +12,44 @@ _@TAG@vector(pmt_t x)
 
 
 pmt_@TAG@vector::pmt_@TAG@vector(size_t k, @TYPE@ fill)
-  : d_v(k)
+  : d_v(k), d_view(0), d_view_len(0)
 {
   for (size_t i = 0; i < k; i++)
     d_v[i] = fill;
 }
 
 pmt_@TAG@vector::pmt_@TAG@vector(size_t k, const @TYPE@ *data)
-  : d_v(k)
+  : d_v(k), d_view(0), d_view_len(0)
 {
   memcpy( &d_v[0], data, k * sizeof(@TYPE@) );
 }
 
+/*
+ * A view of k elements at data, which owner keeps alive. It is
+ * copied the first time anybody asks to write to it.
+ */
+pmt_@TAG@vector::pmt_@TAG@vector(size_t k, const @TYPE@ *data, pmt_t owner)
+  : d_view(data), d_view_len(k), d_owner(owner)
+{
+}
+
+void
+pmt_@TAG@vector::unshare()
+{
+  if (!d_view)
+    return;
+  d_v.assign(d_view, d_view + d_view_len);
+  d_view = 0;
+  d_view_len = 0;
+  d_owner.reset();
+}
+
 @TYPE@
 pmt_@TAG@vector::ref(size_t k) const
 {
   if (k >= length())
     throw out_of_range("pmt_@TAG@vector_ref", from_long(k));
-  return d_v[k];
+  return d_view ? d_view[k] : d_v[k];
 }
 
 void
@@ -37,6 +57,7 @@ pmt_@TAG@vector::set(size_t k, @TYPE@ x)
 {
   if (k >= length())
     throw out_of_range("pmt_@TAG@vector_set", from_long(k));
+  unshare();
   d_v[k] = x;
 }
 
@@ -44,12 +65,13 @@ const @TYPE@ *
 pmt_@TAG@vector::elements(size_t &len)
 {
   len = length();
-  return &d_v[0];
+  return d_view ? d_view : &d_v[0];
 }
 
 @TYPE@ *
 pmt_@TAG@vector::writable_elements(size_t &len)
 {
+  unshare();
   len = length();
   return &d_v[0];
 }
@@ -58,12 +80,13 @@ const void*
 pmt_@TAG@vector::uniform_elements(size_t &len)
 {
   len = length() * sizeof(@TYPE@);
-  return &d_v[0];
+  return d_view ? d_view : &d_v[0];
 }
 
 void*
 pmt_@TAG@vector::uniform_writable_elements(size_t &len)
 {
+  unshare();
   len = length() * sizeof(@TYPE@);
   return &d_v[0];
 }
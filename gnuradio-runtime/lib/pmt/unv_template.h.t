@@ -6,14 +6,20 @@
 class pmt_@TAG@vector : public pmt_uniform_vector
 {
   std::vector< @TYPE@ >	d_v;
+  const @TYPE@	       *d_view;		// if non-zero, the elements, in d_owner
+  size_t		d_view_len;
+  pmt_t			d_owner;
+
+  void unshare();
 
 public:
   pmt_@TAG@vector(size_t k, @TYPE@ fill);
   pmt_@TAG@vector(size_t k, const @TYPE@ *data);
+  pmt_@TAG@vector(size_t k, const @TYPE@ *data, pmt_t owner);
   // ~pmt_@TAG@vector();
 
   bool is_@TAG@vector() const { return true; }
-  size_t length() const { return d_v.size(); }
+  size_t length() const { return d_view ? d_view_len : d_v.size(); }
   size_t itemsize() const { return sizeof(@TYPE@); }
   @TYPE@ ref(size_t k) const;
   void set(size_t k, @TYPE@ x);
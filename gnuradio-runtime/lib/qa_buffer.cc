@@ -26,9 +26,16 @@
 
 #include <qa_buffer.h>
 #include <gnuradio/buffer.h>
+#include <gnuradio/block.h>
+#include <gnuradio/block_detail.h>
+#include <gnuradio/io_signature.h>
+#include <gnuradio/prefs.h>
+#include <block_executor.h>
 #include <cppunit/TestAssert.h>
 #include <stdlib.h>
 #include <gnuradio/random.h>
+#include <boost/thread/thread.hpp>
+#include <boost/bind.hpp>
 
 static void
 leak_check(void f())
@@ -266,6 +273,349 @@ t3_body()
   }
 }
 
+// ----------------------------------------------------------------------------
+// lock-free mode: single writer thread, N reader threads
+// ----------------------------------------------------------------------------
+
+static const int t4_nitems_total = 1000000;
+
+static void
+t4_writer(gr::buffer_sptr buf)
+{
+  int write_counter = 0;
+  while(write_counter < t4_nitems_total) {
+    int n = std::min(buf->space_available(), t4_nitems_total - write_counter);
+    int *wp = (int*)buf->write_pointer();
+    for(int i = 0; i < n; i++)
+      *wp++ = write_counter++;
+    buf->update_write_pointer(n);
+    if(n == 0)
+      boost::this_thread::yield();
+  }
+  buf->set_done(true);
+}
+
+static void
+t4_reader(gr::buffer_reader_sptr r, int *nerrors)
+{
+  int read_counter = 0;
+  while(true) {
+    bool done = r->done();
+    int m = r->items_available();
+    if(m == 0) {
+      if(done)
+        break;
+      boost::this_thread::yield();
+      continue;
+    }
+    const int *rp = (const int*)r->read_pointer();
+    for(int i = 0; i < m; i++) {
+      if(*rp++ != read_counter++)
+        (*nerrors)++;
+    }
+    r->update_read_pointer(m);
+  }
+  if(read_counter != t4_nitems_total)
+    (*nerrors)++;
+}
+
+static void
+t4_body()
+{
+  int nitems = (64 * (1L << 10)) / sizeof(int);
+
+  static const int N = 3;
+  gr::buffer_sptr buf(gr::make_buffer(nitems, sizeof(int), gr::block_sptr(), true));
+  CPPUNIT_ASSERT(buf->lock_free());
+
+  gr::buffer_reader_sptr reader[N];
+  int nerrors[N];
+  for(int i = 0; i < N; i++) {
+    nerrors[i] = 0;
+    reader[i] = buffer_add_reader(buf, 0, gr::block_sptr());
+    CPPUNIT_ASSERT(reader[i]->lock_free());
+  }
+
+  boost::thread_group threads;
+  for(int i = 0; i < N; i++)
+    threads.create_thread(boost::bind(t4_reader, reader[i], &nerrors[i]));
+  threads.create_thread(boost::bind(t4_writer, buf));
+  threads.join_all();
+
+  for(int i = 0; i < N; i++) {
+    CPPUNIT_ASSERT_EQUAL(0, nerrors[i]);
+    CPPUNIT_ASSERT_EQUAL((uint64_t)t4_nitems_total, reader[i]->nitems_read());
+  }
+  CPPUNIT_ASSERT_EQUAL((uint64_t)t4_nitems_total, buf->nitems_written());
+}
+
+// ----------------------------------------------------------------------------
+// tags: ordering, range lookup, per-reader deletion and pruning
+// ----------------------------------------------------------------------------
+
+class qa_buffer_null_block : public gr::block
+{
+public:
+  qa_buffer_null_block()
+    : gr::block("qa_buffer_null_block",
+                gr::io_signature::make(0, 0, 0),
+                gr::io_signature::make(0, 0, 0)) {}
+};
+
+static gr::tag_t
+make_tag(uint64_t offset, long value)
+{
+  gr::tag_t t;
+  t.offset = offset;
+  t.key = pmt::intern("key");
+  t.value = pmt::from_long(value);
+  return t;
+}
+
+static void
+t5_body()
+{
+  int nitems = 4000 / sizeof(int);
+
+  gr::block_sptr b1 = gnuradio::get_initial_sptr(new qa_buffer_null_block());
+  gr::block_sptr b2 = gnuradio::get_initial_sptr(new qa_buffer_null_block());
+
+  gr::buffer_sptr buf(gr::make_buffer(nitems, sizeof(int), gr::block_sptr()));
+  gr::buffer_reader_sptr r1(gr::buffer_add_reader(buf, 0, b1));
+  gr::buffer_reader_sptr r2(gr::buffer_add_reader(buf, 0, b2));
+
+  // Out of order, with two tags on the same offset.
+  buf->add_item_tag(make_tag(5, 0));
+  buf->add_item_tag(make_tag(1, 1));
+  buf->add_item_tag(make_tag(3, 2));
+  buf->add_item_tag(make_tag(3, 3));
+  buf->add_item_tag(make_tag(10, 4));
+  buf->update_write_pointer(20);
+  CPPUNIT_ASSERT_EQUAL((size_t)5, buf->ntags());
+
+  std::vector<gr::tag_t> v;
+  r1->get_tags_in_range(v, 0, 20, b1->unique_id());
+  CPPUNIT_ASSERT_EQUAL((size_t)5, v.size());
+  const uint64_t offsets[] = {1, 3, 3, 5, 10};
+  const long values[] = {1, 2, 3, 0, 4};
+  for(size_t i = 0; i < v.size(); i++) {
+    CPPUNIT_ASSERT_EQUAL(offsets[i], v[i].offset);
+    CPPUNIT_ASSERT_EQUAL(values[i], pmt::to_long(v[i].value));
+  }
+
+  r1->get_tags_in_range(v, 3, 5, b1->unique_id());
+  CPPUNIT_ASSERT_EQUAL((size_t)2, v.size());
+
+  // Deleting for b1 doesn't hide the tag from b2.
+  r1->get_tags_in_range(v, 3, 4, b1->unique_id());
+  buf->remove_item_tag(v[0], b1->unique_id());
+  r1->get_tags_in_range(v, 0, 20, b1->unique_id());
+  CPPUNIT_ASSERT_EQUAL((size_t)4, v.size());
+  CPPUNIT_ASSERT_EQUAL(3L, pmt::to_long(v[1].value));
+  r2->get_tags_in_range(v, 0, 20, b2->unique_id());
+  CPPUNIT_ASSERT_EQUAL((size_t)5, v.size());
+
+  // Prune everything before offset 6.
+  buf->prune_tags(6 + buf->bufsize());
+  CPPUNIT_ASSERT_EQUAL((size_t)1, buf->ntags());
+  r2->get_tags_in_range(v, 0, 20, b2->unique_id());
+  CPPUNIT_ASSERT_EQUAL((size_t)1, v.size());
+  CPPUNIT_ASSERT_EQUAL((uint64_t)10, v[0].offset);
+
+  // Many tags: forces the ring to grow and wrap.
+  for(int i = 0; i < 1000; i++)
+    buf->add_item_tag(make_tag(20 + i, i));
+  buf->prune_tags(520 + buf->bufsize());
+  for(int i = 1000; i < 1500; i++)
+    buf->add_item_tag(make_tag(20 + i, i));
+  CPPUNIT_ASSERT_EQUAL((size_t)1000, buf->ntags());
+  r1->get_tags_in_range(v, 1000, 1100, b1->unique_id());
+  CPPUNIT_ASSERT_EQUAL((size_t)100, v.size());
+  for(size_t i = 0; i < v.size(); i++)
+    CPPUNIT_ASSERT_EQUAL((long)(980 + i), pmt::to_long(v[i].value));
+}
+
+static void
+t6_body()
+{
+  // More than 64 readers need more than one deletion word per tag.
+  int nitems = 4000 / sizeof(int);
+  static const int N = 70;
+
+  gr::buffer_sptr buf(gr::make_buffer(nitems, sizeof(int), gr::block_sptr()));
+  gr::buffer_reader_sptr reader[N];
+  for(int i = 0; i < N; i++)
+    reader[i] = buffer_add_reader(buf, 0, gr::block_sptr());
+
+  buf->add_item_tag(make_tag(1, 0));
+  buf->add_item_tag(make_tag(2, 1));
+  buf->update_write_pointer(10);
+
+  // Readers without a block all have ID -1.
+  std::vector<gr::tag_t> v;
+  reader[0]->get_tags_in_range(v, 2, 3, -1);
+  buf->remove_item_tag(v[0], -1);
+
+  for(int i = 0; i < N; i++) {
+    reader[i]->get_tags_in_range(v, 0, 10, -1);
+    CPPUNIT_ASSERT_EQUAL((size_t)1, v.size());
+    CPPUNIT_ASSERT_EQUAL((uint64_t)1, v[0].offset);
+  }
+
+  // A reader reusing a freed slot doesn't inherit its deletions.
+  reader[N-1].reset();
+  reader[N-1] = buffer_add_reader(buf, 0, gr::block_sptr());
+  reader[N-1]->get_tags_in_range(v, 0, 10, -1);
+  CPPUNIT_ASSERT_EQUAL((size_t)2, v.size());
+}
+
+static void
+t7_body()
+{
+  // a -> b -> c in place: b reads buf and writes buf_b over it, c
+  // reads buf_b and writes buf_c over it, d reads buf_c.
+  int nitems = 4000 / sizeof(int);
+
+  gr::buffer_sptr buf(gr::make_buffer(nitems, sizeof(int), gr::block_sptr()));
+  gr::buffer_reader_sptr b(gr::buffer_add_reader(buf, 0, gr::block_sptr()));
+  gr::buffer_sptr buf_b(gr::make_in_place_buffer(buf, gr::block_sptr()));
+  gr::buffer_reader_sptr c(gr::buffer_add_reader(buf_b, 0, gr::block_sptr()));
+  gr::buffer_sptr buf_c(gr::make_in_place_buffer(buf_b, gr::block_sptr()));
+  gr::buffer_reader_sptr d(gr::buffer_add_reader(buf_c, 0, gr::block_sptr()));
+
+  int sa = buf->space_available();
+  CPPUNIT_ASSERT_EQUAL(buf->bufsize() - 1, sa);
+  CPPUNIT_ASSERT(buf_b->in_place_of() == buf);
+  CPPUNIT_ASSERT(buf_c->in_place_of() == buf_b);
+
+  buf->update_write_pointer(100);
+  CPPUNIT_ASSERT_EQUAL(sa - 100, buf->space_available());
+
+  // b and c write where they read.
+  CPPUNIT_ASSERT_EQUAL(b->read_pointer(), (const void*)buf_b->write_pointer());
+  b->update_read_pointer(60);
+  buf_b->update_write_pointer(60);
+  CPPUNIT_ASSERT_EQUAL(60, c->items_available());
+  CPPUNIT_ASSERT_EQUAL(c->read_pointer(), (const void*)buf_c->write_pointer());
+  c->update_read_pointer(50);
+  buf_c->update_write_pointer(50);
+  CPPUNIT_ASSERT_EQUAL(50, d->items_available());
+
+  // The items are ours until d has read them.
+  CPPUNIT_ASSERT_EQUAL(sa - 100, buf->space_available());
+  CPPUNIT_ASSERT_EQUAL(sa - 60, buf_b->space_available());
+  d->update_read_pointer(30);
+  CPPUNIT_ASSERT_EQUAL(sa - 70, buf->space_available());
+  d->update_read_pointer(20);
+  CPPUNIT_ASSERT_EQUAL(sa - 50, buf->space_available());
+
+  // Dropping the in-place buffers hands the space back.
+  d.reset();
+  buf_c.reset();
+  CPPUNIT_ASSERT_EQUAL(sa - 50, buf->space_available());
+  c->update_read_pointer(10);
+  CPPUNIT_ASSERT_EQUAL(sa - 40, buf->space_available());
+  c.reset();
+  buf_b.reset();
+  CPPUNIT_ASSERT_EQUAL(sa - 40, buf->space_available());
+}
+
+static void
+t8_body()
+{
+  // Tags added in a batch, and the check that lets readers skip
+  // the tag store.
+  int nitems = 4000 / sizeof(int);
+
+  gr::buffer_sptr buf(gr::make_buffer(nitems, sizeof(int), gr::block_sptr()));
+  gr::buffer_reader_sptr r(gr::buffer_add_reader(buf, 0, gr::block_sptr()));
+  gr::buffer_reader_sptr rd(gr::buffer_add_reader(buf, 0, gr::block_sptr(), 5));
+  CPPUNIT_ASSERT_EQUAL((uint64_t)0, buf->tags_end());
+
+  std::vector<gr::tag_t> tags;
+  tags.push_back(make_tag(4, 0));
+  tags.push_back(make_tag(2, 1));
+  tags.push_back(make_tag(8, 2));
+  buf->add_item_tags(tags);
+  buf->add_item_tags(std::vector<gr::tag_t>());
+  buf->update_write_pointer(20);
+  CPPUNIT_ASSERT_EQUAL((size_t)3, buf->ntags());
+  CPPUNIT_ASSERT_EQUAL((uint64_t)9, buf->tags_end());
+
+  std::vector<gr::tag_t> v;
+  r->get_tags_in_range(v, 0, 20, -1);
+  CPPUNIT_ASSERT_EQUAL((size_t)3, v.size());
+  CPPUNIT_ASSERT_EQUAL((uint64_t)2, v[0].offset);
+  CPPUNIT_ASSERT_EQUAL((uint64_t)8, v[2].offset);
+
+  // Past the last tag there's nothing, with or without a delay.
+  r->get_tags_in_range(v, 9, 20, -1);
+  CPPUNIT_ASSERT(v.empty());
+  rd->get_tags_in_range(v, 14, 20, -1);
+  CPPUNIT_ASSERT(v.empty());
+  rd->get_tags_in_range(v, 13, 20, -1);
+  CPPUNIT_ASSERT_EQUAL((size_t)1, v.size());
+  CPPUNIT_ASSERT_EQUAL((uint64_t)13, v[0].offset);
+
+  // An older tag doesn't move the end back.
+  buf->add_item_tag(make_tag(1, 3));
+  CPPUNIT_ASSERT_EQUAL((uint64_t)9, buf->tags_end());
+  buf->add_item_tag(make_tag(15, 4));
+  CPPUNIT_ASSERT_EQUAL((uint64_t)16, buf->tags_end());
+  r->get_tags_in_range(v, 9, 20, -1);
+  CPPUNIT_ASSERT_EQUAL((size_t)1, v.size());
+}
+
+// t9 checks the deprecated accessors on purpose.
+#if defined(__GNUC__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wdeprecated-declarations"
+#endif
+
+static void
+t9_body()
+{
+  // The deprecated multimap accessors still see the tags.
+  int nitems = 4000 / sizeof(int);
+
+  gr::block_sptr b1 = gnuradio::get_initial_sptr(new qa_buffer_null_block());
+  gr::buffer_sptr buf(gr::make_buffer(nitems, sizeof(int), gr::block_sptr()));
+  gr::buffer_reader_sptr r1(gr::buffer_add_reader(buf, 0, b1));
+
+  buf->add_item_tag(make_tag(5, 0));
+  buf->add_item_tag(make_tag(1, 1));
+  buf->add_item_tag(make_tag(3, 2));
+  buf->update_write_pointer(20);
+
+  gr::thread::scoped_lock guard(*buf->mutex());
+  std::multimap<uint64_t,gr::tag_t>::iterator i = buf->get_tags_begin();
+  CPPUNIT_ASSERT_EQUAL((long)3, (long)std::distance(i, buf->get_tags_end()));
+  CPPUNIT_ASSERT_EQUAL((uint64_t)1, i->first);
+  CPPUNIT_ASSERT_EQUAL(1L, pmt::to_long(i->second.value));
+
+  i = buf->get_tags_lower_bound(2);
+  CPPUNIT_ASSERT_EQUAL((uint64_t)3, i->first);
+  CPPUNIT_ASSERT(buf->get_tags_upper_bound(5) == buf->get_tags_end());
+  CPPUNIT_ASSERT(i->second.marked_deleted.empty());
+  guard.unlock();
+
+  // A deletion shows up in marked_deleted, and new tags appear.
+  std::vector<gr::tag_t> v;
+  r1->get_tags_in_range(v, 3, 4, b1->unique_id());
+  buf->remove_item_tag(v[0], b1->unique_id());
+  buf->add_item_tag(make_tag(7, 3));
+
+  guard.lock();
+  i = buf->get_tags_lower_bound(3);
+  CPPUNIT_ASSERT_EQUAL((size_t)1, i->second.marked_deleted.size());
+  CPPUNIT_ASSERT_EQUAL(b1->unique_id(), i->second.marked_deleted[0]);
+  CPPUNIT_ASSERT_EQUAL((long)4, (long)std::distance(buf->get_tags_begin(),
+                                                    buf->get_tags_end()));
+}
+
+#if defined(__GNUC__)
+#pragma GCC diagnostic pop
+#endif
 
 // ----------------------------------------------------------------------------
 
@@ -296,9 +646,143 @@ qa_buffer::t3()
 void
 qa_buffer::t4()
 {
+  leak_check(t4_body);
 }
 
 void
 qa_buffer::t5()
 {
+  leak_check(t5_body);
+}
+
+void
+qa_buffer::t6()
+{
+  leak_check(t6_body);
+}
+
+void
+qa_buffer::t7()
+{
+  leak_check(t7_body);
+}
+
+void
+qa_buffer::t8()
+{
+  leak_check(t8_body);
+}
+
+void
+qa_buffer::t9()
+{
+  leak_check(t9_body);
+}
+
+// ----------------------------------------------------------------------------
+// The executor's snapshot of an input: a writer that publishes its
+// last items and sets done between the two loads must not make us
+// see done with the old count.
+// ----------------------------------------------------------------------------
+
+namespace {
+
+  // The writer finishes right after whichever load comes first.
+  struct racing_reader
+  {
+    mutable int d_items;
+    mutable bool d_done;
+
+    racing_reader() : d_items(5), d_done(false) {}
+
+    void finish() const
+    {
+      if(!d_done) {
+        d_items += 3;
+        d_done = true;
+      }
+    }
+
+    int items_available() const { int n = d_items; finish(); return n; }
+    bool done() const { bool d = d_done; finish(); return d; }
+  };
+
+}
+
+void
+qa_buffer::t10()
+{
+  racing_reader r;
+  bool done;
+  int n = gr::block_executor::input_state(r, done);
+  CPPUNIT_ASSERT(!done || n == 8);
+
+  // Once done, the count is final.
+  n = gr::block_executor::input_state(r, done);
+  CPPUNIT_ASSERT(done);
+  CPPUNIT_ASSERT_EQUAL(8, n);
+}
+
+// ----------------------------------------------------------------------------
+// The working_set cap on noutput_items
+//
+
+namespace {
+
+  // float in, gr_complex out: 12 bytes per output item at rate 1.
+  class ws_block : public gr::block
+  {
+  public:
+    ws_block()
+      : gr::block("ws_block",
+                  gr::io_signature::make(1, 1, sizeof(float)),
+                  gr::io_signature::make(1, 1, sizeof(gr_complex)))
+    {
+      set_detail(gr::make_block_detail(1, 1));
+    }
+  };
+
+  int
+  ws_items(const std::string &working_set, int max_noutput_items,
+           int block_max=0, double rrate=1.0, int multiple=1)
+  {
+    gr::prefs *p = gr::prefs::singleton();
+    std::string old = p->get_string("Scheduler", "working_set", "0");
+    p->set_string("Scheduler", "working_set", working_set);
+
+    gr::block_sptr block = gnuradio::get_initial_sptr(new ws_block());
+    if(block_max > 0)
+      block->set_max_noutput_items(block_max);
+    block->set_relative_rate(rrate);
+    block->set_output_multiple(multiple);
+    int n = gr::block_executor::working_set_noutput_items(block, max_noutput_items);
+
+    p->set_string("Scheduler", "working_set", old);
+    return n;
+  }
+
+}
+
+void
+qa_buffer::t11()
+{
+  // No cap: whichever max is smaller.
+  CPPUNIT_ASSERT_EQUAL(8192, ws_items("0", 8192));
+  CPPUNIT_ASSERT_EQUAL(100, ws_items("0", 8192, 100));
+
+  // 12 KiB at 12 bytes per item, unless a max is smaller.
+  CPPUNIT_ASSERT_EQUAL(1024, ws_items("12288", 8192));
+  CPPUNIT_ASSERT_EQUAL(512, ws_items("12288", 512));
+  CPPUNIT_ASSERT_EQUAL(100, ws_items("12288", 8192, 100));
+
+  // Decimating by 2 reads 8 bytes of input per output item.
+  CPPUNIT_ASSERT_EQUAL(768, ws_items("12288", 8192, 0, 0.5));
+
+  // Never below output_multiple, nor above the max.
+  CPPUNIT_ASSERT_EQUAL(2048, ws_items("12288", 8192, 0, 1.0, 2048));
+  CPPUNIT_ASSERT_EQUAL(1000, ws_items("12288", 8192, 1000, 1.0, 2048));
+
+  // auto is half the L2 cache, whatever that is here.
+  int n = ws_items("auto", 1 << 30);
+  CPPUNIT_ASSERT(n > 0 && n < (1 << 30));
 }
@@ -0,0 +1,248 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2016 Free Software Foundation, Inc.
+ *
+ * This file is part of GNU Radio
+ *
+ * GNU Radio is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * GNU Radio is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GNU Radio; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <qa_msg_port_queue.h>
+#include <gnuradio/msg_port_queue.h>
+#include <gnuradio/block.h>
+#include <gnuradio/block_detail.h>
+#include <gnuradio/io_signature.h>
+#include <gnuradio/prefs.h>
+#include <gnuradio/thread/thread_group.h>
+#include <cppunit/TestAssert.h>
+#include <boost/bind.hpp>
+
+// Fill, overflow and drain a single-threaded queue.
+void
+qa_msg_port_queue::t1()
+{
+  gr::msg_port_queue q(5);
+  pmt::pmt_t m;
+
+  CPPUNIT_ASSERT_EQUAL((size_t)8, q.capacity());
+  CPPUNIT_ASSERT(q.empty());
+  CPPUNIT_ASSERT(!q.pop(m));
+
+  for(long i = 0; i < 8; i++)
+    CPPUNIT_ASSERT(q.push(pmt::from_long(i)));
+  CPPUNIT_ASSERT_EQUAL((size_t)8, q.size());
+  CPPUNIT_ASSERT(!q.push(pmt::from_long(8)));
+
+  // Wrap around a few times.
+  for(long i = 0; i < 20; i++) {
+    CPPUNIT_ASSERT(q.pop(m));
+    CPPUNIT_ASSERT_EQUAL(i, pmt::to_long(m));
+    CPPUNIT_ASSERT(q.push(pmt::from_long(i + 8)));
+  }
+  for(long i = 20; i < 28; i++) {
+    CPPUNIT_ASSERT(q.pop(m));
+    CPPUNIT_ASSERT_EQUAL(i, pmt::to_long(m));
+  }
+  CPPUNIT_ASSERT(q.empty());
+  CPPUNIT_ASSERT(!q.pop(m));
+
+  CPPUNIT_ASSERT_EQUAL((uint64_t)0, q.ndropped());
+  q.add_dropped();
+  CPPUNIT_ASSERT_EQUAL((uint64_t)1, q.ndropped());
+}
+
+// Batched pops.
+void
+qa_msg_port_queue::t2()
+{
+  gr::msg_port_queue q(16);
+  std::vector<pmt::pmt_t> msgs;
+
+  for(long i = 0; i < 10; i++)
+    q.push(pmt::from_long(i));
+
+  CPPUNIT_ASSERT_EQUAL((size_t)4, q.pop_batch(msgs, 4));
+  CPPUNIT_ASSERT_EQUAL((size_t)4, msgs.size());
+  for(long i = 0; i < 4; i++)
+    CPPUNIT_ASSERT_EQUAL(i, pmt::to_long(msgs[i]));
+
+  CPPUNIT_ASSERT_EQUAL((size_t)6, q.pop_batch(msgs, 64));
+  for(long i = 0; i < 6; i++)
+    CPPUNIT_ASSERT_EQUAL(i + 4, pmt::to_long(msgs[i]));
+
+  CPPUNIT_ASSERT_EQUAL((size_t)0, q.pop_batch(msgs, 64));
+  CPPUNIT_ASSERT(msgs.empty());
+}
+
+static const int NPRODUCERS = 4;
+static const long NMSGS = 20000;
+
+static void
+produce(gr::msg_port_queue *q, long id)
+{
+  for(long i = 0; i < NMSGS; i++) {
+    pmt::pmt_t m = pmt::cons(pmt::from_long(id), pmt::from_long(i));
+    while(!q->push(m))
+      boost::this_thread::yield();
+  }
+}
+
+// Several producers, one consumer: nothing is lost and each
+// producer's messages arrive in order.
+void
+qa_msg_port_queue::t3()
+{
+  gr::msg_port_queue q(64);
+  gr::thread::thread_group producers;
+
+  for(long id = 0; id < NPRODUCERS; id++)
+    producers.create_thread(boost::bind(produce, &q, id));
+
+  std::vector<long> next(NPRODUCERS, 0);
+  std::vector<pmt::pmt_t> msgs;
+  long nseen = 0;
+  while(nseen < NPRODUCERS * NMSGS) {
+    if(!q.pop_batch(msgs, 16)) {
+      boost::this_thread::yield();
+      continue;
+    }
+    for(size_t i = 0; i < msgs.size(); i++) {
+      long id = pmt::to_long(pmt::car(msgs[i]));
+      CPPUNIT_ASSERT_EQUAL(next[id], pmt::to_long(pmt::cdr(msgs[i])));
+      next[id]++;
+      nseen++;
+    }
+  }
+
+  producers.join_all();
+  CPPUNIT_ASSERT(q.empty());
+}
+
+namespace {
+
+  // A block with one input message port of four messages.
+  class msg_block : public gr::block
+  {
+  public:
+    msg_block()
+      : gr::block("msg_block",
+                  gr::io_signature::make(0, 0, 0),
+                  gr::io_signature::make(0, 0, 0))
+    {
+      gr::prefs *p = gr::prefs::singleton();
+      std::string max_messages = p->get_string("DEFAULT", "max_messages", "");
+      std::string backpressure = p->get_string("DEFAULT", "msg_backpressure", "");
+      p->set_string("DEFAULT", "max_messages", "4");
+      p->set_string("DEFAULT", "msg_backpressure", "True");
+      message_port_register_in(pmt::mp("in"));
+      p->set_string("DEFAULT", "max_messages", max_messages);
+      p->set_string("DEFAULT", "msg_backpressure", backpressure);
+    }
+
+    pmt::pmt_t pop() { return delete_head_nowait(pmt::mp("in")); }
+
+    // t4 checks the deprecated calls on purpose.
+#if defined(__GNUC__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wdeprecated-declarations"
+#endif
+    void remove_second()
+    {
+      std::deque<pmt::pmt_t>::iterator it = get_iterator(pmt::mp("in"));
+      CPPUNIT_ASSERT_EQUAL(0L, pmt::to_long(*it));
+      erase_msg(pmt::mp("in"), ++it);
+    }
+#if defined(__GNUC__)
+#pragma GCC diagnostic pop
+#endif
+  };
+
+  void
+  post_one(msg_block *blk, bool *returned)
+  {
+    blk->post(pmt::mp("in"), pmt::from_long(4));
+    *returned = true;
+  }
+
+  // Whether a post to blk's full queue gives up after stop is called.
+  bool
+  post_gives_up(msg_block *blk, boost::function<void(boost::thread &)> stop)
+  {
+    bool returned = false;
+    boost::thread t(boost::bind(post_one, blk, &returned));
+    boost::this_thread::sleep(boost::posix_time::milliseconds(50));
+    if(returned)
+      return false;
+    stop(t);
+    return t.timed_join(boost::posix_time::seconds(5)) && returned;
+  }
+
+  void
+  interrupt(boost::thread &t)
+  {
+    t.interrupt();
+  }
+
+  void
+  finish(msg_block *blk, boost::thread &t)
+  {
+    blk->detail()->set_done(true);
+  }
+
+}
+
+// The deprecated get_iterator/erase_msg still remove a message from
+// the middle of the queue.
+void
+qa_msg_port_queue::t4()
+{
+  boost::shared_ptr<msg_block> blk(new msg_block);
+
+  for(long i = 0; i < 4; i++)
+    blk->post(pmt::mp("in"), pmt::from_long(i));
+  blk->remove_second();
+
+  CPPUNIT_ASSERT_EQUAL((size_t)3, blk->nmsgs(pmt::mp("in")));
+  CPPUNIT_ASSERT_EQUAL(0L, pmt::to_long(blk->pop()));
+  CPPUNIT_ASSERT_EQUAL(2L, pmt::to_long(blk->pop()));
+  CPPUNIT_ASSERT_EQUAL(3L, pmt::to_long(blk->pop()));
+  CPPUNIT_ASSERT_EQUAL((uint64_t)0, blk->nmsgs_dropped(pmt::mp("in")));
+}
+
+// With backpressure, a post to a full queue waits, but gives up (and
+// counts a drop) when the poster is interrupted or the block is done.
+void
+qa_msg_port_queue::t5()
+{
+  boost::shared_ptr<msg_block> blk(new msg_block);
+  blk->set_detail(gr::make_block_detail(0, 0));
+
+  for(long i = 0; i < 4; i++)
+    blk->post(pmt::mp("in"), pmt::from_long(i));
+
+  CPPUNIT_ASSERT(post_gives_up(blk.get(), interrupt));
+  CPPUNIT_ASSERT_EQUAL((uint64_t)1, blk->nmsgs_dropped(pmt::mp("in")));
+
+  CPPUNIT_ASSERT(post_gives_up(blk.get(), boost::bind(finish, blk.get(), _1)));
+  CPPUNIT_ASSERT_EQUAL((uint64_t)2, blk->nmsgs_dropped(pmt::mp("in")));
+  CPPUNIT_ASSERT_EQUAL((size_t)4, blk->nmsgs(pmt::mp("in")));
+
+  blk->set_detail(gr::block_detail_sptr());
+}
@@ -0,0 +1,136 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2016 Free Software Foundation, Inc.
+ *
+ * This file is part of GNU Radio
+ *
+ * GNU Radio is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * GNU Radio is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GNU Radio; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <qa_perf_trace.h>
+#include <gnuradio/perf_trace.h>
+#include <gnuradio/block_detail.h>
+#include <cppunit/TestAssert.h>
+#include <fstream>
+#include <string.h>
+#include <unistd.h>
+
+static const char *test_file = "qa_gr_perf_trace.data";
+
+// The ring keeps the newest events, oldest first.
+void
+qa_perf_trace::t1()
+{
+  gr::perf_trace trace(5);
+  CPPUNIT_ASSERT_EQUAL((size_t)8, trace.capacity());
+  CPPUNIT_ASSERT_EQUAL((size_t)0, trace.size());
+
+  for(int i = 0; i < 20; i++)
+    trace.add(gr::perf_trace::WORK, 7, 100 * i, i, i);
+  CPPUNIT_ASSERT_EQUAL((size_t)8, trace.size());
+
+  std::vector<gr::perf_trace::record> r = trace.records();
+  CPPUNIT_ASSERT_EQUAL((size_t)8, r.size());
+  for(int i = 0; i < 8; i++) {
+    CPPUNIT_ASSERT_EQUAL((uint64_t)(100 * (i + 12)), r[i].start);
+    CPPUNIT_ASSERT_EQUAL((uint32_t)(i + 12), r[i].duration);
+    CPPUNIT_ASSERT_EQUAL((uint32_t)(i + 12), r[i].nitems);
+    CPPUNIT_ASSERT_EQUAL((uint32_t)7, r[i].block);
+  }
+
+  // Durations too long for 32 bits saturate.
+  trace.clear();
+  trace.add(gr::perf_trace::BLOCKED_INPUT, 1, 0, 1LL << 40);
+  r = trace.records();
+  CPPUNIT_ASSERT_EQUAL((size_t)1, r.size());
+  CPPUNIT_ASSERT_EQUAL((uint32_t)0xffffffffU, r[0].duration);
+  CPPUNIT_ASSERT_EQUAL((uint32_t)gr::perf_trace::BLOCKED_INPUT, r[0].type);
+}
+
+// The binary file reads back.
+void
+qa_perf_trace::t2()
+{
+  gr::perf_trace trace(4);
+  trace.register_block(3, "blk3");
+  trace.add(gr::perf_trace::WORK, 3, 10, 20, 30);
+  trace.add(gr::perf_trace::BLOCKED_OUTPUT, 3, 40, 50);
+
+  CPPUNIT_ASSERT(trace.write_binary(test_file));
+
+  std::ifstream in(test_file, std::ios::binary);
+  char magic[8];
+  uint64_t tps, nrecords;
+  uint32_t nblocks, id, len;
+  char name[4];
+  in.read(magic, 8);
+  in.read((char *)&tps, sizeof(tps));
+  in.read((char *)&nblocks, sizeof(nblocks));
+  in.read((char *)&id, sizeof(id));
+  in.read((char *)&len, sizeof(len));
+  in.read(name, 4);
+  in.read((char *)&nrecords, sizeof(nrecords));
+  gr::perf_trace::record r[2];
+  in.read((char *)r, sizeof(r));
+  CPPUNIT_ASSERT(in.good());
+  in.close();
+  unlink(test_file);
+
+  CPPUNIT_ASSERT(memcmp(magic, "GRTRACE1", 8) == 0);
+  CPPUNIT_ASSERT_EQUAL((uint64_t)gr::high_res_timer_tps(), tps);
+  CPPUNIT_ASSERT_EQUAL((uint32_t)1, nblocks);
+  CPPUNIT_ASSERT_EQUAL((uint32_t)3, id);
+  CPPUNIT_ASSERT_EQUAL((uint32_t)4, len);
+  CPPUNIT_ASSERT(memcmp(name, "blk3", 4) == 0);
+  CPPUNIT_ASSERT_EQUAL((uint64_t)2, nrecords);
+  CPPUNIT_ASSERT_EQUAL((uint64_t)10, r[0].start);
+  CPPUNIT_ASSERT_EQUAL((uint32_t)30, r[0].nitems);
+  CPPUNIT_ASSERT_EQUAL((uint32_t)gr::perf_trace::BLOCKED_OUTPUT, r[1].type);
+  CPPUNIT_ASSERT_EQUAL((uint32_t)50, r[1].duration);
+}
+
+// block_detail's work time histogram and blocked counters.
+void
+qa_perf_trace::t3()
+{
+  gr::block_detail_sptr d = gr::make_block_detail(0, 0);
+
+  d->add_work_time(0);
+  d->add_work_time(1);
+  d->add_work_time(1000);		// 2^9 <= 1000 < 2^10
+  d->add_work_time(1LL << 40);		// past the end
+  std::vector<uint64_t> hist = d->pc_work_time_hist();
+  CPPUNIT_ASSERT_EQUAL((size_t)gr::block_detail::PC_WORK_HIST_SIZE, hist.size());
+  CPPUNIT_ASSERT_EQUAL((uint64_t)2, hist[0]);
+  CPPUNIT_ASSERT_EQUAL((uint64_t)1, hist[9]);
+  CPPUNIT_ASSERT_EQUAL((uint64_t)1, hist[gr::block_detail::PC_WORK_HIST_SIZE - 1]);
+  CPPUNIT_ASSERT_EQUAL((uint64_t)4, d->pc_work_calls());
+
+  d->add_blocked_time(true, 5);
+  d->add_blocked_time(false, 7);
+  d->add_blocked_time(true, 5);
+  CPPUNIT_ASSERT_EQUAL((uint64_t)10, d->pc_input_blocked_time());
+  CPPUNIT_ASSERT_EQUAL((uint64_t)7, d->pc_output_blocked_time());
+  CPPUNIT_ASSERT_EQUAL((uint64_t)3, d->pc_wakeups());
+
+  d->reset_perf_counters();
+  CPPUNIT_ASSERT_EQUAL((uint64_t)0, d->pc_work_calls());
+  CPPUNIT_ASSERT_EQUAL((uint64_t)0, d->pc_wakeups());
+}
@@ -37,6 +37,11 @@
 #include <qa_fxpt_nco.h>
 #include <qa_fxpt_vco.h>
 #include <qa_logger.h>
+#include <qa_msg_port_queue.h>
+#include <qa_perf_trace.h>
+#include <qa_tagged_stream_block.h>
+#include <qa_thread_placement.h>
+#include <qa_top_block.h>
 #include <qa_math.h>
 #include <qa_vmcircbuf.h>
 #include <qa_sincos.h>
@@ -54,6 +59,11 @@ qa_runtime::suite()
   s->addTest(qa_fxpt_nco::suite());
   s->addTest(qa_fxpt_vco::suite());
   s->addTest(qa_logger::suite());
+  s->addTest(qa_msg_port_queue::suite());
+  s->addTest(qa_perf_trace::suite());
+  s->addTest(qa_tagged_stream_block::suite());
+  s->addTest(qa_thread_placement::suite());
+  s->addTest(qa_top_block::suite());
   s->addTest(qa_math::suite());
   s->addTest(qa_vmcircbuf::suite());
   s->addTest(qa_sincos::suite());
@@ -0,0 +1,249 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2016 Free Software Foundation, Inc.
+ *
+ * This file is part of GNU Radio
+ *
+ * GNU Radio is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * GNU Radio is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GNU Radio; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <qa_tagged_stream_block.h>
+#include <gnuradio/top_block.h>
+#include <gnuradio/sync_block.h>
+#include <gnuradio/tagged_stream_block.h>
+#include <gnuradio/block_detail.h>
+#include <gnuradio/buffer.h>
+#include <gnuradio/io_signature.h>
+#include <cppunit/TestAssert.h>
+#include <algorithm>
+#include <string.h>
+
+namespace {
+
+  const char *s_len_key = "packet_len";
+
+  // Packets of 1, 2, ... max_len bytes, over and over, each byte
+  // holding its packet's length. At most chunk bytes per call, so
+  // packets get split across calls.
+  class packet_source : public gr::sync_block
+  {
+    int d_npackets;
+    int d_max_len;
+    int d_chunk;
+    int d_packet;	// packets started
+    int d_len;		// length of the current one
+    int d_left;		// bytes of it still to go
+
+  public:
+    packet_source(int npackets, int max_len, int chunk)
+      : gr::sync_block("packet_source",
+                       gr::io_signature::make(0, 0, 0),
+                       gr::io_signature::make(1, 1, sizeof(char))),
+        d_npackets(npackets), d_max_len(max_len), d_chunk(chunk),
+        d_packet(0), d_len(0), d_left(0)
+    {
+    }
+
+    int work(int noutput_items,
+             gr_vector_const_void_star &input_items,
+             gr_vector_void_star &output_items)
+    {
+      char *out = (char *)output_items[0];
+      noutput_items = std::min(noutput_items, d_chunk);
+
+      int n = 0;
+      while(n < noutput_items) {
+        if(d_left == 0) {
+          if(d_packet == d_npackets)
+            break;
+          d_len = d_left = d_packet % d_max_len + 1;
+          add_item_tag(0, nitems_written(0) + n,
+                       pmt::intern(s_len_key), pmt::from_long(d_len));
+          d_packet++;
+        }
+        int k = std::min(d_left, noutput_items - n);
+        memset(out + n, d_len, k);
+        n += k;
+        d_left -= k;
+      }
+      return n == 0 ? WORK_DONE : n;
+    }
+  };
+
+  // Appends the packet's length to every packet.
+  class append_length : public gr::tagged_stream_block
+  {
+  public:
+    int d_nworks;
+    int d_nwork_packets;
+
+    append_length(bool packet_vectors)
+      : gr::tagged_stream_block("append_length",
+                                gr::io_signature::make(1, 1, sizeof(char)),
+                                gr::io_signature::make(1, 1, sizeof(char)),
+                                s_len_key),
+        d_nworks(0), d_nwork_packets(0)
+    {
+      enable_packet_vectors(packet_vectors);
+    }
+
+    int calculate_output_stream_length(const gr_vector_int &ninput_items)
+    {
+      return ninput_items[0] + 1;
+    }
+
+    int work(int noutput_items,
+             gr_vector_int &ninput_items,
+             gr_vector_const_void_star &input_items,
+             gr_vector_void_star &output_items)
+    {
+      const char *in = (const char *)input_items[0];
+      char *out = (char *)output_items[0];
+      memcpy(out, in, ninput_items[0]);
+      out[ninput_items[0]] = ninput_items[0];
+      d_nworks++;
+      return ninput_items[0] + 1;
+    }
+
+    int work_packets(int noutput_items,
+                     const std::vector<gr_vector_int> &packet_lengths,
+                     gr_vector_int &packet_noutput_items,
+                     gr_vector_const_void_star &input_items,
+                     gr_vector_void_star &output_items)
+    {
+      d_nwork_packets++;
+      return gr::tagged_stream_block::work_packets(noutput_items, packet_lengths,
+                                                   packet_noutput_items,
+                                                   input_items, output_items);
+    }
+  };
+
+  // Keeps everything it gets, and the length tags.
+  class packet_sink : public gr::sync_block
+  {
+  public:
+    std::vector<char> d_data;
+    std::vector<gr::tag_t> d_tags;
+
+    packet_sink()
+      : gr::sync_block("packet_sink",
+                       gr::io_signature::make(1, 1, sizeof(char)),
+                       gr::io_signature::make(0, 0, 0))
+    {
+    }
+
+    int work(int noutput_items,
+             gr_vector_const_void_star &input_items,
+             gr_vector_void_star &output_items)
+    {
+      const char *in = (const char *)input_items[0];
+      d_data.insert(d_data.end(), in, in + noutput_items);
+
+      std::vector<gr::tag_t> tags;
+      get_tags_in_range(tags, 0, nitems_read(0), nitems_read(0) + noutput_items,
+                        pmt::intern(s_len_key));
+      d_tags.insert(d_tags.end(), tags.begin(), tags.end());
+      return noutput_items;
+    }
+  };
+
+  // Push npackets through append_length, checking the output.
+  boost::shared_ptr<append_length>
+  run_packets(bool packet_vectors, int npackets, int max_len, int chunk)
+  {
+    boost::shared_ptr<append_length> block =
+      gnuradio::get_initial_sptr(new append_length(packet_vectors));
+    boost::shared_ptr<packet_sink> sink = gnuradio::get_initial_sptr(new packet_sink());
+
+    gr::top_block_sptr tb = gr::make_top_block("qa_tagged_stream_block");
+    tb->connect(gnuradio::get_initial_sptr(new packet_source(npackets, max_len, chunk)), 0,
+                block, 0);
+    tb->connect(block, 0, sink, 0);
+    tb->run();
+
+    CPPUNIT_ASSERT_EQUAL((size_t)npackets, sink->d_tags.size());
+    uint64_t offset = 0;
+    for(int p = 0; p < npackets; p++) {
+      int len = p % max_len + 1;
+      CPPUNIT_ASSERT_EQUAL(offset, sink->d_tags[p].offset);
+      CPPUNIT_ASSERT_EQUAL((long)len + 1, pmt::to_long(sink->d_tags[p].value));
+      for(int i = 0; i <= len; i++)
+        CPPUNIT_ASSERT_EQUAL((char)len, sink->d_data[offset + i]);
+      offset += len + 1;
+    }
+    CPPUNIT_ASSERT_EQUAL((size_t)offset, sink->d_data.size());
+
+    return block;
+  }
+
+}
+
+// One packet per call to work(), whatever the scheduler has.
+void
+qa_tagged_stream_block::t1()
+{
+  boost::shared_ptr<append_length> block = run_packets(false, 1000, 20, 64);
+  CPPUNIT_ASSERT_EQUAL(1000, block->d_nworks);
+  CPPUNIT_ASSERT_EQUAL(0, block->d_nwork_packets);
+}
+
+// With packet vectors, everything complete goes in one call.
+void
+qa_tagged_stream_block::t2()
+{
+  boost::shared_ptr<append_length> block = run_packets(true, 1000, 20, 64);
+  CPPUNIT_ASSERT_EQUAL(1000, block->d_nworks);
+  CPPUNIT_ASSERT(block->d_nwork_packets > 0);
+  CPPUNIT_ASSERT(block->d_nwork_packets < 500);
+
+  // Packets split over calls on the way in don't change that.
+  run_packets(true, 1000, 100, 7);
+}
+
+// A negative length tag is as fatal as a missing one.
+void
+qa_tagged_stream_block::t3()
+{
+  boost::shared_ptr<append_length> block =
+    gnuradio::get_initial_sptr(new append_length(true));
+
+  gr::buffer_sptr in = gr::make_buffer(4096, sizeof(char), gr::block_sptr());
+  gr::buffer_sptr out = gr::make_buffer(4096, sizeof(char), block);
+  gr::block_detail_sptr detail = gr::make_block_detail(1, 1);
+  detail->set_input(0, gr::buffer_add_reader(in, 0, block));
+  detail->set_output(0, out);
+  block->set_detail(detail);
+  block->check_topology(1, 1);
+
+  gr::tag_t tag;
+  tag.offset = 0;
+  tag.key = pmt::intern(s_len_key);
+  tag.value = pmt::from_long(-1);
+  in->add_item_tag(tag);
+  in->update_write_pointer(10);
+
+  gr_vector_int ninput_items(1, 10);
+  gr_vector_const_void_star input_items(1, detail->input(0)->read_pointer());
+  gr_vector_void_star output_items(1, out->write_pointer());
+  CPPUNIT_ASSERT_THROW(block->general_work(100, ninput_items, input_items, output_items),
+                       std::runtime_error);
+
+  block->set_detail(gr::block_detail_sptr());
+}
@@ -0,0 +1,210 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2016 Free Software Foundation, Inc.
+ *
+ * This file is part of GNU Radio
+ *
+ * GNU Radio is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * GNU Radio is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GNU Radio; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <qa_thread_placement.h>
+#include <thread_placement.h>
+#include <cppunit/TestAssert.h>
+#include <boost/filesystem.hpp>
+#include <boost/format.hpp>
+#include <fstream>
+
+namespace fs = boost::filesystem;
+
+namespace {
+
+  void
+  write_file(const fs::path &path, const std::string &contents)
+  {
+    fs::create_directories(path.parent_path());
+    std::ofstream out(path.string().c_str());
+    out << contents << std::endl;
+  }
+
+  /*
+   * A sysfs tree for two packages of two cores with two hardware
+   * threads each, numbered the way Linux does: first threads 0-3,
+   * their siblings 4-7. Each core has its own L1 and L2 caches, each
+   * package an L3.
+   */
+  class fake_sysfs
+  {
+    fs::path d_root;
+
+  public:
+    fake_sysfs()
+    {
+      d_root = fs::temp_directory_path() / fs::unique_path("qa_thread_placement-%%%%-%%%%");
+      write_file(d_root / "online", "0-7");
+
+      for(int id = 0; id < 8; id++) {
+        int package = (id / 2) % 2;
+        int core = id % 2;
+        int sibling = id < 4 ? id + 4 : id - 4;
+        std::string l2 = str(boost::format("%d,%d") % std::min(id, sibling) % std::max(id, sibling));
+        std::string l3 = package == 0 ? "0-1,4-5" : "2-3,6-7";
+
+        fs::path cpu = d_root / str(boost::format("cpu%d") % id);
+        write_file(cpu / "topology/physical_package_id", str(boost::format("%d") % package));
+        write_file(cpu / "topology/core_id", str(boost::format("%d") % core));
+
+        const char *levels[] = { "1", "1", "2", "3" };
+        const char *types[] = { "Data", "Instruction", "Unified", "Unified" };
+        std::string shared[] = { l2, l2, l2, l3 };
+        for(int i = 0; i < 4; i++) {
+          fs::path index = cpu / str(boost::format("cache/index%d") % i);
+          write_file(index / "level", levels[i]);
+          write_file(index / "type", types[i]);
+          write_file(index / "shared_cpu_list", shared[i]);
+        }
+      }
+    }
+
+    ~fake_sysfs() { fs::remove_all(d_root); }
+
+    std::string root() const { return d_root.string(); }
+  };
+
+  std::vector<int>
+  ids(const gr::cpu_topology &topology)
+  {
+    std::vector<int> v;
+    for(size_t i = 0; i < topology.cpus().size(); i++)
+      v.push_back(topology.cpus()[i].id);
+    return v;
+  }
+
+  void
+  add_edge(std::vector<gr::placement_edge> &edges, size_t src, size_t dst, double weight)
+  {
+    gr::placement_edge e = { src, dst, weight };
+    edges.push_back(e);
+  }
+
+} /* namespace */
+
+/*
+ * The topology is read and put in placement order.
+ */
+void
+qa_thread_placement::t1()
+{
+  fake_sysfs sysfs;
+  gr::cpu_topology topology(sysfs.root());
+
+  int expected[] = { 0, 1, 4, 5, 2, 3, 6, 7 };
+  std::vector<int> order = ids(topology);
+  CPPUNIT_ASSERT(order == std::vector<int>(expected, expected + 8));
+
+  const gr::cpu_topology::cpu &c = topology.cpus()[7];	// cpu 7
+  CPPUNIT_ASSERT_EQUAL(1, c.package);
+  CPPUNIT_ASSERT_EQUAL(1, c.core);
+  CPPUNIT_ASSERT_EQUAL(1, c.thread);
+  CPPUNIT_ASSERT_EQUAL(3, c.l2);
+  CPPUNIT_ASSERT_EQUAL(2, c.l3);
+
+  // Nothing there
+  gr::cpu_topology none(sysfs.root() + "/missing");
+  CPPUNIT_ASSERT(none.cpus().empty());
+}
+
+/*
+ * restrict_to keeps the order.
+ */
+void
+qa_thread_placement::t2()
+{
+  fake_sysfs sysfs;
+  gr::cpu_topology topology(sysfs.root());
+
+  int allowed[] = { 6, 2, 5, 1 };
+  topology.restrict_to(std::vector<int>(allowed, allowed + 4));
+
+  int expected[] = { 1, 5, 2, 6 };
+  CPPUNIT_ASSERT(ids(topology) == std::vector<int>(expected, expected + 4));
+}
+
+/*
+ * Threads joined by heavy edges end up on neighboring CPUs.
+ */
+void
+qa_thread_placement::t3()
+{
+  fake_sysfs sysfs;
+  gr::cpu_topology topology(sysfs.root());
+
+  // A chain 0 - 2 - 1 - 3 and a light edge across it
+  std::vector<gr::placement_edge> edges;
+  add_edge(edges, 0, 2, 100);
+  add_edge(edges, 1, 2, 100);
+  add_edge(edges, 1, 3, 100);
+  add_edge(edges, 3, 0, 1);
+
+  std::vector<int> cpus = gr::place_threads(4, edges, topology);
+  CPPUNIT_ASSERT_EQUAL(0, cpus[0]);
+  CPPUNIT_ASSERT_EQUAL(1, cpus[2]);
+  CPPUNIT_ASSERT_EQUAL(4, cpus[1]);
+  CPPUNIT_ASSERT_EQUAL(5, cpus[3]);
+
+  // Two chains of four, listed interleaved, get a package each.
+  edges.clear();
+  for(size_t i = 0; i < 3; i++) {
+    add_edge(edges, 2*i, 2*i + 2, 10);
+    add_edge(edges, 2*i + 1, 2*i + 3, 10);
+  }
+  cpus = gr::place_threads(8, edges, topology);
+  for(size_t i = 0; i < 8; i += 2) {
+    int cpu = cpus[i];
+    CPPUNIT_ASSERT(cpu == 0 || cpu == 1 || cpu == 4 || cpu == 5);
+    cpu = cpus[i + 1];
+    CPPUNIT_ASSERT(cpu == 2 || cpu == 3 || cpu == 6 || cpu == 7);
+  }
+}
+
+/*
+ * More threads than CPUs share them with their neighbors; no CPUs
+ * means no placement.
+ */
+void
+qa_thread_placement::t4()
+{
+  fake_sysfs sysfs;
+  gr::cpu_topology topology(sysfs.root());
+
+  std::vector<gr::placement_edge> edges;
+  for(size_t i = 0; i + 1 < 16; i++)
+    add_edge(edges, i, i + 1, 1);
+
+  std::vector<int> cpus = gr::place_threads(16, edges, topology);
+  std::vector<int> order = ids(topology);
+  for(size_t i = 0; i < 16; i++)
+    CPPUNIT_ASSERT_EQUAL(order[i / 2], cpus[i]);
+
+  gr::cpu_topology none(sysfs.root() + "/missing");
+  cpus = gr::place_threads(3, edges, none);
+  CPPUNIT_ASSERT_EQUAL(3, (int)cpus.size());
+  for(size_t i = 0; i < cpus.size(); i++)
+    CPPUNIT_ASSERT_EQUAL(-1, cpus[i]);
+}
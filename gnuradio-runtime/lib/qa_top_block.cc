@@ -0,0 +1,872 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2016 Free Software Foundation, Inc.
+ *
+ * This file is part of GNU Radio
+ *
+ * GNU Radio is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * GNU Radio is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GNU Radio; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <qa_top_block.h>
+#include <gnuradio/top_block.h>
+#include <gnuradio/sync_block.h>
+#include <gnuradio/block_detail.h>
+#include <gnuradio/buffer.h>
+#include <gnuradio/high_res_timer.h>
+#include <gnuradio/io_signature.h>
+#include <gnuradio/prefs.h>
+#include <thread_placement.h>
+#include <cppunit/TestAssert.h>
+#include <boost/atomic.hpp>
+#include <boost/bind.hpp>
+#include <boost/thread/thread.hpp>
+#include <algorithm>
+#include <sstream>
+#include <string.h>
+
+namespace {
+
+  // Sets a pref for as long as it's in scope.
+  class pref_guard
+  {
+    std::string d_section, d_option, d_old;
+
+  public:
+    pref_guard(const std::string &section, const std::string &option,
+               const std::string &value)
+      : d_section(section), d_option(option),
+        d_old(gr::prefs::singleton()->get_string(section, option, ""))
+    {
+      gr::prefs::singleton()->set_string(section, option, value);
+    }
+
+    ~pref_guard()
+    {
+      gr::prefs::singleton()->set_string(d_section, d_option, d_old);
+    }
+  };
+
+  // Counts how often the scheduler starts and stops it, and the
+  // items through it. Sources make zeros, one chunk per millisecond,
+  // unless paused.
+  class counting_block : public gr::sync_block
+  {
+  public:
+    boost::atomic<int> d_nstarts;
+    boost::atomic<int> d_nstops;
+    boost::atomic<long> d_nitems;
+    boost::atomic<bool> d_paused;
+
+    counting_block(bool source)
+      : gr::sync_block("counting_block",
+                       source ? gr::io_signature::make(0, 0, 0)
+                              : gr::io_signature::make(1, 1, sizeof(float)),
+                       source ? gr::io_signature::make(1, 1, sizeof(float))
+                              : gr::io_signature::make(0, 0, 0)),
+        d_nstarts(0), d_nstops(0), d_nitems(0), d_paused(false)
+    {
+    }
+
+    bool start() { d_nstarts++; return true; }
+    bool stop() { d_nstops++; return true; }
+
+    int work(int noutput_items,
+             gr_vector_const_void_star &input_items,
+             gr_vector_void_star &output_items)
+    {
+      if(!output_items.empty()) {
+        boost::this_thread::sleep(boost::posix_time::milliseconds(1));
+        if(d_paused)
+          return 0;
+        memset(output_items[0], 0, noutput_items * sizeof(float));
+      }
+      d_nitems += noutput_items;
+      return noutput_items;
+    }
+  };
+
+  typedef boost::shared_ptr<counting_block> counting_block_sptr;
+
+  counting_block_sptr
+  make_counting_block(bool source)
+  {
+    return gnuradio::get_initial_sptr(new counting_block(source));
+  }
+
+  // Wait (up to 10 s) for more than nitems items to go through block.
+  bool
+  wait_for_items(counting_block_sptr block, long nitems)
+  {
+    for(int i = 0; i < 10000 && block->d_nitems <= nitems; i++)
+      boost::this_thread::sleep(boost::posix_time::milliseconds(1));
+    return block->d_nitems > nitems;
+  }
+
+  // Makes nitems zeros, posting the number of items of each call
+  // on its "count" port.
+  class finite_source : public gr::sync_block
+  {
+    long d_nleft;
+
+  public:
+    finite_source(long nitems)
+      : gr::sync_block("finite_source",
+                       gr::io_signature::make(0, 0, 0),
+                       gr::io_signature::make(1, 1, sizeof(float))),
+        d_nleft(nitems)
+    {
+      message_port_register_out(pmt::mp("count"));
+    }
+
+    int work(int noutput_items,
+             gr_vector_const_void_star &input_items,
+             gr_vector_void_star &output_items)
+    {
+      if(d_nleft == 0)
+        return WORK_DONE;
+      int n = (int)std::min((long)noutput_items, d_nleft);
+      memset(output_items[0], 0, n * sizeof(float));
+      d_nleft -= n;
+      message_port_pub(pmt::mp("count"), pmt::from_long(n));
+      return n;
+    }
+  };
+
+  // Consumes items and adds up the counts it's sent.
+  class counting_sink : public gr::sync_block
+  {
+  public:
+    long d_nitems;
+    long d_nmsgs;
+    long d_msg_total;
+
+    counting_sink()
+      : gr::sync_block("counting_sink",
+                       gr::io_signature::make(1, 1, sizeof(float)),
+                       gr::io_signature::make(0, 0, 0)),
+        d_nitems(0), d_nmsgs(0), d_msg_total(0)
+    {
+      message_port_register_in(pmt::mp("count"));
+      set_msg_handler(pmt::mp("count"), boost::bind(&counting_sink::handle, this, _1));
+    }
+
+    void handle(pmt::pmt_t msg)
+    {
+      d_nmsgs++;
+      d_msg_total += pmt::to_long(msg);
+    }
+
+    int work(int noutput_items,
+             gr_vector_const_void_star &input_items,
+             gr_vector_void_star &output_items)
+    {
+      d_nitems += noutput_items;
+      return noutput_items;
+    }
+  };
+
+  // Counts up from 0, one chunk per millisecond.
+  class ramp_source : public gr::sync_block
+  {
+    int d_next;
+
+  public:
+    ramp_source()
+      : gr::sync_block("ramp_source",
+                       gr::io_signature::make(0, 0, 0),
+                       gr::io_signature::make(1, 1, sizeof(int))),
+        d_next(0)
+    {
+    }
+
+    int work(int noutput_items,
+             gr_vector_const_void_star &input_items,
+             gr_vector_void_star &output_items)
+    {
+      boost::this_thread::sleep(boost::posix_time::milliseconds(1));
+      int *out = (int*)output_items[0];
+      for(int i = 0; i < noutput_items; i++)
+        out[i] = d_next++;
+      return noutput_items;
+    }
+  };
+
+  // Sets a bit in each item, in place when it can.
+  class set_bit : public gr::sync_block
+  {
+    int d_bit;
+
+  public:
+    set_bit(int bit)
+      : gr::sync_block("set_bit",
+                       gr::io_signature::make(1, 1, sizeof(int)),
+                       gr::io_signature::make(1, 1, sizeof(int))),
+        d_bit(bit)
+    {
+      set_in_place(true);
+    }
+
+    int work(int noutput_items,
+             gr_vector_const_void_star &input_items,
+             gr_vector_void_star &output_items)
+    {
+      const int *in = (const int*)input_items[0];
+      int *out = (int*)output_items[0];
+      for(int i = 0; i < noutput_items; i++)
+        out[i] = in[i] | d_bit;
+      return noutput_items;
+    }
+  };
+
+  // Checks that it sees a rising ramp with exactly the bits in mask
+  // set, and counts the items that aren't.
+  class ramp_sink : public gr::sync_block
+  {
+    int d_mask;
+    int d_last;
+
+  public:
+    boost::atomic<long> d_nitems;
+    boost::atomic<long> d_nerrors;
+
+    ramp_sink(int mask)
+      : gr::sync_block("ramp_sink",
+                       gr::io_signature::make(1, 1, sizeof(int)),
+                       gr::io_signature::make(0, 0, 0)),
+        d_mask(mask), d_last(-1), d_nitems(0), d_nerrors(0)
+    {
+    }
+
+    // A reconnected sink picks up wherever the ramp is now.
+    bool start() { d_last = -1; return true; }
+
+    int work(int noutput_items,
+             gr_vector_const_void_star &input_items,
+             gr_vector_void_star &output_items)
+    {
+      const int *in = (const int*)input_items[0];
+      for(int i = 0; i < noutput_items; i++) {
+        int value = in[i] & ~(3 << 28);
+        if((in[i] & (3 << 28)) != d_mask || (d_last >= 0 && value != d_last + 1))
+          d_nerrors++;
+        d_last = value;
+      }
+      d_nitems += noutput_items;
+      return noutput_items;
+    }
+  };
+
+  typedef boost::shared_ptr<ramp_sink> ramp_sink_sptr;
+
+  // Wait (up to 10 s) for more than nitems items to go through sink.
+  bool
+  wait_for_ramp(ramp_sink_sptr sink, long nitems)
+  {
+    for(int i = 0; i < 10000 && sink->d_nitems <= nitems; i++)
+      boost::this_thread::sleep(boost::posix_time::milliseconds(1));
+    return sink->d_nitems > nitems;
+  }
+
+  // Counts up from 0 in floats, tagging every 100th item with its
+  // offset, and stops after nitems (or never, pacing itself, if
+  // nitems < 0).
+  class tagged_ramp : public gr::sync_block
+  {
+    long d_nitems;
+
+  public:
+    tagged_ramp(long nitems)
+      : gr::sync_block("tagged_ramp",
+                       gr::io_signature::make(0, 0, 0),
+                       gr::io_signature::make(1, 1, sizeof(float))),
+        d_nitems(nitems)
+    {
+    }
+
+    int work(int noutput_items,
+             gr_vector_const_void_star &input_items,
+             gr_vector_void_star &output_items)
+    {
+      uint64_t start = nitems_written(0);
+      if(d_nitems < 0)
+        boost::this_thread::sleep(boost::posix_time::milliseconds(1));
+      else if(start >= (uint64_t)d_nitems)
+        return WORK_DONE;
+      else
+        noutput_items = (int)std::min((uint64_t)noutput_items, d_nitems - start);
+
+      float *out = (float*)output_items[0];
+      for(int i = 0; i < noutput_items; i++) {
+        uint64_t offset = start + i;
+        out[i] = (float)(offset % (1 << 20));
+        if(offset % 100 == 0)
+          add_item_tag(0, offset, pmt::mp("offset"), pmt::from_uint64(offset));
+      }
+      return noutput_items;
+    }
+  };
+
+  // out = in * mul + add, at most max_items (if > 0) per call.
+  // Remembers the thread it last ran in.
+  class affine : public gr::sync_block
+  {
+    float d_mul, d_add;
+    int d_max_items;
+
+  public:
+    boost::thread::id d_thread;
+
+    affine(float mul, float add, int max_items = 0)
+      : gr::sync_block("affine",
+                       gr::io_signature::make(1, 1, sizeof(float)),
+                       gr::io_signature::make(1, 1, sizeof(float))),
+        d_mul(mul), d_add(add), d_max_items(max_items)
+    {
+    }
+
+    int work(int noutput_items,
+             gr_vector_const_void_star &input_items,
+             gr_vector_void_star &output_items)
+    {
+      d_thread = boost::this_thread::get_id();
+      if(d_max_items > 0)
+        noutput_items = std::min(noutput_items, d_max_items);
+
+      const float *in = (const float*)input_items[0];
+      float *out = (float*)output_items[0];
+      for(int i = 0; i < noutput_items; i++)
+        out[i] = in[i] * d_mul + d_add;
+      return noutput_items;
+    }
+  };
+
+  typedef boost::shared_ptr<affine> affine_sptr;
+
+  // Keeps every other item; tags are moved to half their offset.
+  class keep_even : public gr::block
+  {
+  public:
+    keep_even()
+      : gr::block("keep_even",
+                  gr::io_signature::make(1, 1, sizeof(float)),
+                  gr::io_signature::make(1, 1, sizeof(float)))
+    {
+      set_relative_rate(0.5);
+    }
+
+    void forecast(int noutput_items, gr_vector_int &ninput_items_required)
+    {
+      ninput_items_required[0] = 2 * noutput_items;
+    }
+
+    int general_work(int noutput_items,
+                     gr_vector_int &ninput_items,
+                     gr_vector_const_void_star &input_items,
+                     gr_vector_void_star &output_items)
+    {
+      const float *in = (const float*)input_items[0];
+      float *out = (float*)output_items[0];
+      int n = std::min(noutput_items, ninput_items[0] / 2);
+      for(int i = 0; i < n; i++)
+        out[i] = in[2 * i];
+      consume_each(2 * n);
+      return n;
+    }
+  };
+
+  // Keeps everything it's given.
+  class collect_sink : public gr::sync_block
+  {
+  public:
+    std::vector<float> d_data;
+    std::vector<gr::tag_t> d_tags;
+
+    collect_sink()
+      : gr::sync_block("collect_sink",
+                       gr::io_signature::make(1, 1, sizeof(float)),
+                       gr::io_signature::make(0, 0, 0))
+    {
+    }
+
+    int work(int noutput_items,
+             gr_vector_const_void_star &input_items,
+             gr_vector_void_star &output_items)
+    {
+      const float *in = (const float*)input_items[0];
+      d_data.insert(d_data.end(), in, in + noutput_items);
+      std::vector<gr::tag_t> tags;
+      get_tags_in_range(tags, 0, nitems_read(0), nitems_read(0) + noutput_items);
+      d_tags.insert(d_tags.end(), tags.begin(), tags.end());
+      return noutput_items;
+    }
+  };
+
+  typedef boost::shared_ptr<collect_sink> collect_sink_sptr;
+
+  // src -> a -> b -> c -> keep_even -> d -> e -> dst, where b does
+  // at most 37 items per call. With fusion, a-c and d-e each make a
+  // chain.
+  struct fusion_graph
+  {
+    gr::top_block_sptr tb;
+    affine_sptr a, b, c, d, e;
+    collect_sink_sptr dst;
+
+    fusion_graph(bool fusion, long nitems)
+      : tb(gr::make_top_block("qa_top_block")),
+        a(new affine(1, 1)), b(new affine(2, 0, 37)), c(new affine(1, -3)),
+        d(new affine(1, 5)), e(new affine(0.5, 0)), dst(new collect_sink)
+    {
+      pref_guard g("Scheduler", "fusion", fusion ? "True" : "False");
+
+      gr::block_sptr src(new tagged_ramp(nitems));
+      gr::block_sptr decim(new keep_even);
+      tb->connect(src, 0, a, 0);
+      tb->connect(a, 0, b, 0);
+      tb->connect(b, 0, c, 0);
+      tb->connect(c, 0, decim, 0);
+      tb->connect(decim, 0, d, 0);
+      tb->connect(d, 0, e, 0);
+      tb->connect(e, 0, dst, 0);
+      if(nitems < 0) {
+        tb->start();
+        for(int i = 0; i < 10000 && dst->nitems_read(0) == 0; i++)
+          boost::this_thread::sleep(boost::posix_time::milliseconds(1));
+        tb->stop();
+        tb->wait();
+      }
+      else
+        tb->run();
+    }
+  };
+
+  // Counts up from 0 in floats at rate items/sec by the clock, no
+  // matter how many items it's asked for, up to nitems.
+  class paced_ramp : public gr::sync_block
+  {
+    double d_rate;
+    uint64_t d_nitems;
+    gr::high_res_timer_type d_start;
+
+  public:
+    paced_ramp(double rate, uint64_t nitems)
+      : gr::sync_block("paced_ramp",
+                       gr::io_signature::make(0, 0, 0),
+                       gr::io_signature::make(1, 1, sizeof(float))),
+        d_rate(rate), d_nitems(nitems), d_start(0)
+    {
+    }
+
+    bool start() { d_start = gr::high_res_timer_now(); return true; }
+
+    int work(int noutput_items,
+             gr_vector_const_void_star &input_items,
+             gr_vector_void_star &output_items)
+    {
+      uint64_t start = nitems_written(0);
+      if(start >= d_nitems)
+        return WORK_DONE;
+
+      double secs = (double)(gr::high_res_timer_now() - d_start) / gr::high_res_timer_tps();
+      uint64_t due = std::min((uint64_t)(secs * d_rate), d_nitems);
+      if(due <= start) {
+        boost::this_thread::sleep(boost::posix_time::milliseconds(1));
+        return 0;
+      }
+      noutput_items = (int)std::min((uint64_t)noutput_items, due - start);
+
+      float *out = (float*)output_items[0];
+      for(int i = 0; i < noutput_items; i++)
+        out[i] = (float)(start + i);
+      return noutput_items;
+    }
+  };
+
+  // Passes its input on, remembering the most items it was asked
+  // for in one call once it's past item after.
+  class chunk_meter : public gr::sync_block
+  {
+    uint64_t d_after;
+
+  public:
+    int d_max_noutput_items;
+
+    chunk_meter(uint64_t after)
+      : gr::sync_block("chunk_meter",
+                       gr::io_signature::make(1, 1, sizeof(float)),
+                       gr::io_signature::make(1, 1, sizeof(float))),
+        d_after(after), d_max_noutput_items(0)
+    {
+    }
+
+    int work(int noutput_items,
+             gr_vector_const_void_star &input_items,
+             gr_vector_void_star &output_items)
+    {
+      if(nitems_read(0) >= d_after)
+        d_max_noutput_items = std::max(d_max_noutput_items, noutput_items);
+      memcpy(output_items[0], input_items[0], noutput_items * sizeof(float));
+      return noutput_items;
+    }
+  };
+
+  typedef boost::shared_ptr<chunk_meter> chunk_meter_sptr;
+
+  // paced_ramp -> a -> b -> dst, all four on one path.
+  struct latency_graph
+  {
+    boost::shared_ptr<paced_ramp> src;
+    chunk_meter_sptr a, b;
+    collect_sink_sptr dst;
+
+    latency_graph(double rate, uint64_t nitems)
+      : src(new paced_ramp(rate, nitems)),
+        a(new chunk_meter(nitems / 2)), b(new chunk_meter(nitems / 2)),
+        dst(new collect_sink)
+    {
+      gr::top_block_sptr tb = gr::make_top_block("qa_top_block");
+      tb->connect(src, 0, a, 0);
+      tb->connect(a, 0, b, 0);
+      tb->connect(b, 0, dst, 0);
+      tb->run();
+    }
+  };
+
+  // Run a_src -> a_dst and b_src -> b_dst, then move b_src over to
+  // c_dst while running.
+  struct reconfigure_graph
+  {
+    counting_block_sptr a_src, a_dst, b_src, b_dst, c_dst;
+
+    reconfigure_graph(bool incremental)
+    {
+      pref_guard guard("Scheduler", "incremental", incremental ? "True" : "False");
+
+      a_src = make_counting_block(true);
+      a_dst = make_counting_block(false);
+      b_src = make_counting_block(true);
+      b_dst = make_counting_block(false);
+      c_dst = make_counting_block(false);
+
+      gr::top_block_sptr tb = gr::make_top_block("qa_top_block");
+      tb->connect(a_src, 0, a_dst, 0);
+      tb->connect(b_src, 0, b_dst, 0);
+      tb->start();
+      CPPUNIT_ASSERT(wait_for_items(a_dst, 0));
+      CPPUNIT_ASSERT(wait_for_items(b_dst, 0));
+      CPPUNIT_ASSERT_EQUAL(0.0, tb->reconfigure_time());
+
+      tb->lock();
+      tb->disconnect(b_src, 0, b_dst, 0);
+      tb->connect(b_src, 0, c_dst, 0);
+      tb->unlock();
+
+      CPPUNIT_ASSERT(tb->reconfigure_time() > 0);
+      CPPUNIT_ASSERT(wait_for_items(a_dst, a_dst->d_nitems));
+      CPPUNIT_ASSERT(wait_for_items(c_dst, 0));
+
+      tb->stop();
+      tb->wait();
+    }
+  };
+
+}
+
+// Incremental: only the blocks on the rewired edge restart.
+void
+qa_top_block::t1()
+{
+  reconfigure_graph g(true);
+
+  CPPUNIT_ASSERT_EQUAL(1, (int)g.a_src->d_nstarts);
+  CPPUNIT_ASSERT_EQUAL(1, (int)g.a_dst->d_nstarts);
+  CPPUNIT_ASSERT_EQUAL(2, (int)g.b_src->d_nstarts);
+  CPPUNIT_ASSERT_EQUAL(2, (int)g.b_src->d_nstops);
+  CPPUNIT_ASSERT_EQUAL(1, (int)g.b_dst->d_nstarts);
+  CPPUNIT_ASSERT_EQUAL(1, (int)g.b_dst->d_nstops);
+  CPPUNIT_ASSERT_EQUAL(1, (int)g.c_dst->d_nstarts);
+}
+
+// Otherwise: everything restarts.
+void
+qa_top_block::t2()
+{
+  reconfigure_graph g(false);
+
+  CPPUNIT_ASSERT_EQUAL(2, (int)g.a_src->d_nstarts);
+  CPPUNIT_ASSERT_EQUAL(2, (int)g.a_dst->d_nstarts);
+  CPPUNIT_ASSERT_EQUAL(2, (int)g.b_src->d_nstarts);
+  CPPUNIT_ASSERT_EQUAL(1, (int)g.b_dst->d_nstarts);
+  CPPUNIT_ASSERT_EQUAL(1, (int)g.c_dst->d_nstarts);
+}
+
+// A block waiting for input sleeps until it gets some, and stop()
+// wakes it up.
+void
+qa_top_block::t3()
+{
+  counting_block_sptr src = make_counting_block(true);
+  counting_block_sptr dst = make_counting_block(false);
+  src->d_paused = true;
+
+  gr::top_block_sptr tb = gr::make_top_block("qa_top_block");
+  tb->connect(src, 0, dst, 0);
+  tb->start();
+
+  // Nothing was delivered, so dst may not have woken up to anything.
+  boost::this_thread::sleep(boost::posix_time::milliseconds(100));
+  gr::tpb_detail &tpb = dst->detail()->d_tpb;
+  CPPUNIT_ASSERT_EQUAL(0L, (long)dst->d_nitems);
+  CPPUNIT_ASSERT_EQUAL((uint64_t)0, tpb.nwakeups());
+  CPPUNIT_ASSERT_EQUAL((uint64_t)0, tpb.nsignals());
+
+  // Input arrives: dst gets woken up for it.
+  src->d_paused = false;
+  CPPUNIT_ASSERT(wait_for_items(dst, 0));
+  CPPUNIT_ASSERT(tpb.nsignals() > 0);
+  CPPUNIT_ASSERT(tpb.nwakeups() > 0);
+
+  src->d_paused = true;
+  tb->stop();
+  tb->wait();
+}
+
+// With topology placement, every block's thread gets a CPU, before
+// and after the warm-up.
+void
+qa_top_block::t4()
+{
+  pref_guard placement("Scheduler", "placement", "topology");
+  pref_guard warmup("Scheduler", "placement_warmup", "0.1");
+
+  counting_block_sptr a_src = make_counting_block(true);
+  counting_block_sptr a_dst = make_counting_block(false);
+  counting_block_sptr b_src = make_counting_block(true);
+  counting_block_sptr b_dst = make_counting_block(false);
+
+  gr::top_block_sptr tb = gr::make_top_block("qa_top_block");
+  tb->connect(a_src, 0, a_dst, 0);
+  tb->connect(b_src, 0, b_dst, 0);
+  tb->start();
+
+  // Placement needs sysfs; without it no thread is bound.
+  bool placed = !gr::cpu_topology().cpus().empty();
+  for(int pass = 0; pass < 2; pass++) {
+    std::stringstream s(tb->thread_placement());
+    std::string line;
+    int nlines = 0;
+    while(std::getline(s, line)) {
+      CPPUNIT_ASSERT(line.find("counting_block") == 0);
+      CPPUNIT_ASSERT_EQUAL(placed, line.find(": -") == std::string::npos);
+      nlines++;
+    }
+    CPPUNIT_ASSERT_EQUAL(4, nlines);
+
+    CPPUNIT_ASSERT(wait_for_items(a_dst, 0));
+    boost::this_thread::sleep(boost::posix_time::milliseconds(200));
+  }
+
+  tb->stop();
+  tb->wait();
+}
+
+// The pool scheduler runs a stream and message graph to the end, and
+// stops a graph that would run forever.
+void
+qa_top_block::t5()
+{
+  pref_guard type("Scheduler", "type", "POOL");
+  pref_guard nthreads("Scheduler", "nthreads", "2");
+
+  const long N = 1000000;
+  boost::shared_ptr<finite_source> src(new finite_source(N));
+  boost::shared_ptr<counting_sink> dst(new counting_sink);
+  counting_block_sptr busy = make_counting_block(true);
+  counting_block_sptr busy_dst = make_counting_block(false);
+
+  gr::top_block_sptr tb = gr::make_top_block("qa_top_block");
+  tb->connect(src, 0, dst, 0);
+  tb->msg_connect(src, "count", dst, "count");
+  tb->run();
+  CPPUNIT_ASSERT_EQUAL(N, dst->d_nitems);
+  CPPUNIT_ASSERT_EQUAL(N, dst->d_msg_total);
+  CPPUNIT_ASSERT(dst->d_nmsgs > 0);
+
+  tb = gr::make_top_block("qa_top_block");
+  tb->connect(busy, 0, busy_dst, 0);
+  tb->start();
+  CPPUNIT_ASSERT(wait_for_items(busy_dst, 0));
+  tb->stop();
+  tb->wait();
+  CPPUNIT_ASSERT_EQUAL(1, (int)busy->d_nstarts);
+  CPPUNIT_ASSERT_EQUAL(1, (int)busy->d_nstops);
+  CPPUNIT_ASSERT_EQUAL(1, (int)busy_dst->d_nstops);
+}
+
+// The adaptive buffer policy sizes an edge from its latency target,
+// within [min_size, max_size] bytes.
+void
+qa_top_block::t6()
+{
+  pref_guard policy("Buffers", "policy", "adaptive");
+  pref_guard report("Buffers", "report", "True");
+  pref_guard min_size("Buffers", "min_size", "4096");
+  pref_guard max_size("Buffers", "max_size", "1048576");
+
+  // Granularity rounds the sizes up, so only check the bounds.
+  long latencies[] = { 100000, 10, 10000000 };
+  long lo[] = { 100000, 4096 / sizeof(float), 1048576 / sizeof(float) };
+  long hi[] = { 200000, 16384, 2 * 1048576 / sizeof(float) };
+  for(int i = 0; i < 3; i++) {
+    std::ostringstream latency;
+    latency << latencies[i];
+    pref_guard latency_items("Buffers", "latency_items", latency.str());
+
+    counting_block_sptr src = make_counting_block(true);
+    counting_block_sptr dst = make_counting_block(false);
+    gr::top_block_sptr tb = gr::make_top_block("qa_top_block");
+    tb->connect(src, 0, dst, 0);
+    tb->start();
+    long bufsize = src->detail()->output(0)->bufsize();
+    tb->stop();
+    tb->wait();
+
+    CPPUNIT_ASSERT(bufsize >= lo[i]);
+    CPPUNIT_ASSERT(bufsize < hi[i]);
+  }
+}
+
+// Blocks writing in place keep their data intact while the graph
+// around them is rewired. A tap on a's output means b has to stop
+// writing over a's buffer (and so src's) while src keeps running.
+void
+qa_top_block::t7()
+{
+  pref_guard in_place("Buffers", "in_place", "True");
+  pref_guard incremental("Scheduler", "incremental", "True");
+
+  const int A = 1 << 28, B = 1 << 29;
+  boost::shared_ptr<ramp_source> src(new ramp_source);
+  boost::shared_ptr<set_bit> a(new set_bit(A));
+  boost::shared_ptr<set_bit> b(new set_bit(B));
+  ramp_sink_sptr b_dst1(new ramp_sink(A | B));
+  ramp_sink_sptr b_dst2(new ramp_sink(A | B));
+  ramp_sink_sptr a_dst(new ramp_sink(A));
+
+  gr::top_block_sptr tb = gr::make_top_block("qa_top_block");
+  tb->connect(src, 0, a, 0);
+  tb->connect(a, 0, b, 0);
+  tb->connect(b, 0, b_dst1, 0);
+  tb->connect(b, 0, b_dst2, 0);
+  tb->start();
+  CPPUNIT_ASSERT(wait_for_ramp(b_dst2, 0));
+  CPPUNIT_ASSERT(b->detail()->output(0)->in_place_of());
+
+  for(int i = 0; i < 5; i++) {
+    tb->lock();
+    tb->connect(a, 0, a_dst, 0);
+    tb->unlock();
+    CPPUNIT_ASSERT(!b->detail()->output(0)->in_place_of());
+    CPPUNIT_ASSERT(wait_for_ramp(a_dst, a_dst->d_nitems));
+    CPPUNIT_ASSERT(wait_for_ramp(b_dst1, b_dst1->d_nitems));
+
+    tb->lock();
+    tb->disconnect(a, 0, a_dst, 0);
+    tb->unlock();
+    CPPUNIT_ASSERT(wait_for_ramp(b_dst1, b_dst1->d_nitems));
+    CPPUNIT_ASSERT(wait_for_ramp(b_dst2, b_dst2->d_nitems));
+  }
+
+  tb->stop();
+  tb->wait();
+
+  CPPUNIT_ASSERT_EQUAL(0L, (long)b_dst1->d_nerrors);
+  CPPUNIT_ASSERT_EQUAL(0L, (long)b_dst2->d_nerrors);
+  CPPUNIT_ASSERT_EQUAL(0L, (long)a_dst->d_nerrors);
+}
+
+// Fused chains produce what the blocks would on their own threads,
+// tags included, next to a decimator and with a block that doesn't
+// do all it's asked to. stop() ends a fused graph that would run
+// forever.
+void
+qa_top_block::t8()
+{
+  const long N = 100000;
+  fusion_graph fused(true, N);
+  fusion_graph unfused(false, N);
+
+  CPPUNIT_ASSERT(fused.a->d_thread == fused.b->d_thread);
+  CPPUNIT_ASSERT(fused.a->d_thread == fused.c->d_thread);
+  CPPUNIT_ASSERT(fused.d->d_thread == fused.e->d_thread);
+  CPPUNIT_ASSERT(fused.a->d_thread != fused.d->d_thread);
+  CPPUNIT_ASSERT(unfused.a->d_thread != unfused.b->d_thread);
+
+  CPPUNIT_ASSERT_EQUAL((size_t)N / 2, unfused.dst->d_data.size());
+  CPPUNIT_ASSERT(fused.dst->d_data == unfused.dst->d_data);
+
+  std::vector<gr::tag_t> &ftags = fused.dst->d_tags;
+  std::vector<gr::tag_t> &utags = unfused.dst->d_tags;
+  CPPUNIT_ASSERT_EQUAL((size_t)N / 100, utags.size());
+  CPPUNIT_ASSERT_EQUAL(utags.size(), ftags.size());
+  std::sort(ftags.begin(), ftags.end(), gr::tag_t::offset_compare);
+  std::sort(utags.begin(), utags.end(), gr::tag_t::offset_compare);
+  for(size_t i = 0; i < utags.size(); i++) {
+    CPPUNIT_ASSERT_EQUAL(utags[i].offset, ftags[i].offset);
+    CPPUNIT_ASSERT(pmt::equal(utags[i].value, ftags[i].value));
+  }
+
+  fusion_graph stopped(true, -1);
+  CPPUNIT_ASSERT(stopped.dst->nitems_read(0) > 0);
+  CPPUNIT_ASSERT(stopped.a->d_thread == stopped.c->d_thread);
+}
+
+// With a latency target each block on the path gets an equal share
+// of it: at 1e6 items/s, 0.4 ms over the 4 blocks here is 100 items
+// a call once the rate is known (the peak rate can run high on a
+// busy machine, so allow for that). Without one, a call gets all
+// that's due, about 1000 items a millisecond. The data's the same.
+void
+qa_top_block::t9()
+{
+  const uint64_t N = 400000;
+  const double rate = 1e6;
+
+  latency_graph free_run(rate, N);
+  CPPUNIT_ASSERT(free_run.b->d_max_noutput_items >= 1000);
+
+  pref_guard latency("Scheduler", "latency", "0.0004");
+  latency_graph bounded(rate, N);
+
+  CPPUNIT_ASSERT_EQUAL(4, bounded.src->detail()->path_depth());
+  CPPUNIT_ASSERT_EQUAL(4, bounded.a->detail()->path_depth());
+  CPPUNIT_ASSERT_EQUAL(4, bounded.b->detail()->path_depth());
+  CPPUNIT_ASSERT_EQUAL(4, bounded.dst->detail()->path_depth());
+
+  CPPUNIT_ASSERT(bounded.a->d_max_noutput_items > 0);
+  CPPUNIT_ASSERT(bounded.a->d_max_noutput_items <= 500);
+  CPPUNIT_ASSERT(bounded.b->d_max_noutput_items > 0);
+  CPPUNIT_ASSERT(bounded.b->d_max_noutput_items <= 500);
+
+  CPPUNIT_ASSERT_EQUAL((size_t)N, bounded.dst->d_data.size());
+  CPPUNIT_ASSERT(bounded.dst->d_data == free_run.dst->d_data);
+  for(size_t i = 0; i < N; i++)
+    CPPUNIT_ASSERT_EQUAL((float)i, bounded.dst->d_data[i]);
+}
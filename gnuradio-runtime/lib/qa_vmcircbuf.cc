@@ -27,7 +27,11 @@
 #include <qa_vmcircbuf.h>
 #include <cppunit/TestAssert.h>
 #include "vmcircbuf.h"
+#include "vmcircbuf_mmap_arena.h"
+#include "vmcircbuf_mmap_hugetlb.h"
 #include <stdio.h>
+#include <string.h>
+#include <vector>
 
 void
 qa_vmcircbuf::test_all()
@@ -38,3 +42,94 @@ qa_vmcircbuf::test_all()
 
   CPPUNIT_ASSERT_EQUAL(true, ok);
 }
+
+/*
+ * Write through the first copy and read back through the second.
+ */
+static void
+check_wrap(gr::vmcircbuf *c, int size)
+{
+  unsigned int *p1 = (unsigned int *)c->pointer_to_first_copy();
+  unsigned int *p2 = (unsigned int *)c->pointer_to_second_copy();
+  int n = size / sizeof(unsigned int);
+
+  for(int i = 0; i < n; i++)
+    p1[i] = i;
+  for(int i = 0; i < n; i++)
+    CPPUNIT_ASSERT_EQUAL((unsigned int)i, p2[i]);
+}
+
+void
+qa_vmcircbuf::test_hugetlb()
+{
+  gr::vmcircbuf_factory *f = gr::vmcircbuf_mmap_hugetlb_factory::singleton();
+  CPPUNIT_ASSERT_EQUAL(2 * (1 << 20), f->granularity());
+
+  // Sizes that aren't a whole number of huge pages are refused
+  CPPUNIT_ASSERT(f->make(4096) == 0);
+
+  // Only works with huge pages reserved (/proc/sys/vm/nr_hugepages)
+  gr::vmcircbuf *c = f->make(f->granularity());
+  if(c == 0) {
+    fprintf(stderr, "qa_vmcircbuf: no huge pages available, skipping\n");
+    return;
+  }
+
+  check_wrap(c, f->granularity());
+  delete c;
+
+  CPPUNIT_ASSERT(gr::vmcircbuf_sysconfig::test_factory(f, 0));
+}
+
+void
+qa_vmcircbuf::test_numa()
+{
+  int node = gr::vmcircbuf_sysconfig::numa_node_of_cpu(0);
+  CPPUNIT_ASSERT(node >= -1);
+  CPPUNIT_ASSERT_EQUAL(-1, gr::vmcircbuf_sysconfig::numa_node_of_cpu(-1));
+
+  int size = gr::vmcircbuf_sysconfig::granularity();
+  gr::vmcircbuf *c = gr::vmcircbuf_sysconfig::make(size);
+  CPPUNIT_ASSERT(c != 0);
+
+  // The policy may not stick (no NUMA support, file backed memory),
+  // but the buffer has to keep working either way.
+  CPPUNIT_ASSERT_EQUAL(false, c->bind_to_numa_node(-1));
+  if(node >= 0)
+    c->bind_to_numa_node(node);
+
+  check_wrap(c, size);
+  delete c;
+}
+
+void
+qa_vmcircbuf::test_arena()
+{
+  gr::vmcircbuf_factory *f = gr::vmcircbuf_mmap_arena_factory::singleton();
+  int size = f->granularity();
+
+  // Many buffers share a backing file; each must wrap onto itself
+  // only.
+  std::vector<gr::vmcircbuf *> bufs;
+  for(int i = 0; i < 8; i++) {
+    bufs.push_back(f->make((i % 3 + 1) * size));
+    CPPUNIT_ASSERT(bufs.back() != 0);
+    memset(bufs.back()->pointer_to_first_copy(), i + 1, (i % 3 + 1) * size);
+  }
+  for(int i = 0; i < 8; i++) {
+    unsigned char *p2 = (unsigned char *)bufs[i]->pointer_to_second_copy();
+    for(int j = 0; j < (i % 3 + 1) * size; j++)
+      CPPUNIT_ASSERT_EQUAL(i + 1, (int)p2[j]);
+  }
+
+  // A freed range can be handed out again
+  delete bufs[0];
+  bufs[0] = f->make(size);
+  CPPUNIT_ASSERT(bufs[0] != 0);
+  check_wrap(bufs[0], size);
+
+  for(int i = 0; i < 8; i++)
+    delete bufs[i];
+
+  CPPUNIT_ASSERT(gr::vmcircbuf_sysconfig::test_factory(f, 0));
+}
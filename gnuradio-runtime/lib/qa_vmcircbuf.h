@@ -30,10 +30,16 @@ class qa_vmcircbuf : public CppUnit::TestCase
 {
   CPPUNIT_TEST_SUITE(qa_vmcircbuf);
   CPPUNIT_TEST(test_all);
+  CPPUNIT_TEST(test_hugetlb);
+  CPPUNIT_TEST(test_numa);
+  CPPUNIT_TEST(test_arena);
   CPPUNIT_TEST_SUITE_END();
 
 private:
   void test_all();
+  void test_hugetlb();
+  void test_numa();
+  void test_arena();
 };
 
 #endif /* QA_GR_VMCIRCBUF_H */
@@ -24,6 +24,7 @@
 #endif
 
 #include "scheduler.h"
+#include <stdexcept>
 
 namespace gr {
 
@@ -36,4 +37,11 @@ namespace gr {
   {
   }
 
+  size_t
+  scheduler::reconfigure(flat_flowgraph_sptr old_ffg,
+                         flat_flowgraph_sptr new_ffg)
+  {
+    throw std::runtime_error("scheduler: can't reconfigure a running flowgraph");
+  }
+
 } /* namespace gr */
@@ -26,6 +26,7 @@
 #include <boost/utility.hpp>
 #include <gnuradio/block.h>
 #include "flat_flowgraph.h"
+#include <string>
 
 namespace gr {
 
@@ -61,6 +62,30 @@ namespace gr {
      * \brief Block until the graph is done.
      */
     virtual void wait() = 0;
+
+    /*!
+     * \brief True if reconfigure() can be used while the graph runs.
+     */
+    virtual bool reconfigurable() const { return false; }
+
+    /*!
+     * \brief Switch from running \p old_ffg to \p new_ffg, its
+     * reconfigured successor, without stopping the blocks whose
+     * connections didn't change.
+     *
+     * Merges \p new_ffg's connections with \p old_ffg's (see
+     * flat_flowgraph::merge_connections) once the blocks it has to
+     * rewire are stopped. Returns the number of blocks restarted.
+     */
+    virtual size_t reconfigure(flat_flowgraph_sptr old_ffg,
+                               flat_flowgraph_sptr new_ffg);
+
+    /*!
+     * \brief The CPU each block's thread was placed on, one "alias:
+     * cpu" line per block ("-" if not placed); empty if this
+     * scheduler doesn't place threads.
+     */
+    virtual std::string thread_placement() { return ""; }
   };
 
 } /* namespace gr */
@@ -0,0 +1,345 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2016 Free Software Foundation, Inc.
+ *
+ * This file is part of GNU Radio
+ *
+ * GNU Radio is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * GNU Radio is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GNU Radio; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include "scheduler_pool.h"
+#include <gnuradio/block_detail.h>
+#include <gnuradio/prefs.h>
+#include <gnuradio/thread/thread_body_wrapper.h>
+#include <boost/bind.hpp>
+#include <boost/foreach.hpp>
+#include <boost/function.hpp>
+#include <algorithm>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+
+namespace gr {
+
+  scheduler_sptr
+  scheduler_pool::make(flat_flowgraph_sptr ffg, int max_noutput_items)
+  {
+    return scheduler_sptr(new scheduler_pool(ffg, max_noutput_items));
+  }
+
+  scheduler_pool::scheduler_pool(flat_flowgraph_sptr ffg,
+                                 int max_noutput_items)
+    : scheduler(ffg, max_noutput_items),
+      d_nqueued(0), d_nidle(0), d_ndone(0), d_stop(false),
+      d_unhooked(false)
+  {
+    prefs *p = prefs::singleton();
+
+    basic_block_vector_t used_blocks = ffg->calc_used_blocks();
+    used_blocks = ffg->topological_sort(used_blocks);
+    block_vector_t blocks = flat_flowgraph::make_block_vector(used_blocks);
+
+    long nthreads = p->get_long("Scheduler", "nthreads", 0);
+    if(nthreads <= 0)
+      nthreads = boost::thread::hardware_concurrency();
+    nthreads = std::max(1L, std::min(nthreads, (long)blocks.size()));
+
+    for(long i = 0; i < nthreads; i++)
+      d_workers.push_back(new worker);
+
+    // Build all the executors (and so start() all the blocks) up
+    // front, then queue every block once, spread over the workers.
+    for(size_t i = 0; i < blocks.size(); i++) {
+      int block_max_noutput_items;
+      if(blocks[i]->is_set_max_noutput_items())
+        block_max_noutput_items = blocks[i]->max_noutput_items();
+      else
+        block_max_noutput_items = max_noutput_items;
+
+      blocks[i]->detail()->set_done(false);
+      blocks[i]->clear_finished();
+
+      task *t = new task;
+      t->index = i;
+      t->block = blocks[i];
+      t->exec.reset(new block_executor(blocks[i], block_max_noutput_items));
+      t->state = QUEUED;
+      d_tasks.push_back(t);
+
+      blocks[i]->detail()->d_tpb.set_notify_hook(
+        boost::bind(&scheduler_pool::notify, this, t));
+
+      d_workers[i % d_workers.size()]->queue.push_back(t);
+      d_nqueued++;
+    }
+
+    // Nothing to run
+    if(d_tasks.empty())
+      d_stop = true;
+
+    for(size_t i = 0; i < d_workers.size(); i++) {
+      std::stringstream name;
+      name << "scheduler-pool[" << i << "]";
+
+      d_threads.create_thread(
+        gr::thread::thread_body_wrapper<boost::function<void()> >
+        (boost::bind(&scheduler_pool::run_worker, this, i), name.str()));
+    }
+  }
+
+  scheduler_pool::~scheduler_pool()
+  {
+    stop();
+    wait();
+
+    for(size_t i = 0; i < d_tasks.size(); i++)
+      delete d_tasks[i];
+    for(size_t i = 0; i < d_workers.size(); i++)
+      delete d_workers[i];
+  }
+
+  void
+  scheduler_pool::stop()
+  {
+    d_stop = true;
+    {
+      gr::thread::scoped_lock guard(d_idle_mutex);
+      d_idle_cond.notify_all();
+    }
+    d_threads.interrupt_all();
+  }
+
+  void
+  scheduler_pool::wait()
+  {
+    d_threads.join_all();
+
+    // No workers left; unhook the blocks and stop any that didn't
+    // finish on their own. Only do this once: by the time we're
+    // destroyed the blocks may belong to the next scheduler.
+    if(d_unhooked)
+      return;
+    d_unhooked = true;
+
+    for(size_t i = 0; i < d_tasks.size(); i++) {
+      d_tasks[i]->block->detail()->d_tpb.set_notify_hook(boost::function<void()>());
+      d_tasks[i]->exec.reset();
+    }
+  }
+
+  /*
+   * Called from the block's tpb_detail (with its mutex held) by
+   * whoever changed its input or output or sent it a message.
+   */
+  void
+  scheduler_pool::notify(task *t)
+  {
+    for(;;) {
+      int s = t->state.load();
+      if(s == IDLE) {
+        if(t->state.compare_exchange_weak(s, QUEUED)) {
+          push(t);
+          return;
+        }
+      }
+      else if(s == RUNNING) {
+        if(t->state.compare_exchange_weak(s, RUNNING_AGAIN))
+          return;
+      }
+      else
+        return;  // already queued, flagged to run again, or done
+    }
+  }
+
+  void
+  scheduler_pool::push(task *t, bool requeue)
+  {
+    // Workers push onto their own deque; anybody else (e.g., a
+    // thread posting a message) picks one by the block's position.
+    size_t *index = d_worker_index.get();
+    worker *w;
+    if(index)
+      w = d_workers[*index];
+    else
+      w = d_workers[t->index % d_workers.size()];
+
+    // A task that just ran goes behind everything else, so a block
+    // that always has work can't starve the rest of the deque.
+    {
+      gr::thread::scoped_lock guard(w->mutex);
+      if(requeue)
+        w->queue.push_front(t);
+      else
+        w->queue.push_back(t);
+    }
+    d_nqueued++;
+
+    if(d_nidle > 0) {
+      gr::thread::scoped_lock guard(d_idle_mutex);
+      d_idle_cond.notify_one();
+    }
+  }
+
+  scheduler_pool::task *
+  scheduler_pool::pop(size_t index)
+  {
+    // Newest from our own deque: it's most likely still in cache.
+    {
+      worker *w = d_workers[index];
+      gr::thread::scoped_lock guard(w->mutex);
+      if(!w->queue.empty()) {
+        task *t = w->queue.back();
+        w->queue.pop_back();
+        d_nqueued--;
+        return t;
+      }
+    }
+
+    // Oldest from someone else's.
+    for(size_t i = 1; i < d_workers.size(); i++) {
+      worker *w = d_workers[(index + i) % d_workers.size()];
+      gr::thread::scoped_lock guard(w->mutex);
+      if(!w->queue.empty()) {
+        task *t = w->queue.front();
+        w->queue.pop_front();
+        d_nqueued--;
+        return t;
+      }
+    }
+
+    return 0;
+  }
+
+  void
+  scheduler_pool::run_worker(size_t index)
+  {
+    d_worker_index.reset(new size_t(index));
+
+    while(!d_stop) {
+      boost::this_thread::interruption_point();
+
+      task *t = pop(index);
+      if(t) {
+        run_task(t);
+        continue;
+      }
+
+      gr::thread::scoped_lock guard(d_idle_mutex);
+      d_nidle++;
+      while(!d_stop && d_nqueued == 0)
+        d_idle_cond.wait(guard);
+      d_nidle--;
+    }
+  }
+
+  void
+  scheduler_pool::handle_messages(task *t)
+  {
+    block_sptr block = t->block;
+
+    // Messages for ports without a handler stay queued; the queue
+    // drops the oldest once it's full.
+    BOOST_FOREACH(basic_block::msg_queue_map_t::value_type &i, block->msg_queue) {
+      if(block->has_msg_handler(i.first)) {
+        while(block->delete_head_batch(i.first, t->msgs)) {
+          BOOST_FOREACH(pmt::pmt_t &msg, t->msgs)
+            block->dispatch_msg(i.first, msg);
+        }
+      }
+    }
+  }
+
+  void
+  scheduler_pool::run_task(task *t)
+  {
+    block_detail *d = t->block->detail().get();
+    block_executor::state s;
+
+    t->state = RUNNING;
+
+    try {
+      handle_messages(t);
+
+      // run one iteration if we are a connected stream block
+      if(d->noutputs() > 0 || d->ninputs() > 0)
+        s = t->exec->run_one_iteration();
+      else
+        s = block_executor::BLKD_IN;
+    }
+    catch(std::exception const &e) {
+      std::cerr << "scheduler_pool: " << t->block << ": " << e.what() << std::endl;
+      d->set_done(true);
+      s = block_executor::DONE;
+    }
+
+    // if msg ports think we are done, we are done
+    if(t->block->finished())
+      s = block_executor::DONE;
+
+    switch(s) {
+    case block_executor::READY:			// Tell neighbors we made progress.
+      d->d_tpb.notify_neighbors(d);
+      break;
+
+    case block_executor::READY_NO_OUTPUT:	// Notify upstream only
+      d->d_tpb.notify_upstream(d);
+      break;
+
+    case block_executor::DONE:
+      finish_task(t);
+      return;
+
+    case block_executor::BLKD_IN:
+    case block_executor::BLKD_OUT:
+    {
+      // Park it until a neighbor or a message wakes it up, unless
+      // that already happened while it was running.
+      int running = RUNNING;
+      if(t->state.compare_exchange_strong(running, IDLE))
+        return;
+    }
+    break;
+
+    default:
+      throw std::runtime_error("possible memory corruption in scheduler");
+    }
+
+    t->state = QUEUED;
+    push(t, true);
+  }
+
+  void
+  scheduler_pool::finish_task(task *t)
+  {
+    block_detail *d = t->block->detail().get();
+
+    t->state = DONE;
+    t->block->notify_msg_neighbors();
+    d->d_tpb.notify_neighbors(d);
+    t->exec.reset();
+
+    if(++d_ndone == (int)d_tasks.size()) {
+      d_stop = true;
+      gr::thread::scoped_lock guard(d_idle_mutex);
+      d_idle_cond.notify_all();
+    }
+  }
+
+} /* namespace gr */
@@ -0,0 +1,127 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2016 Free Software Foundation, Inc.
+ *
+ * This file is part of GNU Radio
+ *
+ * GNU Radio is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * GNU Radio is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GNU Radio; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef INCLUDED_GR_SCHEDULER_POOL_H
+#define INCLUDED_GR_SCHEDULER_POOL_H
+
+#include <gnuradio/api.h>
+#include <gnuradio/thread/thread_group.h>
+#include "scheduler.h"
+#include "block_executor.h"
+#include <boost/atomic.hpp>
+#include <boost/thread/tss.hpp>
+#include <deque>
+
+namespace gr {
+
+  /*!
+   * \brief Concrete scheduler that runs all blocks on a fixed pool
+   * of worker threads.
+   *
+   * Each block is a task that runs block_executor::run_one_iteration().
+   * A task is queued when it made progress last time it ran, or when
+   * a neighbor signals it through the block's tpb_detail (input or
+   * output changed, message arrived); blocked tasks are not queued.
+   * Every worker has its own deque: it pushes newly woken tasks at
+   * the back and pops there, puts the tasks it requeues itself at
+   * the front, and when it runs dry steals from the front of the
+   * others.
+   *
+   * Blocks that sleep or block inside work() hold on to a worker for
+   * that time, so the pool should be larger than the number of such
+   * blocks. Per-block processor affinity and thread priority are not
+   * applied.
+   */
+  class GR_RUNTIME_API scheduler_pool : public scheduler
+  {
+  public:
+    static scheduler_sptr make(flat_flowgraph_sptr ffg,
+                               int max_noutput_items=100000);
+
+    ~scheduler_pool();
+
+    /*!
+     * \brief Tell the scheduler to stop executing.
+     */
+    void stop();
+
+    /*!
+     * \brief Block until the graph is done.
+     */
+    void wait();
+
+  protected:
+    /*!
+     * \brief Construct a scheduler and begin evaluating the graph.
+     *
+     * The number of workers comes from the [Scheduler] nthreads
+     * pref; 0 (the default) uses one per hardware thread.
+     */
+    scheduler_pool(flat_flowgraph_sptr ffg, int max_noutput_items);
+
+  private:
+    enum task_state {
+      IDLE,		// waiting for a notification
+      QUEUED,		// in some worker's deque
+      RUNNING,		// a worker is running it
+      RUNNING_AGAIN,	// notified while running; requeue when done
+      DONE
+    };
+
+    struct task {
+      size_t                            index;	// position in d_tasks
+      block_sptr                        block;
+      boost::shared_ptr<block_executor> exec;
+      boost::atomic<int>                state;
+      std::vector<pmt::pmt_t>           msgs;	// batch being dispatched
+    };
+
+    struct worker {
+      gr::thread::mutex  mutex;		// protects queue
+      std::deque<task*>  queue;
+    };
+
+    std::vector<task*>                  d_tasks;
+    std::vector<worker*>                d_workers;
+    gr::thread::thread_group            d_threads;
+    boost::thread_specific_ptr<size_t>  d_worker_index;
+
+    boost::atomic<int>                  d_nqueued;	// tasks in all deques
+    boost::atomic<int>                  d_nidle;	// workers asleep
+    boost::atomic<int>                  d_ndone;	// tasks DONE
+    boost::atomic<bool>                 d_stop;
+    gr::thread::mutex                   d_idle_mutex;
+    gr::thread::condition_variable      d_idle_cond;
+    bool                                d_unhooked;
+
+    void notify(task *t);
+    void push(task *t, bool requeue=false);
+    task *pop(size_t index);
+    void run_worker(size_t index);
+    void run_task(task *t);
+    void handle_messages(task *t);
+    void finish_task(task *t);
+  };
+
+} /* namespace gr */
+
+#endif /* INCLUDED_GR_SCHEDULER_POOL_H */
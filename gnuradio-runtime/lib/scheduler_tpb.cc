@@ -25,7 +25,16 @@
 
 #include "scheduler_tpb.h"
 #include "tpb_thread_body.h"
+#include "tpb_fused_thread_body.h"
+#include <gnuradio/block_detail.h>
+#include <gnuradio/buffer.h>
+#include <gnuradio/prefs.h>
 #include <gnuradio/thread/thread_body_wrapper.h>
+#include <boost/bind.hpp>
+#include <algorithm>
+#include <iostream>
+#include <map>
+#include <set>
 #include <sstream>
 
 namespace gr {
@@ -45,6 +54,25 @@ namespace gr {
     }
   };
 
+  class tpb_fused_container
+  {
+    block_vector_t d_blocks;
+    std::vector<int> d_max_noutput_items;
+    int d_chunk_bytes;
+
+  public:
+    tpb_fused_container(const block_vector_t &blocks,
+                        const std::vector<int> &max_noutput_items,
+                        int chunk_bytes)
+      : d_blocks(blocks), d_max_noutput_items(max_noutput_items),
+        d_chunk_bytes(chunk_bytes) {}
+
+    void operator()()
+    {
+      tpb_fused_thread_body body(d_blocks, d_max_noutput_items, d_chunk_bytes);
+    }
+  };
+
   scheduler_sptr
   scheduler_tpb::make(flat_flowgraph_sptr ffg, int max_noutput_items)
   {
@@ -53,10 +81,10 @@ namespace gr {
 
   scheduler_tpb::scheduler_tpb(flat_flowgraph_sptr ffg,
                                int max_noutput_items)
-    : scheduler(ffg, max_noutput_items)
+    : scheduler(ffg, max_noutput_items),
+      d_stopped(false), d_reconfiguring(false),
+      d_max_noutput_items(max_noutput_items), d_placer(0), d_sample_time(0)
   {
-    int block_max_noutput_items;
-
     // Get a topologically sorted vector of all the blocks in use.
     // Being topologically sorted probably isn't going to matter, but
     // there's a non-zero chance it might help...
@@ -65,15 +93,98 @@ namespace gr {
     used_blocks = ffg->topological_sort(used_blocks);
     block_vector_t blocks = flat_flowgraph::make_block_vector(used_blocks);
 
+    prefs *p = prefs::singleton();
+    if(p->get_string("Scheduler", "placement", "none") == "topology") {
+      d_topology.reset(new cpu_topology());
+      std::vector<int> allowed = cpu_topology::allowed_cpus();
+      if(!allowed.empty())
+        d_topology->restrict_to(allowed);
+    }
+
+    gr::thread::scoped_lock guard(d_mutex);
+    start_units(ffg, blocks);
+    place_units(false);
+    sample_items();
+
+    double warmup = p->get_double("Scheduler", "placement_warmup", 2.0);
+    if(d_topology && warmup > 0)
+      d_placer = new boost::thread(boost::bind(&scheduler_tpb::run_placer, this, warmup));
+  }
+
+  scheduler_tpb::~scheduler_tpb()
+  {
+    stop();
+    wait();
+
+    if(d_placer) {
+      d_placer->join();
+      delete d_placer;
+    }
+
+    for(std::list<thread_unit*>::iterator u = d_units.begin(); u != d_units.end(); u++) {
+      delete (*u)->thread;
+      delete *u;
+    }
+  }
+
+  /*
+   * Start a thread for each of blocks, which must be topologically
+   * sorted, or for each chain of them. Called with d_mutex held.
+   */
+  void
+  scheduler_tpb::start_units(flat_flowgraph_sptr ffg, block_vector_t &blocks)
+  {
+    int block_max_noutput_items;
+
     // Ensure that the done flag is clear on all blocks
 
     for(size_t i = 0; i < blocks.size(); i++) {
       blocks[i]->detail()->set_done(false);
     }
 
-    // Fire off a thead for each block
+    // Runs of 1:1 blocks share a thread, if enabled. This is
+    // worked out afresh each time the flowgraph is (re)started.
+
+    prefs *p = prefs::singleton();
+    std::vector<block_vector_t> chains;
+    if(p->get_bool("Scheduler", "fusion", false))
+      chains = ffg->calc_fusable_chains(blocks);
+    int chunk_bytes = p->get_long("Scheduler", "fusion_chunk", 16384);
+
+    std::set<block_sptr> fused;
+    for(size_t i = 0; i < chains.size(); i++) {
+      std::stringstream name;
+      name << "thread-per-block-fused[" << i << "]:";
+
+      std::vector<int> chain_max_noutput_items;
+      for(size_t j = 0; j < chains[i].size(); j++) {
+        block_sptr block = chains[i][j];
+        name << " " << block;
+        fused.insert(block);
+        if(block->is_set_max_noutput_items())
+          chain_max_noutput_items.push_back(block->max_noutput_items());
+        else
+          chain_max_noutput_items.push_back(d_max_noutput_items);
+      }
+
+      thread_unit *unit = new thread_unit;
+      unit->blocks = chains[i];
+      unit->running = true;
+      unit->cpu = -1;
+      unit->thread = new boost::thread(
+            boost::bind(&scheduler_tpb::run_unit, this, unit,
+                        gr::thread::thread_body_wrapper<tpb_fused_container>
+                        (tpb_fused_container(chains[i], chain_max_noutput_items, chunk_bytes),
+                         name.str())));
+      d_units.push_back(unit);
+    }
+
+    // Fire off a thead for each remaining block
 
     for(size_t i = 0; i < blocks.size(); i++) {
+      if(fused.count(blocks[i]))
+        continue;
+
       std::stringstream name;
       name << "thread-per-block[" << i << "]: " << blocks[i];
 
@@ -82,31 +193,290 @@ namespace gr {
         block_max_noutput_items = blocks[i]->max_noutput_items();
       }
       else {
-        block_max_noutput_items = max_noutput_items;
+        block_max_noutput_items = d_max_noutput_items;
       }
 
-      d_threads.create_thread(
-	    gr::thread::thread_body_wrapper<tpb_container>
-            (tpb_container(blocks[i], block_max_noutput_items),
-             name.str()));
+      thread_unit *unit = new thread_unit;
+      unit->blocks.push_back(blocks[i]);
+      unit->running = true;
+      unit->cpu = -1;
+      unit->thread = new boost::thread(
+            boost::bind(&scheduler_tpb::run_unit, this, unit,
+                        gr::thread::thread_body_wrapper<tpb_container>
+                        (tpb_container(blocks[i], block_max_noutput_items),
+                         name.str())));
+      d_units.push_back(unit);
     }
   }
 
-  scheduler_tpb::~scheduler_tpb()
+  void
+  scheduler_tpb::run_unit(thread_unit *unit, boost::function<void()> body)
   {
-    stop();
+    // Hold off until start_units() (which holds d_mutex) has spawned
+    // every thread; with thousands of blocks the ones already
+    // running would otherwise hold up starting the rest.
+    {
+      gr::thread::scoped_lock guard(d_mutex);
+    }
+
+    body();
+
+    gr::thread::scoped_lock guard(d_mutex);
+    unit->running = false;
+    d_cond.notify_all();
+  }
+
+  /*
+   * Bind the running threads to the CPUs place_threads() picks,
+   * weighting each connection by the bytes/sec it carried since the
+   * last sample_items() if \p measured, else by its item size.
+   * Called with d_mutex held.
+   */
+  void
+  scheduler_tpb::place_units(bool measured)
+  {
+    if(!d_topology)
+      return;
+
+    std::vector<thread_unit*> units;
+    std::map<block_sptr, size_t> unit_of;
+    for(std::list<thread_unit*>::iterator u = d_units.begin(); u != d_units.end(); u++) {
+      if(!(*u)->running)
+        continue;
+
+      bool pinned = false;
+      for(size_t i = 0; i < (*u)->blocks.size(); i++)
+        pinned |= !(*u)->blocks[i]->processor_affinity().empty();
+      if(pinned) {
+        (*u)->cpu = -1;
+        continue;
+      }
+
+      for(size_t i = 0; i < (*u)->blocks.size(); i++)
+        unit_of[(*u)->blocks[i]] = units.size();
+      units.push_back(*u);
+    }
+
+    double interval = 1;
+    if(measured) {
+      gr::high_res_timer_type now = gr::high_res_timer_now();
+      interval = std::max((double)(now - d_sample_time), 1.0) / gr::high_res_timer_tps();
+    }
+
+    std::vector<placement_edge> edges;
+    for(size_t i = 0; i < units.size(); i++) {
+      for(size_t j = 0; j < units[i]->blocks.size(); j++) {
+        block_detail_sptr d = units[i]->blocks[j]->detail();
+        for(int o = 0; o < d->noutputs(); o++) {
+          buffer_sptr buf = d->output(o);
+          double weight = buf->get_sizeof_item();
+          if(measured) {
+            // Buffers made (or reset) since the sample started out
+            // empty.
+            uint64_t n = buf->nitems_written();
+            std::map<buffer_sptr, uint64_t>::iterator s = d_sampled_items.find(buf);
+            if(s != d_sampled_items.end() && s->second <= n)
+              n -= s->second;
+            weight *= n / interval;
+          }
+
+          for(size_t r = 0; r < buf->nreaders(); r++) {
+            std::map<block_sptr, size_t>::iterator dst = unit_of.find(buf->reader(r)->link());
+            if(dst != unit_of.end()) {
+              placement_edge e = { i, dst->second, weight };
+              edges.push_back(e);
+            }
+          }
+        }
+      }
+    }
+
+    std::vector<int> cpus = place_threads(units.size(), edges, *d_topology);
+    for(size_t i = 0; i < units.size(); i++) {
+      if(cpus[i] < 0 || cpus[i] == units[i]->cpu)
+        continue;
+      try {
+        gr::thread::thread_bind_to_processor(units[i]->thread->native_handle(),
+                                             std::vector<int>(1, cpus[i]));
+        units[i]->cpu = cpus[i];
+      }
+      catch(std::runtime_error &e) {
+        std::cerr << "scheduler_tpb: " << e.what() << std::endl;
+      }
+    }
+  }
+
+  /*
+   * Remember how many items each running unit's outputs have
+   * written, so place_units() can weigh just what comes after.
+   * Called with d_mutex held.
+   */
+  void
+  scheduler_tpb::sample_items()
+  {
+    if(!d_topology)
+      return;
+
+    d_sampled_items.clear();
+    for(std::list<thread_unit*>::iterator u = d_units.begin(); u != d_units.end(); u++) {
+      if(!(*u)->running)
+        continue;
+      for(size_t i = 0; i < (*u)->blocks.size(); i++) {
+        block_detail_sptr d = (*u)->blocks[i]->detail();
+        for(int o = 0; o < d->noutputs(); o++)
+          d_sampled_items[d->output(o)] = d->output(o)->nitems_written();
+      }
+    }
+    d_sample_time = gr::high_res_timer_now();
+  }
+
+  void
+  scheduler_tpb::run_placer(double warmup)
+  {
+    try {
+      boost::this_thread::sleep(boost::posix_time::microseconds((long)(warmup * 1e6)));
+    }
+    catch(boost::thread_interrupted &) {
+      return;
+    }
+
+    gr::thread::scoped_lock guard(d_mutex);
+    if(!d_stopped) {
+      place_units(true);
+      sample_items();
+    }
+  }
+
+  std::string
+  scheduler_tpb::thread_placement()
+  {
+    gr::thread::scoped_lock guard(d_mutex);
+    std::stringstream s;
+    for(std::list<thread_unit*>::iterator u = d_units.begin(); u != d_units.end(); u++) {
+      for(size_t i = 0; i < (*u)->blocks.size(); i++) {
+        s << (*u)->blocks[i]->alias() << ": ";
+        if((*u)->cpu >= 0)
+          s << (*u)->cpu;
+        else
+          s << "-";
+        s << std::endl;
+      }
+    }
+    return s.str();
+  }
+
+  /*
+   * Block threads sleep on their tpb_detail, which an interruption
+   * alone doesn't end.
+   */
+  void
+  scheduler_tpb::interrupt_unit(thread_unit *unit)
+  {
+    unit->thread->interrupt();
+    for(size_t i = 0; i < unit->blocks.size(); i++)
+      unit->blocks[i]->detail()->d_tpb.wake();
   }
 
   void
   scheduler_tpb::stop()
   {
-    d_threads.interrupt_all();
+    gr::thread::scoped_lock guard(d_mutex);
+    d_stopped = true;
+    for(std::list<thread_unit*>::iterator u = d_units.begin(); u != d_units.end(); u++)
+      interrupt_unit(*u);
+    if(d_placer)
+      d_placer->interrupt();
   }
 
   void
   scheduler_tpb::wait()
   {
-    d_threads.join_all();
+    // Threads come and go while reconfiguring, so wait on the flags
+    // rather than joining the threads as we find them.
+    gr::thread::scoped_lock guard(d_mutex);
+    for(;;) {
+      bool running = d_reconfiguring;
+      for(std::list<thread_unit*>::iterator u = d_units.begin(); u != d_units.end(); u++)
+        running |= (*u)->running;
+      if(!running)
+        break;
+      d_cond.wait(guard);
+    }
+
+    for(std::list<thread_unit*>::iterator u = d_units.begin(); u != d_units.end(); u++) {
+      if((*u)->thread->joinable())
+        (*u)->thread->join();
+    }
+  }
+
+  size_t
+  scheduler_tpb::reconfigure(flat_flowgraph_sptr old_ffg,
+                             flat_flowgraph_sptr new_ffg)
+  {
+    basic_block_vector_t changed = new_ffg->calc_changed_blocks(old_ffg);
+    std::set<basic_block_sptr> restart(changed.begin(), changed.end());
+
+    // Take the threads running a changed block out of service, along
+    // with those that already finished: the blocks they ran get a
+    // fresh start, as they would if the whole graph were restarted.
+    std::vector<thread_unit*> paused;
+    {
+      gr::thread::scoped_lock guard(d_mutex);
+      d_reconfiguring = true;
+      std::list<thread_unit*>::iterator u = d_units.begin();
+      while(u != d_units.end()) {
+        bool hit = !(*u)->running;
+        for(size_t i = 0; i < (*u)->blocks.size() && !hit; i++)
+          hit = restart.count((*u)->blocks[i]) > 0;
+
+        if(hit) {
+          interrupt_unit(*u);
+          paused.push_back(*u);
+          u = d_units.erase(u);
+        }
+        else
+          u++;
+      }
+    }
+
+    // Everything on the other side of their buffers keeps running;
+    // it just sees them as blocked until they come back.
+    for(size_t i = 0; i < paused.size(); i++) {
+      paused[i]->thread->join();
+      restart.insert(paused[i]->blocks.begin(), paused[i]->blocks.end());
+      delete paused[i]->thread;
+      delete paused[i];
+    }
+
+    // Blocks removed from the graph stay stopped.
+    block_vector_t blocks;
+    try {
+      new_ffg->merge_connections(old_ffg);
+
+      basic_block_vector_t used_blocks = new_ffg->calc_used_blocks();
+      used_blocks = new_ffg->topological_sort(used_blocks);
+      for(basic_block_viter_t p = used_blocks.begin(); p != used_blocks.end(); p++) {
+        if(restart.count(*p))
+          blocks.push_back(cast_to_block_sptr(*p));
+      }
+    }
+    catch(...) {
+      gr::thread::scoped_lock guard(d_mutex);
+      d_reconfiguring = false;
+      d_cond.notify_all();
+      throw;
+    }
+
+    gr::thread::scoped_lock guard(d_mutex);
+    if(!d_stopped) {
+      start_units(new_ffg, blocks);
+      place_units(true);
+      sample_items();
+    }
+    d_reconfiguring = false;
+    d_cond.notify_all();
+
+    return blocks.size();
   }
 
 } /* namespace gr */
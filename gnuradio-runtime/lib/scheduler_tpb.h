@@ -23,17 +23,61 @@
 #define INCLUDED_GR_SCHEDULER_TPB_H
 
 #include <gnuradio/api.h>
-#include <gnuradio/thread/thread_group.h>
+#include <gnuradio/thread/thread.h>
+#include <gnuradio/high_res_timer.h>
 #include "scheduler.h"
+#include "thread_placement.h"
+#include <boost/function.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <list>
+#include <map>
 
 namespace gr {
 
   /*!
    * \brief Concrete scheduler that uses a kernel thread-per-block
+   *
+   * With [Scheduler] fusion on, each run of 1:1 blocks found by
+   * flat_flowgraph::calc_fusable_chains shares one thread (see
+   * tpb_fused_thread_body).
+   *
+   * reconfigure() stops only the threads running blocks whose
+   * connections change, and those that have already finished.
+   *
+   * With [Scheduler] placement = topology, each thread is bound to a
+   * CPU picked by place_threads() so that connected blocks share a
+   * core's or at least an L3 cache, first by the size of the items
+   * they exchange and, after placement_warmup seconds, by the
+   * bytes/sec each connection carried since the last placement.
+   * Blocks with their own processor affinity keep it.
    */
   class GR_RUNTIME_API scheduler_tpb : public scheduler
   {
-    gr::thread::thread_group d_threads;
+    // One thread and the blocks it runs: a single block or a chain.
+    struct thread_unit {
+      block_vector_t blocks;
+      boost::thread *thread;
+      bool           running;	// false once the thread body returns
+      int            cpu;	// where place_units() bound it, or -1
+    };
+
+    std::list<thread_unit*>        d_units;
+    gr::thread::mutex              d_mutex;	// protects d_units and the flags
+    gr::thread::condition_variable d_cond;	// a unit finished, or a reconfiguration
+    bool                           d_stopped;
+    bool                           d_reconfiguring;
+    int                            d_max_noutput_items;
+    boost::scoped_ptr<cpu_topology> d_topology;	// set if [Scheduler] placement = topology
+    boost::thread                 *d_placer;	// re-places once the rates are known
+    std::map<buffer_sptr, uint64_t> d_sampled_items;	// nitems_written at d_sample_time
+    gr::high_res_timer_type        d_sample_time;
+
+    void start_units(flat_flowgraph_sptr ffg, block_vector_t &blocks);
+    void run_unit(thread_unit *unit, boost::function<void()> body);
+    void place_units(bool measured);
+    void sample_items();
+    void run_placer(double warmup);
+    static void interrupt_unit(thread_unit *unit);
 
   protected:
     /*!
@@ -59,6 +103,13 @@ namespace gr {
      * \brief Block until the graph is done.
      */
     void wait();
+
+    bool reconfigurable() const { return true; }
+
+    size_t reconfigure(flat_flowgraph_sptr old_ffg,
+                       flat_flowgraph_sptr new_ffg);
+
+    std::string thread_placement();
   };
 
 } /* namespace gr */
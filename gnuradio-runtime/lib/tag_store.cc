@@ -0,0 +1,167 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2016 Free Software Foundation, Inc.
+ *
+ * This file is part of GNU Radio
+ *
+ * GNU Radio is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * GNU Radio is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GNU Radio; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <gnuradio/tag_store.h>
+#include <algorithm>
+
+namespace gr {
+
+  static const size_t s_initial_capacity = 16;
+
+  tag_store::tag_store()
+    : d_head(0), d_size(0), d_nwords(1), d_version(0)
+  {
+    d_tags.resize(s_initial_capacity);
+    d_deleted.resize(s_initial_capacity * d_nwords, 0);
+  }
+
+  /*
+   * Re-lay out the ring so it can hold at least ntags tags with
+   * nwords deletion words each. The oldest tag ends up at index 0.
+   */
+  void
+  tag_store::reserve(size_t ntags, unsigned int nwords)
+  {
+    size_t capacity = d_tags.size();
+    while(capacity < ntags)
+      capacity *= 2;
+
+    if(capacity == d_tags.size() && nwords == d_nwords)
+      return;
+
+    std::vector<tag_t> tags(capacity);
+    std::vector<uint64_t> deleted(capacity * nwords, 0);
+    for(size_t i = 0; i < d_size; i++) {
+      size_t s = slot(i);
+      tags[i] = d_tags[s];
+      for(unsigned int w = 0; w < std::min(nwords, d_nwords); w++)
+        deleted[i * nwords + w] = d_deleted[s * d_nwords + w];
+    }
+
+    d_tags.swap(tags);
+    d_deleted.swap(deleted);
+    d_head = 0;
+    d_nwords = nwords;
+  }
+
+  void
+  tag_store::add(const tag_t &tag)
+  {
+    if(d_size == d_tags.size())
+      reserve(d_size + 1, d_nwords);
+
+    // Find where it goes; almost always at the end.
+    size_t pos = d_size;
+    if(d_size > 0 && at(d_size - 1).offset > tag.offset)
+      pos = upper_bound(tag.offset);
+
+    // Open a hole at pos by shifting the newer tags up by one.
+    for(size_t i = d_size; i > pos; i--) {
+      size_t dst = slot(i), src = slot(i - 1);
+      d_tags[dst] = d_tags[src];
+      std::copy(&d_deleted[src * d_nwords], &d_deleted[src * d_nwords] + d_nwords,
+                &d_deleted[dst * d_nwords]);
+    }
+
+    size_t s = slot(pos);
+    d_tags[s].offset = tag.offset;
+    d_tags[s].key = tag.key;
+    d_tags[s].value = tag.value;
+    d_tags[s].srcid = tag.srcid;
+    d_tags[s].marked_deleted.clear();
+    std::fill(&d_deleted[s * d_nwords], &d_deleted[s * d_nwords] + d_nwords, 0);
+    d_size++;
+    d_version++;
+  }
+
+  size_t
+  tag_store::lower_bound(uint64_t offset) const
+  {
+    size_t lo = 0, hi = d_size;
+    while(lo < hi) {
+      size_t mid = lo + (hi - lo) / 2;
+      if(at(mid).offset < offset)
+        lo = mid + 1;
+      else
+        hi = mid;
+    }
+    return lo;
+  }
+
+  size_t
+  tag_store::upper_bound(uint64_t offset) const
+  {
+    size_t lo = 0, hi = d_size;
+    while(lo < hi) {
+      size_t mid = lo + (hi - lo) / 2;
+      if(at(mid).offset <= offset)
+        lo = mid + 1;
+      else
+        hi = mid;
+    }
+    return lo;
+  }
+
+  void
+  tag_store::mark_deleted(size_t i, unsigned int reader_slot)
+  {
+    if(reader_slot >= d_nwords * 64)
+      reserve(d_size, reader_slot / 64 + 1);
+    d_deleted[slot(i) * d_nwords + reader_slot / 64] |= (uint64_t)1 << (reader_slot % 64);
+    d_version++;
+  }
+
+  void
+  tag_store::clear_reader(unsigned int reader_slot)
+  {
+    if(reader_slot >= d_nwords * 64)
+      return;
+    uint64_t mask = ~((uint64_t)1 << (reader_slot % 64));
+    for(size_t i = 0; i < d_size; i++)
+      d_deleted[slot(i) * d_nwords + reader_slot / 64] &= mask;
+    d_version++;
+  }
+
+  size_t
+  tag_store::prune(uint64_t offset)
+  {
+    size_t n = 0;
+    while(d_size > 0 && d_tags[d_head].offset < offset) {
+      // Release the PMTs now rather than when the slot is reused.
+      d_tags[d_head].key.reset();
+      d_tags[d_head].value.reset();
+      d_tags[d_head].srcid.reset();
+      std::fill(&d_deleted[d_head * d_nwords], &d_deleted[d_head * d_nwords] + d_nwords, 0);
+      d_head = (d_head + 1) & (d_tags.size() - 1);
+      d_size--;
+      n++;
+    }
+    if(n > 0)
+      d_version++;
+    return n;
+  }
+
+} /* namespace gr */
@@ -26,6 +26,7 @@
 
 #include <boost/format.hpp>
 #include <gnuradio/tagged_stream_block.h>
+#include <gnuradio/block_detail.h>
 
 namespace gr {
 
@@ -36,6 +37,7 @@ namespace gr {
     : block(name, input_signature, output_signature),
       d_length_tag_key(pmt::string_to_symbol(length_tag_key)),
       d_n_input_items_reqd(input_signature->min_streams(), 0),
+      d_packet_vectors(false),
       d_length_tag_key_str(length_tag_key)
   {
   }
@@ -50,6 +52,11 @@ namespace gr {
       if (i < d_n_input_items_reqd.size() && d_n_input_items_reqd[i] != 0) {
         ninput_items_required[i] = d_n_input_items_reqd[i];
       }
+      else if (d_packet_vectors) {
+        // Ask for no more than one item, or the scheduler shrinks
+        // noutput_items to match and we only ever get one PDU.
+        ninput_items_required[i] = 1;
+      }
       else {
         // If there's no item, there's no tag--so there must at least be one!
         ninput_items_required[i] = std::max(1, (int)std::floor((double) noutput_items / relative_rate() + 0.5));
@@ -89,6 +96,54 @@ namespace gr {
     return;
   }
 
+  void
+  tagged_stream_block::update_packet_length_tags(const gr_vector_int &packet_noutput_items,
+                                                 int n_ports)
+  {
+    for(int i = 0; i < n_ports; i++) {
+      uint64_t offset = nitems_written(i);
+      for(unsigned k = 0; k < packet_noutput_items.size(); k++) {
+        if(packet_noutput_items[k] > 0) {
+          add_item_tag(i, offset,
+                       d_length_tag_key,
+                       pmt::from_long(packet_noutput_items[k]));
+        }
+        offset += packet_noutput_items[k];
+      }
+    }
+  }
+
+  int
+  tagged_stream_block::work_packets(int noutput_items,
+                                    const std::vector<gr_vector_int> &packet_lengths,
+                                    gr_vector_int &packet_noutput_items,
+                                    gr_vector_const_void_star &input_items,
+                                    gr_vector_void_star &output_items)
+  {
+    gr_vector_const_void_star in(input_items);
+    gr_vector_void_star out(output_items);
+    gr_vector_int ninput_items;
+    int n_total = 0;
+
+    for(unsigned k = 0; k < packet_lengths.size(); k++) {
+      ninput_items = packet_lengths[k];
+      int n_produced = work(noutput_items - n_total, ninput_items, in, out);
+      if(n_produced == WORK_DONE) {
+        return n_produced;
+      }
+      packet_noutput_items[k] = n_produced;
+      n_total += n_produced;
+
+      for(unsigned i = 0; i < in.size(); i++) {
+        in[i] = (const char *)in[i] + packet_lengths[k][i] * input_signature()->sizeof_stream_item(i);
+      }
+      for(unsigned i = 0; i < out.size(); i++) {
+        out[i] = (char *)out[i] + n_produced * output_signature()->sizeof_stream_item(i);
+      }
+    }
+    return n_total;
+  }
+
   bool
   tagged_stream_block::check_topology(int ninputs, int /* noutputs */)
   {
@@ -106,6 +161,9 @@ namespace gr {
     if(d_length_tag_key_str.empty()) {
       return work(noutput_items, ninput_items, input_items, output_items);
     }
+    if(d_packet_vectors && !input_items.empty()) {
+      return general_work_packets(noutput_items, ninput_items, input_items, output_items);
+    }
 
     // Read TSB tags, unless we...
     // ...don't have inputs or ...     ... we already set it in a previous run.
@@ -153,4 +211,111 @@ namespace gr {
     return n_produced;
   }
 
+  int
+  tagged_stream_block::general_work_packets(int noutput_items,
+                                            gr_vector_int &ninput_items,
+                                            gr_vector_const_void_star &input_items,
+                                            gr_vector_void_star &output_items)
+  {
+    unsigned ninputs = input_items.size();
+    d_length_tags.resize(ninputs);
+    d_n_input_items_reqd.assign(ninputs, 0);
+
+    // Follow the length tags from PDU to PDU on every input, reading
+    // them all at once. A PDU is complete once all of its items are
+    // there on every input.
+    unsigned npackets = 0;
+    for(unsigned i = 0; i < ninputs; i++) {
+      uint64_t start = nitems_read(i);
+      uint64_t end = start + ninput_items[i];
+      std::vector<tag_t> &tags = d_length_tags[i];
+      get_tags_in_range(tags, i, start, end, d_length_tag_key);
+
+      uint64_t pos = start;
+      unsigned t = 0, n = 0;
+      while(i == 0 || n == 0 || n < npackets) {
+        // Length tags inside a PDU are left alone, as in parse_length_tags()
+        while(t < tags.size() && tags[t].offset < pos) {
+          t++;
+        }
+        if(t == tags.size() || tags[t].offset != pos) {
+          break;
+        }
+        long len = pmt::to_long(tags[t].value);
+        if(len < 0) {
+          GR_LOG_FATAL(d_logger, boost::format("Negative length tag on port %1% at item #%2%") % i % pos);
+          throw std::runtime_error("Negative length tag.");
+        }
+        if(n == 0) {
+          d_n_input_items_reqd[i] = len;
+        }
+        if(pos + len > end) {
+          break;
+        }
+
+        // Keep the tags of the complete PDUs at the front, to remove
+        tags[n] = tags[t++];
+        if(n == d_packet_lengths.size()) {
+          d_packet_lengths.push_back(gr_vector_int(ninputs, 0));
+        }
+        d_packet_lengths[n++][i] = len;
+        pos += len;
+      }
+
+      if(n == 0 && d_n_input_items_reqd[i] == 0) {
+        GR_LOG_FATAL(d_logger, boost::format("Missing a required length tag on port %1% at item #%2%") % i % nitems_read(i));
+        throw std::runtime_error("Missing length tag.");
+      }
+      npackets = (i == 0) ? n : std::min(npackets, n);
+    }
+
+    // Take as many as fit into the output buffer.
+    int n_output = 0;
+    unsigned k;
+    for(k = 0; k < npackets; k++) {
+      int n = calculate_output_stream_length(d_packet_lengths[k]);
+      if(n_output + n > noutput_items) {
+        break;
+      }
+      n_output += n;
+    }
+    if(k == 0) {
+      // Not even the first one; forecast() asks for its items.
+      if(npackets > 0) {
+        set_min_noutput_items(calculate_output_stream_length(d_packet_lengths[0]));
+      }
+      return 0;
+    }
+    set_min_noutput_items(1);
+    npackets = k;
+    d_packet_lengths.resize(npackets);
+    d_packet_noutput_items.assign(npackets, 0);
+
+    // WORK CALLED HERE //
+    int n_produced = work_packets(noutput_items, d_packet_lengths, d_packet_noutput_items,
+                                  input_items, output_items);
+    //////////////////////
+
+    if(n_produced == WORK_DONE) {
+      return n_produced;
+    }
+    for(unsigned i = 0; i < ninputs; i++) {
+      int n_consumed = 0;
+      for(k = 0; k < npackets; k++) {
+        n_consumed += d_packet_lengths[k][i];
+      }
+      consume(i, n_consumed);
+
+      d_length_tags[i].resize(npackets);
+      detail()->remove_item_tags(i, d_length_tags[i], unique_id());
+    }
+    if(n_produced > 0) {
+      update_packet_length_tags(d_packet_noutput_items, output_items.size());
+    }
+
+    d_n_input_items_reqd.assign(ninputs, 0);
+
+    return n_produced;
+  }
+
 }  /* namespace gr */
@@ -0,0 +1,250 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2016 Free Software Foundation, Inc.
+ *
+ * This file is part of GNU Radio
+ *
+ * GNU Radio is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * GNU Radio is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GNU Radio; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "thread_placement.h"
+#include <boost/format.hpp>
+#include <algorithm>
+#include <deque>
+#include <fstream>
+#include <map>
+#include <sstream>
+
+#if defined(__linux__)
+#include <sched.h>
+#endif
+
+namespace gr {
+
+  // "0-3,8,10-11" as written by sysfs
+  static std::vector<int>
+  parse_cpu_list(const std::string &s)
+  {
+    std::vector<int> cpus;
+    std::stringstream in(s);
+    std::string range;
+    while(std::getline(in, range, ',')) {
+      int first, last;
+      char dash;
+      std::stringstream r(range);
+      if(!(r >> first))
+        continue;
+      if(!(r >> dash >> last) || dash != '-')
+        last = first;
+      for(int i = first; i <= last; i++)
+        cpus.push_back(i);
+    }
+    return cpus;
+  }
+
+  static std::string
+  read_line(const std::string &path)
+  {
+    std::string line;
+    std::ifstream in(path.c_str());
+    std::getline(in, line);
+    return line;
+  }
+
+  static int
+  read_int(const std::string &path, int fallback)
+  {
+    int value;
+    std::ifstream in(path.c_str());
+    if(!(in >> value))
+      return fallback;
+    return value;
+  }
+
+  static bool
+  placement_order(const cpu_topology::cpu &a, const cpu_topology::cpu &b)
+  {
+    if(a.package != b.package)
+      return a.package < b.package;
+    if(a.l3 != b.l3)
+      return a.l3 < b.l3;
+    if(a.thread != b.thread)
+      return a.thread < b.thread;
+    if(a.l2 != b.l2)
+      return a.l2 < b.l2;
+    return a.id < b.id;
+  }
+
+  cpu_topology::cpu_topology(const std::string &root)
+  {
+    std::vector<int> ids = parse_cpu_list(read_line(root + "/online"));
+    std::sort(ids.begin(), ids.end());
+
+    std::map<std::pair<int, int>, int> nthreads;	// per (package, core)
+    for(size_t i = 0; i < ids.size(); i++) {
+      std::string dir = str(boost::format("%s/cpu%d/") % root % ids[i]);
+
+      cpu c;
+      c.id = ids[i];
+      c.package = read_int(dir + "topology/physical_package_id", 0);
+      c.core = read_int(dir + "topology/core_id", c.id);
+      c.thread = nthreads[std::make_pair(c.package, c.core)]++;
+      c.l2 = -1;
+      c.l3 = -1;
+
+      // Name each cache after the lowest-numbered CPU sharing it.
+      for(int j = 0; j < 16; j++) {
+        std::string index = str(boost::format("%scache/index%d/") % dir % j);
+        int level = read_int(index + "level", -1);
+        if(level < 0)
+          break;
+        if(read_line(index + "type") == "Instruction")
+          continue;
+
+        std::vector<int> shared = parse_cpu_list(read_line(index + "shared_cpu_list"));
+        int group = shared.empty() ? c.id : *std::min_element(shared.begin(), shared.end());
+        if(level == 2)
+          c.l2 = group;
+        else if(level == 3)
+          c.l3 = group;
+      }
+
+      d_cpus.push_back(c);
+    }
+
+    std::sort(d_cpus.begin(), d_cpus.end(), placement_order);
+  }
+
+  void
+  cpu_topology::restrict_to(const std::vector<int> &allowed)
+  {
+    std::vector<cpu> cpus;
+    for(size_t i = 0; i < d_cpus.size(); i++) {
+      if(std::find(allowed.begin(), allowed.end(), d_cpus[i].id) != allowed.end())
+        cpus.push_back(d_cpus[i]);
+    }
+    d_cpus.swap(cpus);
+  }
+
+  std::vector<int>
+  cpu_topology::allowed_cpus()
+  {
+    std::vector<int> cpus;
+#if defined(__linux__)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if(sched_getaffinity(0, sizeof(set), &set) == 0) {
+      for(int i = 0; i < CPU_SETSIZE; i++) {
+        if(CPU_ISSET(i, &set))
+          cpus.push_back(i);
+      }
+    }
+#endif
+    return cpus;
+  }
+
+  typedef std::pair<size_t, size_t> edge_key_t;
+
+  static bool
+  heavier(const std::pair<double, edge_key_t> &a,
+          const std::pair<double, edge_key_t> &b)
+  {
+    if(a.first != b.first)
+      return a.first > b.first;
+    return a.second < b.second;
+  }
+
+  std::vector<int>
+  place_threads(size_t nthreads, const std::vector<placement_edge> &edges,
+                const cpu_topology &topology)
+  {
+    const std::vector<cpu_topology::cpu> &cpus = topology.cpus();
+    std::vector<int> result(nthreads, -1);
+    if(cpus.empty() || nthreads == 0)
+      return result;
+
+    // Add up the edges between each pair of threads.
+    std::map<edge_key_t, double> weights;
+    for(size_t i = 0; i < edges.size(); i++) {
+      size_t u = std::min(edges[i].src, edges[i].dst);
+      size_t v = std::max(edges[i].src, edges[i].dst);
+      if(u != v && v < nthreads)
+        weights[edge_key_t(u, v)] += edges[i].weight;
+    }
+
+    std::vector<std::pair<double, edge_key_t> > sorted;
+    for(std::map<edge_key_t, double>::iterator i = weights.begin(); i != weights.end(); i++)
+      sorted.push_back(std::make_pair(i->second, i->first));
+    std::sort(sorted.begin(), sorted.end(), heavier);
+
+    // Every thread starts as a path of its own. Going from the
+    // heaviest edge down, join two paths whenever the edge links an
+    // end of one to an end of the other.
+    std::vector<std::deque<size_t> > paths(nthreads);
+    std::vector<size_t> path_of(nthreads);
+    for(size_t i = 0; i < nthreads; i++) {
+      paths[i].push_back(i);
+      path_of[i] = i;
+    }
+
+    for(size_t i = 0; i < sorted.size(); i++) {
+      size_t u = sorted[i].second.first;
+      size_t v = sorted[i].second.second;
+      size_t a = path_of[u], b = path_of[v];
+      if(a == b)
+        continue;
+
+      std::deque<size_t> &pa = paths[a], &pb = paths[b];
+      if(pa.back() != u) {
+        if(pa.front() != u)
+          continue;
+        std::reverse(pa.begin(), pa.end());
+      }
+      if(pb.front() != v) {
+        if(pb.back() != v)
+          continue;
+        std::reverse(pb.begin(), pb.end());
+      }
+
+      for(size_t j = 0; j < pb.size(); j++) {
+        path_of[pb[j]] = a;
+        pa.push_back(pb[j]);
+      }
+      pb.clear();
+    }
+
+    // Lay the paths end to end, in the order of their first threads,
+    // and deal the CPUs out along them.
+    std::vector<size_t> order;
+    for(size_t i = 0; i < nthreads; i++) {
+      std::deque<size_t> &p = paths[path_of[i]];
+      order.insert(order.end(), p.begin(), p.end());
+      p.clear();
+    }
+
+    for(size_t k = 0; k < order.size(); k++) {
+      size_t c = (order.size() <= cpus.size()) ? k : k * cpus.size() / order.size();
+      result[order[k]] = cpus[c].id;
+    }
+
+    return result;
+  }
+
+} /* namespace gr */
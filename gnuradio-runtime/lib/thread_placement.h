@@ -0,0 +1,90 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2016 Free Software Foundation, Inc.
+ *
+ * This file is part of GNU Radio
+ *
+ * GNU Radio is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * GNU Radio is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GNU Radio; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef INCLUDED_GR_THREAD_PLACEMENT_H
+#define INCLUDED_GR_THREAD_PLACEMENT_H
+
+#include <gnuradio/api.h>
+#include <string>
+#include <vector>
+
+namespace gr {
+
+  /*!
+   * \brief The CPUs we may run on, and the caches they share.
+   *
+   * Read from Linux's sysfs; empty elsewhere, or if sysfs is missing.
+   */
+  class GR_RUNTIME_API cpu_topology
+  {
+  public:
+    struct cpu {
+      int id;
+      int package;	// physical_package_id
+      int core;		// core_id within the package
+      int thread;	// 0 for a core's first hardware thread, 1 for the next...
+      int l2;		// lowest-numbered CPU sharing our L2 cache, or -1
+      int l3;		// same for the L3 cache
+    };
+
+    /*!
+     * Read the online CPUs under \p root (normally
+     * /sys/devices/system/cpu) and put them in placement order:
+     * grouped by package and L3 cache, the first hardware thread of
+     * every core ahead of their siblings, and cores sharing an L2
+     * cache next to each other.
+     */
+    cpu_topology(const std::string &root = "/sys/devices/system/cpu");
+
+    //! Drop the CPUs not in \p allowed
+    void restrict_to(const std::vector<int> &allowed);
+
+    //! The CPUs in this process's affinity mask; empty if unknown
+    static std::vector<int> allowed_cpus();
+
+    const std::vector<cpu> &cpus() const { return d_cpus; }
+
+  private:
+    std::vector<cpu> d_cpus;
+  };
+
+  //! Connection between two threads, weighted by the bytes/sec it carries
+  struct placement_edge {
+    size_t src, dst;
+    double weight;
+  };
+
+  /*!
+   * \brief Pick a CPU for each of \p nthreads threads.
+   *
+   * Threads are laid out along \p topology's CPUs so that the
+   * heaviest edges join neighbors, which share a core's caches or at
+   * least an L3 cache. With more threads than CPUs, neighbors share a
+   * CPU. Returns -1 for every thread if there are no CPUs.
+   */
+  GR_RUNTIME_API std::vector<int>
+  place_threads(size_t nthreads, const std::vector<placement_edge> &edges,
+                const cpu_topology &topology);
+
+} /* namespace gr */
+
+#endif /* INCLUDED_GR_THREAD_PLACEMENT_H */
@@ -127,6 +127,24 @@ namespace gr {
     d_impl->set_max_noutput_items(nmax);
   }
 
+  double
+  top_block::reconfigure_time()
+  {
+    return d_impl->reconfigure_time();
+  }
+
+  std::vector<std::pair<std::string, double> >
+  top_block::startup_profile()
+  {
+    return d_impl->startup_profile();
+  }
+
+  std::string
+  top_block::thread_placement()
+  {
+    return d_impl->thread_placement();
+  }
+
   top_block_sptr
   top_block::to_top_block()
   {
@@ -26,13 +26,18 @@
 
 #include "top_block_impl.h"
 #include "flat_flowgraph.h"
+#include "scheduler_pool.h"
 #include "scheduler_sts.h"
 #include "scheduler_tpb.h"
 #include <gnuradio/top_block.h>
+#include <gnuradio/high_res_timer.h>
+#include <gnuradio/perf_trace.h>
 #include <gnuradio/prefs.h>
+#include <boost/format.hpp>
 
 #include <stdexcept>
 #include <iostream>
+#include <sstream>
 #include <string.h>
 #include <unistd.h>
 #include <stdlib.h>
@@ -49,39 +54,44 @@ namespace gr {
     scheduler_maker f;
   } scheduler_table[] = {
     { "TPB", scheduler_tpb::make },    // first entry is default
-    { "STS", scheduler_sts::make }
+    { "STS", scheduler_sts::make },
+    { "POOL", scheduler_pool::make }
   };
 
   static scheduler_sptr
   make_scheduler(flat_flowgraph_sptr ffg, int max_noutput_items)
   {
-    static scheduler_maker factory = 0;
-
-    if(factory == 0) {
-      char *v = getenv("GR_SCHEDULER");
-      if(!v)
-        factory = scheduler_table[0].f;	// use default
-      else {
-        for(size_t i = 0; i < sizeof(scheduler_table)/sizeof(scheduler_table[0]); i++) {
-          if(strcmp(v, scheduler_table[i].name) == 0) {
-            factory = scheduler_table[i].f;
-            break;
-          }
-        }
-        if(factory == 0) {
-          std::cerr << "warning: Invalid GR_SCHEDULER environment variable value \""
-                    << v << "\".  Using \"" << scheduler_table[0].name << "\"\n";
-          factory = scheduler_table[0].f;
-        }
-      }
+    // GR_SCHEDULER takes precedence over the [Scheduler] type pref.
+    // Look it up on every start so that the pref can be changed.
+    std::string v;
+    char *env = getenv("GR_SCHEDULER");
+    if(env)
+      v = env;
+    else
+      v = prefs::singleton()->get_string("Scheduler", "type", "");
+    if(v.empty())
+      v = scheduler_table[0].name;
+
+    for(size_t i = 0; i < sizeof(scheduler_table)/sizeof(scheduler_table[0]); i++) {
+      if(v == scheduler_table[i].name)
+        return scheduler_table[i].f(ffg, max_noutput_items);
     }
-    return factory(ffg, max_noutput_items);
+
+    static bool warned = false;
+    if(!warned) {
+      std::cerr << "warning: Invalid scheduler \""
+                << v << "\".  Using \"" << scheduler_table[0].name << "\"\n";
+      warned = true;
+    }
+    return scheduler_table[0].f(ffg, max_noutput_items);
   }
 
   top_block_impl::top_block_impl(top_block *owner)
     : d_owner(owner), d_ffg(),
-      d_state(IDLE), d_lock_count(0)
+      d_state(IDLE), d_lock_count(0), d_reconfigure_time(0)
   {
+    d_incremental = prefs::singleton()->get_bool("Scheduler", "incremental", false);
+    configure_default_loggers(d_logger, d_debug_logger, "top_block");
   }
 
   top_block_impl::~top_block_impl()
@@ -105,12 +115,20 @@ namespace gr {
     if(d_lock_count > 0)
       throw std::runtime_error("top_block::start: can't start with flow graph locked");
 
+    d_startup_profile.clear();
+    gr::high_res_timer_type t = gr::high_res_timer_now();
+
     // Create new flat flow graph by flattening hierarchy
     d_ffg = d_owner->flatten();
+    end_phase("flatten", t);
 
     // Validate new simple flow graph and wire it up
     d_ffg->validate();
-    d_ffg->setup_connections();
+    end_phase("validate", t);
+    d_ffg->setup_buffers();
+    end_phase("buffers", t);
+    d_ffg->setup_readers();
+    end_phase("readers", t);
 
     // Only export perf. counters if ControlPort config param is
     // enabled and if the PerfCounter option 'export' is turned on.
@@ -119,7 +137,23 @@ namespace gr {
       d_ffg->enable_pc_rpc();
 
     d_scheduler = make_scheduler(d_ffg, d_max_noutput_items);
+    end_phase("scheduler", t);
     d_state = RUNNING;
+
+    std::stringstream s;
+    s << "started in";
+    for(size_t i = 0; i < d_startup_profile.size(); i++)
+      s << " " << d_startup_profile[i].first << " " << d_startup_profile[i].second << " s";
+    GR_LOG_DEBUG(d_debug_logger, s.str());
+  }
+
+  void
+  top_block_impl::end_phase(const char *name, gr::high_res_timer_type &start)
+  {
+    gr::high_res_timer_type now = gr::high_res_timer_now();
+    d_startup_profile.push_back(std::make_pair(std::string(name),
+                                               (double)(now - start) / gr::high_res_timer_tps()));
+    start = now;
   }
 
   void
@@ -142,6 +176,14 @@ namespace gr {
         d_lock_cond.wait(lock);
       }
     } while(true);
+
+    // Only now, rather than on every restart.
+    perf_trace *trace = perf_trace::singleton();
+    if(trace->enabled()) {
+      std::string trace_file = prefs::singleton()->get_string("PerfCounters", "trace_file", "");
+      if(!trace_file.empty() && !trace->write(trace_file))
+        std::cerr << "top_block: unable to write trace to " << trace_file << std::endl;
+    }
   }
 
   void
@@ -159,10 +201,19 @@ namespace gr {
   top_block_impl::lock()
   {
     gr::thread::scoped_lock lock(d_mutex);
-    stop();
+    // A scheduler that can reconfigure itself keeps running until
+    // unlock() works out which blocks have to stop.
+    if(!reconfigurable())
+      stop();
     d_lock_count++;
   }
 
+  bool
+  top_block_impl::reconfigurable()
+  {
+    return d_incremental && d_scheduler && d_scheduler->reconfigurable();
+  }
+
   void
   top_block_impl::unlock()
   {
@@ -187,6 +238,22 @@ namespace gr {
   void
   top_block_impl::restart()
   {
+    gr::high_res_timer_type start = gr::high_res_timer_now();
+
+    if(reconfigurable()) {
+      // Only the blocks whose connections changed stop, and only
+      // once the new graph has checked out.
+      flat_flowgraph_sptr new_ffg = d_owner->flatten();
+      new_ffg->validate();
+      d_scheduler->reconfigure(d_ffg, new_ffg);
+      d_ffg = new_ffg;
+
+      d_reconfigure_time = (double)(gr::high_res_timer_now() - start) / gr::high_res_timer_tps();
+      GR_LOG_DEBUG(d_debug_logger, boost::format("reconfigured in %1% s, restarted changed blocks")
+                   % d_reconfigure_time);
+      return;
+    }
+
     wait_for_jobs();
 
     // Create new simple flow graph
@@ -198,6 +265,10 @@ namespace gr {
     // Create a new scheduler to execute it
     d_scheduler = make_scheduler(d_ffg, d_max_noutput_items);
     d_state = RUNNING;
+
+    d_reconfigure_time = (double)(gr::high_res_timer_now() - start) / gr::high_res_timer_tps();
+    GR_LOG_DEBUG(d_debug_logger, boost::format("reconfigured in %1% s, restarted all blocks")
+                 % d_reconfigure_time);
   }
 
   std::string
@@ -237,4 +308,25 @@ namespace gr {
     d_max_noutput_items = nmax;
   }
 
+  double
+  top_block_impl::reconfigure_time()
+  {
+    return d_reconfigure_time;
+  }
+
+  std::vector<std::pair<std::string, double> >
+  top_block_impl::startup_profile()
+  {
+    return d_startup_profile;
+  }
+
+  std::string
+  top_block_impl::thread_placement()
+  {
+    if(d_scheduler)
+      return d_scheduler->thread_placement();
+    else
+      return "";
+  }
+
 } /* namespace gr */
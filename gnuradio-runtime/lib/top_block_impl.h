@@ -26,6 +26,8 @@
 #include <gnuradio/api.h>
 #include "scheduler.h"
 #include <gnuradio/thread/thread.h>
+#include <gnuradio/high_res_timer.h>
+#include <gnuradio/logger.h>
 
 namespace gr {
 
@@ -72,6 +74,15 @@ namespace gr {
     // Set the maximum number of noutput_items in the flowgraph
     void set_max_noutput_items(int nmax);
 
+    // Seconds the last reconfiguration took
+    double reconfigure_time();
+
+    // Seconds each phase of the last start() took
+    std::vector<std::pair<std::string, double> > startup_profile();
+
+    // Return the CPU each block's thread was placed on
+    std::string thread_placement();
+
   protected:
     enum tb_state { IDLE, RUNNING };
 
@@ -84,10 +95,17 @@ namespace gr {
     int d_lock_count;
     boost::condition_variable d_lock_cond;
     int d_max_noutput_items;
+    bool d_incremental;            // [Scheduler] incremental
+    double d_reconfigure_time;
+    std::vector<std::pair<std::string, double> > d_startup_profile;
+    gr::logger_ptr d_logger;
+    gr::logger_ptr d_debug_logger;
 
   private:
     void restart();
     void wait_for_jobs();
+    bool reconfigurable();
+    void end_phase(const char *name, gr::high_res_timer_type &start);
   };
 
 } /* namespace gr */
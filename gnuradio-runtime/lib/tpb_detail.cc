@@ -27,13 +27,137 @@
 #include <gnuradio/block.h>
 #include <gnuradio/block_detail.h>
 #include <gnuradio/buffer.h>
+#include <boost/static_assert.hpp>
+
+#ifdef HAVE_LINUX_FUTEX_H
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
 
 namespace gr {
 
+#ifdef HAVE_LINUX_FUTEX_H
+  BOOST_STATIC_ASSERT(sizeof(boost::atomic<unsigned int>) == sizeof(int));
+
+  static void
+  futex_wait(boost::atomic<unsigned int> *addr, unsigned int val)
+  {
+    // Returns right away if *addr != val; EINTR and spurious
+    // wakeups are left to the caller's loop.
+    syscall(SYS_futex, (int *)addr, FUTEX_WAIT_PRIVATE, (int)val, 0, 0, 0);
+  }
+
+  static void
+  futex_wake(boost::atomic<unsigned int> *addr)
+  {
+    syscall(SYS_futex, (int *)addr, FUTEX_WAKE_PRIVATE, 1, 0, 0, 0);
+  }
+#endif
+
+  unsigned int
+  tpb_detail::wait(unsigned int events)
+  {
+    events = (events & ALL_EVENTS) | WAKE;
+    unsigned int waiting = events << WAITING_SHIFT;
+
+    bool slept = false;
+    unsigned int e = d_events.load(boost::memory_order_acquire);
+    while(!(e & events)) {
+      // Say what we're waiting for, then sleep unless the word
+      // changed in between.
+      if((e & waiting) != waiting) {
+        if(!d_events.compare_exchange_weak(e, e | waiting,
+                                           boost::memory_order_acq_rel))
+          continue;
+        e |= waiting;
+      }
+
+#ifdef HAVE_LINUX_FUTEX_H
+      futex_wait(&d_events, e);
+#else
+      {
+        gr::thread::scoped_lock guard(mutex);
+        while(d_events.load(boost::memory_order_acquire) == e)
+          d_cond.wait(guard);
+      }
+#endif
+      slept = true;
+      e = d_events.load(boost::memory_order_acquire);
+    }
+
+    if(slept && (e & events & ALL_EVENTS))
+      d_nwakeups.fetch_add(1, boost::memory_order_relaxed);
+
+    d_events.fetch_and(~(waiting | WAKE), boost::memory_order_acq_rel);
+    return e & ALL_EVENTS;
+  }
+
+  void
+  tpb_detail::wake()
+  {
+    post(WAKE);
+  }
+
+  void
+  tpb_detail::post(unsigned int events)
+  {
+    unsigned int waiting = events << WAITING_SHIFT;
+    unsigned int old = d_events.fetch_or(events, boost::memory_order_acq_rel);
+
+    // Only a thread sleeping on one of these needs a system call,
+    // and only from whoever takes down its waiting bits first.
+    if((old & waiting) &&
+       (d_events.fetch_and(~(~0u << WAITING_SHIFT), boost::memory_order_acq_rel) & waiting)) {
+      d_nsignals.fetch_add(1, boost::memory_order_relaxed);
+#ifdef HAVE_LINUX_FUTEX_H
+      futex_wake(&d_events);
+#else
+      gr::thread::scoped_lock guard(mutex);
+      d_cond.notify_one();
+#endif
+    }
+
+    notify_deprecated(events);
+
+    if(d_hooked.load(boost::memory_order_acquire)) {
+      gr::thread::scoped_lock guard(mutex);
+      if(notify_hook)
+        notify_hook();
+    }
+  }
+
+  // These two construct and notify the deprecated input_cond and
+  // output_cond.
+#if defined(__GNUC__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wdeprecated-declarations"
+#endif
+
+  tpb_detail::tpb_detail()
+    : d_events(0), d_hooked(false), d_nwakeups(0), d_nsignals(0)
+  {
+  }
+
+  void
+  tpb_detail::notify_deprecated(unsigned int events)
+  {
+    if(events & (INPUT_CHANGED | MSG_ARRIVED))
+      input_cond.notify_one();
+    if(events & (OUTPUT_CHANGED | MSG_ARRIVED))
+      output_cond.notify_one();
+  }
+
+#if defined(__GNUC__)
+#pragma GCC diagnostic pop
+#endif
+
   /*
-   * We assume that no worker threads are ever running when the graph
-   * structure is being manipulated, thus it's safe for us to poke
-   * around in our neighbors w/o holding any locks.
+   * We assume that no worker threads are running on either side of a
+   * buffer while its connections are being manipulated (even an
+   * incremental reconfiguration stops both ends of every buffer it
+   * rewires), thus it's safe for us to poke around in our neighbors
+   * w/o holding any locks.
    */
   void
   tpb_detail::notify_upstream(block_detail *d)
@@ -45,6 +169,11 @@ namespace gr {
     for(size_t i = 0; i < d->d_input.size(); i++) {
       // Can you say, "pointer chasing?"
       d->d_input[i]->buffer()->link()->detail()->d_tpb.set_output_changed();
+
+      // If the buffer is written in place over another one, we also
+      // made room in that one.
+      for(buffer_sptr b = d->d_input[i]->buffer()->in_place_of(); b; b = b->in_place_of())
+        b->link()->detail()->d_tpb.set_output_changed();
     }
   }
 
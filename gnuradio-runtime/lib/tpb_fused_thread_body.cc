@@ -0,0 +1,211 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2016 Free Software Foundation, Inc.
+ *
+ * This file is part of GNU Radio
+ *
+ * GNU Radio is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * GNU Radio is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GNU Radio; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include "tpb_fused_thread_body.h"
+#include <gnuradio/buffer.h>
+#include <boost/bind.hpp>
+#include <boost/foreach.hpp>
+#include <boost/format.hpp>
+#include <boost/thread.hpp>
+#include <pmt/pmt.h>
+#include <algorithm>
+#include <stdexcept>
+
+namespace gr {
+
+  tpb_fused_thread_body::tpb_fused_thread_body(const block_vector_t &blocks,
+                                               const std::vector<int> &max_noutput_items,
+                                               int chunk_bytes)
+    : d_blocks(blocks), d_changed(false)
+  {
+#ifdef _MSC_VER
+    #include <Windows.h>
+    thread::set_thread_name(GetCurrentThread(), boost::str(boost::format("%s%d+%d") % blocks[0]->name() % blocks[0]->unique_id() % (blocks.size()-1)));
+#else
+    thread::set_thread_name(pthread_self(), boost::str(boost::format("%s%d+%d") % blocks[0]->name() % blocks[0]->unique_id() % (blocks.size()-1)));
+#endif
+
+    gr::thread::gr_thread_t thread = gr::thread::get_current_thread_id();
+
+    for(size_t i = 0; i < d_blocks.size(); i++) {
+      block_sptr block = d_blocks[i];
+      block_detail *d = block->detail().get();
+
+      // Run each block on a chunk that fits in cache, but not less
+      // than it can produce at once.
+      int item_size = block->output_signature()->sizeof_stream_item(0);
+      int chunk = std::max(chunk_bytes / item_size, block->output_multiple());
+      chunk = std::min(chunk, max_noutput_items[i]);
+
+      d->threaded = true;
+      d->thread = thread;
+      block->clear_finished();
+      d_execs.push_back(boost::shared_ptr<block_executor>(new block_executor(block, chunk)));
+    }
+
+    // Anything that would wake up one of the blocks' own threads
+    // wakes up the chain instead.
+    for(size_t i = 0; i < d_blocks.size(); i++)
+      d_blocks[i]->detail()->d_tpb.set_notify_hook(boost::bind(&tpb_fused_thread_body::notify, this));
+
+    try {
+      run();
+    }
+    catch(...) {
+      unhook();
+      throw;
+    }
+    unhook();
+  }
+
+  tpb_fused_thread_body::~tpb_fused_thread_body()
+  {
+  }
+
+  /*
+   * Called from a block's tpb_detail (with its mutex held) by
+   * whoever changed its input or output or sent it a message.
+   */
+  void
+  tpb_fused_thread_body::notify()
+  {
+    gr::thread::scoped_lock guard(d_mutex);
+    d_changed = true;
+    d_cond.notify_one();
+  }
+
+  void
+  tpb_fused_thread_body::unhook()
+  {
+    for(size_t i = 0; i < d_blocks.size(); i++)
+      d_blocks[i]->detail()->d_tpb.set_notify_hook(boost::function<void()>());
+  }
+
+  void
+  tpb_fused_thread_body::run()
+  {
+    size_t nblocks = d_blocks.size();
+    size_t ndone = 0;
+    block_executor::state s;
+    std::vector<pmt::pmt_t> msgs;
+
+    // The ends of the chain tell their outside neighbors once a
+    // quarter of the buffer between them has moved, rather than
+    // after every chunk, and always before going to sleep.
+    block_detail *head = d_blocks[0]->detail().get();
+    block_detail *tail = d_blocks[nblocks-1]->detail().get();
+    uint64_t head_nread = head->input(0)->nitems_read();
+    uint64_t tail_nwritten = tail->output(0)->nitems_written();
+    uint64_t head_batch = std::max(1, head->input(0)->buffer()->bufsize() / 4);
+    uint64_t tail_batch = std::max(1, tail->output(0)->bufsize() / 4);
+
+    while(1) {
+      boost::this_thread::interruption_point();
+
+      {
+        gr::thread::scoped_lock guard(d_mutex);
+        d_changed = false;
+      }
+
+      bool progress = false;
+      for(size_t i = 0; i < nblocks; i++) {
+        if(!d_execs[i])
+          continue;	// done
+
+        block_sptr block = d_blocks[i];
+        block_detail *d = block->detail().get();
+
+        // handle any queued up messages
+        BOOST_FOREACH(basic_block::msg_queue_map_t::value_type &p, block->msg_queue) {
+          if(block->has_msg_handler(p.first)) {
+            while(block->delete_head_batch(p.first, msgs)) {
+              BOOST_FOREACH(pmt::pmt_t &msg, msgs)
+                block->dispatch_msg(p.first, msg);
+            }
+          }
+        }
+
+        s = d_execs[i]->run_one_iteration();
+
+        // if msg ports think we are done, we are done
+        if(block->finished())
+          s = block_executor::DONE;
+
+        // Blocks inside the chain get their turn on this or the next
+        // pass; the ends are handled below.
+        switch(s) {
+        case block_executor::READY:
+        case block_executor::READY_NO_OUTPUT:
+          progress = true;
+          break;
+
+        case block_executor::DONE:
+          progress = true;
+          block->notify_msg_neighbors();
+          d->d_tpb.notify_neighbors(d);
+          d_execs[i].reset();	// stop() it now
+          ndone++;
+          break;
+
+        case block_executor::BLKD_IN:
+        case block_executor::BLKD_OUT:
+          break;
+
+        default:
+          throw std::runtime_error("possible memory corruption in scheduler");
+        }
+      }
+
+      if(ndone == nblocks)
+        return;
+
+      if(d_execs[0]) {
+        uint64_t nread = head->input(0)->nitems_read();
+        if(nread - head_nread >= head_batch || (!progress && nread != head_nread)) {
+          head->d_tpb.notify_upstream(head);
+          head_nread = nread;
+        }
+      }
+      if(d_execs[nblocks-1]) {
+        uint64_t nwritten = tail->output(0)->nitems_written();
+        if(nwritten - tail_nwritten >= tail_batch || (!progress && nwritten != tail_nwritten)) {
+          tail->d_tpb.notify_downstream(tail);
+          tail_nwritten = nwritten;
+        }
+      }
+
+      // Nobody could move: sleep until a neighbor or a message
+      // says otherwise. Stopping wakes the blocks' tpb_details,
+      // which land here too, and the wait is an interruption point.
+      if(!progress) {
+        gr::thread::scoped_lock guard(d_mutex);
+        while(!d_changed)
+          d_cond.wait(guard);
+      }
+    }
+  }
+
+} /* namespace gr */
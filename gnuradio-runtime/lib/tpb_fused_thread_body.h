@@ -0,0 +1,69 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2016 Free Software Foundation, Inc.
+ *
+ * This file is part of GNU Radio
+ *
+ * GNU Radio is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * GNU Radio is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GNU Radio; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef INCLUDED_GR_TPB_FUSED_THREAD_BODY_H
+#define INCLUDED_GR_TPB_FUSED_THREAD_BODY_H
+
+#include <gnuradio/api.h>
+#include <gnuradio/block.h>
+#include <gnuradio/block_detail.h>
+#include <gnuradio/thread/thread.h>
+#include "block_executor.h"
+
+namespace gr {
+
+  /*!
+   * \brief The body of a thread-per-block thread that runs a chain
+   * of blocks instead of one.
+   *
+   * The blocks are a run found by flat_flowgraph::calc_fusable_chains.
+   * Each pass calls every block once, upstream first, on at most
+   * chunk_bytes of output, so the data one block writes is still in
+   * cache when the next one reads it. The buffers between the blocks
+   * are kept, so tags and the blocks themselves see no difference.
+   *
+   * Like tpb_thread_body, the constructor turns into the main loop
+   * which returns when all the blocks are done or it is interrupted.
+   */
+  class GR_RUNTIME_API tpb_fused_thread_body
+  {
+    block_vector_t                                  d_blocks;
+    std::vector<boost::shared_ptr<block_executor> > d_execs;
+
+    gr::thread::mutex              d_mutex;		// protects d_changed
+    gr::thread::condition_variable d_cond;
+    bool                           d_changed;
+
+    void notify();
+    void run();
+    void unhook();
+
+  public:
+    tpb_fused_thread_body(const block_vector_t &blocks,
+                          const std::vector<int> &max_noutput_items,
+                          int chunk_bytes=16384);
+    ~tpb_fused_thread_body();
+  };
+
+} /* namespace gr */
+
+#endif /* INCLUDED_GR_TPB_FUSED_THREAD_BODY_H */
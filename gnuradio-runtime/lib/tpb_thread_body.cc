@@ -32,6 +32,21 @@
 
 namespace gr {
 
+  // Messages for ports without a handler stay queued; the queue
+  // itself is bounded and drops the oldest when it fills up.
+  void
+  tpb_thread_body::handle_msgs(block_sptr block, std::vector<pmt::pmt_t> &msgs)
+  {
+    BOOST_FOREACH(basic_block::msg_queue_map_t::value_type &i, block->msg_queue) {
+      if(block->has_msg_handler(i.first)) {
+        while(block->delete_head_batch(i.first, msgs)) {
+          BOOST_FOREACH(pmt::pmt_t &msg, msgs)
+            block->dispatch_msg(i.first, msg);
+        }
+      }
+    }
+  }
+
   tpb_thread_body::tpb_thread_body(block_sptr block, int max_noutput_items)
     : d_exec(block, max_noutput_items)
   {
@@ -46,18 +61,16 @@ namespace gr {
 
     block_detail *d = block->detail().get();
     block_executor::state s;
-    pmt::pmt_t msg;
+    std::vector<pmt::pmt_t> msgs;
 
     d->threaded = true;
     d->thread = gr::thread::get_current_thread_id();
 
-    prefs *p = prefs::singleton();
-    size_t max_nmsgs = static_cast<size_t>(p->get_long("DEFAULT", "max_messages", 100));
-
     // Setup the logger for the scheduler
 #ifdef ENABLE_GR_LOG
 #ifdef HAVE_LOG4CPP
     #undef LOG
+    prefs *p = prefs::singleton();
     std::string config_file = p->get_string("LOG", "log_config", "");
     std::string log_level = p->get_string("LOG", "log_level", "off");
     std::string log_file = p->get_string("LOG", "log_file", "");
@@ -93,30 +106,14 @@ namespace gr {
     block->clear_finished();
 
     while(1) {
-      tpb_loop_top:
       boost::this_thread::interruption_point();
 
+      // Anything that happens from here on wakes us up again.
+      d->d_tpb.clear_changed();
+
       // handle any queued up messages
-      BOOST_FOREACH(basic_block::msg_queue_map_t::value_type &i, block->msg_queue) {
-        // Check if we have a message handler attached before getting
-        // any messages. This is mostly a protection for the unknown
-        // startup sequence of the threads.
-        if(block->has_msg_handler(i.first)) {
-          while((msg = block->delete_head_nowait(i.first))) {
-            block->dispatch_msg(i.first,msg);
-          }
-        }
-        else {
-          // If we don't have a handler but are building up messages,
-          // prune the queue from the front to keep memory in check.
-          if(block->nmsgs(i.first) > max_nmsgs){
-            GR_LOG_WARN(LOG,"asynchronous message buffer overflowing, dropping message");
-            msg = block->delete_head_nowait(i.first);
-          }
-        }
-      }
+      handle_msgs(block, msgs);
 
-      d->d_tpb.clear_changed();
       // run one iteration if we are a connected stream block
       if(d->noutputs() >0 || d->ninputs()>0){
         s = d_exec.run_one_iteration();
@@ -144,72 +141,34 @@ namespace gr {
         return;
 
       case block_executor::BLKD_IN:		// Wait for input.
-      {
-        gr::thread::scoped_lock guard(d->d_tpb.mutex);
-        while(!d->d_tpb.input_changed) {
-
-          // wait for input or message
-          while(!d->d_tpb.input_changed && block->empty_handled_p()){
-            boost::system_time const timeout=boost::get_system_time()+ boost::posix_time::milliseconds(250);
-            if(!d->d_tpb.input_cond.timed_wait(guard, timeout)){
-                goto tpb_loop_top; // timeout occured (perform sanity checks up top)
-                }
-            }
+        // wait for input or message
+        while(!(d->d_tpb.wait(tpb_detail::INPUT_CHANGED | tpb_detail::MSG_ARRIVED)
+                & tpb_detail::INPUT_CHANGED)) {
+          boost::this_thread::interruption_point();
 
           // handle all pending messages
-          BOOST_FOREACH(basic_block::msg_queue_map_t::value_type &i, block->msg_queue) {
-            if(block->has_msg_handler(i.first)) {
-              while((msg = block->delete_head_nowait(i.first))) {
-                guard.unlock();			// release lock while processing msg
-                block->dispatch_msg(i.first, msg);
-                guard.lock();
-              }
-            }
-            else {
-              // leave msg in queue if no handler is defined
-              // start dropping if we have too many
-              if(block->nmsgs(i.first) > max_nmsgs){
-                GR_LOG_WARN(LOG,"asynchronous message buffer overflowing, dropping message");
-                msg = block->delete_head_nowait(i.first);
-              }
-            }
-          }
-	  if (d->done()) {
-	    return;
-	  }
+          d->d_tpb.clear(tpb_detail::MSG_ARRIVED);
+          handle_msgs(block, msgs);
+          if(d->done() || block->finished())
+            break;
         }
-      }
-      break;
+        if(d->done())
+          return;
+        break;
 
       case block_executor::BLKD_OUT:	// Wait for output buffer space.
-      {
-	gr::thread::scoped_lock guard(d->d_tpb.mutex);
-	while(!d->d_tpb.output_changed) {
-	  // wait for output room or message
-	  while(!d->d_tpb.output_changed && block->empty_handled_p())
-	    d->d_tpb.output_cond.wait(guard);
-
-	  // handle all pending messages
-          BOOST_FOREACH(basic_block::msg_queue_map_t::value_type &i, block->msg_queue) {
-            if(block->has_msg_handler(i.first)) {
-                while((msg = block->delete_head_nowait(i.first))) {
-                  guard.unlock();			// release lock while processing msg
-                  block->dispatch_msg(i.first, msg);
-                  guard.lock();
-                }
-            }
-            else {
-                // leave msg in queue if no handler is defined
-                // start dropping if we have too many
-                if(block->nmsgs(i.first) > max_nmsgs){
-                  GR_LOG_WARN(LOG,"asynchronous message buffer overflowing, dropping message");
-                  msg = block->delete_head_nowait(i.first);
-                }
-            }
-          }
+        // wait for output room or message
+        while(!(d->d_tpb.wait(tpb_detail::OUTPUT_CHANGED | tpb_detail::MSG_ARRIVED)
+                & tpb_detail::OUTPUT_CHANGED)) {
+          boost::this_thread::interruption_point();
+
+          // handle all pending messages
+          d->d_tpb.clear(tpb_detail::MSG_ARRIVED);
+          handle_msgs(block, msgs);
+          if(block->finished())
+            break;
         }
-      }
-      break;
+        break;
 
       default:
         throw std::runtime_error("possible memory corruption in scheduler");
@@ -39,6 +39,8 @@ namespace gr {
   {
     block_executor d_exec;
 
+    void handle_msgs(block_sptr block, std::vector<pmt::pmt_t> &msgs);
+
   public:
     tpb_thread_body(block_sptr block, int max_noutput_items=100000);
     ~tpb_thread_body();
@@ -25,10 +25,17 @@
 #endif
 
 #include <assert.h>
+#include <algorithm>
 #include <stdexcept>
 #include <stdio.h>
 #include <string.h>
 #include <vector>
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+#ifdef HAVE_MBIND
+#include <sys/syscall.h>
+#endif
 #include <boost/format.hpp>
 #include "vmcircbuf.h"
 #include "vmcircbuf_prefs.h"
@@ -36,9 +43,11 @@
 
 // all the factories we know about
 #include "vmcircbuf_createfilemapping.h"
+#include "vmcircbuf_mmap_arena.h"
 #include "vmcircbuf_sysv_shm.h"
 #include "vmcircbuf_mmap_shm_open.h"
 #include "vmcircbuf_mmap_tmpfile.h"
+#include "vmcircbuf_mmap_hugetlb.h"
 
 gr::thread::mutex s_vm_mutex;
 
@@ -110,6 +119,15 @@ namespace gr {
     result.push_back(gr::vmcircbuf_mmap_shm_open_factory::singleton());
 #endif
     result.push_back (gr::vmcircbuf_mmap_tmpfile_factory::singleton());
+#ifdef TRY_SHM_VMCIRCBUF
+    // After the established ones, so it's picked only if they all
+    // fail or when named in vmcircbuf_default_factory.
+    result.push_back(gr::vmcircbuf_mmap_arena_factory::singleton());
+#endif
+
+    // Last, so it's only used when asked for by name: every buffer
+    // costs at least one huge page.
+    result.push_back(gr::vmcircbuf_mmap_hugetlb_factory::singleton());
 
     return result;
   }
@@ -121,6 +139,46 @@ namespace gr {
     s_default_factory = f;
   }
 
+  // ------------------------------------------------------------------------
+  //			      NUMA placement
+  // ------------------------------------------------------------------------
+
+  int
+  vmcircbuf_sysconfig::numa_node_of_cpu(int cpu)
+  {
+#ifdef HAVE_UNISTD_H
+    // sysfs links each CPU to its node: .../cpu/cpuN/nodeM
+    for(int node = 0; node < 1024; node++) {
+      std::string path = str(boost::format("/sys/devices/system/cpu/cpu%d/node%d")
+                             % cpu % node);
+      if(access(path.c_str(), F_OK) == 0)
+        return node;
+    }
+#endif
+    return -1;
+  }
+
+  bool
+  vmcircbuf::bind_to_numa_node(int node)
+  {
+#ifdef HAVE_MBIND
+    static const int MPOL_PREFERRED = 1;	// from <numaif.h>
+    static const int NBITS = 8 * sizeof(unsigned long);
+
+    if(node < 0 || node >= 1024)
+      return false;
+
+    unsigned long nodemask[1024 / NBITS] = { 0 };
+    nodemask[node / NBITS] = 1UL << (node % NBITS);
+
+    // Both copies map the same pages; one call covers them.
+    if(syscall(SYS_mbind, d_base, 2 * (unsigned long)d_size, MPOL_PREFERRED,
+               nodemask, (unsigned long)1024, 0) == 0)
+      return true;
+#endif
+    return false;
+  }
+
 
   // ------------------------------------------------------------------------
   //		    test code for vmcircbuf factories
@@ -230,10 +288,14 @@ namespace gr {
     int start = 0;
     bool ok = true;
 
+    // Keep the middle test at about 1MB when the granularity is large
+    // (i.e., huge pages)
+    int nbunch = std::max(1, (int)((1L << 20) / (4 * granularity)));
+
     ok &= test_a_bunch(f,   1,   1 * granularity, &start,  v);   //   1 x   4KB =   4KB
 
     if(ok) {
-      ok &= test_a_bunch(f,  64,   4 * granularity, &start, v);  //  64 x  16KB =   1MB
+      ok &= test_a_bunch(f, nbunch, 4 * granularity, &start, v); //  64 x  16KB =   1MB
       ok &= test_a_bunch(f,   4,   4 * (1L << 20),  &start, v);  //   4 x   4MB =  16MB
       //  ok &= test_a_bunch(f, 256, 256 * (1L << 10),  &start, v);  // 256 x 256KB =  64MB
     }
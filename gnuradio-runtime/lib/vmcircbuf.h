@@ -50,6 +50,15 @@ namespace gr {
     // ACCESSORS
     void *pointer_to_first_copy()  const{ return d_base; }
     void *pointer_to_second_copy() const{ return d_base + d_size; }
+
+    /*!
+     * \brief Prefer memory on NUMA node \p node for this buffer.
+     *
+     * Only pages that haven't been touched yet are affected, so call
+     * this right after the buffer is made. Returns false if the
+     * policy couldn't be set (no NUMA support, bad node, ...).
+     */
+    bool bind_to_numa_node(int node);
   };
 
   /*!
@@ -121,6 +130,12 @@ namespace gr {
      * verbose = 2: all intermediate results
      */
     static bool test_all_factories(int verbose);
+
+    /*!
+     * \brief Return the NUMA node that CPU \p cpu belongs to, or -1
+     * if that can't be determined.
+     */
+    static int numa_node_of_cpu(int cpu);
   };
 
 } /* namespace gr */
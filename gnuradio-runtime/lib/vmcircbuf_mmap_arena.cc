@@ -0,0 +1,221 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2016 Free Software Foundation, Inc.
+ *
+ * This file is part of GNU Radio
+ *
+ * GNU Radio is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * GNU Radio is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GNU Radio; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "vmcircbuf_mmap_arena.h"
+#include <stdexcept>
+#include <unistd.h>
+#include <fcntl.h>
+#ifdef HAVE_SYS_TYPES_H
+#include <sys/types.h>
+#endif
+#ifdef HAVE_SYS_MMAN_H
+#include <sys/mman.h>
+#endif
+#ifdef HAVE_MEMFD_CREATE
+#include <sys/syscall.h>
+#endif
+#include <errno.h>
+#include <stdio.h>
+#include <algorithm>
+#include <map>
+#include <vector>
+#include "pagesize.h"
+
+// Not in older libc headers
+#ifndef MFD_CLOEXEC
+#define MFD_CLOEXEC	0x0001U
+#endif
+
+namespace gr {
+
+  // Size of each backing file; bigger buffers get one of their own.
+  static const size_t s_chunk_size = 32 * (1 << 20);
+
+  struct arena_chunk {
+    int    fd;
+    size_t size;
+    size_t used;		// handed out from the start so far
+  };
+
+  // Both protected by s_vm_mutex, and never freed: buffers may be
+  // destroyed during static destruction.
+  static std::vector<arena_chunk> *s_chunks = 0;
+  static std::multimap<int, std::pair<int, size_t> > *s_free = 0;	// size -> (chunk, offset)
+
+#if defined(HAVE_MMAP) && (defined(HAVE_MEMFD_CREATE) || defined(HAVE_SHM_OPEN))
+  static int
+  open_chunk(size_t size)
+  {
+#ifdef HAVE_MEMFD_CREATE
+    int fd = syscall(SYS_memfd_create, "gnuradio", MFD_CLOEXEC);
+#else
+    static int s_seg_counter = 0;
+    char seg_name[1024];
+    int fd;
+    do {
+      snprintf(seg_name, sizeof(seg_name), "/gnuradio-arena-%d-%d", getpid(), s_seg_counter++);
+      fd = shm_open(seg_name, O_RDWR | O_CREAT | O_EXCL, 0600);
+    } while(fd == -1 && errno == EEXIST);
+    if(fd != -1)
+      shm_unlink(seg_name);	// nobody else needs to find it
+#endif
+    if(fd == -1) {
+      perror("gr::vmcircbuf_mmap_arena: open");
+      return -1;
+    }
+
+    // Sparse: pages are only allocated as buffers touch them.
+    if(ftruncate(fd, (off_t)size) == -1) {
+      perror("gr::vmcircbuf_mmap_arena: ftruncate");
+      close(fd);
+      return -1;
+    }
+    return fd;
+  }
+#endif
+
+  vmcircbuf_mmap_arena::vmcircbuf_mmap_arena(int size)
+    : gr::vmcircbuf(size), d_chunk(-1), d_offset(0)
+  {
+#if !defined(HAVE_MMAP) || !(defined(HAVE_MEMFD_CREATE) || defined(HAVE_SHM_OPEN))
+    fprintf(stderr, "gr::vmcircbuf_mmap_arena: mmap and memfd_create or shm_open are not available\n");
+    throw std::runtime_error("gr::vmcircbuf_mmap_arena");
+#else
+    gr::thread::scoped_lock guard(s_vm_mutex);
+
+    if(size <= 0 || (size % gr::pagesize()) != 0) {
+      fprintf(stderr, "gr::vmcircbuf_mmap_arena: invalid size = %d\n", size);
+      throw std::runtime_error("gr::vmcircbuf_mmap_arena");
+    }
+
+    if(!s_chunks) {
+      s_chunks = new std::vector<arena_chunk>;
+      s_free = new std::multimap<int, std::pair<int, size_t> >;
+    }
+
+    // A range freed by a buffer of the same size, else the end of
+    // the newest file, else a new file.
+    std::multimap<int, std::pair<int, size_t> >::iterator f = s_free->find(size);
+    if(f != s_free->end()) {
+      d_chunk = f->second.first;
+      d_offset = f->second.second;
+      s_free->erase(f);
+    }
+    else {
+      if(s_chunks->empty() || s_chunks->back().size - s_chunks->back().used < (size_t)size) {
+        arena_chunk c;
+        c.size = std::max(s_chunk_size, (size_t)size);
+        c.used = 0;
+        c.fd = open_chunk(c.size);
+        if(c.fd == -1)
+          throw std::runtime_error("gr::vmcircbuf_mmap_arena");
+        s_chunks->push_back(c);
+      }
+      d_chunk = s_chunks->size() - 1;
+      d_offset = s_chunks->back().used;
+      s_chunks->back().used += size;
+    }
+    int fd = (*s_chunks)[d_chunk].fd;
+
+    // Reserve 2 * size bytes of address space, then map the range
+    // over both halves.
+    char *base = (char*)mmap(0, 2 * (size_t)size, PROT_NONE,
+                             MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    void *first_copy = MAP_FAILED;
+    void *second_copy = MAP_FAILED;
+    if(base != (char*)MAP_FAILED) {
+      first_copy = mmap(base, size, PROT_READ | PROT_WRITE,
+                        MAP_SHARED | MAP_FIXED, fd, (off_t)d_offset);
+      if(first_copy != MAP_FAILED)
+        second_copy = mmap(base + size, size, PROT_READ | PROT_WRITE,
+                           MAP_SHARED | MAP_FIXED, fd, (off_t)d_offset);
+    }
+
+    if(first_copy == MAP_FAILED || second_copy == MAP_FAILED) {
+      perror("gr::vmcircbuf_mmap_arena: mmap");
+      if(base != (char*)MAP_FAILED)
+        munmap(base, 2 * (size_t)size);
+      s_free->insert(std::make_pair(size, std::make_pair(d_chunk, d_offset)));
+      throw std::runtime_error("gr::vmcircbuf_mmap_arena");
+    }
+
+    // Now remember the important stuff
+    d_base = base;
+    d_size = size;
+#endif
+  }
+
+  vmcircbuf_mmap_arena::~vmcircbuf_mmap_arena()
+  {
+#if defined(HAVE_MMAP)
+    gr::thread::scoped_lock guard(s_vm_mutex);
+
+#ifdef MADV_REMOVE
+    // Free the pages; the range reads back as zeros when reused.
+    madvise(d_base, d_size, MADV_REMOVE);
+#endif
+
+    if(munmap(d_base, 2 * (size_t)d_size) == -1) {
+      perror("gr::vmcircbuf_mmap_arena: munmap");
+    }
+
+    s_free->insert(std::make_pair(d_size, std::make_pair(d_chunk, d_offset)));
+#endif
+  }
+
+  // ----------------------------------------------------------------
+  //			The factory interface
+  // ----------------------------------------------------------------
+
+  gr::vmcircbuf_factory *vmcircbuf_mmap_arena_factory::s_the_factory = 0;
+
+  gr::vmcircbuf_factory *
+  vmcircbuf_mmap_arena_factory::singleton()
+  {
+    if(s_the_factory)
+      return s_the_factory;
+
+    s_the_factory = new gr::vmcircbuf_mmap_arena_factory();
+    return s_the_factory;
+  }
+
+  int
+  vmcircbuf_mmap_arena_factory::granularity()
+  {
+    return gr::pagesize();
+  }
+
+  gr::vmcircbuf *
+  vmcircbuf_mmap_arena_factory::make(int size)
+  {
+    try {
+      return new vmcircbuf_mmap_arena(size);
+    }
+    catch (...) {
+      return 0;
+    }
+  }
+
+} /* namespace gr */
@@ -0,0 +1,83 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2016 Free Software Foundation, Inc.
+ *
+ * This file is part of GNU Radio
+ *
+ * GNU Radio is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * GNU Radio is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GNU Radio; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+#ifndef GR_VMCIRCBUF_MMAP_ARENA_H
+#define GR_VMCIRCBUF_MMAP_ARENA_H
+
+#include <gnuradio/api.h>
+#include "vmcircbuf.h"
+
+namespace gr {
+
+  /*!
+   * \brief concrete class to implement circular buffers with mmap,
+   * carved out of a few large shared memory files
+   * \ingroup internal
+   *
+   * The other factories make and name a new shared memory object
+   * for every buffer, a dozen or so system calls each, and SysV
+   * segments run into the system's shmmni limit at a few thousand
+   * buffers. Here each buffer is a range of a 32 MiB memfd (or
+   * unlinked shm_open file) that is kept open: making one costs
+   * three mmap calls. Freed ranges have their pages released and
+   * are reused by the next buffer of the same size.
+   */
+  class GR_RUNTIME_API vmcircbuf_mmap_arena : public gr::vmcircbuf
+  {
+  public:
+    vmcircbuf_mmap_arena(int size);
+    virtual ~vmcircbuf_mmap_arena();
+
+  private:
+    int    d_chunk;		// which backing file
+    size_t d_offset;		// where in it
+  };
+
+  /*!
+   * \brief concrete factory for circular buffers built using mmap
+   * over shared memory files shared between buffers
+   */
+  class GR_RUNTIME_API vmcircbuf_mmap_arena_factory : public gr::vmcircbuf_factory
+  {
+  private:
+    static gr::vmcircbuf_factory *s_the_factory;
+
+  public:
+    static gr::vmcircbuf_factory *singleton();
+
+    virtual const char *name() const { return "gr::vmcircbuf_mmap_arena_factory"; }
+
+    /*!
+     * \brief return granularity of mapping, typically equal to page size
+     */
+    virtual int granularity();
+
+    /*!
+     * \brief return a gr::vmcircbuf, or 0 if unable.
+     *
+     * Call this to create a doubly mapped circular buffer.
+     */
+    virtual gr::vmcircbuf *make(int size);
+  };
+
+} /* namespace gr */
+
+#endif /* GR_VMCIRCBUF_MMAP_ARENA_H */
@@ -0,0 +1,200 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2016 Free Software Foundation, Inc.
+ *
+ * This file is part of GNU Radio
+ *
+ * GNU Radio is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * GNU Radio is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GNU Radio; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "vmcircbuf_mmap_hugetlb.h"
+#include "vmcircbuf_prefs.h"
+#include <stdexcept>
+#include <unistd.h>
+#ifdef HAVE_SYS_TYPES_H
+#include <sys/types.h>
+#endif
+#ifdef HAVE_SYS_MMAN_H
+#include <sys/mman.h>
+#endif
+#ifdef HAVE_MEMFD_CREATE
+#include <sys/syscall.h>
+#endif
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+// Not in older libc headers
+#ifndef MFD_CLOEXEC
+#define MFD_CLOEXEC	0x0001U
+#endif
+#ifndef MFD_HUGETLB
+#define MFD_HUGETLB	0x0004U
+#endif
+#ifndef MFD_HUGE_2MB
+#define MFD_HUGE_2MB	(21U << 26)
+#endif
+
+namespace gr {
+
+  static const int s_huge_page_size = 2 * (1 << 20);
+
+  // Most machines have no huge pages reserved, so failing is normal
+  // when all the factories are probed. Only complain when this
+  // factory was named in the vmcircbuf_default_factory pref.
+  static bool
+  selected()
+  {
+    const char *me = vmcircbuf_mmap_hugetlb_factory::singleton()->name();
+    char name[1024];
+    return (gr::vmcircbuf_prefs::get("vmcircbuf_default_factory", name, sizeof(name)) >= 0
+            && strncmp(name, me, strlen(me)) == 0);
+  }
+
+  static void
+  report(bool verbose, const char *what, int err)
+  {
+    if(!verbose)
+      return;
+    if(err)
+      fprintf(stderr, "gr::vmcircbuf_mmap_hugetlb: %s: %s\n", what, strerror(err));
+    else
+      fprintf(stderr, "gr::vmcircbuf_mmap_hugetlb: %s\n", what);
+  }
+
+  vmcircbuf_mmap_hugetlb::vmcircbuf_mmap_hugetlb(int size)
+    : gr::vmcircbuf(size)
+  {
+    // Reads the prefs, which take s_vm_mutex too.
+    bool verbose = selected();
+
+#if !defined(HAVE_MMAP) || !defined(HAVE_MEMFD_CREATE)
+    report(verbose, "mmap or memfd_create is not available", 0);
+    throw std::runtime_error("gr::vmcircbuf_mmap_hugetlb");
+#else
+    gr::thread::scoped_lock guard(s_vm_mutex);
+
+    if(size <= 0 || (size % s_huge_page_size) != 0) {
+      report(verbose, "invalid size", 0);
+      throw std::runtime_error("gr::vmcircbuf_mmap_hugetlb");
+    }
+
+    // An anonymous file of huge pages; no name to clean up afterwards.
+    int fd = syscall(SYS_memfd_create, "gnuradio",
+                     MFD_CLOEXEC | MFD_HUGETLB | MFD_HUGE_2MB);
+    if(fd == -1) {
+      report(verbose, "memfd_create", errno);
+      throw std::runtime_error("gr::vmcircbuf_mmap_hugetlb");
+    }
+
+    if(ftruncate(fd, (off_t)size) == -1) {
+      report(verbose, "ftruncate", errno);
+      close(fd);
+      throw std::runtime_error("gr::vmcircbuf_mmap_hugetlb");
+    }
+
+    // Reserve enough address space to find 2 * size bytes aligned
+    // to a huge page, then map the file over it twice.
+    size_t span = 2 * (size_t)size + s_huge_page_size;
+    char *reserved = (char*)mmap(0, span, PROT_NONE,
+                                 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if(reserved == MAP_FAILED) {
+      report(verbose, "mmap (reserve)", errno);
+      close(fd);
+      throw std::runtime_error("gr::vmcircbuf_mmap_hugetlb");
+    }
+
+    char *base = (char*)(((uintptr_t)reserved + s_huge_page_size - 1)
+                         & ~(uintptr_t)(s_huge_page_size - 1));
+
+    // Give back the unaligned slack on either side.
+    if(base > reserved)
+      munmap(reserved, base - reserved);
+    if(reserved + span > base + 2 * size)
+      munmap(base + 2 * size, (reserved + span) - (base + 2 * size));
+
+    void *first_copy = mmap(base, size, PROT_READ | PROT_WRITE,
+                            MAP_SHARED | MAP_FIXED, fd, (off_t)0);
+    void *second_copy = MAP_FAILED;
+    if(first_copy != MAP_FAILED)
+      second_copy = mmap(base + size, size, PROT_READ | PROT_WRITE,
+                         MAP_SHARED | MAP_FIXED, fd, (off_t)0);
+
+    int err = errno;
+    close(fd);    // fd no longer needed.  The mappings are retained.
+
+    if(first_copy == MAP_FAILED || second_copy == MAP_FAILED) {
+      report(verbose, "mmap", err);
+      munmap(base, 2 * size);
+      throw std::runtime_error("gr::vmcircbuf_mmap_hugetlb");
+    }
+
+    // Now remember the important stuff
+    d_base = base;
+    d_size = size;
+#endif
+  }
+
+  vmcircbuf_mmap_hugetlb::~vmcircbuf_mmap_hugetlb()
+  {
+#if defined(HAVE_MMAP)
+    gr::thread::scoped_lock guard(s_vm_mutex);
+
+    if(munmap(d_base, 2 * d_size) == -1) {
+      perror("gr::vmcircbuf_mmap_hugetlb: munmap");
+    }
+#endif
+  }
+
+  // ----------------------------------------------------------------
+  //			The factory interface
+  // ----------------------------------------------------------------
+
+  gr::vmcircbuf_factory *vmcircbuf_mmap_hugetlb_factory::s_the_factory = 0;
+
+  gr::vmcircbuf_factory *
+  vmcircbuf_mmap_hugetlb_factory::singleton()
+  {
+    if(s_the_factory)
+      return s_the_factory;
+
+    s_the_factory = new gr::vmcircbuf_mmap_hugetlb_factory();
+    return s_the_factory;
+  }
+
+  int
+  vmcircbuf_mmap_hugetlb_factory::granularity()
+  {
+    return s_huge_page_size;
+  }
+
+  gr::vmcircbuf *
+  vmcircbuf_mmap_hugetlb_factory::make(int size)
+  {
+    try {
+      return new vmcircbuf_mmap_hugetlb(size);
+    }
+    catch (...) {
+      return 0;
+    }
+  }
+
+} /* namespace gr */
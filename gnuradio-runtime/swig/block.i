@@ -50,6 +50,8 @@ class gr::block : public gr::basic_block
 
   int  output_multiple () const;
   double relative_rate () const;
+  void set_in_place(bool in_place);
+  bool in_place() const;
 
   bool start();
   bool stop();
@@ -97,6 +99,13 @@ class gr::block : public gr::basic_block
   float pc_work_time_var();
   float pc_work_time_total();
   float pc_throughput_avg();
+  float pc_msgs_dropped();
+  float pc_work_calls();
+  std::vector<float> pc_work_time_hist();
+  float pc_input_blocked_time();
+  float pc_output_blocked_time();
+  float pc_wakeups();
+  float pc_lock_wait_time();
 
   // Methods to manage processor affinity.
   void set_processor_affinity(const std::vector<int> &mask);
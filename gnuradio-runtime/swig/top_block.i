@@ -49,6 +49,8 @@ namespace gr {
 
     int max_noutput_items();
     void set_max_noutput_items(int nmax);
+    double reconfigure_time();
+    std::string thread_placement();
 
     gr::top_block_sptr to_top_block(); // Needed for Python type coercion
   };
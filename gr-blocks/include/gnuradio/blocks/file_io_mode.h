@@ -0,0 +1,52 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2016 Free Software Foundation, Inc.
+ *
+ * This file is part of GNU Radio
+ *
+ * GNU Radio is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * GNU Radio is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GNU Radio; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef INCLUDED_BLOCKS_FILE_IO_MODE_H
+#define INCLUDED_BLOCKS_FILE_IO_MODE_H
+
+namespace gr {
+  namespace blocks {
+
+    /*!
+     * How file_sink and file_source move data between the flowgraph
+     * and the file.
+     *
+     * The async modes keep several large reads or writes in flight
+     * from an I/O thread of their own, so that a slow or stalled disk
+     * doesn't stall the flowgraph while there's room to buffer.
+     * FILE_IO_DIRECT also bypasses the page cache (O_DIRECT), falling
+     * back to FILE_IO_ASYNC where the file system doesn't support it
+     * (e.g., tmpfs). FILE_IO_MMAP is for sources only: it maps the
+     * file and tells the kernel it's read sequentially; sinks use
+     * FILE_IO_ASYNC instead.
+     */
+    enum file_io_mode {
+      FILE_IO_STDIO = 0,	//!< stdio, in the block's own thread
+      FILE_IO_ASYNC,		//!< I/O thread, through the page cache
+      FILE_IO_DIRECT,		//!< I/O thread, aligned direct I/O
+      FILE_IO_MMAP		//!< map the file read-only (sources)
+    };
+
+  } /* namespace blocks */
+} /* namespace gr */
+
+#endif /* INCLUDED_BLOCKS_FILE_IO_MODE_H */
@@ -66,6 +66,13 @@ namespace gr {
      * the first header (at position 0 in the file) and reading where
      * the data segment starts plus the data segment size. Following
      * will either be a new header or EOF.
+     *
+     * Alongside the data, the sink writes an index to filename.idx
+     * as it goes: where each header and its data are, the item and
+     * time each segment starts at, and the item of every tag. It lets
+     * file_meta_source seek without reading through the headers.
+     * parse_file_metadata.build_index() (or the
+     * gr_index_file_metadata tool) rebuilds it for files without one.
      */
     class BLOCKS_API file_meta_sink : virtual public sync_block
     {
@@ -25,6 +25,7 @@
 
 #include <gnuradio/blocks/api.h>
 #include <gnuradio/sync_block.h>
+#include <stdint.h>
 
 namespace gr {
   namespace blocks {
@@ -47,6 +48,13 @@ namespace gr {
      *
      * Any item inside of the extra header dictionary is ready out and
      * made into a stream tag.
+     *
+     * If the file has an index (filename.idx, see file_meta_sink),
+     * the seek functions can jump to an item, a time or a tag. They
+     * look it up in the index, which is read when the file is opened,
+     * and take effect at the next call to work(): the header of the
+     * segment is read and its tags sent again from there, with
+     * rx_time moved forward to the item sought.
      */
     class BLOCKS_API file_meta_source : virtual public sync_block
     {
@@ -74,6 +82,26 @@ namespace gr {
 			const std::string &hdr_filename="") = 0;
       virtual void close() = 0;
       virtual void do_update() = 0;
+
+      /*!
+       * \brief Continue from item \p item of the file (counting
+       * from 0). Returns false if there is no index.
+       */
+      virtual bool seek_item(uint64_t item) = 0;
+
+      /*!
+       * \brief Continue from the item at rx_time \p secs + \p frac.
+       * Returns false if there is no index or the time is before the
+       * start of the file.
+       */
+      virtual bool seek_time(uint64_t secs, double frac) = 0;
+
+      /*!
+       * \brief Continue from the \p n'th (counting from 0) tag with
+       * key \p key. Returns false if there is no index or not that
+       * many tags.
+       */
+      virtual bool seek_tag(pmt::pmt_t key, size_t n=0) = 0;
     };
 
   } /* namespace blocks */
@@ -47,8 +47,11 @@ namespace gr {
        * \param filename name of the file to open and write output to.
        * \param append if true, data is appended to the file instead of
        *        overwriting the initial content.
+       * \param io_mode how to write the file (see file_io_mode);
+       *        FILE_IO_MMAP means FILE_IO_ASYNC here.
        */
-      static sptr make(size_t itemsize, const char *filename, bool append=false);
+      static sptr make(size_t itemsize, const char *filename, bool append=false,
+                       file_io_mode io_mode=FILE_IO_STDIO);
     };
 
   } /* namespace blocks */
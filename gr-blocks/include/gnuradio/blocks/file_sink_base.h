@@ -24,14 +24,20 @@
 #define INCLUDED_GR_FILE_SINK_BASE_H
 
 #include <gnuradio/blocks/api.h>
+#include <gnuradio/blocks/file_io_mode.h>
 #include <boost/thread.hpp>
 #include <cstdio>
 
 namespace gr {
   namespace blocks {
 
+    class file_writer;
+
     /*!
      * \brief Common base class for file sinks
+     *
+     * In FILE_IO_STDIO mode output goes through d_fp; in the others
+     * through d_writer, and d_fp stays null.
      */
     class BLOCKS_API file_sink_base
     {
@@ -43,12 +49,18 @@ namespace gr {
       boost::mutex d_mutex;
       bool         d_unbuffered;
       bool         d_append;
+      file_io_mode d_io_mode;
+      file_writer *d_writer;    // current writer, in the async modes
+      file_writer *d_new_writer;
 
     protected:
-      file_sink_base(const char *filename, bool is_binary, bool append);
+      file_sink_base(const char *filename, bool is_binary, bool append,
+                     file_io_mode io_mode=FILE_IO_STDIO);
+
+      bool open_writer(const char *filename);
 
     public:
-      file_sink_base() {}
+      file_sink_base() : d_writer(0), d_new_writer(0) {}
       ~file_sink_base();
 
       /*!
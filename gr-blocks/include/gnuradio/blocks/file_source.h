@@ -24,6 +24,7 @@
 #define INCLUDED_BLOCKS_FILE_SOURCE_H
 
 #include <gnuradio/blocks/api.h>
+#include <gnuradio/blocks/file_io_mode.h>
 #include <gnuradio/sync_block.h>
 
 namespace gr {
@@ -54,8 +55,10 @@ namespace gr {
        * \param itemsize	the size of each item in the file, in bytes
        * \param filename	name of the file to source from
        * \param repeat	repeat file from start
+       * \param io_mode	how to read the file (see file_io_mode)
        */
-      static sptr make(size_t itemsize, const char *filename, bool repeat = false);
+      static sptr make(size_t itemsize, const char *filename, bool repeat = false,
+                       file_io_mode io_mode = FILE_IO_STDIO);
 
       /*!
        * \brief seek file to \p seek_point relative to \p whence
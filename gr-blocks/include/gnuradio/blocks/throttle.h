@@ -42,19 +42,59 @@ namespace gr {
      * precisely controlling the rate of samples. That should be
      * controlled by a source or sink tied to sample clock. E.g., a
      * USRP or audio card.
+     *
+     * By default, each call to work() sleeps until the items already
+     * passed are due, then passes everything it was given at once.
+     * With \p precise set, it instead sleeps until an absolute
+     * deadline on the monotonic clock (clock_nanosleep() where
+     * available), so wakeup errors don't add up, and with \p
+     * spin_time > 0 busy-waits for the last spin_time seconds before
+     * it to wake up on time rather than whenever the kernel gets
+     * around to it. Either way, \p max_burst > 0 caps the items per
+     * call to work(), which is how bursty the output is.
+     *
+     * About once a second the block publishes a dictionary on its
+     * "stats" message port describing how well it kept pace since the
+     * last report: "bursts" (calls to work()), "late_mean",
+     * "late_max" and "jitter" (mean, maximum and standard deviation in
+     * seconds of how late each burst went out), and "rate" (items per
+     * second).
      */
     class BLOCKS_API throttle : virtual public sync_block
     {
     public:
       typedef boost::shared_ptr<throttle> sptr;
 
-      static sptr make(size_t itemsize, double samples_per_sec, bool ignore_tags=true);
+      /*!
+       * \param itemsize        The size (in bytes) of the item datatype
+       * \param samples_per_sec Rate to pass items at
+       * \param ignore_tags     Ignore "rx_rate" tags, which otherwise
+       *                        set the rate
+       * \param precise         Sleep until absolute deadlines
+       * \param max_burst       Most items per call to work(); 0 for no limit
+       * \param spin_time       Seconds to busy-wait before each deadline
+       *                        (precise only)
+       */
+      static sptr make(size_t itemsize, double samples_per_sec, bool ignore_tags=true,
+                       bool precise=false, int max_burst=0, double spin_time=0.0);
 
       //! Sets the sample rate in samples per second.
       virtual void set_sample_rate(double rate) = 0;
 
       //! Get the sample rate in samples per second.
       virtual double sample_rate() const = 0;
+
+      //! Sets the most items passed per call to work(); 0 for no limit.
+      virtual void set_max_burst(int max_burst) = 0;
+
+      //! Get the most items passed per call to work().
+      virtual int max_burst() const = 0;
+
+      //! Sets how long (in seconds) to busy-wait before each deadline.
+      virtual void set_spin_time(double spin_time) = 0;
+
+      //! Get how long (in seconds) to busy-wait before each deadline.
+      virtual double spin_time() const = 0;
     };
 
   } /* namespace blocks */
@@ -0,0 +1,63 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2016 Free Software Foundation, Inc.
+ *
+ * This file is part of GNU Radio
+ *
+ * GNU Radio is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * GNU Radio is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GNU Radio; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef INCLUDED_BLOCKS_UDP_HEADER_H
+#define INCLUDED_BLOCKS_UDP_HEADER_H
+
+#include <stddef.h>
+
+namespace gr {
+  namespace blocks {
+
+    /*!
+     * What udp_sink puts in front of each datagram's payload, and
+     * udp_source expects there.
+     *
+     * UDP_HEADER_SEQNO is three big-endian 64-bit integers: the
+     * datagram's sequence number, the number of payload bytes sent
+     * before it, and the sender's clock (ns since the Unix epoch) when
+     * it was sent. Both count from 0 again when the sink connects. The
+     * payload of each datagram shrinks by UDP_SEQNO_HEADER_SIZE to
+     * stay within payload_size.
+     */
+    enum udp_header_type {
+      UDP_HEADER_NONE = 0,	//!< raw payload
+      UDP_HEADER_SEQNO		//!< sequence number, offset, time stamp
+    };
+
+    const size_t UDP_SEQNO_HEADER_SIZE = 24;
+
+    /*!
+     * What udp_source does where datagrams are missing. Either way,
+     * the first item after the gap gets an "rx_time" tag with the
+     * sender's time stamp for it, and a "dropped_items" tag (uint64)
+     * says how many items were lost.
+     */
+    enum udp_gap_mode {
+      UDP_GAP_TAG = 0,	//!< leave the items out; both tags on the first item after
+      UDP_GAP_FILL	//!< zeros in their place, "dropped_items" on the first zero
+    };
+
+  } /* namespace blocks */
+} /* namespace gr */
+
+#endif /* INCLUDED_BLOCKS_UDP_HEADER_H */
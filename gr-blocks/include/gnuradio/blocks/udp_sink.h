@@ -24,6 +24,7 @@
 #define INCLUDED_GR_UDP_SINK_H
 
 #include <gnuradio/blocks/api.h>
+#include <gnuradio/blocks/udp_header.h>
 #include <gnuradio/sync_block.h>
 
 namespace gr {
@@ -32,6 +33,16 @@ namespace gr {
     /*!
      * \brief Write stream to an UDP socket.
      * \ingroup networking_tools_blk
+     *
+     * \details
+     * On Linux, each call to work() hands the kernel its datagrams in
+     * batches with sendmmsg().
+     *
+     * With \p header set to UDP_HEADER_SEQNO, every datagram starts
+     * with a sequence number, the stream offset of its payload and a
+     * time stamp, so that udp_source can find and mark lost datagrams.
+     * The payload of each datagram is then payload_size -
+     * UDP_SEQNO_HEADER_SIZE bytes at most.
      */
     class BLOCKS_API udp_sink : virtual public sync_block
     {
@@ -49,10 +60,12 @@ namespace gr {
        * \param payload_size UDP payload size by default set to
        *                     1472 = (1500 MTU - (8 byte UDP header) - (20 byte IP header))
        * \param eof          Send zero-length packet on disconnect
+       * \param header       Header to put on each datagram (see udp_header_type)
        */
       static sptr make(size_t itemsize,
                        const std::string &host, int port,
-                       int payload_size=1472, bool eof=true);
+                       int payload_size=1472, bool eof=true,
+                       udp_header_type header=UDP_HEADER_NONE);
 
       /*! \brief return the PAYLOAD_SIZE of the socket */
       virtual int payload_size() = 0;
@@ -64,6 +77,7 @@ namespace gr {
        * \param port         Destination port to connect to on receiving host
        *
        * Calls disconnect() to terminate any current connection first.
+       * Sequence numbers and offsets in the header start over at 0.
        */
       virtual void connect(const std::string &host, int port) = 0;
 
@@ -24,6 +24,7 @@
 #define INCLUDED_GR_UDP_SOURCE_H
 
 #include <gnuradio/blocks/api.h>
+#include <gnuradio/blocks/udp_header.h>
 #include <gnuradio/sync_block.h>
 
 namespace gr {
@@ -32,6 +33,36 @@ namespace gr {
     /*!
      * \brief Read stream from an UDP socket.
      * \ingroup networking_tools_blk
+     *
+     * \details
+     * On Linux, datagrams are received in batches with recvmmsg() by
+     * \p nthreads threads, each with its own socket bound to the
+     * address with SO_REUSEPORT. The kernel hands each flow (sender
+     * address and port) to one of the sockets, so more than one thread
+     * only helps with more than one sender; the threads' batches are
+     * merged in the order they arrive. Elsewhere, there is one
+     * receive thread using boost::asio.
+     *
+     * About once a second the block publishes a dictionary on its
+     * "stats" message port with the datagrams received and dropped so
+     * far ("packets", "dropped") and per second since the last report
+     * ("packets_per_sec", "dropped_per_sec"). Drops are those of the
+     * kernel's socket queue on Linux, and of the block's own buffer
+     * elsewhere.
+     *
+     * With \p header set to UDP_HEADER_SEQNO (Linux only), each
+     * datagram must start with the header udp_sink adds in that mode.
+     * The block then notices datagrams that went missing and, per \p
+     * gap_mode, leaves those items out or puts zeros in their place.
+     * Either way it tags the gap with "dropped_items" (uint64, the
+     * number of items lost) and the first item after it with
+     * "rx_time" (a tuple of uint64 seconds and double fractional
+     * seconds: the sender's clock when it sent that datagram), and
+     * the "stats" dictionary gains "dropped_items". The first item
+     * received is tagged with "rx_time" too. Late and duplicate
+     * datagrams are dropped; gaps longer than 64 MiB are never
+     * zero-filled. This expects a single sender: a sequence number of
+     * 0 means it started over.
      */
     class BLOCKS_API udp_source : virtual public sync_block
     {
@@ -51,11 +82,18 @@ namespace gr {
        * \param payload_size UDP payload size by default set to 1472 =
        *                     (1500 MTU - (8 byte UDP header) - (20 byte IP header))
        * \param eof          Interpret zero-length packet as EOF (default: true)
+       * \param nthreads     Number of receive threads (Linux only)
+       * \param header       Header on each datagram (see udp_header_type)
+       * \param gap_mode     What to output for missing datagrams; only
+       *                     used with a header
        */
       static sptr make(size_t itemsize,
                        const std::string &host, int port,
                        int payload_size=1472,
-                       bool eof=true);
+                       bool eof=true,
+                       int nthreads=1,
+                       udp_header_type header=UDP_HEADER_NONE,
+                       udp_gap_mode gap_mode=UDP_GAP_TAG);
 
       /*! \brief Change the connection to a new destination
        *
@@ -76,6 +114,15 @@ namespace gr {
 
       /*! \brief return the port number of the socket */
       virtual int get_port() = 0;
+
+      /*! \brief Number of datagrams received so far. */
+      virtual uint64_t packets_received() = 0;
+
+      /*! \brief Number of datagrams dropped so far. */
+      virtual uint64_t packets_dropped() = 0;
+
+      /*! \brief Number of items lost in gaps so far (header mode only). */
+      virtual uint64_t dropped_items() = 0;
     };
 
   } /* namespace blocks */
@@ -51,6 +51,33 @@ CHECK_CXX_SOURCE_COMPILES("
 )
 GR_ADD_COND_DEF(HAVE_SELECT)
 
+########################################################################
+CHECK_CXX_SOURCE_COMPILES("
+    #include <sys/socket.h>
+    int main(){struct mmsghdr m; recvmmsg(0, &m, 1, MSG_WAITFORONE, 0); return 0;}
+    " HAVE_RECVMMSG
+)
+GR_ADD_COND_DEF(HAVE_RECVMMSG)
+
+CHECK_CXX_SOURCE_COMPILES("
+    #include <sys/socket.h>
+    int main(){struct mmsghdr m; sendmmsg(0, &m, 1, 0); return 0;}
+    " HAVE_SENDMMSG
+)
+GR_ADD_COND_DEF(HAVE_SENDMMSG)
+
+########################################################################
+IF(LINUX)
+    SET(CMAKE_REQUIRED_LIBRARIES rt)
+ENDIF(LINUX)
+CHECK_CXX_SOURCE_COMPILES("
+    #include <time.h>
+    int main(){struct timespec ts = {0, 0}; clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, 0); return 0;}
+    " HAVE_CLOCK_NANOSLEEP
+)
+SET(CMAKE_REQUIRED_LIBRARIES)
+GR_ADD_COND_DEF(HAVE_CLOCK_NANOSLEEP)
+
 ########################################################################
 CHECK_INCLUDE_FILE_CXX(windows.h HAVE_WINDOWS_H)
 IF(HAVE_WINDOWS_H)
@@ -42,6 +42,7 @@ namespace gr {
                    io_signature::make (1, 1, sizeof(float))),
         d_k(k)
     {
+      set_in_place(true);
     }
 
     int
@@ -0,0 +1,608 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2016 Free Software Foundation, Inc.
+ *
+ * This file is part of GNU Radio
+ *
+ * GNU Radio is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * GNU Radio is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GNU Radio; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "file_io.h"
+#include <volk/volk.h>
+#include <boost/bind.hpp>
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+
+#ifdef HAVE_IO_H
+#include <io.h>
+#endif
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+#ifdef HAVE_SYS_MMAN_H
+#include <sys/mman.h>
+#endif
+
+namespace gr {
+  namespace blocks {
+
+    // Alignment of direct I/O buffers, offsets and sizes; covers any
+    // logical block size up to 4 KiB.
+    static const size_t s_align = 4096;
+
+    // How far ahead of a mapped file's reader we ask the kernel to read.
+    static const uint64_t s_read_ahead = 16 << 20;
+
+    int
+    file_io_open(const char *filename, int flags, file_io_mode mode, bool &direct)
+    {
+      direct = false;
+      if(mode == FILE_IO_DIRECT) {
+#ifdef O_DIRECT
+        int fd = ::open(filename, flags | O_DIRECT, 0664);
+        if(fd >= 0) {
+          direct = true;
+          return fd;
+        }
+        if(errno != EINVAL) {
+          perror(filename);
+          return -1;
+        }
+#endif
+        fprintf(stderr, "%s: no direct I/O here, going through the page cache\n",
+                filename);
+      }
+
+      int fd = ::open(filename, flags, 0664);
+      if(fd < 0)
+        perror(filename);
+      return fd;
+    }
+
+    static bool
+    write_at(int fd, const char *data, size_t len, uint64_t offset)
+    {
+      if(lseek(fd, offset, SEEK_SET) == (off_t)-1)
+        return false;
+      while(len > 0) {
+        ssize_t n = ::write(fd, data, len);
+        if(n < 0) {
+          if(errno == EINTR)
+            continue;
+          return false;
+        }
+        data += n;
+        len -= n;
+      }
+      return true;
+    }
+
+    // Reads len bytes, fewer only at the end of the file (or of
+    // size, where a direct read can't go on from an unaligned offset).
+    static ssize_t
+    read_at(int fd, char *data, size_t len, uint64_t offset, uint64_t size)
+    {
+      if(lseek(fd, offset, SEEK_SET) == (off_t)-1)
+        return -1;
+      size_t got = 0;
+      while(got < len && offset + got < size) {
+        ssize_t n = ::read(fd, data + got, len - got);
+        if(n < 0) {
+          if(errno == EINTR)
+            continue;
+          return -1;
+        }
+        if(n == 0)
+          break;
+        got += n;
+      }
+      return got;
+    }
+
+    static std::vector<char*>
+    alloc_buffers(size_t nbuffers, size_t buffer_size)
+    {
+      std::vector<char*> buffers;
+      for(size_t i = 0; i < nbuffers; i++) {
+        char *b = (char*)volk_malloc(buffer_size, s_align);
+        if(!b) {
+          for(size_t j = 0; j < buffers.size(); j++)
+            volk_free(buffers[j]);
+          throw std::bad_alloc();
+        }
+        buffers.push_back(b);
+      }
+      return buffers;
+    }
+
+    static void
+    free_buffers(std::vector<char*> &buffers)
+    {
+      for(size_t i = 0; i < buffers.size(); i++)
+        volk_free(buffers[i]);
+      buffers.clear();
+    }
+
+    // ------------------------------------------------------------------
+
+    file_writer::file_writer(int fd, uint64_t offset, bool direct,
+                             size_t nbuffers, size_t buffer_size)
+      : d_fd(fd), d_direct(direct),
+        d_buffer_size(std::max(s_align, buffer_size - buffer_size % s_align)),
+        d_busy(std::max((size_t)2, nbuffers), false),
+        d_current(0), d_fill(0), d_offset(offset), d_done(false)
+    {
+      try {
+        d_buffers = alloc_buffers(d_busy.size(), d_buffer_size);
+      }
+      catch(...) {
+        ::close(d_fd);
+        throw;
+      }
+
+      // Direct writes have to start at an aligned offset: begin with
+      // the partial block already at the end of the file.
+      if(d_direct && offset % s_align) {
+        d_offset = offset - offset % s_align;
+        d_fill = offset - d_offset;
+        if(read_at(d_fd, d_buffers[0], s_align, d_offset, offset) < (ssize_t)d_fill) {
+          std::string error = strerror(errno);
+          free_buffers(d_buffers);
+          ::close(d_fd);
+          throw std::runtime_error("file_writer: can't read the end of the file: " + error);
+        }
+      }
+
+      d_thread = boost::shared_ptr<gr::thread::thread>
+        (new gr::thread::thread(boost::bind(&file_writer::run, this)));
+    }
+
+    file_writer::~file_writer()
+    {
+      try {
+        close();
+      }
+      catch(std::exception &e) {
+        std::cerr << "file_writer: " << e.what() << std::endl;
+      }
+      free_buffers(d_buffers);
+    }
+
+    void
+    file_writer::write(const void *data, size_t nbytes)
+    {
+      check_error();
+
+      const char *p = (const char*)data;
+      while(nbytes > 0) {
+        size_t n = std::min(nbytes, d_buffer_size - d_fill);
+        memcpy(d_buffers[d_current] + d_fill, p, n);
+        d_fill += n;
+        p += n;
+        nbytes -= n;
+
+        if(d_fill == d_buffer_size) {
+          submit(d_buffer_size, 0);
+          d_offset += d_buffer_size;
+          d_fill = 0;
+          d_current = (d_current + 1) % d_buffers.size();
+          wait_idle(d_current);
+        }
+      }
+    }
+
+    void
+    file_writer::flush()
+    {
+      if(d_fill > 0) {
+        size_t len = d_fill;
+        uint64_t truncate = 0;
+        if(d_direct && d_fill % s_align) {
+          len = d_fill + s_align - d_fill % s_align;
+          memset(d_buffers[d_current] + d_fill, 0, len - d_fill);
+          truncate = d_offset + d_fill;
+        }
+        submit(len, truncate);
+      }
+
+      for(size_t i = 0; i < d_busy.size(); i++)
+        wait_idle(i);
+
+      // An unfinished direct block is written again, with the rest of
+      // its data, next time.
+      size_t done = d_direct ? d_fill - d_fill % s_align : d_fill;
+      memmove(d_buffers[d_current], d_buffers[d_current] + done, d_fill - done);
+      d_offset += done;
+      d_fill -= done;
+    }
+
+    void
+    file_writer::close()
+    {
+      if(d_fd < 0)
+        return;
+
+      std::string error;
+      try {
+        flush();
+      }
+      catch(std::runtime_error &e) {
+        error = e.what();
+      }
+
+      {
+        gr::thread::scoped_lock guard(d_mutex);
+        d_done = true;
+        d_cond.notify_all();
+      }
+      d_thread->join();
+
+      if(::close(d_fd) < 0 && error.empty())
+        error = std::string("file_writer: close failed: ") + strerror(errno);
+      d_fd = -1;
+
+      if(!error.empty())
+        throw std::runtime_error(error);
+    }
+
+    void
+    file_writer::submit(size_t len, uint64_t truncate)
+    {
+      job j;
+      j.index = d_current;
+      j.len = len;
+      j.offset = d_offset;
+      j.truncate = truncate;
+
+      gr::thread::scoped_lock guard(d_mutex);
+      d_busy[d_current] = true;
+      d_queue.push_back(j);
+      d_cond.notify_all();
+    }
+
+    void
+    file_writer::wait_idle(size_t index)
+    {
+      gr::thread::scoped_lock guard(d_mutex);
+      while(d_busy[index] && d_error.empty())
+        d_cond.wait(guard);
+      if(!d_error.empty())
+        throw std::runtime_error(d_error);
+    }
+
+    void
+    file_writer::check_error()
+    {
+      gr::thread::scoped_lock guard(d_mutex);
+      if(!d_error.empty())
+        throw std::runtime_error(d_error);
+    }
+
+    void
+    file_writer::run()
+    {
+      for(;;) {
+        job j;
+        bool failed;
+        {
+          gr::thread::scoped_lock guard(d_mutex);
+          while(d_queue.empty() && !d_done)
+            d_cond.wait(guard);
+          if(d_queue.empty())
+            return;
+          j = d_queue.front();
+          d_queue.pop_front();
+          failed = !d_error.empty();
+        }
+
+        // Once a write failed, the rest are only handed back.
+        std::string error;
+        if(!failed) {
+          if(!write_at(d_fd, d_buffers[j.index], j.len, j.offset))
+            error = std::string("file_writer: write failed: ") + strerror(errno);
+#ifdef O_DIRECT
+          else if(j.truncate && ftruncate(d_fd, j.truncate) < 0)
+            error = std::string("file_writer: truncate failed: ") + strerror(errno);
+#endif
+        }
+
+        gr::thread::scoped_lock guard(d_mutex);
+        d_busy[j.index] = false;
+        if(d_error.empty())
+          d_error = error;
+        d_cond.notify_all();
+      }
+    }
+
+    // ------------------------------------------------------------------
+
+    file_reader *
+    file_reader::make(int fd, file_io_mode mode, bool direct)
+    {
+      try {
+        if(mode == FILE_IO_MMAP) {
+          try {
+            return new mmap_file_reader(fd);
+          }
+          catch(std::runtime_error &e) {
+            std::cerr << "file_reader: " << e.what()
+                      << "; reading it from an I/O thread instead" << std::endl;
+          }
+        }
+        return new async_file_reader(fd, direct);
+      }
+      catch(...) {
+        ::close(fd);
+        throw;
+      }
+    }
+
+    static uint64_t
+    file_size(int fd)
+    {
+      struct stat st;
+      if(fstat(fd, &st) < 0)
+        throw std::runtime_error(std::string("file_reader: fstat failed: ") + strerror(errno));
+      return st.st_size;
+    }
+
+    async_file_reader::async_file_reader(int fd, bool direct,
+                                         size_t nbuffers, size_t buffer_size)
+      : d_fd(fd),
+        d_buffer_size(std::max(s_align, buffer_size - buffer_size % s_align)),
+        d_read_index(0), d_fill_index(0), d_next(0), d_generation(0),
+        d_done(false)
+    {
+      d_size = file_size(fd);
+
+      std::vector<char*> data = alloc_buffers(std::max((size_t)2, nbuffers), d_buffer_size);
+      for(size_t i = 0; i < data.size(); i++) {
+        buffer b;
+        b.data = data[i];
+        b.len = 0;
+        b.offset = 0;
+        b.state = EMPTY;
+        d_buffers.push_back(b);
+      }
+
+#ifdef POSIX_FADV_SEQUENTIAL
+      if(!direct)
+        posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+
+      d_thread = boost::shared_ptr<gr::thread::thread>
+        (new gr::thread::thread(boost::bind(&async_file_reader::run, this)));
+    }
+
+    async_file_reader::~async_file_reader()
+    {
+      {
+        gr::thread::scoped_lock guard(d_mutex);
+        d_done = true;
+        d_cond.notify_all();
+      }
+      d_thread->join();
+
+      ::close(d_fd);
+      for(size_t i = 0; i < d_buffers.size(); i++)
+        volk_free(d_buffers[i].data);
+    }
+
+    size_t
+    async_file_reader::read(void *data, size_t nbytes)
+    {
+      char *p = (char*)data;
+      size_t copied = 0;
+
+      gr::thread::scoped_lock guard(d_mutex);
+      while(copied < nbytes && d_position < d_size) {
+        buffer &b = d_buffers[d_read_index];
+        while(b.state != FULL && d_error.empty())
+          d_cond.wait(guard);
+        if(!d_error.empty())
+          throw std::runtime_error(d_error);
+
+        // A short buffer short of size() means the file shrank.
+        uint64_t end = b.offset + b.len;
+        if(d_position >= end) {
+          d_size = d_position;
+          break;
+        }
+
+        // Only we empty a full buffer, and seek() needs our caller's
+        // lock: copy without holding up the I/O thread.
+        size_t n = std::min((uint64_t)(nbytes - copied), end - d_position);
+        const char *src = b.data + (d_position - b.offset);
+        guard.unlock();
+        memcpy(p + copied, src, n);
+        guard.lock();
+
+        copied += n;
+        d_position += n;
+        if(d_position == end) {
+          b.state = EMPTY;
+          d_read_index = (d_read_index + 1) % d_buffers.size();
+          d_cond.notify_all();
+        }
+      }
+
+      return copied;
+    }
+
+    void
+    async_file_reader::seek(uint64_t offset)
+    {
+      gr::thread::scoped_lock guard(d_mutex);
+
+      // Whatever the I/O thread is reading now, it throws away.
+      d_generation++;
+      for(size_t i = 0; i < d_buffers.size(); i++) {
+        if(d_buffers[i].state == FULL)
+          d_buffers[i].state = EMPTY;
+      }
+
+      d_fill_index = d_read_index;
+      d_next = offset - offset % s_align;
+      d_position = std::min(offset, d_size);
+      d_cond.notify_all();
+    }
+
+    void
+    async_file_reader::run()
+    {
+      for(;;) {
+        size_t index;
+        uint64_t offset, size;
+        unsigned generation;
+        {
+          gr::thread::scoped_lock guard(d_mutex);
+          while(!d_done && (d_next >= d_size || !d_error.empty() ||
+                            d_buffers[d_fill_index].state != EMPTY))
+            d_cond.wait(guard);
+          if(d_done)
+            return;
+
+          index = d_fill_index;
+          offset = d_next;
+          size = d_size;
+          generation = d_generation;
+          d_buffers[index].state = READING;
+          d_fill_index = (index + 1) % d_buffers.size();
+          d_next += d_buffer_size;
+        }
+
+        ssize_t n = read_at(d_fd, d_buffers[index].data, d_buffer_size, offset, size);
+        std::string error;
+        if(n < 0)
+          error = std::string("file_reader: read failed: ") + strerror(errno);
+
+        gr::thread::scoped_lock guard(d_mutex);
+        buffer &b = d_buffers[index];
+        if(generation != d_generation)
+          b.state = EMPTY;
+        else if(n < 0) {
+          b.state = EMPTY;
+          d_error = error;
+        }
+        else {
+          b.len = n;
+          b.offset = offset;
+          b.state = FULL;
+        }
+        d_cond.notify_all();
+      }
+    }
+
+    // ------------------------------------------------------------------
+
+#ifdef HAVE_SYS_MMAN_H
+
+    mmap_file_reader::mmap_file_reader(int fd)
+      : d_fd(fd), d_base(0), d_advised(0)
+    {
+      d_size = file_size(fd);
+      if(d_size == 0)
+        return;
+      if(d_size != (size_t)d_size)
+        throw std::runtime_error("mmap_file_reader: file too large to map");
+
+      void *base = mmap(0, d_size, PROT_READ, MAP_SHARED, fd, 0);
+      if(base == MAP_FAILED)
+        throw std::runtime_error(std::string("mmap_file_reader: mmap failed: ") + strerror(errno));
+      d_base = (char*)base;
+
+#ifdef MADV_SEQUENTIAL
+      madvise(d_base, d_size, MADV_SEQUENTIAL);
+#endif
+      advise(0);
+    }
+
+    mmap_file_reader::~mmap_file_reader()
+    {
+      if(d_base)
+        munmap(d_base, d_size);
+      ::close(d_fd);
+    }
+
+    // Keep asking for the next s_read_ahead bytes, half of it at a time.
+    void
+    mmap_file_reader::advise(uint64_t position)
+    {
+      if(d_advised >= d_size || position + s_read_ahead / 2 < d_advised)
+        return;
+
+      uint64_t end = std::min(position + s_read_ahead, d_size);
+#ifdef MADV_WILLNEED
+      static const uint64_t page = sysconf(_SC_PAGESIZE);
+      uint64_t start = d_advised - d_advised % page;
+      madvise(d_base + start, end - start, MADV_WILLNEED);
+#endif
+      d_advised = end;
+    }
+
+#else
+
+    mmap_file_reader::mmap_file_reader(int fd)
+      : d_fd(fd), d_base(0), d_advised(0)
+    {
+      throw std::runtime_error("mmap_file_reader: no mmap on this platform");
+    }
+
+    mmap_file_reader::~mmap_file_reader()
+    {
+    }
+
+    void
+    mmap_file_reader::advise(uint64_t position)
+    {
+    }
+
+#endif /* HAVE_SYS_MMAN_H */
+
+    size_t
+    mmap_file_reader::read(void *data, size_t nbytes)
+    {
+      if(d_position >= d_size)
+        return 0;
+
+      size_t n = std::min((uint64_t)nbytes, d_size - d_position);
+      advise(d_position);
+      memcpy(data, d_base + d_position, n);
+      d_position += n;
+      return n;
+    }
+
+    void
+    mmap_file_reader::seek(uint64_t offset)
+    {
+      d_position = std::min(offset, d_size);
+      d_advised = d_position;
+      advise(d_position);
+    }
+
+  } /* namespace blocks */
+} /* namespace gr */
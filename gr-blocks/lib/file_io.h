@@ -0,0 +1,207 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2016 Free Software Foundation, Inc.
+ *
+ * This file is part of GNU Radio
+ *
+ * GNU Radio is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * GNU Radio is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GNU Radio; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef INCLUDED_BLOCKS_FILE_IO_H
+#define INCLUDED_BLOCKS_FILE_IO_H
+
+#include <gnuradio/blocks/file_io_mode.h>
+#include <gnuradio/thread/thread.h>
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+#include <stdint.h>
+#include <deque>
+#include <string>
+#include <vector>
+
+namespace gr {
+  namespace blocks {
+
+    /*!
+     * \brief Open \p filename for \p mode, adding O_DIRECT to \p
+     * flags for FILE_IO_DIRECT where the file system supports it.
+     *
+     * Returns the file descriptor, or -1 (after printing why) on
+     * failure. \p direct is set if the file was opened with O_DIRECT.
+     */
+    int file_io_open(const char *filename, int flags, file_io_mode mode, bool &direct);
+
+    /*!
+     * \brief Writes a file from its own thread, several large buffers
+     * at a time.
+     *
+     * write() copies into the current buffer; each full one goes to
+     * the I/O thread, and write() only waits when all of them are
+     * still being written. With \p direct, buffers are aligned and
+     * written at aligned offsets; a partial last block is written
+     * padded and the file truncated behind it. Errors in the I/O
+     * thread are thrown from the next write(), flush() or close().
+     */
+    class file_writer : boost::noncopyable
+    {
+    public:
+      /*!
+       * Write \p fd (which file_writer closes, even if this throws)
+       * from \p offset on.
+       */
+      file_writer(int fd, uint64_t offset, bool direct,
+                  size_t nbuffers=4, size_t buffer_size=1 << 20);
+      ~file_writer();
+
+      void write(const void *data, size_t nbytes);
+
+      //! Write out what's buffered and wait until it's done.
+      void flush();
+
+      //! Flush and close the file.
+      void close();
+
+    private:
+      struct job {
+        size_t   index;		// buffer
+        size_t   len;
+        uint64_t offset;
+        uint64_t truncate;	// file size to truncate to afterwards, or 0
+      };
+
+      int                d_fd;
+      bool               d_direct;
+      size_t             d_buffer_size;
+      std::vector<char*> d_buffers;
+      std::vector<bool>  d_busy;	// handed to the I/O thread
+      size_t             d_current;	// buffer being filled
+      size_t             d_fill;	// bytes in it
+      uint64_t           d_offset;	// file offset of its first byte
+
+      gr::thread::mutex              d_mutex;	// protects d_busy, d_queue, d_error, d_done
+      gr::thread::condition_variable d_cond;
+      std::deque<job>                d_queue;
+      std::string                    d_error;
+      bool                           d_done;
+      boost::shared_ptr<gr::thread::thread> d_thread;
+
+      void submit(size_t len, uint64_t truncate);
+      void wait_idle(size_t index);
+      void check_error();
+      void run();
+    };
+
+    /*!
+     * \brief Sequential reader behind file_source's FILE_IO_ASYNC,
+     * FILE_IO_DIRECT and FILE_IO_MMAP modes.
+     *
+     * Not thread safe: the caller serializes read() and seek().
+     */
+    class file_reader : boost::noncopyable
+    {
+    public:
+      virtual ~file_reader() {}
+
+      //! Copy up to \p nbytes to \p data; returns how many, 0 at the end.
+      virtual size_t read(void *data, size_t nbytes) = 0;
+
+      //! Continue reading at \p offset, at most size().
+      virtual void seek(uint64_t offset) = 0;
+
+      uint64_t position() const { return d_position; }
+      uint64_t size() const { return d_size; }
+
+      /*!
+       * Read \p fd (which the reader closes, even if this throws) in
+       * \p mode; FILE_IO_MMAP falls back to FILE_IO_ASYNC where the
+       * file can't be mapped.
+       */
+      static file_reader *make(int fd, file_io_mode mode, bool direct);
+
+    protected:
+      uint64_t d_position;
+      uint64_t d_size;
+
+      file_reader() : d_position(0), d_size(0) {}
+    };
+
+    /*!
+     * \brief Reads a file ahead of the flowgraph from its own thread,
+     * several large (aligned, if \p direct) buffers at a time.
+     */
+    class async_file_reader : public file_reader
+    {
+    public:
+      async_file_reader(int fd, bool direct,
+                        size_t nbuffers=4, size_t buffer_size=1 << 20);
+      ~async_file_reader();
+
+      size_t read(void *data, size_t nbytes);
+      void seek(uint64_t offset);
+
+    private:
+      enum buffer_state { EMPTY, READING, FULL };
+
+      struct buffer {
+        char        *data;
+        size_t       len;
+        uint64_t     offset;
+        buffer_state state;
+      };
+
+      int                 d_fd;
+      size_t              d_buffer_size;
+      std::vector<buffer> d_buffers;
+      size_t              d_read_index;	// buffer read() takes from next
+
+      gr::thread::mutex              d_mutex;	// protects everything below and the buffer states
+      gr::thread::condition_variable d_cond;
+      size_t                         d_fill_index;	// buffer the I/O thread fills next
+      uint64_t                       d_next;	// file offset it reads next
+      unsigned                       d_generation;	// bumped by seek()
+      std::string                    d_error;
+      bool                           d_done;
+      boost::shared_ptr<gr::thread::thread> d_thread;
+
+      void run();
+    };
+
+    /*!
+     * \brief Reads a file mapped read-only, asking the kernel to read
+     * ahead of us and drop the pages behind.
+     */
+    class mmap_file_reader : public file_reader
+    {
+    public:
+      //! Throws std::runtime_error if \p fd can't be mapped.
+      mmap_file_reader(int fd);
+      ~mmap_file_reader();
+
+      size_t read(void *data, size_t nbytes);
+      void seek(uint64_t offset);
+
+    private:
+      int       d_fd;
+      char     *d_base;
+      uint64_t  d_advised;	// read-ahead asked for up to here
+
+      void advise(uint64_t end);
+    };
+
+  } /* namespace blocks */
+} /* namespace gr */
+
+#endif /* INCLUDED_BLOCKS_FILE_IO_H */
@@ -0,0 +1,241 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2016 Free Software Foundation, Inc.
+ *
+ * This file is part of GNU Radio
+ *
+ * GNU Radio is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * GNU Radio is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GNU Radio; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "file_meta_index.h"
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <cmath>
+
+namespace gr {
+  namespace blocks {
+
+    static const char *INDEX_MAGIC = "gr_meta_index";
+
+    static pmt::pmt_t
+    segment_record(const file_meta_index_segment &seg)
+    {
+      return pmt::make_tuple(pmt::mp("seg"),
+                             pmt::from_uint64(seg.header_offset),
+                             pmt::from_uint64(seg.data_offset),
+                             pmt::from_uint64(seg.item),
+                             pmt::from_uint64(seg.secs),
+                             pmt::from_double(seg.frac),
+                             pmt::from_double(seg.rate));
+    }
+
+    file_meta_index_writer::file_meta_index_writer()
+      : d_fp(0), d_last_segment(-1)
+    {
+    }
+
+    file_meta_index_writer::~file_meta_index_writer()
+    {
+      close();
+    }
+
+    bool
+    file_meta_index_writer::open(const std::string &filename)
+    {
+      close();
+
+      if((d_fp = fopen(filename.c_str(), "wb")) == NULL) {
+        perror(filename.c_str());
+        return false;
+      }
+
+      d_last_segment = -1;
+      write(pmt::make_tuple(pmt::mp(INDEX_MAGIC),
+                            pmt::from_long(METADATA_INDEX_VERSION)));
+      return true;
+    }
+
+    void
+    file_meta_index_writer::close()
+    {
+      if(d_fp) {
+        fclose(d_fp);
+        d_fp = 0;
+      }
+    }
+
+    void
+    file_meta_index_writer::write(pmt::pmt_t record)
+    {
+      std::string s = pmt::serialize_str(record);
+      if(fwrite(s.data(), 1, s.size(), d_fp) != s.size())
+        throw std::runtime_error("file_meta_sink: error writing index.\n");
+    }
+
+    void
+    file_meta_index_writer::add_segment(const file_meta_index_segment &seg)
+    {
+      d_last_segment = ftell(d_fp);
+      write(segment_record(seg));
+    }
+
+    void
+    file_meta_index_writer::update_segment(const file_meta_index_segment &seg)
+    {
+      if(d_last_segment < 0) {
+        add_segment(seg);
+        return;
+      }
+
+      // Tags may have been added behind it.
+      long end = ftell(d_fp);
+      fseek(d_fp, d_last_segment, SEEK_SET);
+      write(segment_record(seg));
+      fseek(d_fp, end, SEEK_SET);
+    }
+
+    void
+    file_meta_index_writer::add_tag(pmt::pmt_t key, uint64_t item)
+    {
+      write(pmt::make_tuple(pmt::mp("tag"), pmt::from_uint64(item), key));
+    }
+
+    void
+    file_meta_index_writer::flush()
+    {
+      if(d_fp)
+        fflush(d_fp);
+    }
+
+    /**********************************************************************/
+
+    bool
+    file_meta_index::load(const std::string &filename)
+    {
+      clear();
+
+      std::filebuf fb;
+      if(!fb.open(filename.c_str(), std::ios::in | std::ios::binary))
+        return false;
+
+      try {
+        pmt::pmt_t r = pmt::deserialize(fb);
+        if(!pmt::is_tuple(r) || pmt::length(r) != 2 ||
+           !pmt::eq(pmt::tuple_ref(r, 0), pmt::mp(INDEX_MAGIC)) ||
+           pmt::to_long(pmt::tuple_ref(r, 1)) != METADATA_INDEX_VERSION) {
+          std::cerr << "file_meta_source: " << filename
+                    << " is not a metadata index" << std::endl;
+          return false;
+        }
+
+        while(!pmt::is_eof_object(r = pmt::deserialize(fb))) {
+          pmt::pmt_t type = pmt::tuple_ref(r, 0);
+          if(pmt::eq(type, pmt::mp("seg"))) {
+            file_meta_index_segment seg;
+            seg.header_offset = pmt::to_uint64(pmt::tuple_ref(r, 1));
+            seg.data_offset = pmt::to_uint64(pmt::tuple_ref(r, 2));
+            seg.item = pmt::to_uint64(pmt::tuple_ref(r, 3));
+            seg.secs = pmt::to_uint64(pmt::tuple_ref(r, 4));
+            seg.frac = pmt::to_double(pmt::tuple_ref(r, 5));
+            seg.rate = pmt::to_double(pmt::tuple_ref(r, 6));
+            d_segments.push_back(seg);
+          }
+          else if(pmt::eq(type, pmt::mp("tag"))) {
+            uint64_t item = pmt::to_uint64(pmt::tuple_ref(r, 1));
+            d_tags[pmt::write_string(pmt::tuple_ref(r, 2))].push_back(item);
+          }
+        }
+      }
+      catch(std::exception &e) {
+        // Keep what we've got so far.
+      }
+
+      return true;
+    }
+
+    void
+    file_meta_index::clear()
+    {
+      d_segments.clear();
+      d_tags.clear();
+    }
+
+    void
+    file_meta_index::swap(file_meta_index &other)
+    {
+      d_segments.swap(other.d_segments);
+      d_tags.swap(other.d_tags);
+    }
+
+    static bool
+    item_less(uint64_t item, const file_meta_index_segment &seg)
+    {
+      return item < seg.item;
+    }
+
+    static bool
+    time_less(const file_meta_index_segment &t, const file_meta_index_segment &seg)
+    {
+      return t.secs < seg.secs || (t.secs == seg.secs && t.frac < seg.frac);
+    }
+
+    long
+    file_meta_index::find_item(uint64_t item) const
+    {
+      std::vector<file_meta_index_segment>::const_iterator s =
+        std::upper_bound(d_segments.begin(), d_segments.end(), item, item_less);
+      return (long)(s - d_segments.begin()) - 1;
+    }
+
+    bool
+    file_meta_index::find_time(uint64_t secs, double frac, uint64_t &item) const
+    {
+      file_meta_index_segment t;
+      t.secs = secs;
+      t.frac = frac;
+
+      std::vector<file_meta_index_segment>::const_iterator s =
+        std::upper_bound(d_segments.begin(), d_segments.end(), t, time_less);
+      if(s == d_segments.begin())
+        return false;
+
+      std::vector<file_meta_index_segment>::const_iterator next = s--;
+      double dt = (double)(secs - s->secs) + (frac - s->frac);
+      item = s->item + (uint64_t)floor(dt * s->rate + 0.5);	// nearest
+      if(next != d_segments.end() && item > next->item)
+        item = next->item;
+      return true;
+    }
+
+    bool
+    file_meta_index::find_tag(pmt::pmt_t key, size_t n, uint64_t &item) const
+    {
+      tag_map_t::const_iterator t = d_tags.find(pmt::write_string(key));
+      if(t == d_tags.end() || n >= t->second.size())
+        return false;
+
+      item = t->second[n];
+      return true;
+    }
+
+  } /* namespace blocks */
+} /* namespace gr */
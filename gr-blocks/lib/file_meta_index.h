@@ -0,0 +1,143 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2016 Free Software Foundation, Inc.
+ *
+ * This file is part of GNU Radio
+ *
+ * GNU Radio is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * GNU Radio is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GNU Radio; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef INCLUDED_BLOCKS_FILE_META_INDEX_H
+#define INCLUDED_BLOCKS_FILE_META_INDEX_H
+
+#include <pmt/pmt.h>
+#include <boost/noncopyable.hpp>
+#include <stdint.h>
+#include <cstdio>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace gr {
+  namespace blocks {
+
+    /*
+     * The index of a metadata file lives next to it in
+     * 'filename.idx' and is a sequence of serialized PMT tuples:
+     *
+     *   ('gr_meta_index', version)                  once, first
+     *   ('seg', hdr, data, item, secs, frac, rate)  per header
+     *   ('tag', item, key)                          per stream tag
+     *
+     * hdr and data are the byte offsets of the segment's header (in
+     * the header file when detached) and of its first item, item is
+     * the number of items before it in the file and secs, frac and
+     * rate are its rx_time and rx_rate. Integers are uint64 and reals
+     * double, so a 'seg' record always has the same size and can be
+     * rewritten in place. Records are in item order.
+     */
+    const int METADATA_INDEX_VERSION = 0;
+
+    struct file_meta_index_segment
+    {
+      uint64_t header_offset;
+      uint64_t data_offset;
+      uint64_t item;
+      uint64_t secs;
+      double   frac;
+      double   rate;
+    };
+
+    /*!
+     * \brief Appends to a metadata index as the file is written.
+     */
+    class file_meta_index_writer : boost::noncopyable
+    {
+    public:
+      file_meta_index_writer();
+      ~file_meta_index_writer();
+
+      //! Create (or truncate) \p filename; false after printing why.
+      bool open(const std::string &filename);
+      void close();
+      bool is_open() const { return d_fp != 0; }
+
+      void add_segment(const file_meta_index_segment &seg);
+
+      //! Rewrite the last segment, e.g., when a tag changed its header.
+      void update_segment(const file_meta_index_segment &seg);
+
+      void add_tag(pmt::pmt_t key, uint64_t item);
+
+      void flush();
+
+    private:
+      FILE *d_fp;
+      long  d_last_segment;	// file position of the last 'seg' record
+
+      void write(pmt::pmt_t record);
+    };
+
+    /*!
+     * \brief A metadata index loaded into memory for searching.
+     */
+    class file_meta_index
+    {
+    public:
+      /*!
+       * Load \p filename, replacing what was there. Returns false if
+       * it doesn't exist or isn't an index; a truncated last record
+       * (say, from a capture that was killed) is ignored.
+       */
+      bool load(const std::string &filename);
+      void clear();
+      void swap(file_meta_index &other);
+
+      bool empty() const { return d_segments.empty(); }
+      size_t nsegments() const { return d_segments.size(); }
+      const file_meta_index_segment &segment(size_t i) const { return d_segments[i]; }
+
+      /*!
+       * Index of the segment holding \p item, or -1 if \p item comes
+       * before the first one.
+       */
+      long find_item(uint64_t item) const;
+
+      /*!
+       * Item closest to time \p secs + \p frac, or false if that's
+       * before the first segment. Time stamps must not go backwards.
+       * A time between two segments (a gap in the capture) gives the
+       * start of the later one.
+       */
+      bool find_time(uint64_t secs, double frac, uint64_t &item) const;
+
+      /*!
+       * Item of the \p n'th tag with \p key, or false if there are not
+       * that many.
+       */
+      bool find_tag(pmt::pmt_t key, size_t n, uint64_t &item) const;
+
+    private:
+      typedef std::map<std::string, std::vector<uint64_t> > tag_map_t;
+
+      std::vector<file_meta_index_segment> d_segments;
+      tag_map_t d_tags;
+    };
+
+  } /* namespace blocks */
+} /* namespace gr */
+
+#endif /* INCLUDED_BLOCKS_FILE_META_INDEX_H */
@@ -85,7 +85,8 @@ namespace gr {
 	d_itemsize(itemsize),
 	d_samp_rate(samp_rate), d_relative_rate(relative_rate),
 	d_max_seg_size(max_segment_size), d_total_seg_size(0),
-	d_updated(false), d_unbuffered(false)
+	d_updated(false), d_unbuffered(false),
+	d_nitems(0), d_seg_hdr_offset(0), d_seg_data_offset(0)
     {
       d_fp = 0;
       d_new_fp = 0;
@@ -130,11 +131,7 @@ namespace gr {
       d_header = pmt::dict_add(d_header, mp("bytes"), pmt::from_uint64(0));
 
       do_update();
-
-      if(d_state == STATE_DETACHED)
-	write_header(d_hdr_fp, d_header, d_extra);
-      else
-	write_header(d_fp, d_header, d_extra);
+      write_and_update();
     }
 
     file_meta_sink_impl::~file_meta_sink_impl()
@@ -164,6 +161,16 @@ namespace gr {
       }
 
       ret = ret && _open(&d_new_fp, filename.c_str());
+
+      // Readers can do without the index, so carry on without it if
+      // it can't be written.
+      if(ret) {
+	gr::thread::scoped_lock guard(d_setlock);
+	d_new_index.reset(new file_meta_index_writer());
+	if(!d_new_index->open(filename + ".idx"))
+	  d_new_index.reset();
+      }
+
       d_updated = true;
       return ret;
     }
@@ -215,6 +222,7 @@ namespace gr {
 	fclose(d_new_fp);
 	d_new_fp = 0;
       }
+      d_new_index.reset();
       d_updated = true;
     }
 
@@ -235,6 +243,10 @@ namespace gr {
 	d_fp = d_new_fp;		// install new file pointer
 	d_new_fp = 0;
 
+	d_index.swap(d_new_index);
+	d_new_index.reset();
+	d_nitems = 0;
+
 	d_updated = false;
       }
     }
@@ -349,10 +361,40 @@ namespace gr {
       s = pmt::from_uint64(METADATA_HEADER_SIZE + d_extra_size);
       update_header(mp("strt"), s);
 
+      FILE *fp = (d_state == STATE_DETACHED) ? d_hdr_fp : d_fp;
+      d_seg_hdr_offset = ftell(fp);
+      d_seg_data_offset = ftell(d_fp);
+      write_header(fp, d_header, d_extra);
+      index_segment(false);
+    }
+
+    void
+    file_meta_sink_impl::index_segment(bool update)
+    {
+      if(!d_index)
+	return;
+
+      pmt::pmt_t r = pmt::dict_ref(d_header, mp("rx_time"), pmt::PMT_NIL);
+
+      file_meta_index_segment seg;
+      seg.header_offset = d_seg_hdr_offset;
       if(d_state == STATE_DETACHED)
-	write_header(d_hdr_fp, d_header, d_extra);
+	seg.data_offset = d_seg_data_offset;
       else
-	write_header(d_fp, d_header, d_extra);
+	seg.data_offset = d_seg_hdr_offset + METADATA_HEADER_SIZE + d_extra_size;
+      seg.item = d_nitems;
+      seg.secs = pmt::to_uint64(pmt::tuple_ref(r, 0));
+      seg.frac = pmt::to_double(pmt::tuple_ref(r, 1));
+      seg.rate = pmt::to_double(pmt::dict_ref(d_header, mp("rx_rate"), pmt::PMT_NIL));
+
+      // A new segment is a good point to push out what the index has
+      // so far; rewrites only happen before any data went into it.
+      if(update)
+	d_index->update_segment(seg);
+      else {
+	d_index->add_segment(seg);
+	d_index->flush();
+      }
     }
 
     void
@@ -412,6 +454,7 @@ namespace gr {
 	    break;
 	  nwritten += count;
 	  inbuf += count * d_itemsize;
+	  d_nitems += count;
 
 	  d_total_seg_size += count;
 
@@ -427,7 +470,10 @@ namespace gr {
 	}
 
 	if(d_total_seg_size > 0) {
+	  // The tag starts a new header, whose rx_time follows on
+	  // from this segment like one started by max_segment_size.
 	  update_last_header();
+	  update_rx_time();
 	  update_header(itr->key, itr->value);
 	  write_and_update();
 	  d_total_seg_size = 0;
@@ -435,7 +481,11 @@ namespace gr {
 	else {
 	  update_header(itr->key, itr->value);
 	  update_last_header();
+	  index_segment(true);
 	}
+
+	if(d_index)
+	  d_index->add_tag(itr->key, d_nitems);
       }
 
       // Finish up the rest of the data after tags
@@ -447,6 +497,7 @@ namespace gr {
 	  break;
 	nwritten += count;
 	inbuf += count * d_itemsize;
+	d_nitems += count;
 
 	d_total_seg_size += count;
 	if(d_total_seg_size == d_max_seg_size) {
@@ -457,8 +508,11 @@ namespace gr {
 	}
       }
 
-      if(d_unbuffered)
+      if(d_unbuffered) {
 	fflush(d_fp);
+	if(d_index)
+	  d_index->flush();
+      }
 
       return nwritten;
     }
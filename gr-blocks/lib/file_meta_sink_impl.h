@@ -24,7 +24,9 @@
 #define INCLUDED_BLOCKS_FILE_META_SINK_IMPL_H
 
 #include <gnuradio/blocks/file_meta_sink.h>
+#include "file_meta_index.h"
 #include <pmt/pmt.h>
+#include <boost/scoped_ptr.hpp>
 
 using namespace pmt;
 
@@ -54,6 +56,11 @@ namespace gr {
       FILE *d_fp, *d_hdr_fp;
       meta_state_t d_state;
 
+      boost::scoped_ptr<file_meta_index_writer> d_new_index, d_index;
+      uint64_t d_nitems;		// items written to this file
+      uint64_t d_seg_hdr_offset;	// where the current segment's header is
+      uint64_t d_seg_data_offset;	// and its data (detached only)
+
     protected:
       void write_header(FILE *fp, pmt_t header, pmt_t extra);
       void update_header(pmt_t key, pmt_t value);
@@ -62,6 +69,7 @@ namespace gr {
       void update_last_header_detached();
       void write_and_update();
       void update_rx_time();
+      void index_segment(bool update);
 
       bool _open(FILE **fp, const char *filename);
 
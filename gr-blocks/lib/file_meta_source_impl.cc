@@ -32,6 +32,7 @@
 #include <fcntl.h>
 #include <stdexcept>
 #include <stdio.h>
+#include <algorithm>
 
 // win32 (mingw/msvc) specific
 #ifdef HAVE_IO_H
@@ -77,7 +78,8 @@ namespace gr {
 		      io_signature::make(1, 1, 1)),
 	d_itemsize(0), d_samp_rate(0),
 	d_seg_size(0),
-	d_updated(false), d_repeat(repeat)
+	d_updated(false), d_repeat(repeat),
+	d_seek_pending(false), d_seek_item(0)
     {
       d_fp = 0;
       d_new_fp = 0;
@@ -290,6 +292,14 @@ namespace gr {
       }
 
       ret = ret && _open(&d_new_fp, filename.c_str());
+
+      // Files written before there was an index don't have one; they
+      // just can't seek.
+      if(ret) {
+	gr::thread::scoped_lock guard(d_setlock);
+	d_new_index.load(filename + ".idx");
+      }
+
       d_updated = true;
       return ret;
     }
@@ -338,6 +348,7 @@ namespace gr {
 	fclose(d_new_fp);
 	d_new_fp = 0;
       }
+      d_new_index.clear();
       d_updated = true;
     }
 
@@ -358,15 +369,109 @@ namespace gr {
 	d_fp = d_new_fp;		// install new file pointer
 	d_new_fp = 0;
 
+	d_index.swap(d_new_index);
+	d_new_index.clear();
+	d_seek_pending = false;
+
 	d_updated = false;
       }
     }
 
+    bool
+    file_meta_source_impl::request_seek(uint64_t item)
+    {
+      if(d_index.find_item(item) < 0)
+	return false;
+
+      d_seek_item = item;
+      d_seek_pending = true;
+      return true;
+    }
+
+    bool
+    file_meta_source_impl::seek_item(uint64_t item)
+    {
+      gr::thread::scoped_lock guard(d_setlock);
+      return request_seek(item);
+    }
+
+    bool
+    file_meta_source_impl::seek_time(uint64_t secs, double frac)
+    {
+      gr::thread::scoped_lock guard(d_setlock);
+      uint64_t item;
+      return d_index.find_time(secs, frac, item) && request_seek(item);
+    }
+
+    bool
+    file_meta_source_impl::seek_tag(pmt::pmt_t key, size_t n)
+    {
+      gr::thread::scoped_lock guard(d_setlock);
+      uint64_t item;
+      return d_index.find_tag(key, n, item) && request_seek(item);
+    }
+
+    void
+    file_meta_source_impl::apply_seek()
+    {
+      // Called from work() with d_setlock held.
+      d_seek_pending = false;
+
+      const file_meta_index_segment &seg =
+	d_index.segment(d_index.find_item(d_seek_item));
+
+      FILE *fp;
+      if(d_state == STATE_DETACHED)
+	fp = d_hdr_fp;
+      else
+	fp = d_fp;
+
+      pmt::pmt_t hdr = pmt::PMT_NIL, extras = pmt::PMT_NIL;
+      if((fseek(fp, seg.header_offset, SEEK_SET) == -1) ||
+	 !read_header(hdr, extras))
+	throw std::runtime_error("file_meta_source: index doesn't match the file.\n");
+
+      d_tags.clear();
+      parse_header(hdr, nitems_written(0), d_tags);
+      parse_extras(extras, nitems_written(0), d_tags);
+
+      // Skip into the segment, and move its time stamp along with us.
+      uint64_t skip = std::min((uint64_t)d_seg_size, d_seek_item - seg.item);
+      d_seg_size -= skip;
+
+      if(fseek(d_fp, seg.data_offset + skip*d_itemsize, SEEK_SET) == -1) {
+	std::stringstream s;
+	s << "[" << __FILE__ << "]" << " fseek failed" << std::endl;
+	throw std::runtime_error(s.str());
+      }
+
+      if(skip > 0 && d_samp_rate > 0) {
+	uint64_t secs = pmt::to_uint64(pmt::tuple_ref(d_time_stamp, 0));
+	double fracs = pmt::to_double(pmt::tuple_ref(d_time_stamp, 1));
+	fracs += skip / d_samp_rate;
+	uint64_t new_secs = static_cast<uint64_t>(fracs);
+	secs += new_secs;
+	fracs -= new_secs;
+	d_time_stamp = pmt::make_tuple(pmt::from_uint64(secs), pmt::from_double(fracs));
+
+	for(size_t i = 0; i < d_tags.size(); i++) {
+	  if(pmt::eq(d_tags[i].key, pmt::mp("rx_time")))
+	    d_tags[i].value = d_time_stamp;
+	}
+      }
+    }
+
     int
     file_meta_source_impl::work(int noutput_items,
 				gr_vector_const_void_star &input_items,
 				gr_vector_void_star &output_items)
     {
+      {
+	gr::thread::scoped_lock lock(d_setlock);
+	if(d_seek_pending)
+	  apply_seek();
+      }
+
       // We've reached the end of a segment; parse the next header and get
       // the new tags to send and set the next segment size.
       if(d_seg_size == 0) {
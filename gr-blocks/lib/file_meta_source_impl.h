@@ -29,6 +29,7 @@
 #include <gnuradio/thread/thread.h>
 
 #include <gnuradio/blocks/file_meta_sink.h>
+#include "file_meta_index.h"
 
 using namespace pmt;
 
@@ -56,6 +57,10 @@ namespace gr {
 
       std::vector<tag_t> d_tags;
 
+      file_meta_index d_new_index, d_index;
+      bool d_seek_pending;
+      uint64_t d_seek_item;
+
     protected:
       bool _open(FILE **fp, const char *filename);
       bool read_header(pmt_t &hdr, pmt_t &extras);
@@ -63,6 +68,8 @@ namespace gr {
 			std::vector<tag_t> &tags);
       void parse_extras(pmt_t extras, uint64_t offset,
 			std::vector<tag_t> &tags);
+      bool request_seek(uint64_t item);
+      void apply_seek();
 
     public:
       file_meta_source_impl(const std::string &filename,
@@ -77,6 +84,10 @@ namespace gr {
       void close();
       void do_update();
 
+      bool seek_item(uint64_t item);
+      bool seek_time(uint64_t secs, double frac);
+      bool seek_tag(pmt::pmt_t key, size_t n=0);
+
       int work(int noutput_items,
 	       gr_vector_const_void_star &input_items,
 	       gr_vector_void_star &output_items);
@@ -25,18 +25,23 @@
 #endif
 
 #include <gnuradio/blocks/file_sink_base.h>
+#include "file_io.h"
 #include <cstdio>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <fcntl.h>
 #include <stdexcept>
 #include <stdio.h>
+#include <iostream>
 #include <gnuradio/thread/thread.h>
 
 // win32 (mingw/msvc) specific
 #ifdef HAVE_IO_H
 #include <io.h>
 #endif
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
 #ifdef O_BINARY
 #define	OUR_O_BINARY O_BINARY
 #else
@@ -53,8 +58,11 @@
 namespace gr {
   namespace blocks {
 
-    file_sink_base::file_sink_base(const char *filename, bool is_binary, bool append)
-      : d_fp(0), d_new_fp(0), d_updated(false), d_is_binary(is_binary), d_append(append)
+    file_sink_base::file_sink_base(const char *filename, bool is_binary, bool append,
+                                   file_io_mode io_mode)
+      : d_fp(0), d_new_fp(0), d_updated(false), d_is_binary(is_binary), d_append(append),
+        d_io_mode(io_mode == FILE_IO_MMAP ? FILE_IO_ASYNC : io_mode),
+        d_writer(0), d_new_writer(0)
     {
       if (!open(filename))
         throw std::runtime_error ("can't open file");
@@ -67,6 +75,8 @@ namespace gr {
         fclose(d_fp);
         d_fp = 0;
       }
+      delete d_writer;		// flushes it
+      d_writer = 0;
     }
 
     bool
@@ -82,6 +92,9 @@ namespace gr {
       } else {
         flags = O_WRONLY|O_CREAT|O_TRUNC|OUR_O_LARGEFILE|OUR_O_BINARY;
       }
+      if(d_io_mode != FILE_IO_STDIO)
+        return open_writer(filename);
+
       if((fd = ::open(filename, flags, 0664)) < 0){
         perror(filename);
         return false;
@@ -100,6 +113,46 @@ namespace gr {
       return d_new_fp != 0;
     }
 
+    /*
+     * The writer keeps its own file position, so no O_APPEND; a
+     * direct writer appending reads back the file's last block.
+     * Called with d_mutex held.
+     */
+    bool
+    file_sink_base::open_writer(const char *filename)
+    {
+      int flags = OUR_O_LARGEFILE|OUR_O_BINARY|O_CREAT;
+      flags |= d_append ? O_RDWR : O_WRONLY|O_TRUNC;
+
+      bool direct;
+      int fd = file_io_open(filename, flags, d_io_mode, direct);
+      if(fd < 0)
+        return false;
+
+      uint64_t offset = 0;
+      if(d_append) {
+        off_t end = lseek(fd, 0, SEEK_END);
+        if(end == (off_t)-1) {
+          perror(filename);
+          ::close(fd);
+          return false;
+        }
+        offset = end;
+      }
+
+      delete d_new_writer;	// if we've already got a new one open, close it
+      d_new_writer = 0;
+      try {
+        d_new_writer = new file_writer(fd, offset, direct);
+      }
+      catch(std::exception &e) {
+        std::cerr << filename << ": " << e.what() << std::endl;
+      }
+
+      d_updated = true;
+      return d_new_writer != 0;
+    }
+
     void
     file_sink_base::close()
     {
@@ -109,6 +162,8 @@ namespace gr {
         fclose(d_new_fp);
         d_new_fp = 0;
       }
+      delete d_new_writer;
+      d_new_writer = 0;
       d_updated = true;
     }
 
@@ -122,6 +177,20 @@ namespace gr {
         d_fp = d_new_fp;                     // install new file pointer
         d_new_fp = 0;
         d_updated = false;
+
+        file_writer *old = d_writer;        // install new writer
+        d_writer = d_new_writer;
+        d_new_writer = 0;
+        if(old) {
+          try {
+            old->close();
+          }
+          catch(...) {
+            delete old;
+            throw;
+          }
+          delete old;
+        }
       }
     }
 
@@ -25,24 +25,28 @@
 #endif
 
 #include "file_sink_impl.h"
+#include "file_io.h"
 #include <gnuradio/io_signature.h>
+#include <iostream>
 #include <stdexcept>
 
 namespace gr {
   namespace blocks {
 
     file_sink::sptr
-    file_sink::make(size_t itemsize, const char *filename, bool append)
+    file_sink::make(size_t itemsize, const char *filename, bool append,
+                    file_io_mode io_mode)
     {
       return gnuradio::get_initial_sptr
-        (new file_sink_impl(itemsize, filename, append));
+        (new file_sink_impl(itemsize, filename, append, io_mode));
     }
 
-    file_sink_impl::file_sink_impl(size_t itemsize, const char *filename, bool append)
+    file_sink_impl::file_sink_impl(size_t itemsize, const char *filename, bool append,
+                                   file_io_mode io_mode)
       : sync_block("file_sink",
                       io_signature::make(1, 1, itemsize),
                       io_signature::make(0, 0, 0)),
-        file_sink_base(filename, true, append),
+        file_sink_base(filename, true, append, io_mode),
         d_itemsize(itemsize)
     {
     }
@@ -51,6 +55,21 @@ namespace gr {
     {
     }
 
+    bool
+    file_sink_impl::stop()
+    {
+      // Get what's buffered onto the file, as fflush() would.
+      try {
+        if(d_writer)
+          d_writer->flush();
+      }
+      catch(std::exception &e) {
+        std::cerr << "file_sink: " << e.what() << std::endl;
+        return false;
+      }
+      return true;
+    }
+
     int
     file_sink_impl::work(int noutput_items,
                          gr_vector_const_void_star &input_items,
@@ -61,6 +80,13 @@ namespace gr {
 
       do_update();                    // update d_fp is reqd
 
+      if(d_writer) {
+        d_writer->write(inbuf, noutput_items * d_itemsize);
+        if(d_unbuffered)
+          d_writer->flush();
+        return noutput_items;
+      }
+
       if(!d_fp)
         return noutput_items;         // drop output on the floor
 
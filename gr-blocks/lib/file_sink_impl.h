@@ -34,9 +34,12 @@ namespace gr {
       size_t d_itemsize;
 
     public:
-      file_sink_impl(size_t itemsize, const char *filename, bool append=false);
+      file_sink_impl(size_t itemsize, const char *filename, bool append=false,
+                     file_io_mode io_mode=FILE_IO_STDIO);
       ~file_sink_impl();
 
+      bool stop();
+
       int work(int noutput_items,
                gr_vector_const_void_star &input_items,
                gr_vector_void_star &output_items);
@@ -26,6 +26,7 @@
 
 #include <gnuradio/thread/thread.h>
 #include "file_source_impl.h"
+#include "file_io.h"
 #include <gnuradio/io_signature.h>
 #include <cstdio>
 #include <sys/types.h>
@@ -53,18 +54,20 @@
 namespace gr {
   namespace blocks {
 
-    file_source::sptr file_source::make(size_t itemsize, const char *filename, bool repeat)
+    file_source::sptr file_source::make(size_t itemsize, const char *filename, bool repeat,
+                                        file_io_mode io_mode)
     {
       return gnuradio::get_initial_sptr
-	(new file_source_impl(itemsize, filename, repeat));
+	(new file_source_impl(itemsize, filename, repeat, io_mode));
     }
 
-    file_source_impl::file_source_impl(size_t itemsize, const char *filename, bool repeat)
+    file_source_impl::file_source_impl(size_t itemsize, const char *filename, bool repeat,
+                                       file_io_mode io_mode)
       : sync_block("file_source",
 		      io_signature::make(0, 0, 0),
 		      io_signature::make(1, 1, itemsize)),
-	d_itemsize(itemsize), d_fp(0), d_new_fp(0), d_repeat(repeat),
-	d_updated(false)
+	d_itemsize(itemsize), d_fp(0), d_new_fp(0), d_reader(0), d_new_reader(0),
+	d_io_mode(io_mode), d_repeat(repeat), d_updated(false)
     {
       open(filename, repeat);
       do_update();
@@ -76,12 +79,28 @@ namespace gr {
         fclose ((FILE*)d_fp);
       if(d_new_fp)
         fclose ((FILE*)d_new_fp);
+      delete d_reader;
+      delete d_new_reader;
     }
 
     bool
     file_source_impl::seek(long seek_point, int whence)
     {
-      return fseek((FILE*)d_fp, seek_point *d_itemsize, whence) == 0;
+      if(!d_reader)
+        return fseek((FILE*)d_fp, seek_point *d_itemsize, whence) == 0;
+
+      gr::thread::scoped_lock lock(fp_mutex);
+      int64_t base = 0;
+      if(whence == SEEK_CUR)
+        base = d_reader->position();
+      else if(whence == SEEK_END)
+        base = d_reader->size();
+
+      int64_t offset = base + (int64_t)seek_point * d_itemsize;
+      if(offset < 0 || offset > (int64_t)d_reader->size())
+        return false;
+      d_reader->seek(offset);
+      return true;
     }
 
 
@@ -93,6 +112,21 @@ namespace gr {
 
       int fd;
 
+      if(d_io_mode != FILE_IO_STDIO) {
+        bool direct;
+        if((fd = file_io_open(filename, O_RDONLY | OUR_O_LARGEFILE | OUR_O_BINARY,
+                              d_io_mode, direct)) < 0)
+          throw std::runtime_error("can't open file");
+
+        delete d_new_reader;
+        d_new_reader = 0;
+        d_new_reader = file_reader::make(fd, d_io_mode, direct);
+
+        d_updated = true;
+        d_repeat = repeat;
+        return;
+      }
+
       // we use "open" to use to the O_LARGEFILE flag
       if((fd = ::open(filename, O_RDONLY | OUR_O_LARGEFILE | OUR_O_BINARY)) < 0) {
 	perror(filename);
@@ -124,6 +158,8 @@ namespace gr {
 	fclose(d_new_fp);
 	d_new_fp = NULL;
       }
+      delete d_new_reader;
+      d_new_reader = 0;
       d_updated = true;
     }
 
@@ -139,6 +175,10 @@ namespace gr {
 	d_fp = d_new_fp;    // install new file pointer
 	d_new_fp = 0;
 	d_updated = false;
+
+	delete d_reader;
+	d_reader = d_new_reader;
+	d_new_reader = 0;
       }
     }
 
@@ -152,10 +192,15 @@ namespace gr {
       int size = noutput_items;
 
       do_update();       // update d_fp is reqd
-      if(d_fp == NULL)
+      if(d_fp == NULL && d_reader == NULL)
 	throw std::runtime_error("work with file not open");
 
       gr::thread::scoped_lock lock(fp_mutex); // hold for the rest of this function
+      if(d_reader) {
+        int n = read_items(o, noutput_items);
+        return n == 0 ? -1 : n;		// nothing read; say we're done
+      }
+
       while(size) {
 	i = fread(o, d_itemsize, size, (FILE*)d_fp);
 
@@ -189,5 +234,28 @@ namespace gr {
       return noutput_items;
     }
 
+    // Like the fread() loop in work(): whole items only, starting
+    // over at the end of the file if repeating. Holds fp_mutex.
+    int
+    file_source_impl::read_items(char *o, int nitems)
+    {
+      size_t want = nitems * d_itemsize;
+      size_t got = 0;
+      while(got < want) {
+        size_t n = d_reader->read(o + got, want - got);
+        got += n;
+        if(n > 0)
+          continue;
+
+        // End of file; a partial item there is dropped.
+        got -= got % d_itemsize;
+        if(!d_repeat || d_reader->size() < d_itemsize)
+          break;
+        d_reader->seek(0);
+      }
+
+      return got / d_itemsize;
+    }
+
   } /* namespace blocks */
 } /* namespace gr */
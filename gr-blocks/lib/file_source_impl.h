@@ -29,20 +29,27 @@
 namespace gr {
   namespace blocks {
 
+    class file_reader;
+
     class BLOCKS_API file_source_impl : public file_source
     {
     private:
       size_t d_itemsize;
       FILE *d_fp;
       FILE *d_new_fp;
+      file_reader *d_reader;	// instead of d_fp, in the other modes
+      file_reader *d_new_reader;
+      file_io_mode d_io_mode;
       bool d_repeat;
       bool d_updated;
       boost::mutex fp_mutex;
 
       void do_update();
+      int read_items(char *o, int nitems);
 
     public:
-      file_source_impl(size_t itemsize, const char *filename, bool repeat);
+      file_source_impl(size_t itemsize, const char *filename, bool repeat,
+                       file_io_mode io_mode = FILE_IO_STDIO);
       ~file_source_impl();
 
       bool seek(long seek_point, int whence);
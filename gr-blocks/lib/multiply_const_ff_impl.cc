@@ -47,6 +47,7 @@ namespace gr {
       const int alignment_multiple =
 	volk_get_alignment() / sizeof(float);
       set_alignment(std::max(1,alignment_multiple));
+      set_in_place(true);
     }
 
     int
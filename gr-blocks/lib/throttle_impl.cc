@@ -28,7 +28,10 @@
 #include <gnuradio/io_signature.h>
 #include <cstring>
 #include <boost/thread/thread.hpp>
+#include <algorithm>
+#include <cmath>
 #include <limits>
+#include <time.h>
 
 pmt::pmt_t throttle_rx_rate_pmt(pmt::intern("rx_rate"));
 
@@ -36,21 +39,34 @@ namespace gr {
   namespace blocks {
 
     throttle::sptr
-    throttle::make(size_t itemsize, double samples_per_sec, bool ignore_tags)
+    throttle::make(size_t itemsize, double samples_per_sec, bool ignore_tags,
+                   bool precise, int max_burst, double spin_time)
     {
       return gnuradio::get_initial_sptr
-        (new throttle_impl(itemsize, samples_per_sec, ignore_tags));
+        (new throttle_impl(itemsize, samples_per_sec, ignore_tags,
+                           precise, max_burst, spin_time));
     }
 
     throttle_impl::throttle_impl(size_t itemsize,
                                  double samples_per_second,
-                                 bool ignore_tags)
+                                 bool ignore_tags,
+                                 bool precise,
+                                 int max_burst,
+                                 double spin_time)
       : sync_block("throttle",
                       io_signature::make(1, 1, itemsize),
                       io_signature::make(1, 1, itemsize)),
         d_itemsize(itemsize),
-        d_ignore_tags(ignore_tags)
+        d_ignore_tags(ignore_tags),
+        d_precise(precise),
+        d_last_report(high_res_timer_now()),
+        d_nbursts(0), d_nitems(0),
+        d_late_sum(0), d_late_sum2(0), d_late_max(0)
     {
+      message_port_register_out(pmt::mp("stats"));
+
+      set_max_burst(max_burst);
+      set_spin_time(spin_time);
       set_sample_rate(samples_per_second);
     }
 
@@ -58,11 +74,19 @@ namespace gr {
     {
     }
 
-    bool
-    throttle_impl::start()
+    void
+    throttle_impl::reset()
     {
       d_start = boost::get_system_time();
+      d_start_ticks = high_res_timer_now();
       d_total_samples = 0;
+    }
+
+    bool
+    throttle_impl::start()
+    {
+      reset();
+      d_last_report = high_res_timer_now();
       return block::start();
     }
 
@@ -70,8 +94,7 @@ namespace gr {
     throttle_impl::set_sample_rate(double rate)
     {
       //changing the sample rate performs a reset of state params
-      d_start = boost::get_system_time();
-      d_total_samples = 0;
+      reset();
       d_samps_per_tick = rate/boost::posix_time::time_duration::ticks_per_second();
       d_samps_per_us = rate/1e6;
     }
@@ -82,11 +105,109 @@ namespace gr {
       return d_samps_per_us * 1e6;
     }
 
+    void
+    throttle_impl::set_max_burst(int max_burst)
+    {
+      gr::thread::scoped_lock guard(d_setlock);
+      d_max_burst = std::max(max_burst, 0);
+    }
+
+    void
+    throttle_impl::set_spin_time(double spin_time)
+    {
+      gr::thread::scoped_lock guard(d_setlock);
+      d_spin_time = std::max(spin_time, 0.0);
+    }
+
+    // When the next item is due, in high_res_timer ticks.
+    high_res_timer_type
+    throttle_impl::deadline() const
+    {
+      double secs = d_total_samples / (d_samps_per_us * 1e6);
+      return d_start_ticks + high_res_timer_type(secs * high_res_timer_tps());
+    }
+
+    void
+    throttle_impl::sleep_until(high_res_timer_type t)
+    {
+      // Sleep in slices of at most 100 ms so that stopping the
+      // flowgraph can interrupt us.
+      const high_res_timer_type slice = high_res_timer_tps() / 10;
+
+      for(;;) {
+        boost::this_thread::interruption_point();
+
+        high_res_timer_type now = high_res_timer_now();
+        if(now >= t)
+          return;
+        high_res_timer_type until = std::min(t, now + slice);
+
+#if defined(HAVE_CLOCK_NANOSLEEP) && defined(GNURADIO_HRT_USE_CLOCK_GETTIME)
+        // high_res_timer counts ns on CLOCK_MONOTONIC here; wake up
+        // early on a signal and go around again.
+        struct timespec ts;
+        ts.tv_sec = until / high_res_timer_tps();
+        ts.tv_nsec = until % high_res_timer_tps();
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+#else
+        boost::this_thread::sleep(boost::posix_time::microseconds
+                                  (long((until - now) * 1000000 / high_res_timer_tps())));
+#endif
+      }
+    }
+
+    void
+    throttle_impl::record_late(double late)
+    {
+      d_nbursts++;
+      d_late_sum += late;
+      d_late_sum2 += late * late;
+      d_late_max = std::max(d_late_max, late);
+    }
+
+    void
+    throttle_impl::report_stats()
+    {
+      high_res_timer_type now = high_res_timer_now();
+      double dt = double(now - d_last_report) / high_res_timer_tps();
+      if(dt < 1.0 || d_nbursts == 0)
+        return;
+
+      double mean = d_late_sum / d_nbursts;
+      double var = d_late_sum2 / d_nbursts - mean * mean;
+
+      pmt::pmt_t stats = pmt::make_dict();
+      stats = pmt::dict_add(stats, pmt::mp("bursts"), pmt::from_uint64(d_nbursts));
+      stats = pmt::dict_add(stats, pmt::mp("late_mean"), pmt::from_double(mean));
+      stats = pmt::dict_add(stats, pmt::mp("late_max"), pmt::from_double(d_late_max));
+      stats = pmt::dict_add(stats, pmt::mp("jitter"),
+                            pmt::from_double(std::sqrt(std::max(var, 0.0))));
+      stats = pmt::dict_add(stats, pmt::mp("rate"), pmt::from_double(d_nitems / dt));
+      message_port_pub(pmt::mp("stats"), stats);
+
+      d_last_report = now;
+      d_nbursts = 0;
+      d_nitems = 0;
+      d_late_sum = d_late_sum2 = d_late_max = 0;
+    }
+
     int
     throttle_impl::work(int noutput_items,
                         gr_vector_const_void_star &input_items,
                         gr_vector_void_star &output_items)
     {
+      // Don't hold the lock while we sleep.
+      int max_burst;
+      double spin_time;
+      {
+        gr::thread::scoped_lock guard(d_setlock);
+        max_burst = d_max_burst;
+        spin_time = d_spin_time;
+      }
+
+      if(max_burst > 0)
+        noutput_items = std::min(noutput_items, max_burst);
+
       // check for updated rx_rate tag
       if(!d_ignore_tags){
         uint64_t abs_N = nitems_read(0);
@@ -101,20 +222,37 @@ namespace gr {
           }
         }
 
-      //calculate the expected number of samples to have passed through
-      boost::system_time now = boost::get_system_time();
-      boost::int64_t ticks = (now - d_start).ticks();
-      uint64_t expected_samps = uint64_t(d_samps_per_tick*ticks);
-
-      //if the expected samples was less, we need to throttle back
-      if(d_total_samples > expected_samps) {
-        double sleep_time = (d_total_samples - expected_samps)/d_samps_per_us;
-        if (std::numeric_limits<long>::max() < sleep_time) {
-            GR_LOG_ALERT(d_logger, "WARNING: Throttle sleep time overflow! You "
-                    "are probably using a very low sample rate.");
+      if(d_precise) {
+        // Sleep until shortly before the first of these items is due,
+        // then spin until it is.
+        high_res_timer_type due = deadline();
+        high_res_timer_type spin = high_res_timer_type(spin_time * high_res_timer_tps());
+        sleep_until(due - spin);
+
+        high_res_timer_type now = high_res_timer_now();
+        while(now < due)
+          now = high_res_timer_now();
+        record_late(double(now - due) / high_res_timer_tps());
+      }
+      else {
+        //calculate the expected number of samples to have passed through
+        boost::system_time now = boost::get_system_time();
+        boost::int64_t ticks = (now - d_start).ticks();
+        uint64_t expected_samps = uint64_t(d_samps_per_tick*ticks);
+
+        //if the expected samples was less, we need to throttle back
+        if(d_total_samples > expected_samps) {
+          double sleep_time = (d_total_samples - expected_samps)/d_samps_per_us;
+          if (std::numeric_limits<long>::max() < sleep_time) {
+              GR_LOG_ALERT(d_logger, "WARNING: Throttle sleep time overflow! You "
+                      "are probably using a very low sample rate.");
+          }
+          boost::this_thread::sleep(boost::posix_time::microseconds
+                                    (long(sleep_time)));
         }
-        boost::this_thread::sleep(boost::posix_time::microseconds
-                                  (long(sleep_time)));
+
+        double elapsed = (boost::get_system_time() - d_start).total_microseconds();
+        record_late((elapsed - d_total_samples / d_samps_per_us) * 1e-6);
       }
 
       //copy all samples output[i] <= input[i]
@@ -122,6 +260,16 @@ namespace gr {
       char *out = (char *)output_items[0];
       std::memcpy(out, in, noutput_items * d_itemsize);
       d_total_samples += noutput_items;
+      d_nitems += noutput_items;
+
+      // Move the start up now and then so that deadline() doesn't
+      // lose precision.
+      if(d_precise && d_total_samples >= (1ULL << 32)) {
+        d_start_ticks = deadline();
+        d_total_samples = 0;
+      }
+
+      report_stats();
       return noutput_items;
     }
 
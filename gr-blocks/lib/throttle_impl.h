@@ -24,6 +24,7 @@
 #define INCLUDED_GR_THROTTLE_IMPL_H
 
 #include <gnuradio/blocks/throttle.h>
+#include <gnuradio/high_res_timer.h>
 
 namespace gr {
   namespace blocks {
@@ -37,8 +38,26 @@ namespace gr {
       double d_samps_per_tick, d_samps_per_us;
       bool d_ignore_tags;
 
+      // precise pacing: deadlines on the high_res_timer clock
+      bool d_precise;
+      int d_max_burst;
+      double d_spin_time;
+      high_res_timer_type d_start_ticks;
+
+      // pacing statistics since the last report
+      high_res_timer_type d_last_report;
+      uint64_t d_nbursts, d_nitems;
+      double d_late_sum, d_late_sum2, d_late_max;
+
+      void reset();
+      high_res_timer_type deadline() const;
+      void sleep_until(high_res_timer_type t);
+      void record_late(double late);
+      void report_stats();
+
     public:
-      throttle_impl(size_t itemsize, double samples_per_sec, bool ignore_tags=true);
+      throttle_impl(size_t itemsize, double samples_per_sec, bool ignore_tags,
+                    bool precise, int max_burst, double spin_time);
       ~throttle_impl();
 
       // Overloading gr::block::start to reset timer
@@ -49,6 +68,12 @@ namespace gr {
       void set_sample_rate(double rate);
       double sample_rate() const;
 
+      void set_max_burst(int max_burst);
+      int max_burst() const { return d_max_burst; }
+
+      void set_spin_time(double spin_time);
+      double spin_time() const { return d_spin_time; }
+
       int work(int noutput_items,
                gr_vector_const_void_star &input_items,
                gr_vector_void_star &output_items);
@@ -0,0 +1,424 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2016 Free Software Foundation, Inc.
+ *
+ * This file is part of GNU Radio
+ *
+ * GNU Radio is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * GNU Radio is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GNU Radio; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "udp_batch_receiver.h"
+
+#ifdef HAVE_RECVMMSG
+
+#include <boost/bind.hpp>
+#include <algorithm>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <netinet/in.h>
+
+namespace gr {
+  namespace blocks {
+
+    const int udp_batch_receiver::BATCH_SIZE = 64;
+    const int udp_batch_receiver::NBATCHES = 8;
+    const uint64_t udp_batch_receiver::MAX_FILL = 64 << 20;
+
+    static const size_t CONTROL_LEN = CMSG_SPACE(sizeof(uint32_t));
+
+    static uint64_t
+    get_be64(const char *p)
+    {
+      uint64_t v = 0;
+      for(int i = 0; i < 8; i++)
+        v = (v << 8) | (unsigned char)p[i];
+      return v;
+    }
+
+    udp_batch_receiver::udp_batch_receiver(const struct sockaddr *addr, socklen_t addrlen,
+                                           size_t itemsize, int payload_size, bool eof,
+                                           int nthreads,
+                                           udp_header_type header,
+                                           udp_gap_mode gap_mode)
+      : d_itemsize(itemsize), d_payload_size(payload_size), d_eof(eof),
+        d_header(header), d_gap_mode(gap_mode),
+        d_stop(false), d_received(0), d_dropped(0),
+        d_current(0), d_index(0), d_offset(0), d_done(false), d_nitems(0),
+        d_synced(false), d_next_seq(0), d_next_offset(0),
+        d_fill(0), d_skip(0), d_dropped_items(0)
+    {
+#ifndef SO_REUSEPORT
+      nthreads = 1;
+#endif
+      nthreads = std::max(nthreads, 1);
+
+      // The first socket picks the port if we were given 0; the rest
+      // join it there.
+      struct sockaddr_storage bind_addr;
+      memcpy(&bind_addr, addr, addrlen);
+
+      for(int i = 0; i < nthreads; i++) {
+        int fd = socket(addr->sa_family, SOCK_DGRAM, 0);
+        int one = 1;
+        int rcvbuf = 4 << 20;
+        struct timeval tv = { 0, 100000 };	// to notice d_stop
+
+        if(fd < 0 ||
+           setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one)) < 0 ||
+#ifdef SO_REUSEPORT
+           (nthreads > 1 &&
+            setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one)) < 0) ||
+#endif
+           setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv)) < 0 ||
+           bind(fd, (struct sockaddr*)&bind_addr, addrlen) < 0) {
+          std::stringstream s;
+          s << "udp_source: can't open socket: " << strerror(errno);
+          if(fd >= 0)
+            ::close(fd);
+          for(size_t j = 0; j < d_fds.size(); j++)
+            ::close(d_fds[j]);
+          throw std::runtime_error(s.str());
+        }
+
+        // Best effort: a bigger kernel queue rides out longer stalls,
+        // and SO_RXQ_OVFL tells us how much it dropped.
+        setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+#ifdef SO_RXQ_OVFL
+        setsockopt(fd, SOL_SOCKET, SO_RXQ_OVFL, &one, sizeof(one));
+#endif
+
+        if(i == 0) {
+          socklen_t len = addrlen;
+          getsockname(fd, (struct sockaddr*)&bind_addr, &len);
+        }
+        d_fds.push_back(fd);
+      }
+
+      for(int i = 0; i < nthreads * NBATCHES; i++) {
+        batch *b = new batch;
+        b->data.resize(BATCH_SIZE * d_payload_size);
+        b->msgs.resize(BATCH_SIZE);
+        b->iov.resize(BATCH_SIZE);
+        b->control.resize(BATCH_SIZE * CONTROL_LEN);
+        for(int j = 0; j < BATCH_SIZE; j++) {
+          b->iov[j].iov_base = &b->data[j * d_payload_size];
+          b->iov[j].iov_len = d_payload_size;
+          memset(&b->msgs[j], 0, sizeof(b->msgs[j]));
+          b->msgs[j].msg_hdr.msg_iov = &b->iov[j];
+          b->msgs[j].msg_hdr.msg_iovlen = 1;
+          b->msgs[j].msg_hdr.msg_control = &b->control[j * CONTROL_LEN];
+        }
+        b->count = 0;
+        b->eof = false;
+        d_batches.push_back(b);
+        d_free.push_back(b);
+      }
+
+      for(int i = 0; i < nthreads; i++)
+        d_threads.create_thread(boost::bind(&udp_batch_receiver::run, this, i));
+    }
+
+    udp_batch_receiver::~udp_batch_receiver()
+    {
+      {
+        gr::thread::scoped_lock guard(d_mutex);
+        d_stop = true;
+        d_free_cond.notify_all();
+      }
+      d_threads.join_all();
+
+      for(size_t i = 0; i < d_fds.size(); i++)
+        ::close(d_fds[i]);
+      for(size_t i = 0; i < d_batches.size(); i++)
+        delete d_batches[i];
+    }
+
+    int
+    udp_batch_receiver::port() const
+    {
+      struct sockaddr_storage addr;
+      socklen_t len = sizeof(addr);
+      if(getsockname(d_fds[0], (struct sockaddr*)&addr, &len) < 0)
+        return -1;
+      if(addr.ss_family == AF_INET6)
+        return ntohs(((struct sockaddr_in6*)&addr)->sin6_port);
+      return ntohs(((struct sockaddr_in*)&addr)->sin_port);
+    }
+
+    void
+    udp_batch_receiver::counts(uint64_t &received, uint64_t &dropped)
+    {
+      gr::thread::scoped_lock guard(d_mutex);
+      received = d_received;
+      dropped = d_dropped;
+    }
+
+    void
+    udp_batch_receiver::release(batch *b)
+    {
+      gr::thread::scoped_lock guard(d_mutex);
+      d_free.push_back(b);
+      d_free_cond.notify_one();
+    }
+
+    void
+    udp_batch_receiver::run(size_t index)
+    {
+      int fd = d_fds[index];
+      uint32_t overflows = 0;
+
+      for(;;) {
+        batch *b;
+        {
+          gr::thread::scoped_lock guard(d_mutex);
+          while(!d_stop && d_free.empty())
+            d_free_cond.wait(guard);
+          if(d_stop)
+            return;
+          b = d_free.back();
+          d_free.pop_back();
+        }
+
+        // Wait for the first datagram, then take whatever else is
+        // already queued.
+        int n;
+        for(;;) {
+          for(int i = 0; i < BATCH_SIZE; i++)
+            b->msgs[i].msg_hdr.msg_controllen = CONTROL_LEN;
+
+          n = recvmmsg(fd, &b->msgs[0], BATCH_SIZE, MSG_WAITFORONE, NULL);
+          if(n > 0)
+            break;
+          if(n < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+            std::cerr << "udp_source: recvmmsg: " << strerror(errno) << std::endl;
+
+          gr::thread::scoped_lock guard(d_mutex);
+          if(d_stop)
+            return;
+        }
+
+        b->count = n;
+        b->eof = false;
+        uint32_t last = overflows;
+        for(int i = 0; i < n; i++) {
+          struct msghdr *h = &b->msgs[i].msg_hdr;
+          for(struct cmsghdr *c = CMSG_FIRSTHDR(h); c; c = CMSG_NXTHDR(h, c)) {
+#ifdef SO_RXQ_OVFL
+            if(c->cmsg_level == SOL_SOCKET && c->cmsg_type == SO_RXQ_OVFL)
+              memcpy(&overflows, CMSG_DATA(c), sizeof(overflows));
+#endif
+          }
+
+          if(d_eof && b->msgs[i].msg_len == 1 && b->data[i * d_payload_size] == 0x00) {
+            b->count = i;
+            b->eof = true;
+            break;
+          }
+        }
+
+        gr::thread::scoped_lock guard(d_mutex);
+        d_received += b->count;
+        d_dropped += (uint32_t)(overflows - last);
+        d_ready.push_back(b);
+        d_ready_cond.notify_one();
+      }
+    }
+
+    void
+    udp_batch_receiver::add_event(uint64_t item, bool time, uint64_t value)
+    {
+      event e;
+      e.item = item;
+      e.time = time;
+      e.value = value;
+      d_events.push_back(e);
+    }
+
+    /*
+     * Look at the header of the next datagram, with \p got bytes
+     * already in read()'s output. Returns false if the datagram
+     * should be dropped.
+     */
+    bool
+    udp_batch_receiver::start_datagram(const char *p, size_t len, size_t &got)
+    {
+      if(len < UDP_SEQNO_HEADER_SIZE)
+        return false;
+
+      uint64_t seq = get_be64(p);
+      uint64_t off = get_be64(p + 8);
+      uint64_t t = get_be64(p + 16);
+      uint64_t is = d_itemsize;
+
+      if(!d_synced || (seq == 0 && d_next_seq > 0)) {
+        // First datagram, or the sender started over: begin at the
+        // first whole item.
+        got -= got % is;
+        d_skip = (is - off % is) % is;
+        add_event(d_nitems + got / is, true, t);
+        d_synced = true;
+      }
+      else if(off < d_next_offset) {
+        return false;	// late or duplicate
+      }
+      else if(off > d_next_offset) {
+        uint64_t lost = off - d_next_offset;
+        uint64_t first = (d_next_offset + d_skip) / is;
+        uint64_t dropped = (off + is - 1) / is - first;
+
+        if(d_gap_mode == UDP_GAP_FILL && d_skip == 0 && lost <= MAX_FILL) {
+          // Zeros where the bytes went missing keep the items that
+          // straddle the gap in place.
+          uint64_t pos = d_nitems * is + got;
+          add_event(pos / is, false, dropped);
+          add_event((pos + lost + is - 1) / is, true, t);
+          d_fill = lost;
+        }
+        else {
+          // Drop the item the gap cut short and pick up at the next
+          // whole one.
+          got -= got % is;
+          d_skip = (is - off % is) % is;
+          if(dropped > 0)
+            add_event(d_nitems + got / is, false, dropped);
+          add_event(d_nitems + got / is, true, t);
+        }
+        d_dropped_items += dropped;
+      }
+
+      d_next_seq = seq + 1;
+      d_next_offset = off + (len - UDP_SEQNO_HEADER_SIZE);
+      return true;
+    }
+
+    int
+    udp_batch_receiver::read(void *out, int nitems, std::vector<event> &events)
+    {
+      events.clear();
+      if(d_done)
+        return -1;
+
+      char *o = (char*)out;
+      size_t want = nitems * d_itemsize;
+      size_t got = d_partial.size();
+      if(got > 0)
+        memcpy(o, &d_partial[0], got);
+      d_partial.clear();
+
+      while(got < want) {
+        if(d_fill > 0) {
+          size_t n = (size_t)std::min<uint64_t>(d_fill, want - got);
+          memset(o + got, 0, n);
+          got += n;
+          d_fill -= n;
+          continue;
+        }
+
+        if(!d_current) {
+          gr::thread::scoped_lock guard(d_mutex);
+          if(d_ready.empty()) {
+            // Only wait if we don't have a single item yet.
+            if(got >= d_itemsize)
+              break;
+            d_ready_cond.timed_wait(guard, boost::posix_time::milliseconds(10));
+            if(d_ready.empty())
+              break;
+          }
+          d_current = d_ready.front();
+          d_ready.pop_front();
+          d_index = 0;
+          d_offset = 0;
+        }
+
+        batch *b = d_current;
+        while(got < want && d_fill == 0 && d_index < b->count) {
+          const char *p = &b->data[d_index * d_payload_size];
+          size_t len = b->msgs[d_index].msg_len;
+
+          if(d_header != UDP_HEADER_NONE && d_offset == 0) {
+            if(!start_datagram(p, len, got)) {
+              d_index++;
+              continue;
+            }
+            d_offset = UDP_SEQNO_HEADER_SIZE;
+            continue;	// any zeros for a gap go first
+          }
+          if(d_skip > 0) {
+            size_t n = (size_t)std::min<uint64_t>(d_skip, len - d_offset);
+            d_offset += n;
+            d_skip -= n;
+          }
+
+          size_t n = std::min(len - d_offset, want - got);
+          memcpy(o + got, p + d_offset, n);
+          got += n;
+          d_offset += n;
+          if(d_offset == len) {
+            d_index++;
+            d_offset = 0;
+          }
+        }
+
+        if(d_index == b->count) {
+          bool eof = b->eof;
+          d_current = 0;
+          release(b);
+          if(eof) {
+            d_done = true;
+            break;
+          }
+        }
+      }
+
+      // Keep the start of an item that hasn't all arrived yet.
+      size_t tail = got % d_itemsize;
+      d_partial.assign(o + got - tail, o + got);
+      got -= tail;
+
+      uint64_t first = d_nitems;
+      d_nitems += got / d_itemsize;
+
+      // Hand over the events that fall in what we return.
+      if(!d_events.empty()) {
+        size_t j = 0;
+        for(size_t i = 0; i < d_events.size(); i++) {
+          if(d_events[i].item < d_nitems) {
+            events.push_back(d_events[i]);
+            events.back().item -= first;
+          }
+          else
+            d_events[j++] = d_events[i];
+        }
+        d_events.resize(j);
+      }
+
+      if(got == 0 && d_done)
+        return -1;
+      return got / d_itemsize;
+    }
+
+  } /* namespace blocks */
+} /* namespace gr */
+
+#endif /* HAVE_RECVMMSG */
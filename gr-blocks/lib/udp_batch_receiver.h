@@ -0,0 +1,159 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2016 Free Software Foundation, Inc.
+ *
+ * This file is part of GNU Radio
+ *
+ * GNU Radio is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * GNU Radio is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GNU Radio; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef INCLUDED_BLOCKS_UDP_BATCH_RECEIVER_H
+#define INCLUDED_BLOCKS_UDP_BATCH_RECEIVER_H
+
+#include <gnuradio/blocks/udp_header.h>
+#include <gnuradio/thread/thread.h>
+#include <gnuradio/thread/thread_group.h>
+#include <boost/noncopyable.hpp>
+#include <stdint.h>
+#include <deque>
+#include <string>
+#include <vector>
+
+#ifdef HAVE_RECVMMSG
+#include <sys/socket.h>
+#endif
+
+namespace gr {
+  namespace blocks {
+
+#ifdef HAVE_RECVMMSG
+
+    /*!
+     * \brief Receives UDP in batches with recvmmsg() on one or more
+     * threads, for udp_source.
+     *
+     * Each thread has its own socket bound to the same address with
+     * SO_REUSEPORT, so the kernel spreads flows (not the datagrams of
+     * one flow) over them. A thread fills a batch of datagrams per
+     * call and queues it; read() takes the batches in the order they
+     * were queued and hands out their payloads as a stream of items.
+     * When read() falls behind, the threads wait for a free batch and
+     * the datagrams queue (and eventually drop) in the kernel, which
+     * reports how many it dropped through SO_RXQ_OVFL.
+     *
+     * With UDP_HEADER_SEQNO, read() also follows the sender's byte
+     * offsets: it drops late and duplicate datagrams, fills or skips
+     * what went missing, and reports where each gap is.
+     */
+    class udp_batch_receiver : boost::noncopyable
+    {
+    public:
+      /*!
+       * Bind \p nthreads sockets to \p addr and start receiving.
+       * Throws std::runtime_error if that fails.
+       */
+      udp_batch_receiver(const struct sockaddr *addr, socklen_t addrlen,
+                         size_t itemsize, int payload_size, bool eof,
+                         int nthreads,
+                         udp_header_type header=UDP_HEADER_NONE,
+                         udp_gap_mode gap_mode=UDP_GAP_TAG);
+      ~udp_batch_receiver();
+
+      //! Something to tag in the output.
+      struct event {
+        uint64_t item;	//!< relative to the items read() returned
+        bool     time;	//!< "rx_time" (value in ns) or "dropped_items"
+        uint64_t value;
+      };
+
+      /*!
+       * Copy up to \p nitems items to \p out, waiting up to 10 ms for
+       * some to arrive. Returns the number copied, or -1 once the EOF
+       * datagram has been reached. \p events gets what should be
+       * tagged in the items copied.
+       */
+      int read(void *out, int nitems, std::vector<event> &events);
+
+      int port() const;
+
+      //! Datagrams received and dropped (by the kernel) so far.
+      void counts(uint64_t &received, uint64_t &dropped);
+
+      //! Items lost in gaps so far; only call from read()'s thread.
+      uint64_t dropped_items() const { return d_dropped_items; }
+
+      static const int BATCH_SIZE;	//!< datagrams per recvmmsg()
+      static const int NBATCHES;	//!< batches per thread
+      static const uint64_t MAX_FILL;	//!< longest gap zero-filled, in bytes
+
+    private:
+      struct batch {
+        std::vector<char>           data;	// BATCH_SIZE payloads
+        std::vector<struct mmsghdr> msgs;
+        std::vector<struct iovec>   iov;
+        std::vector<char>           control;	// SO_RXQ_OVFL per datagram
+        int                         count;	// datagrams received
+        bool                        eof;	// ends at an EOF datagram
+      };
+
+      size_t d_itemsize;
+      int    d_payload_size;
+      bool   d_eof;
+      udp_header_type d_header;
+      udp_gap_mode    d_gap_mode;
+
+      std::vector<int>      d_fds;
+      std::vector<batch*>   d_batches;
+      gr::thread::thread_group d_threads;
+
+      gr::thread::mutex              d_mutex;	// protects the rest
+      gr::thread::condition_variable d_ready_cond;
+      gr::thread::condition_variable d_free_cond;
+      std::deque<batch*>  d_ready;
+      std::vector<batch*> d_free;
+      bool     d_stop;
+      uint64_t d_received;
+      uint64_t d_dropped;
+
+      // Only read() touches these.
+      batch   *d_current;
+      int      d_index;			// datagram in d_current
+      size_t   d_offset;		// byte in that datagram
+      std::vector<char> d_partial;	// start of an item split over datagrams
+      bool     d_done;
+      uint64_t d_nitems;		// items returned so far
+
+      // Gap detection (UDP_HEADER_SEQNO)
+      bool     d_synced;		// found the first datagram
+      uint64_t d_next_seq;		// sequence number expected next
+      uint64_t d_next_offset;		// and the sender's byte offset
+      uint64_t d_fill;			// zero bytes still to output
+      uint64_t d_skip;			// payload bytes still to skip
+      uint64_t d_dropped_items;
+      std::vector<event> d_events;	// not yet in the output
+
+      void run(size_t index);
+      void release(batch *b);
+      bool start_datagram(const char *p, size_t len, size_t &got);
+      void add_event(uint64_t item, bool time, uint64_t value);
+    };
+
+#endif /* HAVE_RECVMMSG */
+
+  } /* namespace blocks */
+} /* namespace gr */
+
+#endif /* INCLUDED_BLOCKS_UDP_BATCH_RECEIVER_H */
@@ -28,34 +28,80 @@
 #include <gnuradio/io_signature.h>
 #include <boost/array.hpp>
 #include <boost/asio.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
 #include <boost/format.hpp>
 #include <gnuradio/thread/thread.h>
+#include <algorithm>
 #include <stdexcept>
+#include <errno.h>
 #include <stdio.h>
 #include <string.h>
 
 namespace gr {
   namespace blocks {
 
+#ifdef HAVE_SENDMMSG
+    const int udp_sink_impl::BATCH_SIZE = 64;
+#endif
+
     udp_sink::sptr
     udp_sink::make(size_t itemsize,
                    const std::string &host, int port,
-                   int payload_size, bool eof)
+                   int payload_size, bool eof,
+                   udp_header_type header)
     {
       return gnuradio::get_initial_sptr
         (new udp_sink_impl(itemsize, host, port,
-                           payload_size, eof));
+                           payload_size, eof, header));
+    }
+
+    static void
+    put_be64(char *p, uint64_t v)
+    {
+      for(int i = 7; i >= 0; i--) {
+        p[i] = (char)(v & 0xff);
+        v >>= 8;
+      }
+    }
+
+    static uint64_t
+    now_ns()
+    {
+      static const boost::posix_time::ptime epoch(boost::gregorian::date(1970, 1, 1));
+      boost::posix_time::time_duration t =
+        boost::posix_time::microsec_clock::universal_time() - epoch;
+      return (uint64_t)t.total_microseconds() * 1000;
     }
 
     udp_sink_impl::udp_sink_impl(size_t itemsize,
                                  const std::string &host, int port,
-                                 int payload_size, bool eof)
+                                 int payload_size, bool eof,
+                                 udp_header_type header)
       : sync_block("udp_sink",
                       io_signature::make(1, 1, itemsize),
                       io_signature::make(0, 0, 0)),
         d_itemsize(itemsize), d_payload_size(payload_size), d_eof(eof),
-        d_connected(false)
+        d_connected(false), d_header(header), d_seqno(0), d_stream_offset(0)
     {
+      if(d_payload_size <= (int)header_length())
+        throw std::invalid_argument("udp_sink: payload_size too small for the header");
+      d_data_size = d_payload_size - header_length();
+
+#ifdef HAVE_SENDMMSG
+      // Each packet gathers its header (if any) and its payload.
+      size_t hlen = header_length();
+      d_msgs.resize(BATCH_SIZE);
+      d_iov.resize(2*BATCH_SIZE);
+      d_headers.resize(BATCH_SIZE * std::max<size_t>(hlen, 1));
+      for(int i = 0; i < BATCH_SIZE; i++) {
+        memset(&d_msgs[i], 0, sizeof(d_msgs[i]));
+        d_iov[2*i].iov_base = &d_headers[i * hlen];
+        d_iov[2*i].iov_len = hlen;
+        d_msgs[i].msg_hdr.msg_iov = hlen ? &d_iov[2*i] : &d_iov[2*i+1];
+        d_msgs[i].msg_hdr.msg_iovlen = hlen ? 2 : 1;
+      }
+#endif
+
       // Get the destination address
       connect(host, port);
     }
@@ -67,12 +113,30 @@ namespace gr {
         disconnect();
     }
 
+    size_t
+    udp_sink_impl::header_length() const
+    {
+      return d_header == UDP_HEADER_SEQNO ? UDP_SEQNO_HEADER_SIZE : 0;
+    }
+
+    void
+    udp_sink_impl::make_header(char *p, size_t nbytes, uint64_t now)
+    {
+      put_be64(p, d_seqno++);
+      put_be64(p + 8, d_stream_offset);
+      put_be64(p + 16, now);
+      d_stream_offset += nbytes;
+    }
+
     void
     udp_sink_impl::connect(const std::string &host, int port)
     {
       if(d_connected)
         disconnect();
 
+      d_seqno = 0;
+      d_stream_offset = 0;
+
       std::string s_port = (boost::format("%d")%port).str();
       if(host.size() > 0) {
         boost::asio::ip::udp::resolver resolver(d_io_service);
@@ -86,6 +150,13 @@ namespace gr {
         boost::asio::socket_base::reuse_address roption(true);
         d_socket->set_option(roption);
 
+#ifdef HAVE_SENDMMSG
+        for(int i = 0; i < BATCH_SIZE; i++) {
+          d_msgs[i].msg_hdr.msg_name = d_endpoint.data();
+          d_msgs[i].msg_hdr.msg_namelen = d_endpoint.size();
+        }
+#endif
+
         d_connected = true;
       }
     }
@@ -123,13 +194,56 @@ namespace gr {
 
       gr::thread::scoped_lock guard(d_mutex);  // protect d_socket
 
+#ifdef HAVE_SENDMMSG
+      // Hand the kernel a batch of datagrams at a time.
+      while(d_connected && bytes_sent < total_size) {
+        int n = 0;
+        for(ssize_t pos = bytes_sent; pos < total_size && n < BATCH_SIZE; pos += d_data_size) {
+          d_iov[2*n+1].iov_base = (void*)(in+pos);
+          d_iov[2*n+1].iov_len = std::min((ssize_t)d_data_size, total_size-pos);
+          n++;
+        }
+
+        // Headers are written for the whole batch but only count for
+        // the packets the kernel took.
+        uint64_t seqno = d_seqno, stream_offset = d_stream_offset;
+        ssize_t batch_start = bytes_sent;
+        if(d_header != UDP_HEADER_NONE) {
+          uint64_t now = now_ns();
+          for(int i = 0; i < n; i++)
+            make_header(&d_headers[i * UDP_SEQNO_HEADER_SIZE], d_iov[2*i+1].iov_len, now);
+        }
+
+        int nsent = sendmmsg(d_socket->native_handle(), &d_msgs[0], n, 0);
+        if(nsent < 0) {
+          d_seqno = seqno;
+          d_stream_offset = stream_offset;
+          if(errno == EINTR)
+            continue;
+          GR_LOG_ERROR(d_logger, boost::format("send error: %s") % strerror(errno));
+          return -1;
+        }
+
+        for(int i = 0; i < nsent; i++)
+          bytes_sent += d_iov[2*i+1].iov_len;
+        d_seqno = seqno + nsent;
+        d_stream_offset = stream_offset + (bytes_sent - batch_start);
+      }
+#endif
+
+      char header[UDP_SEQNO_HEADER_SIZE];
+      size_t hlen = header_length();
       while(bytes_sent <  total_size) {
-        bytes_to_send = std::min((ssize_t)d_payload_size, (total_size-bytes_sent));
+        bytes_to_send = std::min((ssize_t)d_data_size, (total_size-bytes_sent));
 
         if(d_connected) {
           try {
-            r = d_socket->send_to(boost::asio::buffer((void*)(in+bytes_sent), bytes_to_send),
-                                 d_endpoint);
+            if(hlen)
+              make_header(header, bytes_to_send, now_ns());
+            boost::array<boost::asio::const_buffer, 2> bufs = {{
+                boost::asio::buffer(header, hlen),
+                boost::asio::buffer((const void*)(in+bytes_sent), bytes_to_send) }};
+            r = d_socket->send_to(bufs, d_endpoint) - hlen;
           }
           catch(std::exception& e) {
             GR_LOG_ERROR(d_logger, boost::format("send error: %s") % e.what());
@@ -25,6 +25,11 @@
 
 #include <gnuradio/blocks/udp_sink.h>
 #include <boost/asio.hpp>
+#include <vector>
+
+#ifdef HAVE_SENDMMSG
+#include <sys/socket.h>
+#endif
 
 namespace gr {
   namespace blocks {
@@ -37,16 +42,31 @@ namespace gr {
       int    d_payload_size;    // maximum transmission unit (packet length)
       bool   d_eof;             // send zero-length packet on disconnect
       bool   d_connected;       // are we connected?
+      udp_header_type d_header;
+      int    d_data_size;       // payload bytes per packet after the header
+      uint64_t d_seqno;         // header: next sequence number
+      uint64_t d_stream_offset; // header: bytes sent since connect()
       gr::thread::mutex  d_mutex;    // protects d_socket and d_connected
 
       boost::asio::ip::udp::socket *d_socket;          // handle to socket
       boost::asio::ip::udp::endpoint d_endpoint;
       boost::asio::io_service d_io_service;
 
+#ifdef HAVE_SENDMMSG
+      static const int BATCH_SIZE;	// datagrams per sendmmsg()
+      std::vector<struct mmsghdr> d_msgs;
+      std::vector<struct iovec>   d_iov;	// header and payload per packet
+      std::vector<char>           d_headers;
+#endif
+
+      size_t header_length() const;
+      void make_header(char *p, size_t nbytes, uint64_t now_ns);
+
     public:
       udp_sink_impl(size_t itemsize,
                     const std::string &host, int port,
-                    int payload_size, bool eof);
+                    int payload_size, bool eof,
+                    udp_header_type header);
       ~udp_sink_impl();
 
       int payload_size() { return d_payload_size; }
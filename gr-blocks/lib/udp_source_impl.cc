@@ -40,22 +40,40 @@ namespace gr {
     udp_source::sptr
     udp_source::make(size_t itemsize,
                      const std::string &ipaddr, int port,
-                     int payload_size, bool eof)
+                     int payload_size, bool eof,
+                     int nthreads, udp_header_type header,
+                     udp_gap_mode gap_mode)
     {
       return gnuradio::get_initial_sptr
         (new udp_source_impl(itemsize, ipaddr, port,
-                             payload_size, eof));
+                             payload_size, eof, nthreads,
+                             header, gap_mode));
     }
 
     udp_source_impl::udp_source_impl(size_t itemsize,
                                      const std::string &host, int port,
-                                     int payload_size, bool eof)
+                                     int payload_size, bool eof,
+                                     int nthreads, udp_header_type header,
+                                     udp_gap_mode gap_mode)
       : sync_block("udp_source",
                       io_signature::make(0, 0, 0),
                       io_signature::make(1, 1, itemsize)),
         d_itemsize(itemsize), d_payload_size(payload_size),
-        d_eof(eof), d_connected(false), d_residual(0), d_sent(0), d_offset(0)
+        d_eof(eof), d_connected(false), d_residual(0), d_sent(0), d_offset(0),
+        d_nthreads(nthreads), d_header(header), d_gap_mode(gap_mode),
+        d_received(0), d_dropped(0), d_dropped_items(0),
+        d_last_received(0), d_last_dropped(0),
+        d_last_report(boost::posix_time::microsec_clock::universal_time())
     {
+#ifndef HAVE_RECVMMSG
+      if(d_header != UDP_HEADER_NONE)
+        throw std::invalid_argument("udp_source: headers need recvmmsg()");
+#endif
+      if(d_header != UDP_HEADER_NONE && d_payload_size <= (int)UDP_SEQNO_HEADER_SIZE)
+        throw std::invalid_argument("udp_source: payload_size too small for the header");
+
+      message_port_register_out(pmt::mp("stats"));
+
       // Give us some more room to play.
       d_rxbuf = new char[4*d_payload_size];
       d_residbuf = new char[BUF_SIZE_PAYLOADS*d_payload_size];
@@ -90,6 +108,11 @@ namespace gr {
                                                     boost::asio::ip::resolver_query_base::passive);
         d_endpoint = *resolver.resolve(query);
 
+#ifdef HAVE_RECVMMSG
+        d_receiver.reset(new udp_batch_receiver(d_endpoint.data(), d_endpoint.size(),
+                                                d_itemsize, d_payload_size, d_eof,
+                                                d_nthreads, d_header, d_gap_mode));
+#else
         d_socket = new boost::asio::ip::udp::socket(d_io_service);
         d_socket->open(d_endpoint.protocol());
 
@@ -103,6 +126,7 @@ namespace gr {
 
         start_receive();
         d_udp_thread = gr::thread::thread(boost::bind(&udp_source_impl::run_io_service, this));
+#endif
         d_connected = true;
       }
     }
@@ -115,6 +139,15 @@ namespace gr {
       if(!d_connected)
         return;
 
+#ifdef HAVE_RECVMMSG
+      if(d_receiver) {
+        counts(d_received, d_dropped, d_dropped_items);
+        d_receiver.reset();
+        d_connected = false;
+        return;
+      }
+#endif
+
       d_io_service.reset();
       d_io_service.stop();
       d_udp_thread.join();
@@ -129,10 +162,91 @@ namespace gr {
     int
     udp_source_impl::get_port(void)
     {
+#ifdef HAVE_RECVMMSG
+      if(d_receiver)
+        return d_receiver->port();
+#endif
       //return d_endpoint.port();
       return d_socket->local_endpoint().port();
     }
 
+    void
+    udp_source_impl::counts(uint64_t &received, uint64_t &dropped,
+                            uint64_t &dropped_items)
+    {
+      // Called with d_setlock held.
+      {
+        boost::lock_guard<gr::thread::mutex> lock(d_udp_mutex);
+        received = d_received;
+        dropped = d_dropped;
+      }
+      dropped_items = d_dropped_items;
+#ifdef HAVE_RECVMMSG
+      if(d_receiver) {
+        uint64_t r, d;
+        d_receiver->counts(r, d);
+        received += r;
+        dropped += d;
+        dropped_items += d_receiver->dropped_items();
+      }
+#endif
+    }
+
+    uint64_t
+    udp_source_impl::packets_received()
+    {
+      gr::thread::scoped_lock lock(d_setlock);
+      uint64_t received, dropped, items;
+      counts(received, dropped, items);
+      return received;
+    }
+
+    uint64_t
+    udp_source_impl::packets_dropped()
+    {
+      gr::thread::scoped_lock lock(d_setlock);
+      uint64_t received, dropped, items;
+      counts(received, dropped, items);
+      return dropped;
+    }
+
+    uint64_t
+    udp_source_impl::dropped_items()
+    {
+      gr::thread::scoped_lock lock(d_setlock);
+      uint64_t received, dropped, items;
+      counts(received, dropped, items);
+      return items;
+    }
+
+    void
+    udp_source_impl::report_stats()
+    {
+      // Called from work() with d_setlock held.
+      boost::posix_time::ptime now = boost::posix_time::microsec_clock::universal_time();
+      double dt = (now - d_last_report).total_microseconds() * 1e-6;
+      if(dt < 1.0)
+        return;
+
+      uint64_t received, dropped, items;
+      counts(received, dropped, items);
+
+      pmt::pmt_t stats = pmt::make_dict();
+      stats = pmt::dict_add(stats, pmt::mp("packets"), pmt::from_uint64(received));
+      stats = pmt::dict_add(stats, pmt::mp("dropped"), pmt::from_uint64(dropped));
+      stats = pmt::dict_add(stats, pmt::mp("packets_per_sec"),
+                            pmt::from_double((received - d_last_received) / dt));
+      stats = pmt::dict_add(stats, pmt::mp("dropped_per_sec"),
+                            pmt::from_double((dropped - d_last_dropped) / dt));
+      if(d_header != UDP_HEADER_NONE)
+        stats = pmt::dict_add(stats, pmt::mp("dropped_items"), pmt::from_uint64(items));
+      message_port_pub(pmt::mp("stats"), stats);
+
+      d_last_received = received;
+      d_last_dropped = dropped;
+      d_last_report = now;
+    }
+
     void
     udp_source_impl::start_receive()
     {
@@ -162,12 +276,14 @@ namespace gr {
             // data in the buffer if we've run out of room.
             if((int)(d_residual + bytes_transferred) >= (BUF_SIZE_PAYLOADS*d_payload_size)) {
               GR_LOG_WARN(d_logger, "Too much data; dropping packet.");
+              d_dropped++;
             }
             else {
               // otherwise, copy received data into local buffer for
               // copying later.
               memcpy(d_residbuf+d_residual, d_rxbuf, bytes_transferred);
               d_residual += bytes_transferred;
+              d_received++;
             }
           }
           d_cond_wait.notify_one();
@@ -185,6 +301,25 @@ namespace gr {
 
       char *out = (char*)output_items[0];
 
+      report_stats();
+
+#ifdef HAVE_RECVMMSG
+      if(d_receiver) {
+        int n = d_receiver->read(out, noutput_items, d_events);
+        for(size_t i = 0; n > 0 && i < d_events.size(); i++) {
+          const udp_batch_receiver::event &e = d_events[i];
+          if(e.time)
+            add_item_tag(0, nitems_written(0) + e.item, pmt::mp("rx_time"),
+                         pmt::make_tuple(pmt::from_uint64(e.value / 1000000000),
+                                         pmt::from_double((e.value % 1000000000) * 1e-9)));
+          else
+            add_item_tag(0, nitems_written(0) + e.item, pmt::mp("dropped_items"),
+                         pmt::from_uint64(e.value));
+        }
+        return n;
+      }
+#endif
+
       // Use async receive_from to get data from UDP buffer and wait
       // on a conditional signal before proceeding. We use this
       // because the conditional wait is interruptable while a
@@ -24,8 +24,10 @@
 #define INCLUDED_GR_UDP_SOURCE_IMPL_H
 
 #include <gnuradio/blocks/udp_source.h>
+#include "udp_batch_receiver.h"
 #include <boost/asio.hpp>
 #include <boost/format.hpp>
+#include <boost/scoped_ptr.hpp>
 #include <gnuradio/thread/thread.h>
 
 namespace gr {
@@ -43,6 +45,16 @@ namespace gr {
       ssize_t d_residual;     // hold information about number of bytes stored in residbuf
       ssize_t d_sent;         // track how much of d_residbuf we've outputted
       size_t  d_offset;       // point to residbuf location offset
+      int     d_nthreads;     // receive threads (batched path)
+      udp_header_type d_header;
+      udp_gap_mode    d_gap_mode;
+      uint64_t d_received;    // datagrams received (batched: before the last disconnect)
+      uint64_t d_dropped;     // and dropped
+      uint64_t d_dropped_items; // items lost in gaps before the last disconnect
+
+      // what we last reported on the stats port, and when
+      uint64_t d_last_received, d_last_dropped;
+      boost::posix_time::ptime d_last_report;
 
       static const int BUF_SIZE_PAYLOADS; //!< The d_residbuf size in multiples of d_payload_size
 
@@ -58,15 +70,25 @@ namespace gr {
       gr::thread::mutex d_udp_mutex;
       gr::thread::thread d_udp_thread;
 
+#ifdef HAVE_RECVMMSG
+      boost::scoped_ptr<udp_batch_receiver> d_receiver;
+      std::vector<udp_batch_receiver::event> d_events;
+#endif
+
       void start_receive();
       void handle_read(const boost::system::error_code& error,
                        size_t bytes_transferred);
       void run_io_service() { d_io_service.run(); }
+      void counts(uint64_t &received, uint64_t &dropped,
+                  uint64_t &dropped_items);
+      void report_stats();
 
     public:
       udp_source_impl(size_t itemsize,
                       const std::string &host, int port,
-                      int payload_size, bool eof);
+                      int payload_size, bool eof,
+                      int nthreads, udp_header_type header,
+                      udp_gap_mode gap_mode);
       ~udp_source_impl();
 
       void connect(const std::string &host, int port);
@@ -75,6 +97,10 @@ namespace gr {
       int payload_size() { return d_payload_size; }
       int get_port();
 
+      uint64_t packets_received();
+      uint64_t packets_dropped();
+      uint64_t dropped_items();
+
       int work(int noutput_items,
                gr_vector_const_void_star &input_items,
                gr_vector_void_star &output_items);
@@ -180,3 +180,90 @@ def parse_extra_dict(p, info, VERBOSE=False):
             print "{0}: {1}".format(key, val)
 
     return info
+
+# Must match METADATA_INDEX_VERSION in lib/file_meta_index.h, which
+# also describes the format.
+INDEX_VERSION = 0
+
+# WRITE AN INDEX (filename.idx) FOR A FILE THAT DOESN'T HAVE ONE
+def build_index(filename, detached=False, hdr_filename=None):
+    '''
+    Scans the headers of a file written by file_meta_sink and writes
+    the index file_meta_source uses to seek. Only the headers are left
+    of the tags, so a tag is taken to be where rx_rate or an extra
+    item changes value, or rx_time doesn't follow on from the segment
+    before. Returns the number of segments.
+    '''
+    if(detached):
+        if(hdr_filename is None):
+            hdr_filename = filename + ".hdr"
+        handle = open(hdr_filename, "rb")
+    else:
+        handle = open(filename, "rb")
+    index = open(filename + ".idx", "wb")
+
+    def write(*args):
+        index.write(pmt.serialize_str(pmt.make_tuple(*args)))
+
+    write(pmt.intern("gr_meta_index"), pmt.from_long(INDEX_VERSION))
+
+    hdr_pos = 0
+    data_pos = 0
+    item = 0
+    nsegs = 0
+    last = None
+    while(True):
+        header_str = handle.read(HEADER_LENGTH)
+        if(len(header_str) < HEADER_LENGTH):
+            break
+        header = pmt.deserialize_str(header_str)
+        info = parse_header(header, False)
+
+        extra = pmt.make_dict()
+        if(info["extra_len"] > 0):
+            extra_str = handle.read(info["extra_len"])
+            if(len(extra_str) < info["extra_len"]):
+                break
+            extra = pmt.deserialize_str(extra_str)
+
+        r = pmt.dict_ref(header, pmt.intern("rx_time"), pmt.PMT_NIL)
+        secs = pmt.to_uint64(pmt.tuple_ref(r, 0))
+        frac = pmt.to_double(pmt.tuple_ref(r, 1))
+        rate = info["rx_rate"]
+
+        if(not detached):
+            data_pos = hdr_pos + info["hdr_len"]
+        write(pmt.intern("seg"), pmt.from_uint64(hdr_pos),
+              pmt.from_uint64(data_pos), pmt.from_uint64(item),
+              pmt.from_uint64(secs), pmt.from_double(frac),
+              pmt.from_double(rate))
+
+        if(last is None or rate != last["rate"]):
+            write(pmt.intern("tag"), pmt.from_uint64(item), pmt.intern("rx_rate"))
+        if(last is not None):
+            dt = (secs - last["secs"]) + (frac - last["frac"])
+            gap = dt - last["nitems"] / last["rate"]
+        if(last is None or abs(gap) * rate > 0.5):
+            write(pmt.intern("tag"), pmt.from_uint64(item), pmt.intern("rx_time"))
+
+        items = pmt.dict_items(extra)
+        for i in xrange(pmt.length(items)):
+            key = pmt.car(pmt.nth(i, items))
+            val = pmt.cdr(pmt.nth(i, items))
+            if(last is None or not pmt.equal(val, pmt.dict_ref(last["extra"], key, pmt.PMT_NIL))):
+                write(pmt.intern("tag"), pmt.from_uint64(item), key)
+
+        last = {"secs": secs, "frac": frac, "rate": rate,
+                "nitems": info["nitems"], "extra": extra}
+        nsegs += 1
+        item += info["nitems"]
+        if(detached):
+            hdr_pos += info["hdr_len"]
+            data_pos += info["nbytes"]
+        else:
+            hdr_pos += info["hdr_len"] + info["nbytes"]
+            handle.seek(hdr_pos, 0)
+
+    index.close()
+    handle.close()
+    return nsegs
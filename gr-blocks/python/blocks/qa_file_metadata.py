@@ -119,6 +119,7 @@ class test_file_metadata(gr_unittest.TestCase):
         self.assertComplexTuplesAlmostEqual(vsnk.data(), ssnk.data(), 5)
 
 	os.remove(outfile)
+	os.remove(outfile + ".idx")
 
     def test_002(self):
         N = 1000
@@ -201,6 +202,109 @@ class test_file_metadata(gr_unittest.TestCase):
 
 	os.remove(outfile)
 	os.remove(outfile_hdr)
+	os.remove(outfile + ".idx")
+
+    def test_003_seek(self):
+        N = 10000
+        outfile = "test_out.dat"
+        samp_rate = 1000
+
+        tags = []
+        for offset, key, value in ((0, "rx_time", pmt.make_tuple(pmt.from_uint64(100), pmt.from_double(0))),
+                                   (1000, "burst", pmt.from_long(1)),
+                                   (4000, "burst", pmt.from_long(2)),
+                                   (7000, "burst", pmt.from_long(3))):
+            t = gr.tag_t()
+            t.offset = offset
+            t.key = pmt.intern(key)
+            t.value = value
+            tags.append(t)
+
+        src = blocks.vector_source_f(map(float, xrange(N)), tags=tags)
+        fsnk = blocks.file_meta_sink(gr.sizeof_float, outfile,
+                                     samp_rate, 1,
+                                     blocks.GR_FILE_FLOAT, False,
+                                     2500)
+        self.tb.connect(src, fsnk)
+        self.tb.run()
+        fsnk.close()
+
+        def read_from(seek):
+            tb = gr.top_block()
+            fsrc = blocks.file_meta_source(outfile)
+            vsnk = blocks.vector_sink_f()
+            self.assertTrue(seek(fsrc))
+            tb.connect(fsrc, vsnk)
+            tb.run()
+            return vsnk.data()
+
+        def check_seeks():
+            data = read_from(lambda fsrc: fsrc.seek_item(2600))
+            self.assertFloatTuplesAlmostEqual(data, map(float, xrange(2600, N)))
+            data = read_from(lambda fsrc: fsrc.seek_time(103, 0.5))
+            self.assertFloatTuplesAlmostEqual(data, map(float, xrange(3500, N)))
+            data = read_from(lambda fsrc: fsrc.seek_tag(pmt.intern("burst"), 1))
+            self.assertFloatTuplesAlmostEqual(data, map(float, xrange(4000, N)))
+
+        check_seeks()
+
+        # Without an index the source can't seek; rebuild it.
+        os.remove(outfile + ".idx")
+        fsrc = blocks.file_meta_source(outfile)
+        self.assertFalse(fsrc.seek_item(2600))
+        fsrc = None
+
+        parse_file_metadata.build_index(outfile)
+        check_seeks()
+
+        os.remove(outfile)
+        os.remove(outfile + ".idx")
+
+    def test_004_rx_time(self):
+        N = 10000
+        outfile = "test_out.dat"
+        samp_rate = 1000
+
+        # Headers are started both by tags and by max_segment_size;
+        # each one's rx_time has to follow on from the one before.
+        tags = []
+        for offset, key, value in ((0, "rx_time", pmt.make_tuple(pmt.from_uint64(100), pmt.from_double(0))),
+                                   (1000, "burst", pmt.from_long(1)),
+                                   (4000, "burst", pmt.from_long(2))):
+            t = gr.tag_t()
+            t.offset = offset
+            t.key = pmt.intern(key)
+            t.value = value
+            tags.append(t)
+
+        src = blocks.vector_source_f(map(float, xrange(N)), tags=tags)
+        fsnk = blocks.file_meta_sink(gr.sizeof_float, outfile,
+                                     samp_rate, 1,
+                                     blocks.GR_FILE_FLOAT, False,
+                                     2500)
+        self.tb.connect(src, fsnk)
+        self.tb.run()
+        fsnk.close()
+
+        handle = open(outfile, "rb")
+        item = 0
+        starts = []
+        while(True):
+            header_str = handle.read(parse_file_metadata.HEADER_LENGTH)
+            if(len(header_str) < parse_file_metadata.HEADER_LENGTH):
+                break
+            info = parse_file_metadata.parse_header(pmt.deserialize_str(header_str), False)
+            self.assertAlmostEqual(info["rx_time"], 100 + float(item) / samp_rate)
+            starts.append(item)
+            item += info["nitems"]
+            handle.seek(info["hdr_len"] + info["nbytes"] - parse_file_metadata.HEADER_LENGTH, 1)
+        handle.close()
+
+        self.assertEqual(starts, [0, 1000, 3500, 4000, 6500, 9000])
+        self.assertEqual(item, N)
+
+        os.remove(outfile)
+        os.remove(outfile + ".idx")
 
 if __name__ == '__main__':
     gr_unittest.run(test_file_metadata, "test_file_metadata.xml")
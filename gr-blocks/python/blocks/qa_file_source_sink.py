@@ -104,6 +104,41 @@ class test_file_source_sink(gr_unittest.TestCase):
 
         os.remove(filename)
 
+    def test_io_modes(self):
+        # More than one I/O buffer, then an append that doesn't end
+        # on a block boundary
+        src_data = [float(x) for x in range(300000)]
+        more_data = [float(x) for x in range(1001)]
+        expected_result = src_data + more_data
+
+        filename = "tmp.32f"
+        for sink_mode in (blocks.FILE_IO_ASYNC, blocks.FILE_IO_DIRECT):
+            for append, data in ((False, src_data), (True, more_data)):
+                tb = gr.top_block()
+                snk = blocks.file_sink(gr.sizeof_float, filename, append, sink_mode)
+                tb.connect(blocks.vector_source_f(data), snk)
+                tb.run()
+            self.assertEqual(4*len(expected_result), os.path.getsize(filename))
+
+            for source_mode in (blocks.FILE_IO_STDIO, blocks.FILE_IO_ASYNC,
+                                blocks.FILE_IO_DIRECT, blocks.FILE_IO_MMAP):
+                tb = gr.top_block()
+                src = blocks.file_source(gr.sizeof_float, filename, False, source_mode)
+                snk = blocks.vector_sink_f()
+                tb.connect(src, snk)
+                tb.run()
+                self.assertFloatTuplesAlmostEqual(expected_result, snk.data())
+
+                tb = gr.top_block()
+                src = blocks.file_source(gr.sizeof_float, filename, False, source_mode)
+                self.assertTrue(src.seek(-len(more_data), os.SEEK_END))
+                snk = blocks.vector_sink_f()
+                tb.connect(src, snk)
+                tb.run()
+                self.assertFloatTuplesAlmostEqual(more_data, snk.data())
+
+        os.remove(filename)
+
 if __name__ == '__main__':
     gr_unittest.run(test_file_source_sink, "test_file_source_sink.xml")
 
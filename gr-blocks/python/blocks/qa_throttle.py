@@ -21,6 +21,8 @@
 #
 
 from gnuradio import gr, gr_unittest, blocks
+import pmt
+import time
 
 class test_throttle(gr_unittest.TestCase):
 
@@ -34,5 +36,45 @@ class test_throttle(gr_unittest.TestCase):
         # Test that we can make the block
         op = blocks.throttle(gr.sizeof_gr_complex, 1)
 
+    def test_02_precise(self):
+        # 120000 items at 100000 items/s in bursts of at most 100, so
+        # that a stats report goes out after the first second
+        src_data = [float(x) for x in range(120000)]
+        src = blocks.vector_source_f(src_data)
+        op = blocks.throttle(gr.sizeof_float, 100000, precise=True,
+                             max_burst=100, spin_time=50e-6)
+        dst = blocks.vector_sink_f()
+        stats = blocks.message_debug()
+        self.tb.connect(src, op, dst)
+        self.tb.msg_connect(op, "stats", stats, "store")
+
+        start = time.time()
+        self.tb.run()
+        elapsed = time.time() - start
+
+        self.assertEqual(tuple(src_data), dst.data())
+        self.assertEqual(op.max_burst(), 100)
+        self.assertAlmostEqual(op.spin_time(), 50e-6)
+        # The last burst goes out at 1.199 s.
+        self.assertTrue(elapsed > 1.19)
+
+        self.assertTrue(stats.num_messages() >= 1)
+        msg = stats.get_message(0)
+        keys = [pmt.symbol_to_string(pmt.car(pmt.nth(i, pmt.dict_items(msg))))
+                for i in range(pmt.length(pmt.dict_items(msg)))]
+        self.assertEqual(sorted(keys),
+                         ["bursts", "jitter", "late_max", "late_mean", "rate"])
+        # Only the pacing is checked, not how close a loaded machine
+        # keeps to it: no item goes out before it's due, so at most
+        # one burst more than the rate allows shows up in the report's
+        # (at least 1 s long) interval, and no burst is over 100.
+        rate = pmt.to_double(pmt.dict_ref(msg, pmt.intern("rate"), pmt.PMT_NIL))
+        self.assertTrue(0 < rate < 100000 + 200)
+        bursts = pmt.to_uint64(pmt.dict_ref(msg, pmt.intern("bursts"), pmt.PMT_NIL))
+        self.assertTrue(bursts * 100 >= rate)
+        late_mean = pmt.to_double(pmt.dict_ref(msg, pmt.intern("late_mean"), pmt.PMT_NIL))
+        late_max = pmt.to_double(pmt.dict_ref(msg, pmt.intern("late_max"), pmt.PMT_NIL))
+        self.assertTrue(0 <= late_mean <= late_max)
+
 if __name__ == '__main__':
     gr_unittest.run(test_throttle, "test_throttle.xml")
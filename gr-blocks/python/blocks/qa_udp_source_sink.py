@@ -21,7 +21,11 @@
 #
 
 from gnuradio import gr, gr_unittest, blocks
+import pmt
 import os
+import socket
+import struct
+import time
 
 from threading import Timer
 
@@ -113,6 +117,147 @@ class test_udp_sink_source(gr_unittest.TestCase):
         self.assertEqual(expected_result, result_data)
         self.assert_(self.timeout)  # source ignores EOF?
 
+    def test_004_threads(self):
+        # Two senders, so two flows the receive threads share out
+        n_data = 10000
+        src_data = [float(x) for x in range(n_data)]
+
+        # An end-of-stream from one sender could overtake the other's
+        # data on another thread, so stop the receiver by hand.
+        udp_rcv = blocks.udp_source(gr.sizeof_float, '127.0.0.1', 0, 1472,
+                                    eof=False, nthreads=2)
+        dst = blocks.vector_sink_f()
+        self.tb_rcv.connect(udp_rcv, dst)
+
+        senders = []
+        for i in range(2):
+            src = blocks.vector_source_f(src_data[i::2])
+            udp_snd = blocks.udp_sink(gr.sizeof_float, '127.0.0.1',
+                                      udp_rcv.get_port(), 1472, eof=False)
+            self.tb_snd.connect(src, udp_snd)
+            senders.append(udp_snd)
+
+        self.tb_rcv.start()
+        self.tb_snd.run()
+        for udp_snd in senders:
+            udp_snd.disconnect()
+        time.sleep(0.5)
+        self.tb_rcv.stop()
+        self.tb_rcv.wait()
+
+        # Each sender's items are whole in every datagram, so what
+        # arrives is exactly what both of them sent, in some order.
+        self.assertEqual(sorted(src_data), sorted(dst.data()))
+        self.assert_(udp_rcv.packets_received() >= 2*(n_data/2)*gr.sizeof_float/1472)
+        self.assertEqual(udp_rcv.packets_dropped(), 0)
+
+    def test_005_header(self):
+        # Sequence-number headers, items split over datagrams
+        n_data = 10000
+        src_data = [float(x) for x in range(n_data)]
+        expected_result = tuple(src_data)
+
+        udp_rcv = blocks.udp_source(gr.sizeof_float, '127.0.0.1', 0, 1470,
+                                    eof=True, header=blocks.UDP_HEADER_SEQNO,
+                                    gap_mode=blocks.UDP_GAP_FILL)
+        udp_snd = blocks.udp_sink(gr.sizeof_float, '127.0.0.1',
+                                  udp_rcv.get_port(), 1470,
+                                  header=blocks.UDP_HEADER_SEQNO)
+
+        src = blocks.vector_source_f(src_data)
+        dst = blocks.vector_sink_f()
+        self.tb_snd.connect(src, udp_snd)
+        self.tb_rcv.connect(udp_rcv, dst)
+
+        self.tb_rcv.start()
+        self.tb_snd.run()
+        udp_snd.disconnect()
+        self.timeout = False
+        q = Timer(2.0,self.stop_rcv)
+        q.start()
+        self.tb_rcv.wait()
+        q.cancel()
+
+        self.assertEqual(expected_result, dst.data())
+        self.assert_(not self.timeout)
+        self.assertEqual(udp_rcv.dropped_items(), 0)
+
+        # Only the first item gets a time stamp when nothing is lost.
+        tags = dst.tags()
+        self.assertEqual(len(tags), 1)
+        self.assertEqual(tags[0].offset, 0)
+        self.assertEqual(pmt.symbol_to_string(tags[0].key), "rx_time")
+
+    def run_crafted(self, gap_mode):
+        # Datagrams with hand-built sequence-number headers. The
+        # stream is float k at byte 4k; each entry is (seqno, byte
+        # offset, payload bytes). The time stamp of datagram i is
+        # 100+i seconds plus 0.25.
+        datagrams = ((5, 2, 10),        # sync mid-item: items 1, 2
+                     (6, 12, 10),       # items 3, 4 and half of 5
+                     (8, 30, 10),       # seqno 7 missing: 5 to 7 lost; 8, 9
+                     (7, 22, 8),        # late: dropped
+                     (9, 40, 8),        # items 10, 11
+                     (9, 40, 8),        # duplicate: dropped
+                     (0, 0, 8))         # sender restarted: items 0, 1
+        stream = struct.pack('=16f', *range(16))
+
+        udp_rcv = blocks.udp_source(gr.sizeof_float, '127.0.0.1', 0, 1472,
+                                    eof=True, header=blocks.UDP_HEADER_SEQNO,
+                                    gap_mode=gap_mode)
+        dst = blocks.vector_sink_f()
+        self.tb_rcv.connect(udp_rcv, dst)
+        self.tb_rcv.start()
+
+        sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+        addr = ('127.0.0.1', udp_rcv.get_port())
+        for i, (seqno, offset, nbytes) in enumerate(datagrams):
+            header = struct.pack('>QQQ', seqno, offset, (100+i)*1000000000 + 250000000)
+            sock.sendto(header + stream[offset:offset+nbytes], addr)
+            time.sleep(0.02)
+        sock.sendto('\x00', addr)
+        sock.close()
+
+        self.timeout = False
+        q = Timer(2.0,self.stop_rcv)
+        q.start()
+        self.tb_rcv.wait()
+        q.cancel()
+        self.assert_(not self.timeout)
+
+        tags = []
+        for t in dst.tags():
+            key = pmt.symbol_to_string(t.key)
+            if key == "rx_time":
+                value = (pmt.to_uint64(pmt.tuple_ref(t.value, 0)),
+                         round(pmt.to_double(pmt.tuple_ref(t.value, 1)), 6))
+            else:
+                value = pmt.to_uint64(t.value)
+            tags.append((t.offset, key, value))
+        return stream, dst.data(), sorted(tags), udp_rcv.dropped_items()
+
+    def test_006_header_gaps(self):
+        # Gaps leave the items out and tag the first one after them.
+        stream, data, tags, dropped = self.run_crafted(blocks.UDP_GAP_TAG)
+        self.assertFloatTuplesAlmostEqual((1, 2, 3, 4, 8, 9, 10, 11, 0, 1), data)
+        self.assertEqual([(0, "rx_time", (100, 0.25)),
+                          (4, "dropped_items", 3),
+                          (4, "rx_time", (102, 0.25)),
+                          (8, "rx_time", (106, 0.25))], tags)
+        self.assertEqual(dropped, 3)
+
+    def test_007_header_fill(self):
+        # The lost bytes (22 to 29) come out as zeros, which keeps the
+        # items after them in place.
+        stream, data, tags, dropped = self.run_crafted(blocks.UDP_GAP_FILL)
+        expected = stream[4:22] + '\x00'*8 + stream[30:48] + stream[0:8]
+        self.assertEqual(struct.unpack('=13f', expected), data)
+        self.assertEqual([(0, "rx_time", (100, 0.25)),
+                          (4, "dropped_items", 3),
+                          (7, "rx_time", (102, 0.25)),
+                          (11, "rx_time", (106, 0.25))], tags)
+        self.assertEqual(dropped, 3)
+
     def stop_rcv(self):
         self.timeout = True
         self.tb_rcv.stop()
@@ -36,6 +36,7 @@
 #include "gnuradio/blocks/endian_swap.h"
 #include "gnuradio/blocks/file_descriptor_sink.h"
 #include "gnuradio/blocks/file_descriptor_source.h"
+#include "gnuradio/blocks/file_io_mode.h"
 #include "gnuradio/blocks/file_sink_base.h"
 #include "gnuradio/blocks/file_sink.h"
 #include "gnuradio/blocks/file_source.h"
@@ -62,6 +63,7 @@
 %include "gnuradio/blocks/endian_swap.h"
 %include "gnuradio/blocks/file_descriptor_sink.h"
 %include "gnuradio/blocks/file_descriptor_source.h"
+%include "gnuradio/blocks/file_io_mode.h"
 %include "gnuradio/blocks/file_sink_base.h"
 %include "gnuradio/blocks/file_sink.h"
 %include "gnuradio/blocks/file_source.h"
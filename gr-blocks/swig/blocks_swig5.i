@@ -60,6 +60,7 @@
 #include "gnuradio/blocks/transcendental.h"
 #include "gnuradio/blocks/tuntap_pdu.h"
 #include "gnuradio/blocks/uchar_to_float.h"
+#include "gnuradio/blocks/udp_header.h"
 #include "gnuradio/blocks/udp_sink.h"
 #include "gnuradio/blocks/udp_source.h"
 #include "gnuradio/blocks/unpack_k_bits.h"
@@ -103,6 +104,7 @@
 %include "gnuradio/blocks/transcendental.h"
 %include "gnuradio/blocks/tuntap_pdu.h"
 %include "gnuradio/blocks/uchar_to_float.h"
+%include "gnuradio/blocks/udp_header.h"
 %include "gnuradio/blocks/udp_sink.h"
 %include "gnuradio/blocks/udp_source.h"
 %include "gnuradio/blocks/unpack_k_bits.h"
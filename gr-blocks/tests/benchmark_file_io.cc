@@ -0,0 +1,149 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2016 Free Software Foundation, Inc.
+ *
+ * This file is part of GNU Radio
+ *
+ * GNU Radio is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * GNU Radio is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GNU Radio; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/*
+ * Write and then read back a file through file_sink and file_source
+ * in each I/O mode, reporting MB/s and, for writes, the longest time
+ * the flowgraph upstream of the sink went without its output being
+ * taken: what a real-time source would have to ride out without
+ * dropping samples.
+ *
+ * Usage: benchmark_file_io DIR [MiB]. Run it once with DIR on a
+ * tmpfs (e.g. /dev/shm) and once on a real disk; each run writes a
+ * MiB-sized (default 1024) file there and removes it. Sources
+ * reading a file just written through the page cache mostly measure
+ * the cache; FILE_IO_DIRECT always goes to the disk.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <gnuradio/top_block.h>
+#include <gnuradio/sync_block.h>
+#include <gnuradio/io_signature.h>
+#include <gnuradio/high_res_timer.h>
+#include <gnuradio/blocks/null_source.h>
+#include <gnuradio/blocks/null_sink.h>
+#include <gnuradio/blocks/head.h>
+#include <gnuradio/blocks/file_sink.h>
+#include <gnuradio/blocks/file_source.h>
+#include <algorithm>
+#include <string>
+
+// Copies its input, noting the longest gap between calls to work().
+class stall_probe : public gr::sync_block
+{
+  gr::high_res_timer_type d_last;
+
+public:
+  gr::high_res_timer_type d_longest;
+
+  stall_probe()
+    : gr::sync_block("stall_probe",
+                     gr::io_signature::make(1, 1, sizeof(gr_complex)),
+                     gr::io_signature::make(1, 1, sizeof(gr_complex))),
+      d_last(0), d_longest(0)
+  {}
+
+  int work(int noutput_items,
+           gr_vector_const_void_star &input_items,
+           gr_vector_void_star &output_items)
+  {
+    gr::high_res_timer_type now = gr::high_res_timer_now();
+    if(d_last)
+      d_longest = std::max(d_longest, now - d_last);
+    d_last = now;
+
+    memcpy(output_items[0], input_items[0], noutput_items * sizeof(gr_complex));
+    return noutput_items;
+  }
+};
+
+static const struct {
+  const char *name;
+  gr::blocks::file_io_mode mode;
+} modes[] = {
+  { "stdio",  gr::blocks::FILE_IO_STDIO },
+  { "async",  gr::blocks::FILE_IO_ASYNC },
+  { "direct", gr::blocks::FILE_IO_DIRECT },
+  { "mmap",   gr::blocks::FILE_IO_MMAP },
+};
+
+static double
+seconds_since(gr::high_res_timer_type start)
+{
+  return (double)(gr::high_res_timer_now() - start) / gr::high_res_timer_tps();
+}
+
+int
+main(int argc, char **argv)
+{
+  if(argc < 2) {
+    fprintf(stderr, "usage: %s DIR [MiB]\n", argv[0]);
+    return 1;
+  }
+  std::string filename = std::string(argv[1]) + "/benchmark_file_io.dat";
+  long mib = argc > 2 ? atol(argv[2]) : 1024;
+  long nitems = mib * (1 << 20) / sizeof(gr_complex);
+
+  for(size_t i = 0; i < sizeof(modes) / sizeof(modes[0]); i++) {
+    // Sinks don't map files; FILE_IO_MMAP writes as FILE_IO_ASYNC.
+    if(modes[i].mode != gr::blocks::FILE_IO_MMAP) {
+      gr::top_block_sptr tb = gr::make_top_block("write");
+      boost::shared_ptr<stall_probe> probe(new stall_probe());
+      gr::basic_block_sptr head = gr::blocks::head::make(sizeof(gr_complex), nitems);
+      tb->connect(gr::blocks::null_source::make(sizeof(gr_complex)), 0, head, 0);
+      tb->connect(head, 0, probe, 0);
+      tb->connect(probe, 0, gr::blocks::file_sink::make(sizeof(gr_complex), filename.c_str(),
+                                                        false, modes[i].mode), 0);
+
+      gr::high_res_timer_type start = gr::high_res_timer_now();
+      tb->run();
+      tb.reset();	// close the file
+      double secs = seconds_since(start);
+
+      printf("write  %-7s %9.1f MB/s   longest stall %8.2f ms\n",
+             modes[i].name, mib * 1.048576 / secs,
+             (double)probe->d_longest / gr::high_res_timer_tps() * 1e3);
+    }
+
+    gr::top_block_sptr tb = gr::make_top_block("read");
+    tb->connect(gr::blocks::file_source::make(sizeof(gr_complex), filename.c_str(),
+                                              false, modes[i].mode), 0,
+                gr::blocks::null_sink::make(sizeof(gr_complex)), 0);
+
+    gr::high_res_timer_type start = gr::high_res_timer_now();
+    tb->run();
+    double secs = seconds_since(start);
+
+    printf("read   %-7s %9.1f MB/s\n", modes[i].name, mib * 1.048576 / secs);
+  }
+
+  unlink(filename.c_str());
+  return 0;
+}
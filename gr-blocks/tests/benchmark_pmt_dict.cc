@@ -0,0 +1,171 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2016 Free Software Foundation, Inc.
+ *
+ * This file is part of GNU Radio
+ *
+ * GNU Radio is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * GNU Radio is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GNU Radio; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/*
+ * Time per dict_add, dict_ref and replacing dict_add on PMT
+ * dictionaries of 10, 100 and 10000 symbol keys, for the current
+ * dictionaries and for the a-lists they used to be (reproduced below
+ * as the reference).
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+
+#ifdef HAVE_SYS_RESOURCE_H
+#include <sys/resource.h>
+#endif
+
+#include <pmt/pmt.h>
+#include <boost/format.hpp>
+#include <algorithm>
+#include <vector>
+
+#define OPS_PER_SIZE 1000000	// operations timed at each size, at most
+#define MAX_ALIST_OPS 1000	// ... for the a-lists, which are O(n)
+
+static double
+timeval_to_double(const struct timeval *tv)
+{
+  return (double)tv->tv_sec + (double)tv->tv_usec * 1e-6;
+}
+
+static double
+cpu_time()
+{
+#ifdef HAVE_SYS_RESOURCE_H
+  struct rusage	rusage;
+  if(getrusage(RUSAGE_SELF, &rusage) < 0) {
+    perror("getrusage");
+    exit(1);
+  }
+  return timeval_to_double(&rusage.ru_utime) + timeval_to_double(&rusage.ru_stime);
+#else
+  return (double)clock() / CLOCKS_PER_SEC;
+#endif
+}
+
+// ----------------------------------------------------------------
+// The old a-list dictionary.
+
+static pmt::pmt_t
+alist_delete(const pmt::pmt_t &dict, const pmt::pmt_t &key)
+{
+  if(pmt::is_null(dict))
+    return dict;
+  if(pmt::eqv(pmt::caar(dict), key))
+    return pmt::cdr(dict);
+  return pmt::cons(pmt::car(dict), alist_delete(pmt::cdr(dict), key));
+}
+
+static pmt::pmt_t
+alist_add(const pmt::pmt_t &dict, const pmt::pmt_t &key, const pmt::pmt_t &value)
+{
+  if(pmt::is_pair(pmt::assv(key, dict)))
+    return pmt::acons(key, value, alist_delete(dict, key));
+  return pmt::acons(key, value, dict);
+}
+
+static pmt::pmt_t
+alist_ref(const pmt::pmt_t &dict, const pmt::pmt_t &key, const pmt::pmt_t &not_found)
+{
+  pmt::pmt_t p = pmt::assv(key, dict);
+  return pmt::is_pair(p) ? pmt::cdr(p) : not_found;
+}
+
+// ----------------------------------------------------------------
+
+struct dict_ops {
+  const char *name;
+  pmt::pmt_t (*make)();
+  pmt::pmt_t (*add)(const pmt::pmt_t &, const pmt::pmt_t &, const pmt::pmt_t &);
+  pmt::pmt_t (*ref)(const pmt::pmt_t &, const pmt::pmt_t &, const pmt::pmt_t &);
+  size_t max_ops;
+};
+
+static pmt::pmt_t make_alist() { return pmt::PMT_NIL; }
+
+static void
+report(const char *name, const char *op, size_t nkeys, size_t nops, double t)
+{
+  printf("%8s %-7s %6lu keys: %8.1f ns/op\n",
+         name, op, (unsigned long)nkeys, t / nops * 1e9);
+}
+
+static void
+run(const dict_ops &ops, const std::vector<pmt::pmt_t> &keys)
+{
+  size_t nkeys = keys.size();
+  size_t nops = std::min(ops.max_ops, (size_t)OPS_PER_SIZE);
+  pmt::pmt_t value = pmt::from_long(1);
+  pmt::pmt_t d;
+  long found = 0;
+
+  // add: build the dictionary from empty, at least once
+  size_t nrounds = std::max((size_t)1, nops / nkeys);
+  double start = cpu_time();
+  for(size_t r = 0; r < nrounds; r++) {
+    d = ops.make();
+    for(size_t i = 0; i < nkeys; i++)
+      d = ops.add(d, keys[i], value);
+  }
+  report(ops.name, "add", nkeys, nrounds * nkeys, cpu_time() - start);
+
+  // ref: look up the keys in a different order
+  std::vector<pmt::pmt_t> shuffled(keys);
+  std::random_shuffle(shuffled.begin(), shuffled.end());
+  start = cpu_time();
+  for(size_t i = 0; i < nops; i++)
+    found += pmt::to_long(ops.ref(d, shuffled[i % nkeys], pmt::PMT_NIL));
+  report(ops.name, "ref", nkeys, nops, cpu_time() - start);
+
+  // update: give existing keys new values
+  start = cpu_time();
+  for(size_t i = 0; i < nops; i++)
+    d = ops.add(d, shuffled[i % nkeys], value);
+  report(ops.name, "update", nkeys, nops, cpu_time() - start);
+
+  if(found != (long)nops)
+    fprintf(stderr, "%s: found %ld of %lu keys\n", ops.name, found, (unsigned long)nops);
+}
+
+int
+main(int argc, char **argv)
+{
+  static const size_t sizes[] = { 10, 100, 10000 };
+  dict_ops alist = { "a-list", make_alist, alist_add, alist_ref, MAX_ALIST_OPS };
+  dict_ops dict = { "dict", pmt::make_dict, pmt::dict_add, pmt::dict_ref, OPS_PER_SIZE };
+
+  for(size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+    std::vector<pmt::pmt_t> keys;
+    for(size_t i = 0; i < sizes[s]; i++)
+      keys.push_back(pmt::mp(str(boost::format("key-%d") % i)));
+
+    run(alist, keys);
+    run(dict, keys);
+  }
+  return 0;
+}
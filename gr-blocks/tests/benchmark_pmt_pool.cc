@@ -0,0 +1,111 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2016 Free Software Foundation, Inc.
+ *
+ * This file is part of GNU Radio
+ *
+ * GNU Radio is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * GNU Radio is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GNU Radio; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/*
+ * malloc/free pairs per second from several threads at once, each
+ * keeping a sliding window of live items, for pmt::pmt_pool and for
+ * operator new/delete.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <pmt/pmt_pool.h>
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+#define NTHREADS 8
+#define NITERATIONS 200000
+#define NLIVE 64
+
+// With no pool, use operator new/delete.
+static void
+churn(pmt::pmt_pool *pool, int id, bool *ok)
+{
+  void *live[NLIVE];
+  memset(live, 0, sizeof(live));
+
+  for(int i = 0; i < NITERATIONS; i++) {
+    int n = i % NLIVE;
+    if(live[n]) {
+      if(*(int *)live[n] != id)
+        *ok = false;
+      if(pool)
+        pool->free(live[n]);
+      else
+        ::operator delete(live[n]);
+    }
+    live[n] = pool ? pool->malloc() : ::operator new(64);
+    *(int *)live[n] = id;
+  }
+
+  for(int n = 0; n < NLIVE; n++) {
+    if(pool)
+      pool->free(live[n]);
+    else
+      ::operator delete(live[n]);
+  }
+}
+
+static double
+run_churn(pmt::pmt_pool *pool)
+{
+  bool ok[NTHREADS];
+  boost::thread_group threads;
+
+  boost::posix_time::ptime start = boost::posix_time::microsec_clock::universal_time();
+  for(int i = 0; i < NTHREADS; i++) {
+    ok[i] = true;
+    threads.create_thread(boost::bind(churn, pool, i, &ok[i]));
+  }
+  threads.join_all();
+  boost::posix_time::time_duration elapsed =
+    boost::posix_time::microsec_clock::universal_time() - start;
+
+  for(int i = 0; i < NTHREADS; i++) {
+    if(!ok[i]) {
+      fprintf(stderr, "thread %d: item overwritten\n", i);
+      exit(1);
+    }
+  }
+
+  return (double)NTHREADS * NITERATIONS / (elapsed.total_microseconds() * 1e-6);
+}
+
+int
+main(int argc, char **argv)
+{
+  pmt::pmt_pool pool(64, 64, 4096);
+
+  double pool_rate = run_churn(&pool);
+  double heap_rate = run_churn(0);
+
+  printf("%d threads: pmt_pool %.3e, new/delete %.3e malloc/free per sec\n",
+         NTHREADS, pool_rate, heap_rate);
+  return 0;
+}
@@ -0,0 +1,205 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2016 Free Software Foundation, Inc.
+ *
+ * This file is part of GNU Radio
+ *
+ * GNU Radio is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * GNU Radio is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GNU Radio; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/*
+ * Throughput of PDU (meta . vector) serialization with 1 KiB to 1 MiB
+ * of u8 or c32 data: through a std::stringbuf the way ZMQ and file
+ * metadata did it, with the old element-by-element writer for the
+ * vector (reproduced below as the reference), and into and out of a
+ * contiguous buffer.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#ifdef HAVE_SYS_RESOURCE_H
+#include <sys/resource.h>
+#endif
+
+#include <pmt/pmt.h>
+#include <pmt/pmt_serial_tags.h>
+#include <complex>
+#include <sstream>
+#include <vector>
+
+#define BYTES_PER_SIZE (32 * 1024 * 1024)	// data moved per test
+
+static double
+timeval_to_double(const struct timeval *tv)
+{
+  return (double)tv->tv_sec + (double)tv->tv_usec * 1e-6;
+}
+
+static double
+cpu_time()
+{
+#ifdef HAVE_SYS_RESOURCE_H
+  struct rusage	rusage;
+  if(getrusage(RUSAGE_SELF, &rusage) < 0) {
+    perror("getrusage");
+    exit(1);
+  }
+  return timeval_to_double(&rusage.ru_utime) + timeval_to_double(&rusage.ru_stime);
+#else
+  return (double)clock() / CLOCKS_PER_SEC;
+#endif
+}
+
+// ----------------------------------------------------------------
+// The old writer: one sputc per byte.
+
+static void
+old_u32(unsigned int i, std::streambuf &sb)
+{
+  sb.sputc((i >> 24) & 0xff);
+  sb.sputc((i >> 16) & 0xff);
+  sb.sputc((i >>  8) & 0xff);
+  sb.sputc((i >> 0) & 0xff);
+}
+
+static void
+old_f64(double d, std::streambuf &sb)
+{
+  uint64_t i;
+  memcpy(&i, &d, sizeof(i));
+  old_u32(i >> 32, sb);
+  old_u32(i, sb);
+}
+
+static void
+old_serialize_pdu(pmt::pmt_t pdu, std::streambuf &sb)
+{
+  pmt::pmt_t vec = pmt::cdr(pdu);
+  sb.sputc(PST_PAIR);
+  pmt::serialize(pmt::car(pdu), sb);
+  sb.sputc(PST_UNIFORM_VECTOR);
+  if(pmt::is_u8vector(vec)) {
+    sb.sputc(UVI_U8);
+    old_u32(pmt::length(vec), sb);
+    sb.sputc(1);
+    sb.sputc(0);
+    for(size_t i = 0; i < pmt::length(vec); i++)
+      sb.sputc(pmt::u8vector_ref(vec, i));
+  }
+  else {
+    sb.sputc(UVI_C32);
+    old_u32(pmt::length(vec), sb);
+    sb.sputc(1);
+    sb.sputc(0);
+    for(size_t i = 0; i < pmt::length(vec); i++) {
+      std::complex<float> c = pmt::c32vector_ref(vec, i);
+      old_f64(c.real(), sb);
+      old_f64(c.imag(), sb);
+    }
+  }
+}
+
+// ----------------------------------------------------------------
+
+static void
+report(const char *name, size_t nbytes, size_t nrounds, double t)
+{
+  printf("  %-24s %8.1f MB/s\n", name, (double)nbytes * nrounds / t * 1e-6);
+}
+
+static void
+run(pmt::pmt_t pdu, size_t nbytes)
+{
+  size_t nrounds = std::max((size_t)1, (size_t)BYTES_PER_SIZE / nbytes);
+  double start;
+  std::string s;
+
+  // reference: the old writer and the streambuf reader
+  start = cpu_time();
+  for(size_t r = 0; r < nrounds; r++) {
+    std::stringbuf sb("");
+    old_serialize_pdu(pdu, sb);
+    s = sb.str();
+  }
+  report("old serialize", nbytes, nrounds, cpu_time() - start);
+
+  if(s != pmt::serialize_str(pdu))
+    fprintf(stderr, "old and new serializations differ\n");
+
+  start = cpu_time();
+  for(size_t r = 0; r < nrounds; r++) {
+    std::stringbuf sb(s);
+    pmt::deserialize(sb);
+  }
+  report("streambuf deserialize", nbytes, nrounds, cpu_time() - start);
+
+  // the same, as serialize_str/deserialize_str
+  start = cpu_time();
+  for(size_t r = 0; r < nrounds; r++)
+    s = pmt::serialize_str(pdu);
+  report("serialize_str", nbytes, nrounds, cpu_time() - start);
+
+  start = cpu_time();
+  for(size_t r = 0; r < nrounds; r++)
+    pmt::deserialize_str(s);
+  report("deserialize_str", nbytes, nrounds, cpu_time() - start);
+
+  // caller's buffer
+  std::vector<uint8_t> buf(pmt::serialized_size(pdu));
+  start = cpu_time();
+  for(size_t r = 0; r < nrounds; r++)
+    pmt::serialize(pdu, &buf[0], buf.size());
+  report("serialize to buffer", nbytes, nrounds, cpu_time() - start);
+
+  size_t used;
+  start = cpu_time();
+  for(size_t r = 0; r < nrounds; r++)
+    pmt::deserialize(&buf[0], buf.size(), used);
+  report("deserialize from buffer", nbytes, nrounds, cpu_time() - start);
+
+  pmt::pmt_t blob = pmt::init_u8vector(buf.size(), buf);
+  start = cpu_time();
+  for(size_t r = 0; r < nrounds; r++) {
+    size_t offset = 0;
+    pmt::deserialize(blob, offset);
+  }
+  report("deserialize from u8vector", nbytes, nrounds, cpu_time() - start);
+}
+
+int
+main(int argc, char **argv)
+{
+  pmt::pmt_t meta = pmt::make_dict();
+  meta = pmt::dict_add(meta, pmt::mp("packet_len"), pmt::from_long(0));
+  meta = pmt::dict_add(meta, pmt::mp("rx_time"),
+                       pmt::cons(pmt::from_uint64(1), pmt::from_double(0.5)));
+
+  for(size_t nbytes = 1024; nbytes <= 1024 * 1024; nbytes *= 32) {
+    printf("%lu bytes of u8:\n", (unsigned long)nbytes);
+    run(pmt::cons(meta, pmt::make_u8vector(nbytes, 0x5a)), nbytes);
+
+    printf("%lu bytes of c32:\n", (unsigned long)nbytes);
+    run(pmt::cons(meta, pmt::make_c32vector(nbytes / 8, std::complex<float>(1, -1))), nbytes);
+  }
+  return 0;
+}
@@ -0,0 +1,121 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2016 Free Software Foundation, Inc.
+ *
+ * This file is part of GNU Radio
+ *
+ * GNU Radio is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * GNU Radio is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GNU Radio; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+/*
+ * How long it takes to build, start and stop a large generated
+ * flowgraph: one source fanned out to hierarchical channels of
+ * NDEPTH copy blocks and a sink each, 1k and 10k blocks in all, or
+ * the sizes given on the command line. Start is broken down by
+ * top_block::startup_profile().
+ *
+ * Every stream edge needs a doubly mapped buffer. An installation
+ * that settled on gr::vmcircbuf_sysv_shm_factory earlier (see
+ * ~/.gnuradio/prefs/vmcircbuf_default_factory) runs out of SysV
+ * segments at a few thousand; gr::vmcircbuf_mmap_arena_factory
+ * doesn't.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <gnuradio/top_block.h>
+#include <gnuradio/hier_block2.h>
+#include <gnuradio/io_signature.h>
+#include <gnuradio/high_res_timer.h>
+#include <gnuradio/blocks/null_source.h>
+#include <gnuradio/blocks/null_sink.h>
+#include <gnuradio/blocks/copy.h>
+
+#define NDEPTH 8		// copy blocks in each channel
+
+static double
+elapsed(gr::high_res_timer_type start)
+{
+  return (double)(gr::high_res_timer_now() - start) / gr::high_res_timer_tps();
+}
+
+// source -> nchannels x (NDEPTH copies -> sink)
+static gr::top_block_sptr
+make_graph(int nchannels)
+{
+  gr::top_block_sptr tb = gr::make_top_block("startup");
+  gr::basic_block_sptr src = gr::blocks::null_source::make(sizeof(float));
+
+  for(int c = 0; c < nchannels; c++) {
+    gr::hier_block2_sptr channel =
+      gr::make_hier_block2("channel",
+                           gr::io_signature::make(1, 1, sizeof(float)),
+                           gr::io_signature::make(0, 0, 0));
+    gr::basic_block_sptr prev = channel;
+    for(int i = 0; i < NDEPTH; i++) {
+      gr::basic_block_sptr b = gr::blocks::copy::make(sizeof(float));
+      channel->connect(prev, 0, b, 0);
+      prev = b;
+    }
+    channel->connect(prev, 0, gr::blocks::null_sink::make(sizeof(float)), 0);
+    tb->connect(src, 0, channel, 0);
+  }
+  return tb;
+}
+
+static void
+run(int nblocks)
+{
+  int nchannels = (nblocks - 1) / (NDEPTH + 1);
+
+  gr::high_res_timer_type start = gr::high_res_timer_now();
+  gr::top_block_sptr tb = make_graph(nchannels);
+  double build = elapsed(start);
+
+  start = gr::high_res_timer_now();
+  tb->start();
+  double started = elapsed(start);
+
+  start = gr::high_res_timer_now();
+  tb->stop();
+  tb->wait();
+  double stopped = elapsed(start);
+
+  printf("%6d blocks:  build: %6.3f  start: %6.3f  stop: %6.3f  (",
+         nchannels * (NDEPTH + 1) + 1, build, started, stopped);
+  std::vector<std::pair<std::string, double> > profile = tb->startup_profile();
+  for(size_t i = 0; i < profile.size(); i++)
+    printf("%s%s: %.3f", i ? "  " : "", profile[i].first.c_str(), profile[i].second);
+  printf(")\n");
+}
+
+int
+main(int argc, char **argv)
+{
+  if(argc > 1) {
+    for(int i = 1; i < argc; i++)
+      run(atoi(argv[i]));
+  }
+  else {
+    run(1000);
+    run(10000);
+  }
+  return 0;
+}
@@ -0,0 +1,148 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2016 Free Software Foundation, Inc.
+ *
+ * This file is part of GNU Radio
+ *
+ * GNU Radio is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * GNU Radio is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GNU Radio; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/*
+ * Tags/second through a flowgraph: a source that puts a tag on
+ * every PACKET_LEN-th item, a chain of NBLOCKS copy blocks that
+ * propagate them, and a null sink. The same chain without any tags
+ * shows what tag propagation costs blocks that never see one.
+ * Defaults to 1 << 25 items; pass another count on the command line.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#ifdef HAVE_SYS_RESOURCE_H
+#include <sys/resource.h>
+#endif
+
+#include <gnuradio/top_block.h>
+#include <gnuradio/sync_block.h>
+#include <gnuradio/io_signature.h>
+#include <gnuradio/high_res_timer.h>
+#include <gnuradio/blocks/copy.h>
+#include <gnuradio/blocks/null_sink.h>
+#include <algorithm>
+
+#define NBLOCKS 10		// copy blocks in the chain
+#define PACKET_LEN 64		// items between tags
+
+static double
+timeval_to_double(const struct timeval *tv)
+{
+  return (double)tv->tv_sec + (double)tv->tv_usec * 1e-6;
+}
+
+static double
+cpu_time()
+{
+#ifdef HAVE_SYS_RESOURCE_H
+  struct rusage	rusage;
+  if(getrusage(RUSAGE_SELF, &rusage) < 0) {
+    perror("getrusage");
+    exit(1);
+  }
+  return timeval_to_double(&rusage.ru_utime) + timeval_to_double(&rusage.ru_stime);
+#else
+  return (double)clock() / CLOCKS_PER_SEC;
+#endif
+}
+
+// Zeros, tagged every packet_len items (never if 0), until nitems.
+class tagged_source : public gr::sync_block
+{
+  uint64_t d_nitems;
+  int d_packet_len;
+  pmt::pmt_t d_key;
+  pmt::pmt_t d_srcid;
+
+public:
+  tagged_source(uint64_t nitems, int packet_len)
+    : gr::sync_block("tagged_source",
+                     gr::io_signature::make(0, 0, 0),
+                     gr::io_signature::make(1, 1, sizeof(float))),
+      d_nitems(nitems), d_packet_len(packet_len),
+      d_key(pmt::intern("packet_len")), d_srcid(pmt::intern(alias()))
+  {}
+
+  int work(int noutput_items,
+           gr_vector_const_void_star &input_items,
+           gr_vector_void_star &output_items)
+  {
+    uint64_t start = nitems_written(0);
+    if(start >= d_nitems)
+      return WORK_DONE;
+    noutput_items = std::min((uint64_t)noutput_items, d_nitems - start);
+
+    memset(output_items[0], 0, noutput_items * sizeof(float));
+
+    if(d_packet_len > 0) {
+      uint64_t o = (start + d_packet_len - 1) / d_packet_len * d_packet_len;
+      for(; o < start + noutput_items; o += d_packet_len)
+        add_item_tag(0, o, d_key, pmt::from_long(d_packet_len), d_srcid);
+    }
+    return noutput_items;
+  }
+};
+
+static void
+run(const char *name, uint64_t nitems, int packet_len)
+{
+  gr::top_block_sptr tb = gr::make_top_block("tag_propagation");
+  gr::basic_block_sptr prev =
+    gnuradio::get_initial_sptr(new tagged_source(nitems, packet_len));
+  for(int i = 0; i < NBLOCKS; i++) {
+    gr::basic_block_sptr b = gr::blocks::copy::make(sizeof(float));
+    tb->connect(prev, 0, b, 0);
+    prev = b;
+  }
+  tb->connect(prev, 0, gr::blocks::null_sink::make(sizeof(float)), 0);
+
+  double cpu_start = cpu_time();
+  gr::high_res_timer_type start = gr::high_res_timer_now();
+  tb->run();
+  double wall = (double)(gr::high_res_timer_now() - start) / gr::high_res_timer_tps();
+  double cpu = cpu_time() - cpu_start;
+
+  printf("%10s:  wall: %6.3f  cpu: %6.3f  items/sec: %10.3e", name, wall, cpu, nitems / wall);
+  if(packet_len > 0)
+    printf("  tags/sec: %10.3e", (double)(nitems / packet_len) * NBLOCKS / wall);
+  printf("\n");
+}
+
+int
+main(int argc, char **argv)
+{
+  uint64_t nitems = 1 << 25;
+  if(argc > 1)
+    nitems = strtoull(argv[1], 0, 0);
+
+  run("untagged", nitems, 0);
+  run("tagged", nitems, PACKET_LEN);
+  return 0;
+}
@@ -0,0 +1,132 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2016 Free Software Foundation, Inc.
+ *
+ * This file is part of GNU Radio
+ *
+ * GNU Radio is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * GNU Radio is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GNU Radio; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/*
+ * PDUs/second through a tagged stream block: 100-byte PDUs from a
+ * source that tags them, through a block that copies each one, into
+ * a null sink. Once with one PDU per call to work(), as usual, and
+ * once with packet vectors enabled.
+ * Defaults to 1M PDUs; pass another count on the command line.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <gnuradio/top_block.h>
+#include <gnuradio/sync_block.h>
+#include <gnuradio/tagged_stream_block.h>
+#include <gnuradio/io_signature.h>
+#include <gnuradio/high_res_timer.h>
+#include <gnuradio/blocks/null_sink.h>
+#include <algorithm>
+
+#define PACKET_LEN 100		// bytes per PDU
+
+static const char *s_len_key = "packet_len";
+
+// npackets PDUs of PACKET_LEN zeros
+class packet_source : public gr::sync_block
+{
+  uint64_t d_nitems;
+  pmt::pmt_t d_key;
+  pmt::pmt_t d_value;
+
+public:
+  packet_source(uint64_t npackets)
+    : gr::sync_block("packet_source",
+                     gr::io_signature::make(0, 0, 0),
+                     gr::io_signature::make(1, 1, sizeof(char))),
+      d_nitems(npackets * PACKET_LEN),
+      d_key(pmt::intern(s_len_key)), d_value(pmt::from_long(PACKET_LEN))
+  {}
+
+  int work(int noutput_items,
+           gr_vector_const_void_star &input_items,
+           gr_vector_void_star &output_items)
+  {
+    uint64_t start = nitems_written(0);
+    if(start >= d_nitems)
+      return WORK_DONE;
+    noutput_items = std::min((uint64_t)noutput_items, d_nitems - start);
+
+    memset(output_items[0], 0, noutput_items);
+
+    uint64_t o = (start + PACKET_LEN - 1) / PACKET_LEN * PACKET_LEN;
+    for(; o < start + noutput_items; o += PACKET_LEN)
+      add_item_tag(0, o, d_key, d_value);
+    return noutput_items;
+  }
+};
+
+class packet_copy : public gr::tagged_stream_block
+{
+public:
+  packet_copy(bool packet_vectors)
+    : gr::tagged_stream_block("packet_copy",
+                              gr::io_signature::make(1, 1, sizeof(char)),
+                              gr::io_signature::make(1, 1, sizeof(char)),
+                              s_len_key)
+  {
+    enable_packet_vectors(packet_vectors);
+  }
+
+  int work(int noutput_items,
+           gr_vector_int &ninput_items,
+           gr_vector_const_void_star &input_items,
+           gr_vector_void_star &output_items)
+  {
+    memcpy(output_items[0], input_items[0], ninput_items[0]);
+    return ninput_items[0];
+  }
+};
+
+static void
+run(const char *name, uint64_t npackets, bool packet_vectors)
+{
+  gr::top_block_sptr tb = gr::make_top_block("tagged_stream");
+  gr::basic_block_sptr copy = gnuradio::get_initial_sptr(new packet_copy(packet_vectors));
+  tb->connect(gnuradio::get_initial_sptr(new packet_source(npackets)), 0, copy, 0);
+  tb->connect(copy, 0, gr::blocks::null_sink::make(sizeof(char)), 0);
+
+  gr::high_res_timer_type start = gr::high_res_timer_now();
+  tb->run();
+  double wall = (double)(gr::high_res_timer_now() - start) / gr::high_res_timer_tps();
+
+  printf("%16s:  wall: %6.3f  PDUs/sec: %10.3e\n", name, wall, npackets / wall);
+}
+
+int
+main(int argc, char **argv)
+{
+  uint64_t npackets = 1000000;
+  if(argc > 1)
+    npackets = strtoull(argv[1], 0, 0);
+
+  run("one per call", npackets, false);
+  run("packet vectors", npackets, true);
+  return 0;
+}
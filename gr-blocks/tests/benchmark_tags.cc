@@ -0,0 +1,192 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2016 Free Software Foundation, Inc.
+ *
+ * This file is part of GNU Radio
+ *
+ * GNU Radio is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * GNU Radio is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GNU Radio; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/*
+ * Tags/second through a gr::buffer with one writer and two readers,
+ * one tag per "packet", compared against the std::multimap tag store
+ * gr::buffer used to have (reproduced below as the reference).
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+
+#ifdef HAVE_SYS_RESOURCE_H
+#include <sys/resource.h>
+#endif
+
+#include <gnuradio/buffer.h>
+#include <algorithm>
+#include <map>
+#include <vector>
+
+#define NTAGS 2000000
+#define PACKET_LEN 64		// items between tags
+#define CHUNK 4096		// items per simulated work call
+#define NREADERS 2
+
+static double
+timeval_to_double(const struct timeval *tv)
+{
+  return (double)tv->tv_sec + (double)tv->tv_usec * 1e-6;
+}
+
+static double
+cpu_time()
+{
+#ifdef HAVE_SYS_RESOURCE_H
+  struct rusage	rusage;
+  if(getrusage(RUSAGE_SELF, &rusage) < 0) {
+    perror("getrusage");
+    exit(1);
+  }
+  return timeval_to_double(&rusage.ru_utime) + timeval_to_double(&rusage.ru_stime);
+#else
+  return (double)clock() / CLOCKS_PER_SEC;
+#endif
+}
+
+static void
+report(const char *implementation_name, double total, size_t nseen)
+{
+  printf("%18s:  cpu: %6.3f  tags/sec: %10.3e  (%lu tags seen)\n",
+         implementation_name, total, NTAGS / total, (unsigned long)nseen);
+}
+
+// ----------------------------------------------------------------
+// The old gr::buffer tag handling: multimap + marked_deleted.
+
+static void
+multimap_tags()
+{
+  std::multimap<uint64_t,gr::tag_t> item_tags;
+  gr::thread::mutex mutex;
+  std::vector<gr::tag_t> v;
+  pmt::pmt_t key = pmt::intern("packet_len");
+  pmt::pmt_t value = pmt::from_long(PACKET_LEN);
+  size_t nseen = 0;
+  long id = 1;
+
+  double start = cpu_time();
+
+  uint64_t nwritten = 0;
+  uint64_t ntagged = 0;
+  while(ntagged < NTAGS) {
+    for(uint64_t o = nwritten; o < nwritten + CHUNK; o += PACKET_LEN) {
+      gr::tag_t t;
+      t.offset = o;
+      t.key = key;
+      t.value = value;
+      gr::thread::scoped_lock guard(mutex);
+      item_tags.insert(std::pair<uint64_t,gr::tag_t>(t.offset, t));
+      ntagged++;
+    }
+
+    for(int r = 0; r < NREADERS; r++) {
+      gr::thread::scoped_lock guard(mutex);
+      v.resize(0);
+      std::multimap<uint64_t,gr::tag_t>::iterator itr = item_tags.lower_bound(nwritten);
+      std::multimap<uint64_t,gr::tag_t>::iterator itr_end = item_tags.upper_bound(nwritten + CHUNK);
+      while(itr != itr_end) {
+        uint64_t item_time = itr->second.offset;
+        if(item_time >= nwritten && item_time < nwritten + CHUNK) {
+          if(std::find(itr->second.marked_deleted.begin(),
+                       itr->second.marked_deleted.end(), id) == itr->second.marked_deleted.end()) {
+            v.push_back(itr->second);
+            v.back().marked_deleted.clear();
+          }
+        }
+        itr++;
+      }
+      nseen += v.size();
+    }
+    nwritten += CHUNK;
+
+    // prune everything the readers are done with
+    gr::thread::scoped_lock guard(mutex);
+    std::multimap<uint64_t,gr::tag_t>::iterator itr(item_tags.begin()), tmp;
+    while(itr != item_tags.end() && itr->second.offset < nwritten) {
+      tmp = itr;
+      itr++;
+      item_tags.erase(tmp);
+    }
+  }
+
+  report("multimap", cpu_time() - start, nseen);
+}
+
+// ----------------------------------------------------------------
+// The current gr::buffer.
+
+static void
+buffer_tags()
+{
+  gr::buffer_sptr buf(gr::make_buffer(2 * CHUNK, sizeof(char), gr::block_sptr()));
+  gr::buffer_reader_sptr readers[NREADERS];
+  for(int r = 0; r < NREADERS; r++)
+    readers[r] = gr::buffer_add_reader(buf, 0, gr::block_sptr());
+
+  std::vector<gr::tag_t> v;
+  pmt::pmt_t key = pmt::intern("packet_len");
+  pmt::pmt_t value = pmt::from_long(PACKET_LEN);
+  size_t nseen = 0;
+
+  double start = cpu_time();
+
+  uint64_t ntagged = 0;
+  while(ntagged < NTAGS) {
+    uint64_t nwritten = buf->nitems_written();
+    for(uint64_t o = nwritten; o < nwritten + CHUNK; o += PACKET_LEN) {
+      gr::tag_t t;
+      t.offset = o;
+      t.key = key;
+      t.value = value;
+      buf->add_item_tag(t);
+      ntagged++;
+    }
+    buf->update_write_pointer(CHUNK);
+
+    for(int r = 0; r < NREADERS; r++) {
+      readers[r]->get_tags_in_range(v, nwritten, nwritten + CHUNK, -1);
+      nseen += v.size();
+      readers[r]->update_read_pointer(CHUNK);
+    }
+
+    // space_available() prunes the tags behind the slowest reader
+    gr::thread::scoped_lock guard(*buf->mutex());
+    buf->space_available();
+  }
+
+  report("gr::buffer", cpu_time() - start, nseen);
+}
+
+int
+main(int argc, char **argv)
+{
+  multimap_tags();
+  buffer_tags();
+  return 0;
+}
@@ -0,0 +1,133 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2016 Free Software Foundation, Inc.
+ *
+ * This file is part of GNU Radio
+ *
+ * GNU Radio is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * GNU Radio is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GNU Radio; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/*
+ * How evenly throttle paces its output: a null source through a
+ * throttle into a sink that notes when each burst of items arrives
+ * and how far that is from when its first item was due. Runs the
+ * default pacing, then precise pacing without and with a spin.
+ *
+ * Usage: benchmark_throttle [rate] [max_burst] [seconds] [spin_us],
+ * by default 1e6 items/s in bursts of 1000 for 2 seconds with a
+ * 50 us spin.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <gnuradio/top_block.h>
+#include <gnuradio/sync_block.h>
+#include <gnuradio/io_signature.h>
+#include <gnuradio/high_res_timer.h>
+#include <gnuradio/blocks/null_source.h>
+#include <gnuradio/blocks/head.h>
+#include <gnuradio/blocks/throttle.h>
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+// Records how late each burst arrives.
+class arrival_sink : public gr::sync_block
+{
+  double d_rate;
+  gr::high_res_timer_type d_start;
+
+public:
+  std::vector<double> d_late;	// seconds
+
+  arrival_sink(double rate)
+    : gr::sync_block("arrival_sink",
+                     gr::io_signature::make(1, 1, sizeof(float)),
+                     gr::io_signature::make(0, 0, 0)),
+      d_rate(rate), d_start(0)
+  {
+    d_late.reserve(1 << 20);
+  }
+
+  int work(int noutput_items,
+           gr_vector_const_void_star &input_items,
+           gr_vector_void_star &output_items)
+  {
+    gr::high_res_timer_type now = gr::high_res_timer_now();
+
+    // Time from the first arrival, when item 0 was due.
+    if(nitems_read(0) == 0)
+      d_start = now;
+    double t = double(now - d_start) / gr::high_res_timer_tps();
+    d_late.push_back(t - nitems_read(0) / d_rate);
+    return noutput_items;
+  }
+};
+
+static void
+run(const char *name, double rate, int max_burst, double secs,
+    bool precise, double spin)
+{
+  gr::top_block_sptr tb = gr::make_top_block("benchmark_throttle");
+  gr::basic_block_sptr head = gr::blocks::head::make(sizeof(float), (uint64_t)(rate * secs));
+  gr::blocks::throttle::sptr thr =
+    gr::blocks::throttle::make(sizeof(float), rate, true, precise, max_burst, spin);
+  boost::shared_ptr<arrival_sink> sink(new arrival_sink(rate));
+
+  tb->connect(gr::blocks::null_source::make(sizeof(float)), 0, head, 0);
+  tb->connect(head, 0, thr, 0);
+  tb->connect(thr, 0, sink, 0);
+  tb->run();
+
+  // Arrivals are late by a constant on top of the jitter; measure
+  // the jitter around the median.
+  std::vector<double> late = sink->d_late;
+  if(late.empty())
+    return;
+  std::sort(late.begin(), late.end());
+  double median = late[late.size() / 2];
+  double sum2 = 0, worst = 0;
+  for(size_t i = 0; i < late.size(); i++) {
+    double d = late[i] - median;
+    sum2 += d * d;
+    worst = std::max(worst, std::fabs(d));
+  }
+
+  printf("%-22s %8lu bursts  jitter %8.1f us rms  %8.1f us max  p99 %8.1f us\n",
+         name, (unsigned long)late.size(),
+         std::sqrt(sum2 / late.size()) * 1e6, worst * 1e6,
+         (late[(size_t)(late.size() * 0.99)] - median) * 1e6);
+}
+
+int
+main(int argc, char **argv)
+{
+  double rate = argc > 1 ? atof(argv[1]) : 1e6;
+  int max_burst = argc > 2 ? atoi(argv[2]) : 1000;
+  double secs = argc > 3 ? atof(argv[3]) : 2.0;
+  double spin = (argc > 4 ? atof(argv[4]) : 50.0) * 1e-6;
+
+  printf("%.0f items/s, bursts of %d, %.1f s\n", rate, max_burst, secs);
+  run("default", rate, max_burst, secs, false, 0);
+  run("precise", rate, max_burst, secs, true, 0);
+  run("precise with spin", rate, max_burst, secs, true, spin);
+  return 0;
+}
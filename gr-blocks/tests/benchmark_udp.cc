@@ -0,0 +1,109 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2016 Free Software Foundation, Inc.
+ *
+ * This file is part of GNU Radio
+ *
+ * GNU Radio is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * GNU Radio is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GNU Radio; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/*
+ * Push datagrams through udp_sink and udp_source on loopback as fast
+ * as the senders go, and report how many the source received and how
+ * many were dropped on the way.
+ *
+ * Usage: benchmark_udp [MiB] [senders] [threads] [payload] [header].
+ * Each of the senders (default 1) is its own udp_sink, so its own
+ * flow; the kernel spreads flows over the source's receive threads
+ * (default 1). The payload defaults to 1472 bytes. A header of 1
+ * sends UDP_HEADER_SEQNO headers and has the source tag gaps, to
+ * compare against the default of 0 (no header).
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <gnuradio/top_block.h>
+#include <gnuradio/high_res_timer.h>
+#include <gnuradio/blocks/null_source.h>
+#include <gnuradio/blocks/null_sink.h>
+#include <gnuradio/blocks/head.h>
+#include <gnuradio/blocks/udp_sink.h>
+#include <gnuradio/blocks/udp_source.h>
+#include <boost/thread/thread.hpp>
+
+int
+main(int argc, char **argv)
+{
+  long mib = argc > 1 ? atol(argv[1]) : 1024;
+  int nsenders = argc > 2 ? atoi(argv[2]) : 1;
+  int nthreads = argc > 3 ? atoi(argv[3]) : 1;
+  int payload = argc > 4 ? atoi(argv[4]) : 1472;
+  gr::blocks::udp_header_type header = (argc > 5 && atoi(argv[5])) ?
+    gr::blocks::UDP_HEADER_SEQNO : gr::blocks::UDP_HEADER_NONE;
+
+  // Bytes of data per datagram
+  int data = payload;
+  if(header == gr::blocks::UDP_HEADER_SEQNO)
+    data -= gr::blocks::UDP_SEQNO_HEADER_SIZE;
+
+  long nbytes = mib * (1 << 20);
+  long ndatagrams = nbytes / data;
+
+  gr::blocks::udp_source::sptr src =
+    gr::blocks::udp_source::make(1, "127.0.0.1", 0, payload, false, nthreads, header);
+  gr::top_block_sptr rx = gr::make_top_block("rx");
+  rx->connect(src, 0, gr::blocks::null_sink::make(1), 0);
+
+  gr::top_block_sptr tx = gr::make_top_block("tx");
+  for(int i = 0; i < nsenders; i++) {
+    gr::basic_block_sptr head =
+      gr::blocks::head::make(1, (ndatagrams / nsenders) * data);
+    tx->connect(gr::blocks::null_source::make(1), 0, head, 0);
+    tx->connect(head, 0, gr::blocks::udp_sink::make(1, "127.0.0.1", src->get_port(),
+                                                    payload, false, header), 0);
+  }
+
+  rx->start();
+  gr::high_res_timer_type start = gr::high_res_timer_now();
+  tx->run();
+  double secs = (double)(gr::high_res_timer_now() - start) / gr::high_res_timer_tps();
+
+  // Let the source drain what's queued.
+  boost::this_thread::sleep(boost::posix_time::milliseconds(200));
+  rx->stop();
+  rx->wait();
+
+  // udp_sink ends a datagram at the end of each work() call, so
+  // compare bytes rather than datagrams.
+  double sent = (double)(ndatagrams / nsenders) * nsenders * data;
+  double received = (double)src->nitems_written(0);
+  printf("%d sender(s), %d thread(s), %d byte payloads%s\n", nsenders, nthreads, payload,
+         header == gr::blocks::UDP_HEADER_SEQNO ? " with headers" : "");
+  printf("sent     %8.1f MB  %8.1f MB/s  ~%.0f datagrams/s\n",
+         sent * 1e-6, sent / secs * 1e-6, sent / data / secs);
+  printf("received %8.1f MB  (%.1f%%) in %llu datagrams, %llu dropped\n",
+         received * 1e-6, 100.0 * received / sent,
+         (unsigned long long)src->packets_received(),
+         (unsigned long long)src->packets_dropped());
+  if(header == gr::blocks::UDP_HEADER_SEQNO)
+    printf("         %llu bytes in gaps\n", (unsigned long long)src->dropped_items());
+  return 0;
+}
@@ -0,0 +1,208 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2016 Free Software Foundation, Inc.
+ *
+ * This file is part of GNU Radio
+ *
+ * GNU Radio is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * GNU Radio is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GNU Radio; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/*
+ * How often the thread-per-block scheduler wakes up each block of a
+ * chain: a source, NBLOCKS copy blocks and a null sink. Once while
+ * streaming as fast as it goes, and once for a second with the
+ * source producing nothing, when nobody should wake up at all.
+ * All of that twice: with a thread per block, and with the copy
+ * blocks fused into one thread ([Scheduler] fusion), which doesn't
+ * sleep on the blocks' own tpb_details, so the context switches of
+ * the whole process are counted as well.
+ * Defaults to 1 << 26 items; pass another count on the command line.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef HAVE_SYS_RESOURCE_H
+#include <sys/resource.h>
+#endif
+
+#include <gnuradio/top_block.h>
+#include <gnuradio/sync_block.h>
+#include <gnuradio/block_detail.h>
+#include <gnuradio/io_signature.h>
+#include <gnuradio/high_res_timer.h>
+#include <gnuradio/prefs.h>
+#include <gnuradio/blocks/copy.h>
+#include <gnuradio/blocks/null_sink.h>
+#include <boost/thread/thread.hpp>
+#include <algorithm>
+#include <vector>
+
+#define NBLOCKS 10		// copy blocks in the chain
+
+// Zeros until nitems; while paused, blocks in work() until resumed
+// so that it doesn't wake up itself.
+class pausable_source : public gr::sync_block
+{
+  uint64_t d_nitems;
+  gr::thread::mutex d_mutex;
+  gr::thread::condition_variable d_cond;
+  bool d_paused;
+
+public:
+  pausable_source(uint64_t nitems)
+    : gr::sync_block("pausable_source",
+                     gr::io_signature::make(0, 0, 0),
+                     gr::io_signature::make(1, 1, sizeof(float))),
+      d_nitems(nitems), d_paused(true)
+  {}
+
+  void resume()
+  {
+    gr::thread::scoped_lock guard(d_mutex);
+    d_paused = false;
+    d_cond.notify_all();
+  }
+
+  int work(int noutput_items,
+           gr_vector_const_void_star &input_items,
+           gr_vector_void_star &output_items)
+  {
+    {
+      gr::thread::scoped_lock guard(d_mutex);
+      while(d_paused)
+        d_cond.wait(guard);
+    }
+
+    uint64_t start = nitems_written(0);
+    if(start >= d_nitems)
+      return WORK_DONE;
+    noutput_items = std::min((uint64_t)noutput_items, d_nitems - start);
+    memset(output_items[0], 0, noutput_items * sizeof(float));
+    return noutput_items;
+  }
+};
+
+static double
+now()
+{
+  return (double)gr::high_res_timer_now() / gr::high_res_timer_tps();
+}
+
+// Voluntary context switches of all threads, i.e., times any of
+// them went to sleep.
+static uint64_t
+context_switches()
+{
+#ifdef HAVE_SYS_RESOURCE_H
+  struct rusage	rusage;
+  if(getrusage(RUSAGE_SELF, &rusage) < 0) {
+    perror("getrusage");
+    exit(1);
+  }
+  return rusage.ru_nvcsw;
+#else
+  return 0;
+#endif
+}
+
+static std::vector<uint64_t>
+counts(const std::vector<gr::block_sptr> &blocks, bool signals)
+{
+  std::vector<uint64_t> n;
+  for(size_t i = 0; i < blocks.size(); i++) {
+    gr::tpb_detail &tpb = blocks[i]->detail()->d_tpb;
+    n.push_back(signals ? tpb.nsignals() : tpb.nwakeups());
+  }
+  return n;
+}
+
+static void
+report(const char *name, const std::vector<gr::block_sptr> &blocks,
+       const std::vector<uint64_t> &wakeups0, const std::vector<uint64_t> &signals0,
+       uint64_t switches0, double secs)
+{
+  uint64_t switches = context_switches();
+  std::vector<uint64_t> wakeups = counts(blocks, false);
+  std::vector<uint64_t> signals = counts(blocks, true);
+
+  printf("%s (%.3f s), per second:\n", name, secs);
+  for(size_t i = 0; i < blocks.size(); i++) {
+    printf("  %-16s  wakeups: %10.1f  signals: %10.1f\n",
+           blocks[i]->alias().c_str(),
+           (wakeups[i] - wakeups0[i]) / secs, (signals[i] - signals0[i]) / secs);
+  }
+  printf("  %-16s  context switches: %10.1f\n", "(process)",
+         (switches - switches0) / secs);
+}
+
+static void
+run(const char *mode, uint64_t nitems)
+{
+  gr::top_block_sptr tb = gr::make_top_block("wakeups");
+  boost::shared_ptr<pausable_source> src =
+    gnuradio::get_initial_sptr(new pausable_source(nitems));
+  std::vector<gr::block_sptr> blocks;
+  blocks.push_back(src);
+  for(int i = 0; i < NBLOCKS; i++)
+    blocks.push_back(gr::blocks::copy::make(sizeof(float)));
+  blocks.push_back(gr::blocks::null_sink::make(sizeof(float)));
+  for(size_t i = 1; i < blocks.size(); i++)
+    tb->connect(blocks[i-1], 0, blocks[i], 0);
+
+  // Idle first: let the chain settle, then count for a second.
+  tb->start();
+  boost::this_thread::sleep(boost::posix_time::milliseconds(100));
+  std::vector<uint64_t> wakeups0 = counts(blocks, false);
+  std::vector<uint64_t> signals0 = counts(blocks, true);
+  uint64_t switches0 = context_switches();
+  double start = now();
+  boost::this_thread::sleep(boost::posix_time::seconds(1));
+  double secs = now() - start;
+  printf("%s, ", mode);
+  report("idle", blocks, wakeups0, signals0, switches0, secs);
+
+  wakeups0 = counts(blocks, false);
+  signals0 = counts(blocks, true);
+  switches0 = context_switches();
+  start = now();
+  src->resume();
+  tb->wait();
+  secs = now() - start;
+  printf("%s, ", mode);
+  report("streaming", blocks, wakeups0, signals0, switches0, secs);
+  printf("streaming: %10.3e items/sec\n", nitems / secs);
+}
+
+int
+main(int argc, char **argv)
+{
+  uint64_t nitems = 1 << 26;
+  if(argc > 1)
+    nitems = strtoull(argv[1], 0, 0);
+
+  gr::prefs *p = gr::prefs::singleton();
+  p->set_bool("Scheduler", "fusion", false);
+  run("thread per block", nitems);
+  p->set_bool("Scheduler", "fusion", true);
+  run("fused", nitems);
+  return 0;
+}
@@ -0,0 +1,124 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2016 Free Software Foundation, Inc.
+ *
+ * This file is part of GNU Radio
+ *
+ * GNU Radio is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * GNU Radio is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GNU Radio; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/*
+ * Throughput of a few common chains of blocks against the
+ * [Scheduler] working_set cap on the items per call to work(), from
+ * no cap (whatever fits in the buffers) down to a few KiB.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <gnuradio/top_block.h>
+#include <gnuradio/prefs.h>
+#include <gnuradio/high_res_timer.h>
+#include <gnuradio/blocks/null_source.h>
+#include <gnuradio/blocks/null_sink.h>
+#include <gnuradio/blocks/head.h>
+#include <gnuradio/blocks/multiply_const_ff.h>
+#include <gnuradio/blocks/add_const_ff.h>
+#include <gnuradio/blocks/multiply_const_cc.h>
+#include <gnuradio/blocks/add_const_cc.h>
+#include <gnuradio/blocks/conjugate_cc.h>
+
+#define NBLOCKS 8		// blocks in each chain
+
+static const char *working_sets[] = {
+  "0", "262144", "131072", "65536", "32768", "16384", "8192", "4096", "auto"
+};
+
+// source -> head -> NBLOCKS float blocks -> sink
+static gr::top_block_sptr
+float_chain(long nitems)
+{
+  gr::top_block_sptr tb = gr::make_top_block("float_chain");
+  gr::basic_block_sptr prev = gr::blocks::head::make(sizeof(float), nitems);
+  tb->connect(gr::blocks::null_source::make(sizeof(float)), 0, prev, 0);
+  for(int i = 0; i < NBLOCKS; i++) {
+    gr::basic_block_sptr b;
+    if(i % 2)
+      b = gr::blocks::add_const_ff::make(1.0);
+    else
+      b = gr::blocks::multiply_const_ff::make(0.5);
+    tb->connect(prev, 0, b, 0);
+    prev = b;
+  }
+  tb->connect(prev, 0, gr::blocks::null_sink::make(sizeof(float)), 0);
+  return tb;
+}
+
+// source -> head -> NBLOCKS complex blocks -> sink
+static gr::top_block_sptr
+complex_chain(long nitems)
+{
+  gr::top_block_sptr tb = gr::make_top_block("complex_chain");
+  gr::basic_block_sptr prev = gr::blocks::head::make(sizeof(gr_complex), nitems);
+  tb->connect(gr::blocks::null_source::make(sizeof(gr_complex)), 0, prev, 0);
+  for(int i = 0; i < NBLOCKS; i++) {
+    gr::basic_block_sptr b;
+    switch(i % 3) {
+    case 0: b = gr::blocks::multiply_const_cc::make(gr_complex(0.5, 0.5)); break;
+    case 1: b = gr::blocks::add_const_cc::make(gr_complex(1.0, 0.0)); break;
+    default: b = gr::blocks::conjugate_cc::make(); break;
+    }
+    tb->connect(prev, 0, b, 0);
+    prev = b;
+  }
+  tb->connect(prev, 0, gr::blocks::null_sink::make(sizeof(gr_complex)), 0);
+  return tb;
+}
+
+static void
+run_chain(const char *name, gr::top_block_sptr (*make)(long), long nitems)
+{
+  size_t n = sizeof(working_sets) / sizeof(working_sets[0]);
+  for(size_t i = 0; i < n; i++) {
+    gr::prefs::singleton()->set_string("Scheduler", "working_set", working_sets[i]);
+
+    // A fresh flowgraph each time; the executors read the pref when
+    // the flowgraph starts.
+    gr::top_block_sptr tb = make(nitems);
+    gr::high_res_timer_type start = gr::high_res_timer_now();
+    tb->run();
+    double secs = (double)(gr::high_res_timer_now() - start) / gr::high_res_timer_tps();
+
+    printf("%14s  working_set: %7s  %8.2f Msamples/sec\n",
+           name, working_sets[i], nitems / secs * 1e-6);
+  }
+}
+
+int
+main(int argc, char **argv)
+{
+  long nitems = 100000000;
+  if(argc > 1)
+    nitems = atol(argv[1]);
+
+  run_chain("float x8", float_chain, nitems);
+  run_chain("complex x8", complex_chain, nitems / 2);
+  return 0;
+}
@@ -72,12 +72,8 @@ namespace gr {
 
     void push_msg_sink_impl::handler(pmt::pmt_t msg)
     {
-      std::stringbuf sb("");
-      pmt::serialize( msg, sb );
-      std::string s = sb.str();
-      zmq::message_t zmsg(s.size());
-
-      memcpy(zmsg.data(), s.c_str(), s.size());
+      zmq::message_t zmsg(pmt::serialized_size(msg));
+      pmt::serialize(msg, zmsg.data(), zmsg.size());
       d_socket->send(zmsg);
     }
 
@@ -106,11 +106,8 @@ namespace gr {
 
             // create message copy and send
             pmt::pmt_t msg = delete_head_nowait(pmt::mp("in"));
-            std::stringbuf sb("");
-            pmt::serialize( msg, sb );
-            std::string s = sb.str();
-            zmq::message_t zmsg(s.size());
-            memcpy( zmsg.data(), s.c_str(), s.size() );
+            zmq::message_t zmsg(pmt::serialized_size(msg));
+            pmt::serialize(msg, zmsg.data(), zmsg.size());
             d_socket->send(zmsg);
           } // if req
         } // while !empty
@@ -108,9 +108,8 @@ namespace gr {
           zmq::message_t msg;
           d_socket->recv(&msg);
 
-          std::string buf(static_cast<char*>(msg.data()), msg.size());
-          std::stringbuf sb(buf);
-          pmt::pmt_t m = pmt::deserialize(sb);
+          size_t used;
+          pmt::pmt_t m = pmt::deserialize(msg.data(), msg.size(), used);
           message_port_pub(pmt::mp("out"), m);
 
         } else {